@@ -48,6 +48,7 @@ namespace xclemulation{
     mVerbosity = 0; 
     mServerPort = 0; 
     mKeepRunDir=false; 
+    mDeviceServerPool = 0;
   }
 
   static bool getBoolValue(std::string& value,bool defaultValue)
@@ -122,6 +123,15 @@ namespace xclemulation{
       {
         setKeepRunDir(getBoolValue(value,false));
       }
+      else if(name == "device_server_pool")
+      {
+        unsigned int poolSize = strtoll(value.c_str(),NULL,0);
+        setDeviceServerPool(poolSize);
+      }
+      else if(name == "ddr_snapshot_dir")
+      {
+        setDDRSnapshotDir(value);
+      }
       else if(name == "sim_dir")
       {
         setSimDir(value);
@@ -112,6 +112,8 @@ namespace xclemulation{
       inline void setVerbosityLevel(unsigned int verbosity)     { mVerbosity        = verbosity;     }
       inline void setServerPort(unsigned int serverPort)        { mServerPort       = serverPort;    }
       inline void setKeepRunDir(bool _mKeepRundir)              { mKeepRunDir = _mKeepRundir;        }    
+      inline void setDeviceServerPool(unsigned int poolSize)    { mDeviceServerPool = poolSize;      }
+      inline void setDDRSnapshotDir(std::string& dir)           { mDDRSnapshotDir = dir;             }
       
       inline bool isDiagnosticsEnabled()        const { return mDiagnostics;    }
       inline bool isUMRChecksEnabled()          const { return mUMRChecks;      }
@@ -130,6 +132,8 @@ namespace xclemulation{
       inline bool isKeepRunDirEnabled()         const { return mKeepRunDir;       }    
       inline bool isInfosToBePrintedOnConsole() const { return mPrintInfosInConsole;   }  
       inline unsigned int getServerPort()       const { return mServerPort;      }
+      inline unsigned int getDeviceServerPool() const { return mDeviceServerPool; }
+      inline std::string getDDRSnapshotDir()    const { return mDDRSnapshotDir;   }
       inline bool isErrorsToBePrintedOnConsole()   const { return mPrintErrorsInConsole;  }
       inline bool isWarningsToBePrintedOnConsole() const { return mPrintWarningsInConsole;}
       
@@ -156,6 +160,8 @@ namespace xclemulation{
       bool mVerbosity;
       unsigned int mServerPort;
       bool mKeepRunDir;
+      unsigned int mDeviceServerPool;
+      std::string mDDRSnapshotDir;
       
      
       config();
@@ -102,6 +102,17 @@ namespace xclemulation {
     uint32_t flags;
   };
 
+  /*
+   * Contiguous 32-bit kernel control registers written by one block of
+   * xclWriteRegisters
+   */
+  struct register_block
+  {
+    uint64_t offset;
+    const void* data;
+    size_t size;
+  };
+
   /*
    * Opcodes for the embedded scheduler provided by the client to the driver
    */
@@ -18,11 +18,11 @@
 
 namespace xclemulation {
   MemoryManager::MemoryManager(uint64_t size, uint64_t start,
-      unsigned alignment) : mSize(size), mStart(start), mAlignment(alignment),
-  mCoalesceThreshold(4), mFreeSize(0)
+      unsigned alignment) : mFreeBinMask(0), mSize(size), mStart(start), mAlignment(alignment),
+  mFreeSize(0)
   {
     assert(start % alignment == 0);
-    mFreeBufferList.push_back(std::make_pair(mStart, mSize));
+    addFree(mStart, mSize);
     mFreeSize = mSize;
   }
 
@@ -31,12 +31,35 @@ namespace xclemulation {
 
   }
 
+  unsigned MemoryManager::bin(uint64_t size)
+  {
+    return 63 - __builtin_clzll(size);
+  }
+
+  void MemoryManager::addFree(uint64_t start, uint64_t size)
+  {
+    if (size == 0)
+      return;
+    unsigned b = bin(size);
+    mFreeBuffers.emplace(start, size);
+    mFreeBins[b].emplace(size, start);
+    mFreeBinMask |= (1ull << b);
+  }
+
+  void MemoryManager::removeFree(BufferMap::iterator i)
+  {
+    unsigned b = bin(i->second);
+    mFreeBins[b].erase(std::make_pair(i->second, i->first));
+    if (mFreeBins[b].empty())
+      mFreeBinMask &= ~(1ull << b);
+    mFreeBuffers.erase(i);
+  }
+
   uint64_t MemoryManager::alloc(size_t& origSize, unsigned int paddingFactor)
   {
     if (origSize == 0)
       origSize = mAlignment;
 
-    uint64_t result = mNull;
     const size_t mod_size = origSize % mAlignment;
     const size_t pad = (mod_size > 0) ? (mAlignment - mod_size) : 0;
     origSize += pad;
@@ -45,100 +68,76 @@ namespace xclemulation {
 
     std::lock_guard<std::mutex> lock(mMemManagerMutex);
 
-    for (PairList::iterator i = mFreeBufferList.begin(), e = mFreeBufferList.end(); i != e; ++i) 
+    // The smallest fitting block is either in the bin of size or, failing
+    // that, the smallest block of the next non empty bin
+    unsigned b = bin(size);
+    Bin::iterator fit = mFreeBins[b].lower_bound(std::make_pair(size, uint64_t(0)));
+    if (fit == mFreeBins[b].end())
     {
-      if (i->second < size)
-        continue;
-      result = i->first;
-      if (i->second > size) 
-      {
-        // Resize the existing entry in freelist
-        i->first += size;
-        i->second -= size;
-      }
-      else 
-      {
-        // remove the exact match found
-        mFreeBufferList.erase(i);
-      }
-      mBusyBufferList.push_back(std::make_pair(result, size));
-      mFreeSize -= size;
-      break;
+      uint64_t larger = (b + 1 < mBinCount) ? (mFreeBinMask & (~0ull << (b + 1))) : 0;
+      if (!larger)
+        return mNull;
+      b = __builtin_ctzll(larger);
+      fit = mFreeBins[b].begin();
     }
+
+    const uint64_t result = fit->second;
+    const uint64_t blockSize = fit->first;
+    removeFree(mFreeBuffers.find(result));
+    addFree(result + size, blockSize - size);
+    mBusyBuffers.emplace(result, size);
+    mFreeSize -= size;
     return result;
   }
 
   void MemoryManager::free(uint64_t buf)
   {
     std::lock_guard<std::mutex> lock(mMemManagerMutex);
-    PairList::iterator i = find(buf);
-    if (i == mBusyBufferList.end())
+    BufferMap::iterator i = mBusyBuffers.find(buf);
+    if (i == mBusyBuffers.end())
       return;
-    mFreeSize += i->second;
-    mFreeBufferList.push_back(std::make_pair(i->first, i->second));
-    mBusyBufferList.erase(i);
-    if (mFreeBufferList.size() > mCoalesceThreshold) {
-      coalesce();
-    }
-  }
-
-
-  void MemoryManager::coalesce()
-  {
-    // First sort the free buffers and then attempt to coalesce the neighbors
-    mFreeBufferList.sort();
-
-    PairList::iterator curr = mFreeBufferList.begin();
-    PairList::iterator next = curr;
-    ++next;
-    PairList::iterator last = mFreeBufferList.end();
-    while (next != last) {
-      if ((curr->first + curr->second) != next->first) {
-        // Non contiguous blocks
-        curr = next;
-        ++next;
-        continue;
+    uint64_t start = i->first;
+    uint64_t size = i->second;
+    mFreeSize += size;
+    mBusyBuffers.erase(i);
+
+    // Merge with the free neighbours
+    BufferMap::iterator next = mFreeBuffers.lower_bound(start);
+    if (next != mFreeBuffers.begin())
+    {
+      BufferMap::iterator prev = std::prev(next);
+      if (prev->first + prev->second == start)
+      {
+        start = prev->first;
+        size += prev->second;
+        removeFree(prev);
       }
-      // Coalesce curr and next
-      curr->second += next->second;
-      mFreeBufferList.erase(next);
-      next = curr;
-      ++next;
     }
-  }
-
-
-  MemoryManager::PairList::iterator MemoryManager::find(uint64_t buf)
-  {
-#if GCC_VERSION >= 40800
-    PairList::iterator i = std::find_if(mBusyBufferList.begin(), mBusyBufferList.end(), [&] (const PairList::value_type& s)
-        { return s.first == buf; });
-#else
-    PairList::iterator i = mBusyBufferList.begin();
-    PairList::iterator last  = mBusyBufferList.end();
-    while(i != last) {
-      if (i->first == buf)
-        break;
-      ++i;
+    if (next != mFreeBuffers.end() && start + size == next->first)
+    {
+      size += next->second;
+      removeFree(next);
     }
-#endif
-    return i;
+    addFree(start, size);
   }
 
   void MemoryManager::reset()
   {
     std::lock_guard<std::mutex> lock(mMemManagerMutex);
-    mFreeBufferList.clear();
-    mBusyBufferList.clear();
-    mFreeBufferList.push_back(std::make_pair(mStart, mSize));
-    mFreeSize = 0;
+    mFreeBuffers.clear();
+    for (auto& b : mFreeBins)
+      b.clear();
+    mFreeBinMask = 0;
+    mBusyBuffers.clear();
+    addFree(mStart, mSize);
+    mFreeSize = mSize;
   }
 
   std::pair<uint64_t, uint64_t> MemoryManager::lookup(uint64_t buf)
   {
     std::lock_guard<std::mutex> lock(mMemManagerMutex);
-    PairList::iterator i = find(buf);
-    if (i != mBusyBufferList.end())
+    BufferMap::iterator i = mBusyBuffers.find(buf);
+    if (i != mBusyBuffers.end())
       return *i;
     // Compiler bug -- Some versions of GCC C++11 compiler do not
     // like mNull directly inside std::make_pair, so capture mNull
@@ -18,7 +18,8 @@
 #define _HWEM_MEMORY_MANAGER_H_
 
 #include <mutex>
-#include <list>
+#include <map>
+#include <set>
 #include <cassert>
 #include <algorithm>
 
@@ -27,19 +28,25 @@
 
 namespace xclemulation
 {
+    // Best fit allocator.  Free blocks are kept by address, to merge a freed
+    // block with its neighbours right away, and in bins by log2 of their
+    // size, to find the smallest block that fits without a scan.
     class MemoryManager 
     {
+        static const unsigned mBinCount = 64;
+        typedef std::map<uint64_t, uint64_t> BufferMap;
+        typedef std::set<std::pair<uint64_t, uint64_t> > Bin;
+
         std::mutex mMemManagerMutex;
-        std::list<std::pair<uint64_t, uint64_t> > mFreeBufferList;
-        std::list<std::pair<uint64_t, uint64_t> > mBusyBufferList;
+        BufferMap mFreeBuffers;       // start -> size
+        Bin mFreeBins[mBinCount];     // (size, start) of free blocks
+        uint64_t mFreeBinMask;        // bit n set if mFreeBins[n] is not empty
+        BufferMap mBusyBuffers;       // start -> size including padding
         uint64_t mSize;
         uint64_t mStart;
         uint64_t mAlignment;
-        const unsigned mCoalesceThreshold;
         uint64_t mFreeSize;
 
-        typedef std::list<std::pair<uint64_t, uint64_t> > PairList;
-
     public:
         static const uint64_t mNull = 0xffffffffffffffffull;
 
@@ -58,8 +65,9 @@ namespace xclemulation
         std::pair<uint64_t, uint64_t>lookup(uint64_t buf);
 
     private:
-        void coalesce();
-        PairList::iterator find(uint64_t buf);
+        static unsigned bin(uint64_t size);
+        void addFree(uint64_t start, uint64_t size);
+        void removeFree(BufferMap::iterator i);
     };
 }
 
@@ -0,0 +1,220 @@
+/**
+ * Copyright (C) 2016-2018 Xilinx, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "shared_memory.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+namespace xclemulation {
+
+  static int createMemFd(const char* name)
+  {
+#ifdef SYS_memfd_create
+    return syscall(SYS_memfd_create, name, MFD_CLOEXEC);
+#else
+    return -1;
+#endif
+  }
+
+  // Shared mapping of a new memfd of size bytes, the device process opens
+  // the descriptor through /proc, it is not inherited across exec
+  static char* mapMemFd(const char* name, uint64_t size, int& fd, std::string& fileName)
+  {
+    fd = createMemFd(name);
+    if (fd < 0)
+      return nullptr;
+
+    // memfd pages are only allocated when touched
+    if (ftruncate(fd, size) == -1) {
+      close(fd);
+      return nullptr;
+    }
+    void* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_NORESERVE, fd, 0);
+    if (data == MAP_FAILED) {
+      close(fd);
+      return nullptr;
+    }
+    fileName = "/proc/" + std::to_string(getpid()) + "/fd/" + std::to_string(fd);
+    return static_cast<char*>(data);
+  }
+
+  bool SharedDeviceMemory::addRegion(uint64_t base, uint64_t size, uint32_t space)
+  {
+    if (!size)
+      return false;
+
+    Region region;
+    region.data = mapMemFd("xcl_emu_ddr", size, region.fd, region.fileName);
+    if (!region.data)
+      return false;
+    region.base = base;
+    region.size = size;
+    region.space = space;
+    mRegions.push_back(region);
+    return true;
+  }
+
+  void SharedDeviceMemory::release()
+  {
+    for (auto& region : mRegions) {
+      munmap(region.data, region.size);
+      close(region.fd);
+    }
+    mRegions.clear();
+    mEnabled = false;
+  }
+
+  char* SharedDeviceMemory::find(uint64_t addr, size_t size, uint32_t space) const
+  {
+    if (!mEnabled)
+      return nullptr;
+    for (auto& region : mRegions) {
+      if (region.space != space || addr < region.base)
+        continue;
+      uint64_t offset = addr - region.base;
+      if (offset >= region.size || size > region.size - offset)
+        continue;
+      return region.data + offset;
+    }
+    return nullptr;
+  }
+
+  bool SharedDeviceMemory::write(uint64_t addr, const void* src, size_t size, uint32_t space)
+  {
+    char* dst = find(addr, size, space);
+    if (!dst)
+      return false;
+    std::memcpy(dst, src, size);
+    return true;
+  }
+
+  bool SharedDeviceMemory::read(uint64_t addr, void* dst, size_t size, uint32_t space)
+  {
+    char* src = find(addr, size, space);
+    if (!src)
+      return false;
+    std::memcpy(dst, src, size);
+    return true;
+  }
+
+  static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "stream rings need lock free 64 bit atomics");
+  static_assert(sizeof(StreamRingHeader) <= StreamRing::DATA_OFFSET, "stream ring header too large");
+
+  static inline uint64_t recordBytes(uint32_t len)
+  {
+    return sizeof(StreamRecord) + ((uint64_t(len) + 7) & ~uint64_t(7));
+  }
+
+  bool StreamRing::create(uint64_t size)
+  {
+    release();
+    uint64_t data = 4096;
+    while (data < size)
+      data <<= 1;
+
+    char* base = mapMemFd("xcl_emu_stream", DATA_OFFSET + data, mFd, mFileName);
+    if (!base)
+      return false;
+    mHeader = new (base) StreamRingHeader;
+    mHeader->magic = MAGIC;
+    mHeader->size = data;
+    mHeader->head.store(0, std::memory_order_relaxed);
+    mHeader->tail.store(0, std::memory_order_relaxed);
+    mData = base + DATA_OFFSET;
+    mSize = data;
+    return true;
+  }
+
+  void StreamRing::release()
+  {
+    if (!mHeader)
+      return;
+    munmap(mHeader, DATA_OFFSET + mSize);
+    close(mFd);
+    mFd = -1;
+    mHeader = nullptr;
+    mData = nullptr;
+    mSize = 0;
+    mFileName.clear();
+  }
+
+  uint32_t StreamRing::maxPayload() const
+  {
+    uint64_t max = mSize - sizeof(StreamRecord);
+    return max > UINT32_MAX ? UINT32_MAX & ~7U : uint32_t(max);
+  }
+
+  void StreamRing::copyIn(uint64_t pos, const void* src, size_t size)
+  {
+    uint64_t offset = pos & (mSize - 1);
+    size_t first = std::min<uint64_t>(size, mSize - offset);
+    std::memcpy(mData + offset, src, first);
+    if (first < size)
+      std::memcpy(mData, static_cast<const char*>(src) + first, size - first);
+  }
+
+  void StreamRing::copyOut(uint64_t pos, void* dst, size_t size) const
+  {
+    uint64_t offset = pos & (mSize - 1);
+    size_t first = std::min<uint64_t>(size, mSize - offset);
+    std::memcpy(dst, mData + offset, first);
+    if (first < size)
+      std::memcpy(static_cast<char*>(dst) + first, mData, size - first);
+  }
+
+  bool StreamRing::push(const StreamRecord& rec, const void* payload)
+  {
+    uint64_t head = mHeader->head.load(std::memory_order_relaxed);
+    uint64_t tail = mHeader->tail.load(std::memory_order_acquire);
+    uint64_t bytes = recordBytes(rec.len);
+    if (mSize - (head - tail) < bytes)
+      return false;
+    copyIn(head, &rec, sizeof(rec));
+    if (rec.len)
+      copyIn(head + sizeof(rec), payload, rec.len);
+    mHeader->head.store(head + bytes, std::memory_order_release);
+    return true;
+  }
+
+  bool StreamRing::peek(StreamRecord& rec) const
+  {
+    uint64_t tail = mHeader->tail.load(std::memory_order_relaxed);
+    if (mHeader->head.load(std::memory_order_acquire) == tail)
+      return false;
+    copyOut(tail, &rec, sizeof(rec));
+    return true;
+  }
+
+  void StreamRing::pop(void* payload)
+  {
+    StreamRecord rec;
+    if (!peek(rec))
+      return;
+    uint64_t tail = mHeader->tail.load(std::memory_order_relaxed);
+    if (payload && rec.len)
+      copyOut(tail + sizeof(rec), payload, rec.len);
+    mHeader->tail.store(tail + recordBytes(rec.len), std::memory_order_release);
+  }
+}
@@ -0,0 +1,165 @@
+/**
+ * Copyright (C) 2016-2018 Xilinx, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _EM_SHARED_MEMORY_H_
+#define _EM_SHARED_MEMORY_H_
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "em_defines.h"
+
+namespace xclemulation
+{
+  // Device memory banks backed by anonymous shared memory (memfd) that the
+  // shim offers to the device process.  The shim describes the regions in
+  // the message that starts the device (xclLoadBitstream for sw_emu,
+  // xclSetEnvironment for hw_emu); a device process that maps them answers
+  // with sharedmem set.  From then on host transfers inside a region are
+  // plain memcpys in the shim and the socket only carries control messages.
+  // Device processes that do not know the fields ignore them and the shim
+  // keeps sending the data over the socket.
+  class SharedDeviceMemory
+  {
+    struct Region
+    {
+      uint64_t base;
+      uint64_t size;
+      uint32_t space;
+      int fd;
+      char* data;
+      std::string fileName;
+    };
+
+    std::vector<Region> mRegions;
+    bool mEnabled;
+
+  public:
+    SharedDeviceMemory() : mEnabled(false) {}
+    ~SharedDeviceMemory() { release(); }
+
+    // Back [base, base + size) of address space space; false if the
+    // system offers no anonymous shared memory
+    bool addRegion(uint64_t base, uint64_t size, uint32_t space = 0);
+    // Unmap all regions, transfers go over the socket again
+    void release();
+
+    bool empty() const { return mRegions.empty(); }
+    // Device process has mapped the regions
+    void setEnabled(bool enabled) { mEnabled = enabled && !mRegions.empty(); }
+    bool isEnabled() const { return mEnabled; }
+
+    // Copy between host memory and a region; false, copying nothing, when
+    // disabled or if the range is not inside one region
+    bool write(uint64_t addr, const void* src, size_t size, uint32_t space = 0);
+    bool read(uint64_t addr, void* dst, size_t size, uint32_t space = 0);
+
+    // Add the regions to the sharedmem field of a call message
+    template <typename Msg>
+    void describe(Msg& msg) const
+    {
+      for (auto& region : mRegions) {
+        auto sharedmem = msg.add_sharedmem();
+        sharedmem->set_base(region.base);
+        sharedmem->set_size(region.size);
+        sharedmem->set_space(region.space);
+        sharedmem->set_filename(region.fileName);
+      }
+    }
+
+  private:
+    char* find(uint64_t addr, size_t size, uint32_t space) const;
+  };
+
+  // Record of a StreamRing: the header of a data chunk, a read descriptor
+  // or a completion, followed by len payload bytes and padding to 8 bytes
+  struct StreamRecord
+  {
+    uint64_t req;   // request of the host the record belongs to
+    uint64_t size;  // bytes asked for (descriptors) or done (completions)
+    uint32_t len;   // payload bytes
+    uint32_t flags;
+  };
+
+  // Single producer, single consumer ring of StreamRecords in anonymous
+  // shared memory, one end in the shim and the other in the device
+  // process.  The mapping starts with StreamRingHeader, the data of size
+  // bytes (a power of two) starts at DATA_OFFSET.  head and tail count the
+  // bytes ever produced and consumed; each side only advances its own
+  // counter, publishing the records before it with release ordering.
+  // Records may wrap around the end of the data.
+  struct StreamRingHeader
+  {
+    uint64_t magic;
+    uint64_t size;
+    alignas(64) std::atomic<uint64_t> head;
+    alignas(64) std::atomic<uint64_t> tail;
+  };
+
+  class StreamRing
+  {
+  public:
+    static const uint64_t MAGIC = 0x31474e49524c4358ULL; // "XCLRING1"
+    static const uint64_t DATA_OFFSET = 4096;
+
+    enum : uint32_t {
+      RECORD_LAST = 1,  // last record of the request
+      RECORD_EOT  = 2   // request ends the stream transfer
+    };
+
+    StreamRing() : mFd(-1), mHeader(nullptr), mData(nullptr), mSize(0) {}
+    ~StreamRing() { release(); }
+    StreamRing(const StreamRing&) = delete;
+    StreamRing& operator=(const StreamRing&) = delete;
+
+    // Map a ring with size bytes of data, rounded up to a power of two;
+    // false if the system offers no anonymous shared memory
+    bool create(uint64_t size);
+    void release();
+    bool valid() const { return mHeader != nullptr; }
+
+    // Largest payload of a record
+    uint32_t maxPayload() const;
+
+    // Producer: false, writing nothing, if the ring has no room
+    bool push(const StreamRecord& rec, const void* payload);
+
+    // Consumer: look at the oldest record, then copy its payload to
+    // payload (if not null) and drop it
+    bool peek(StreamRecord& rec) const;
+    void pop(void* payload);
+
+    template <typename Msg>
+    void describe(Msg* msg) const
+    {
+      msg->set_filename(mFileName);
+      msg->set_size(mSize);
+    }
+
+  private:
+    void copyIn(uint64_t pos, const void* src, size_t size);
+    void copyOut(uint64_t pos, void* dst, size_t size) const;
+
+    int mFd;
+    StreamRingHeader* mHeader;
+    char* mData;
+    uint64_t mSize;
+    std::string mFileName;
+  };
+}
+
+#endif
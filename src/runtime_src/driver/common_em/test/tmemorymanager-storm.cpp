@@ -0,0 +1,100 @@
+/**
+ * Copyright (C) 2016-2018 Xilinx, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "memorymanager.h"
+
+/**
+ * Allocation storm on the emulation device memory manager: keeps a few
+ * thousand buffers of random sizes alive while allocating, looking up and
+ * freeing buffers in random order, then checks that freeing everything
+ * gives back a single block of the whole bank.
+ * Compile command: g++ -O2 -std=c++11 -I .. -I ../../include tmemorymanager-storm.cpp ../memorymanager.cxx -lpthread
+ */
+
+static const uint64_t bankSize = 16ULL << 30;
+static const unsigned alignment = 4096;
+
+static bool
+storm(size_t live, size_t ops, unsigned paddingFactor)
+{
+  xclemulation::MemoryManager mm(bankSize, 0, alignment);
+  std::mt19937_64 gen(live);
+  std::vector<std::pair<uint64_t, uint64_t>> bufs;
+
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < ops; i++) {
+    if (bufs.size() < live) {
+      size_t size = 1 + gen() % (1 << 20);
+      const size_t requested = size;
+      uint64_t buf = mm.alloc(size, paddingFactor);
+      if (buf == xclemulation::MemoryManager::mNull)
+        continue;
+      if (buf % alignment || size % alignment || size < requested) {
+        std::cout << "misaligned buffer " << buf << " of " << size << " B\n";
+        return false;
+      }
+      if (mm.lookup(buf).second != size * (1 + 2 * paddingFactor)) {
+        std::cout << "lookup of " << buf << " returned wrong size\n";
+        return false;
+      }
+      bufs.emplace_back(buf, size);
+      continue;
+    }
+    size_t victim = gen() % bufs.size();
+    mm.free(bufs[victim].first);
+    if (!xclemulation::MemoryManager::isNullAlloc(mm.lookup(bufs[victim].first))) {
+      std::cout << "freed buffer still busy\n";
+      return false;
+    }
+    bufs[victim] = bufs.back();
+    bufs.pop_back();
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  std::cout << live << " live buffers, padding " << paddingFactor << ": "
+            << ops / elapsed.count() / 1e6 << " M ops/s\n";
+
+  for (auto& buf : bufs)
+    mm.free(buf.first);
+  if (mm.freeSize() != bankSize) {
+    std::cout << "leaked " << bankSize - mm.freeSize() << " B\n";
+    return false;
+  }
+  size_t all = bankSize;
+  if (mm.alloc(all) != 0) {
+    std::cout << "free blocks were not coalesced\n";
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv)
+{
+  for (size_t live : {100, 1000, 10000}) {
+    for (unsigned paddingFactor : {0, 1}) {
+      if (!storm(live, 200000, paddingFactor)) {
+        std::cout << "FAILED TEST\n";
+        return 1;
+      }
+    }
+  }
+  std::cout << "PASSED TEST\n";
+  return 0;
+}
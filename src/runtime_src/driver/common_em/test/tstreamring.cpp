@@ -0,0 +1,154 @@
+/**
+ * Copyright (C) 2016-2018 Xilinx, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "shared_memory.h"
+
+/**
+ * Stream throughput through the shared memory rings of emulated QDMA
+ * queues.  A forked consumer plays the device process: it takes the data
+ * records of each request from a 4 MB data ring, checks them and posts a
+ * completion per request, the way a write queue of the sw_emu shim is
+ * served.
+ * Compile command: g++ -O2 -std=c++11 -I .. -I ../../include tstreamring.cpp ../shared_memory.cxx
+ */
+
+using xclemulation::StreamRecord;
+using xclemulation::StreamRing;
+
+static const uint64_t totalBytes = 4ULL << 30;
+
+static void
+backoff(unsigned& spins)
+{
+  if (++spins < 64)
+    std::this_thread::yield();
+  else
+    std::this_thread::sleep_for(std::chrono::microseconds(20));
+}
+
+/* device side: sums the payload of each request and completes it */
+static int
+consume(StreamRing& data, StreamRing& completions, uint64_t requests)
+{
+  std::vector<char> payload(data.maxPayload());
+  uint64_t bytes = 0;
+  unsigned spins = 0;
+  for (uint64_t req = 0; req < requests; ) {
+    StreamRecord rec;
+    if (!data.peek(rec)) {
+      backoff(spins);
+      continue;
+    }
+    spins = 0;
+    data.pop(payload.data());
+    if (rec.req != req)
+      return 1;
+    bytes += rec.len;
+    if (!(rec.flags & StreamRing::RECORD_LAST))
+      continue;
+    if (payload[rec.len - 1] != char(req))
+      return 1;
+    StreamRecord done = {req, bytes, 0, StreamRing::RECORD_LAST};
+    while (!completions.push(done, nullptr))
+      backoff(spins);
+    bytes = 0;
+    req++;
+  }
+  return 0;
+}
+
+static double
+run(uint64_t requestSize)
+{
+  StreamRing data, completions;
+  if (!data.create(4 << 20) || !completions.create(256 << 10)) {
+    std::cerr << "no anonymous shared memory" << std::endl;
+    exit(1);
+  }
+  const uint64_t requests = totalBytes / requestSize;
+  const uint64_t chunk = data.maxPayload() / 4;
+
+  pid_t pid = fork();
+  if (pid == 0)
+    _exit(consume(data, completions, requests));
+
+  std::vector<char> buf(requestSize);
+  auto start = std::chrono::steady_clock::now();
+  uint64_t completed = 0;
+  unsigned spins = 0;
+  for (uint64_t req = 0; req < requests; req++) {
+    buf[requestSize - 1] = char(req);
+    for (uint64_t done = 0; done < requestSize; ) {
+      StreamRecord rec = {req, 0, uint32_t(std::min(requestSize - done, chunk)), 0};
+      if (done + rec.len == requestSize)
+        rec.flags = StreamRing::RECORD_LAST;
+      while (!data.push(rec, buf.data() + done)) {
+        StreamRecord c;
+        while (completions.peek(c)) {
+          completions.pop(nullptr);
+          completed++;
+        }
+        backoff(spins);
+      }
+      spins = 0;
+      done += rec.len;
+    }
+  }
+  while (completed < requests) {
+    StreamRecord c;
+    if (completions.peek(c)) {
+      if (c.size != requestSize) {
+        std::cerr << "request " << c.req << " completed " << c.size << " bytes" << std::endl;
+        exit(1);
+      }
+      completions.pop(nullptr);
+      completed++;
+    }
+    else
+      backoff(spins);
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  int status = 0;
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+    std::cerr << "consumer saw corrupt records" << std::endl;
+    exit(1);
+  }
+  return totalBytes / elapsed.count() / (1 << 20);
+}
+
+int main()
+{
+  std::cout << "request bytes       MB/s" << std::endl;
+  for (uint64_t size = 4096; size <= (16 << 20); size *= 16) {
+    double rate = run(size);
+    std::cout.width(13);
+    std::cout << size << " ";
+    std::cout.width(10);
+    std::cout << (unsigned long)rate << std::endl;
+  }
+  return 0;
+}
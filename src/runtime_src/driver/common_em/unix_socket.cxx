@@ -40,6 +40,45 @@ unix_socket::unix_socket()
   start_server(name);
 }
 
+unix_socket::unix_socket(const std::string& sock_id, unsigned int timeout_sec)
+{
+  server_started = false;
+  fd = -1;
+  name = socket_path(sock_id);
+
+  struct sockaddr_un server;
+  memset(&server, 0, sizeof(server));
+  server.sun_family = AF_UNIX;
+  strncpy(server.sun_path, name.c_str(), STR_MAX_LEN);
+
+  // The device process may still be resetting after its previous host
+  for (unsigned int tries = 0; tries <= timeout_sec * 100; tries++) {
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0) {
+      perror("opening stream socket");
+      return;
+    }
+    if (connect(sock, (struct sockaddr*)&server, sizeof(server)) >= 0) {
+      fd = sock;
+      server_started = true;
+      return;
+    }
+    close(sock);
+    usleep(10000);
+  }
+}
+
+std::string unix_socket::socket_path(const std::string& sock_id)
+{
+  if(getenv("USER") == NULL)
+    return "/tmp/" + sock_id;
+
+  std::string user = getenv("USER");
+  std::string pathname =  "/tmp/" + user;
+  systemUtil::makeSystemCall(pathname, systemUtil::systemOperation::CREATE);
+  return pathname + "/" + sock_id;
+}
+
 void unix_socket::start_server(const std::string sk_desc)
 {
   int sock= -1;
@@ -38,6 +38,10 @@ public:
     void set_name(std::string &sock_name) { name = sock_name;}
     std::string get_name() { return name;}
     unix_socket();
+    // Connect to a device process that already listens on sock_id, retrying
+    // for up to timeout_sec seconds; server_started stays false if none does
+    unix_socket(const std::string& sock_id, unsigned int timeout_sec);
+    static std::string socket_path(const std::string& sock_id);
     ~unix_socket()
     {
        server_started = false;
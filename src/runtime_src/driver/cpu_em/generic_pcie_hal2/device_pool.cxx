@@ -0,0 +1,128 @@
+/**
+ * Copyright (C) 2016-2018 Xilinx, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "device_pool.h"
+#include "unix_socket.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace xclcpuemhal2 {
+
+  DeviceServerPool::DeviceServerPool(const std::string& deviceName, unsigned int size)
+    : mDeviceName(deviceName)
+    , mDirectory(unix_socket::socket_path(deviceName + "_pool"))
+    , mSize(size)
+    , mSlot(-1)
+    , mLockFd(-1)
+    , mPid(0)
+    , mSpawned(false)
+  {
+    systemUtil::makeSystemCall(mDirectory, systemUtil::systemOperation::CREATE);
+  }
+
+  std::string DeviceServerPool::socketId() const
+  {
+    return mDeviceName + "_pool_" + std::to_string(mSlot);
+  }
+
+  bool DeviceServerPool::claim()
+  {
+    if (claimed())
+      return true;
+
+    // First pass only takes slots whose device process is up
+    for (int pass = 0; pass < 2; pass++) {
+      for (unsigned int slot = 0; slot < mSize; slot++) {
+        std::string lockFile = mDirectory + "/slot_" + std::to_string(slot) + ".lock";
+        int fd = open(lockFile.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+        if (fd < 0)
+          continue;
+        if (flock(fd, LOCK_EX | LOCK_NB) == -1) {
+          close(fd);
+          continue;
+        }
+        mSlot = slot;
+        mLockFd = fd;
+        mPid = readPid();
+        mSpawned = false;
+        if (pass == 1 || isWarm())
+          return true;
+        mSlot = -1;
+        mLockFd = -1;
+        flock(fd, LOCK_UN);
+        close(fd);
+      }
+    }
+    return false;
+  }
+
+  bool DeviceServerPool::isWarm() const
+  {
+    if (!claimed() || mPid <= 0 || kill(mPid, 0) == -1)
+      return false;
+    struct stat st;
+    return stat(unix_socket::socket_path(socketId()).c_str(), &st) == 0;
+  }
+
+  void DeviceServerPool::setServer(pid_t pid)
+  {
+    mPid = pid;
+    mSpawned = true;
+    writePid(pid);
+  }
+
+  void DeviceServerPool::release(bool keepWarm)
+  {
+    if (!claimed())
+      return;
+
+    if (!keepWarm) {
+      if (mSpawned) {
+        int status = 0;
+        while (waitpid(mPid, &status, 0) == -1 && errno == EINTR);
+      }
+      writePid(0);
+    }
+    flock(mLockFd, LOCK_UN);
+    close(mLockFd);
+    mLockFd = -1;
+    mSlot = -1;
+    mPid = 0;
+    mSpawned = false;
+  }
+
+  pid_t DeviceServerPool::readPid() const
+  {
+    char text[32] = {0};
+    if (pread(mLockFd, text, sizeof(text) - 1, 0) <= 0)
+      return 0;
+    return strtol(text, NULL, 10);
+  }
+
+  void DeviceServerPool::writePid(pid_t pid)
+  {
+    std::string text = std::to_string(pid);
+    if (ftruncate(mLockFd, 0) == 0)
+      (void) pwrite(mLockFd, text.c_str(), text.size(), 0);
+  }
+}
@@ -0,0 +1,71 @@
+/**
+ * Copyright (C) 2016-2018 Xilinx, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _SW_EMU_DEVICE_POOL_H_
+#define _SW_EMU_DEVICE_POOL_H_
+
+#include <string>
+#include <sys/types.h>
+
+namespace xclcpuemhal2 {
+
+  // Device processes kept alive across hosts (device_server_pool=<n> in
+  // sdaccel.ini).  A pool has n slots per device name, each with its own
+  // socket, /tmp/$USER/<device>_pool_<slot>, and a lock file under
+  // /tmp/$USER/<device>_pool holding the pid of the slot's device process.
+  // A host owns a slot, and so its device process, while it holds the lock.
+  //
+  // The device process of a slot is started with EMULATION_DEVICE_POOL=1 in
+  // its own session.  When the host closes it sends xclClose with keepalive
+  // set; a device process that answers keepalive has unloaded the program,
+  // dropped all device memory and listens on the slot socket for the next
+  // host, which connects instead of spawning a process.  Device processes
+  // that do not know the field exit as before.
+  class DeviceServerPool
+  {
+    std::string mDeviceName;
+    std::string mDirectory;
+    unsigned int mSize;
+    int mSlot;
+    int mLockFd;
+    pid_t mPid;
+    bool mSpawned;
+
+  public:
+    DeviceServerPool(const std::string& deviceName, unsigned int size);
+    ~DeviceServerPool() { release(false); }
+
+    // Lock a free slot, preferring one with a live device process; false
+    // if other hosts hold all of them
+    bool claim();
+    bool claimed() const { return mSlot >= 0; }
+    // Socket id (EMULATION_SOCKETID) of the claimed slot
+    std::string socketId() const;
+    // Device process of the claimed slot is alive and waits for a host
+    bool isWarm() const;
+    // A new device process was spawned for the claimed slot
+    void setServer(pid_t pid);
+    // Unlock the slot.  Unless keepWarm the device process is gone or about
+    // to exit; wait for it if it is our child and forget it.
+    void release(bool keepWarm);
+
+  private:
+    pid_t readPid() const;
+    void writePid(pid_t pid);
+  };
+}
+
+#endif
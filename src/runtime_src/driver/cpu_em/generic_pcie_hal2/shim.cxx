@@ -20,11 +20,13 @@
 
 #include "shim.h"
 #include <unistd.h>
+#include <chrono>
 namespace xclcpuemhal2 {
 
   std::map<unsigned int, CpuemShim*> devices;
   unsigned int CpuemShim::mBufferCount = 0;
   std::map<int, std::tuple<std::string,int,void*> > CpuemShim::mFdToFileNameMap;
+  std::mutex CpuemShim::mFdToFileNameMapMtx;
   bool CpuemShim::mFirstBinary = true;
   const unsigned CpuemShim::TAG = 0X586C0C6C; // XL OpenCL X->58(ASCII), L->6C(ASCII), O->0 C->C L->6C(ASCII);
   const unsigned CpuemShim::CONTROL_AP_START = 1;
@@ -76,6 +78,9 @@ namespace xclcpuemhal2 {
       message_size = 0x800000;
     }
     mCloseAll = false;
+    mKeepAlive = false;
+    mServerPool = NULL;
+    mRegisterBatch = false;
     bUnified = _unified;
     bXPR = _xpr;
   }
@@ -111,6 +116,22 @@ namespace xclcpuemhal2 {
     }
   }
 
+  void CpuemShim::initSharedMemory()
+  {
+    if (!mSharedMemory.empty())
+      return;
+    // the device process either maps the banks or leaves sharedmem unset in
+    // its response, in which case copies stay on the socket
+    for (auto i : mDDRMemoryManager)
+    {
+      if (!mSharedMemory.addRegion(i->start(), i->size()))
+      {
+        mSharedMemory.release();
+        return;
+      }
+    }
+  }
+
 //private 
   bool CpuemShim::isGood() const 
   {
@@ -343,10 +364,29 @@ namespace xclcpuemhal2 {
 
     // Spawn off the process to run the stub
     bool simDontRun = xclemulation::config::getInstance()->isDontRun();
+
+    // A device process of the pool can be reused unless it has to attach to
+    // the debugger of this host
+    unsigned int poolSize = xclemulation::config::getInstance()->getDeviceServerPool();
+    if(!simDontRun && !debuggable && poolSize && !mServerPool)
+      mServerPool = new DeviceServerPool(deviceName, poolSize);
+    bool pooled = mServerPool && !debuggable && mServerPool->claim();
+    if(pooled && mServerPool->isWarm())
+    {
+      sock = new unix_socket(mServerPool->socketId(), 30);
+      if(sock->server_started)
+        return;
+      delete sock;
+      sock = NULL;
+    }
+
     if(!simDontRun)
     {
       std::stringstream socket_id;
-      socket_id << deviceName << "_" << binaryCounter << "_" << getpid();
+      if(pooled)
+        socket_id << mServerPool->socketId();
+      else
+        socket_id << deviceName << "_" << binaryCounter << "_" << getpid();
       setenv("EMULATION_SOCKETID",socket_id.str().c_str(),true);
 
       pid_t pid = fork();
@@ -354,6 +394,12 @@ namespace xclcpuemhal2 {
       if (pid == 0)
       { 
         //I am child
+        if(pooled)
+        {
+          // Outlive this host and its process group signals
+          setsid();
+          setenv("EMULATION_DEVICE_POOL","1",true);
+        }
         std::string childProcessPath("");
         std::string xilinxInstall("");
         char *installEnvvar = getenv("XILINX_SDX");
@@ -421,6 +467,8 @@ namespace xclcpuemhal2 {
         if(r == -1){std::cerr << "FATAL ERROR : child process did not launch" << std::endl; exit(1);}
         exit(0);
       }
+      if(pooled)
+        mServerPool->setServer(pid);
     }
     sock = new unix_socket;
   }
@@ -586,6 +634,7 @@ namespace xclcpuemhal2 {
       bool verbose = false;
       if(mLogStream.is_open())
         verbose = true;
+      initSharedMemory();
       xclLoadBitstream_RPC_CALL(xclLoadBitstream,xmlFile,tempdlopenfilename,deviceDirectory,binaryDirectory,verbose);
       if(!ack)
         return -1;
@@ -606,6 +655,11 @@ namespace xclcpuemhal2 {
 
   void CpuemShim::launchTempProcess()
   {
+    // copies and allocations of several threads may find the device
+    // process missing at the same time
+    std::lock_guard<std::mutex> lk(mTempProcessMtx);
+    if(sock)
+      return;
     std::string binaryDirectory("");
     launchDeviceProcess(false,binaryDirectory);
     std::string xmlFile("");
@@ -614,6 +668,7 @@ namespace xclcpuemhal2 {
     bool verbose = false;
     if(mLogStream.is_open())
       verbose = true;
+    initSharedMemory();
     xclLoadBitstream_RPC_CALL(xclLoadBitstream,xmlFile,tempdlopenfilename,deviceDirectory,binaryDirectory,verbose);
   }
 
@@ -721,7 +776,6 @@ namespace xclcpuemhal2 {
 
   size_t CpuemShim::xclWrite(xclAddressSpace space, uint64_t offset, const void *hostBuf, size_t size) 
   {
-    std::lock_guard<std::mutex> lk(mApiMtx);
     if (mLogStream.is_open()) {
       mLogStream << __func__ << ", " << std::this_thread::get_id() << ", " << offset<<", "<<hostBuf<<", "<< size<<std::endl;
     }
@@ -742,14 +796,124 @@ namespace xclcpuemhal2 {
     }
 
     fflush(stdout);
+    if(mRegisterBatch)
+    {
+      std::lock_guard<std::mutex> lk(mPostedMtx);
+      // A later write of the same registers replaces an earlier one, the
+      // register map written before the start of a CU is sent once
+      std::string data((const char*)hostBuf, size);
+      for(auto it = mPostedWrites.begin(); it != mPostedWrites.end(); )
+      {
+        if(it->first == offset && it->second.size() <= size)
+          it = mPostedWrites.erase(it);
+        else
+          ++it;
+      }
+      mPostedWrites.emplace_back(offset, data);
+      if(size && !(*(const uint32_t*)hostBuf & CONTROL_AP_START))
+      {
+        PRINTENDFUNC;
+        return size;
+      }
+      if(!flushPostedWrites())
+        size = -1;
+      PRINTENDFUNC;
+      return size;
+    }
     xclWriteAddrKernelCtrl_RPC_CALL(xclWriteAddrKernelCtrl,space,offset,hostBuf,size,kernelArgsInfo);
     PRINTENDFUNC;
     return size;
   }
 
+  bool CpuemShim::flushPostedWrites()
+  {
+    if(mPostedWrites.empty())
+      return true;
+    std::vector<xclemulation::register_block> blocks;
+    for(auto& it : mPostedWrites)
+      blocks.push_back({it.first, it.second.data(), it.second.size()});
+    bool valid = false;
+    xclWriteRegisters_RPC_CALL(xclWriteRegisters,blocks,kernelArgsInfo);
+    mPostedWrites.clear();
+    return valid;
+  }
+
+  size_t CpuemShim::xclWriteRegisters(const std::vector<xclemulation::register_block>& blocks)
+  {
+    if (mLogStream.is_open()) {
+      mLogStream << __func__ << ", " << std::this_thread::get_id() << ", " << blocks.size() << std::endl;
+    }
+
+    if(!sock)
+      return 0;
+
+    size_t size = 0;
+    if(!mRegisterBatch)
+    {
+      for(auto& block : blocks)
+      {
+        if(xclWrite(XCL_ADDR_KERNEL_CTRL, block.offset, block.data, block.size) != block.size)
+          return -1;
+        size += block.size;
+      }
+      return size;
+    }
+
+    std::lock_guard<std::mutex> lk(mPostedMtx);
+    for(auto& block : blocks)
+    {
+      if(block.size%4)
+      {
+        if (mLogStream.is_open()) mLogStream << "xclWriteRegisters only supports 32-bit writes" << std::endl;
+        return -1;
+      }
+      mPostedWrites.emplace_back(block.offset, std::string((const char*)block.data, block.size));
+      size += block.size;
+    }
+    if(!flushPostedWrites())
+      return -1;
+    PRINTENDFUNC;
+    return size;
+  }
+
+  int CpuemShim::xclWaitRegisters(const std::vector<uint64_t>& offsets, uint32_t mask, uint32_t timeout, std::vector<uint32_t>& values)
+  {
+    if (mLogStream.is_open()) {
+      mLogStream << __func__ << ", " << std::this_thread::get_id() << ", " << offsets.size() << ", " << mask << ", " << timeout << std::endl;
+    }
+
+    values.assign(offsets.size(), 0);
+    if(!sock)
+      return 0;
+
+    if(!mRegisterBatch)
+    {
+      // Poll from here, one message per register
+      auto start = std::chrono::steady_clock::now();
+      do
+      {
+        for(size_t i = 0; i < offsets.size(); i++)
+        {
+          if(xclRead(XCL_ADDR_KERNEL_CTRL, offsets[i], &values[i], 4) != 4)
+            return -1;
+          if(values[i] & mask)
+            return 0;
+        }
+      } while(std::chrono::steady_clock::now() - start < std::chrono::microseconds(timeout));
+      return 0;
+    }
+
+    std::lock_guard<std::mutex> lk(mPostedMtx);
+    if(!flushPostedWrites())
+      return -1;
+    bool valid = false;
+    xclWaitRegisters_RPC_CALL(xclWaitRegisters,offsets,mask,timeout,values);
+    PRINTENDFUNC;
+    return valid ? 0 : -1;
+  }
+
   size_t CpuemShim::xclRead(xclAddressSpace space, uint64_t offset, void *hostBuf, size_t size) 
   {
-    std::lock_guard<std::mutex> lk(mApiMtx);
     if (mLogStream.is_open()) {
       mLogStream << __func__ << ", " << std::this_thread::get_id() << ", " << space << ", "
         << offset << ", " << hostBuf << ", " << size << std::endl;
@@ -773,6 +937,15 @@ namespace xclcpuemhal2 {
       PRINTENDFUNC;
       return -1;
     }
+    if(mRegisterBatch)
+    {
+      std::lock_guard<std::mutex> lk(mPostedMtx);
+      if(!flushPostedWrites())
+      {
+        PRINTENDFUNC;
+        return -1;
+      }
+    }
     xclReadAddrKernelCtrl_RPC_CALL(xclReadAddrKernelCtrl,space,offset,hostBuf,size);
     PRINTENDFUNC;
     return size;
@@ -794,6 +967,9 @@ namespace xclcpuemhal2 {
     }
     dest += seek;
 
+    if(mSharedMemory.write(dest, src, size))
+      return size;
+
     void *handle = this;
 
     unsigned int messageSize = get_messagesize();
@@ -831,6 +1007,9 @@ namespace xclcpuemhal2 {
       launchTempProcess();
     }
     src += skip;
+    if(mSharedMemory.read(src, dest, size))
+      return size;
+
     void *handle = this;
 
     unsigned int messageSize = get_messagesize();
@@ -908,19 +1087,27 @@ namespace xclcpuemhal2 {
   }
   void CpuemShim::resetProgram(bool callingFromClose)
   {
-    for (auto& it: mFdToFileNameMap)
     {
-      int fd=it.first;
-      int sSize = std::get<1>(it.second);
-      void* addr = std::get<2>(it.second);
-      munmap(addr,sSize);
-      close(fd);
+      std::lock_guard<std::mutex> lk(mFdToFileNameMapMtx);
+      for (auto& it: mFdToFileNameMap)
+      {
+        int fd=it.first;
+        int sSize = std::get<1>(it.second);
+        void* addr = std::get<2>(it.second);
+        munmap(addr,sSize);
+        close(fd);
+      }
+      mFdToFileNameMap.clear();
     }
-    mFdToFileNameMap.clear();
 
     if (mLogStream.is_open()) {
       mLogStream << __func__ << ", " << std::this_thread::get_id() << std::endl;
     }
+    {
+      // Writes that never saw a start do not reach the next program
+      std::lock_guard<std::mutex> lk(mPostedMtx);
+      mPostedWrites.clear();
+    }
     if(!sock)
       return;
     
@@ -946,33 +1133,58 @@ namespace xclcpuemhal2 {
         systemUtil::makeSystemCall(deviceDirectory, systemUtil::systemOperation::REMOVE);
       return;
     }
-    for (auto& it: mFdToFileNameMap)
     {
-      int fd=it.first;
-      int sSize = std::get<1>(it.second);
-      void* addr = std::get<2>(it.second);
-      munmap(addr,sSize);
-      close(fd);
-    }
+      std::lock_guard<std::mutex> lk(mFdToFileNameMapMtx);
+      for (auto& it: mFdToFileNameMap)
+      {
+        int fd=it.first;
+        int sSize = std::get<1>(it.second);
+        void* addr = std::get<2>(it.second);
+        munmap(addr,sSize);
+        close(fd);
+      }
       mFdToFileNameMap.clear();
+    }
     mCloseAll = true; 
     std::string socketName = sock->get_name();
     if(socketName.empty() == false)// device is active if socketName is non-empty
     {
 #ifndef _WINDOWS
+      mKeepAlive = mServerPool && mServerPool->claimed();
       xclClose_RPC_CALL(xclClose,this);
 #endif
     }
     mCloseAll = false; 
 
-    int status = 0;
-    bool simDontRun = xclemulation::config::getInstance()->isDontRun();
-    if(!simDontRun)
-      while (-1 == waitpid(0, &status, 0));
-    
-    systemUtil::makeSystemCall(socketName, systemUtil::systemOperation::REMOVE);
+    if(mServerPool && mServerPool->claimed())
+    {
+      // The device process listens on the slot socket again if it took
+      // keepalive, otherwise it exits like an unpooled one
+      mServerPool->release(mKeepAlive);
+      if(!mKeepAlive)
+        systemUtil::makeSystemCall(socketName, systemUtil::systemOperation::REMOVE);
+    }
+    else
+    {
+      int status = 0;
+      bool simDontRun = xclemulation::config::getInstance()->isDontRun();
+      if(!simDontRun)
+        while (-1 == waitpid(0, &status, 0));
+
+      systemUtil::makeSystemCall(socketName, systemUtil::systemOperation::REMOVE);
+    }
+    mKeepAlive = false;
+    delete mServerPool;
+    mServerPool = NULL;
+    {
+      std::lock_guard<std::mutex> lk(mPostedMtx);
+      mPostedWrites.clear();
+      mRegisterBatch = false;
+    }
     delete sock;
     sock = NULL;
+    mSharedMemory.release();
+    releaseStreamQueues();
     //clean up directories which are created inside the driver
     if( xclemulation::config::getInstance()->isKeepRunDirEnabled() == false)
     {
@@ -1014,6 +1226,7 @@ namespace xclcpuemhal2 {
 
 xclemulation::drm_xocl_bo* CpuemShim::xclGetBoByHandle(unsigned int boHandle)
 {
+  std::lock_guard<std::mutex> lk(mBOMapMtx);
   auto it = mXoclObjMap.find(boHandle);
   if(it == mXoclObjMap.end())
     return nullptr;
@@ -1034,7 +1247,6 @@ inline unsigned long long CpuemShim::xocl_ddr_channel_size()
 
 int CpuemShim::xclGetBOProperties(unsigned int boHandle, xclBOProperties *properties)
 {
-  std::lock_guard<std::mutex> lk(mApiMtx);
   if (mLogStream.is_open()) 
   {
     mLogStream << __func__ << ", " << std::this_thread::get_id() << ", " << std::hex << boHandle << std::endl;
@@ -1082,6 +1294,7 @@ int CpuemShim::xoclCreateBo(xclemulation::xocl_create_bo* info)
   xobj->buf = NULL;
   xobj->fd = -1;
 
+  std::lock_guard<std::mutex> lk(mBOMapMtx);
   info->handle = mBufferCount;
   mXoclObjMap[mBufferCount++] = xobj;
   return 0;
@@ -1089,7 +1302,6 @@ int CpuemShim::xoclCreateBo(xclemulation::xocl_create_bo* info)
 
 unsigned int CpuemShim::xclAllocBO(size_t size, xclBOKind domain, unsigned flags)
 {
-  std::lock_guard<std::mutex> lk(mApiMtx);
   if (mLogStream.is_open()) 
   {
     mLogStream << __func__ << ", " << std::this_thread::get_id() << ", " << std::hex << size << std::dec << " , "<<domain <<" , "<< flags << std::endl;
@@ -1104,7 +1316,6 @@ unsigned int CpuemShim::xclAllocBO(size_t size, xclBOKind domain, unsigned flags
 /******************************** xclAllocUserPtrBO ************************************/
 unsigned int CpuemShim::xclAllocUserPtrBO(void *userptr, size_t size, unsigned flags)
 {
-  std::lock_guard<std::mutex> lk(mApiMtx);
   if (mLogStream.is_open()) 
   {
     mLogStream << __func__ << ", " << std::this_thread::get_id() << ", " << userptr <<", " << std::hex << size << std::dec <<" , "<< flags << std::endl;
@@ -1162,7 +1373,10 @@ int CpuemShim::xclExportBO(unsigned int boHandle)
     munmap(data,bo->size);
     return -1;
   }
-  mFdToFileNameMap [fd] = std::make_tuple(sFileName,size,(void*)data);
+  {
+    std::lock_guard<std::mutex> lk(mFdToFileNameMapMtx);
+    mFdToFileNameMap [fd] = std::make_tuple(sFileName,size,(void*)data);
+  }
   PRINTENDFUNC;
   return fd;
 }
@@ -1176,34 +1390,36 @@ unsigned int CpuemShim::xclImportBO(int boGlobalHandle, unsigned flags)
   {
     mLogStream << __func__ << ", " << std::this_thread::get_id() << ", " << std::hex << boGlobalHandle << std::endl;
   }
-  auto itr = mFdToFileNameMap.find(boGlobalHandle);
-  if(itr != mFdToFileNameMap.end())
+  std::string fileName;
+  int size = 0;
   {
-    const std::string& fileName = std::get<0>((*itr).second);
-    int size = std::get<1>((*itr).second);
-    unsigned int importedBo = xclAllocBO(size, xclBOKind::XCL_BO_DEVICE_RAM,flags);
-    xclemulation::drm_xocl_bo* bo = xclGetBoByHandle(importedBo);
-    if(!bo)
-    {
-      std::cout<<"ERROR HERE in importBO "<<std::endl;
-      return -1;
-    }
-    bo->fd = boGlobalHandle;
-    bool ack;
-    xclImportBO_RPC_CALL(xclImportBO,fileName,bo->base,size);
-    if(!ack)
+    std::lock_guard<std::mutex> lk(mFdToFileNameMapMtx);
+    auto itr = mFdToFileNameMap.find(boGlobalHandle);
+    if(itr == mFdToFileNameMap.end())
       return -1;
-    PRINTENDFUNC;
-    return importedBo;
+    fileName = std::get<0>((*itr).second);
+    size = std::get<1>((*itr).second);
+  }
+  unsigned int importedBo = xclAllocBO(size, xclBOKind::XCL_BO_DEVICE_RAM,flags);
+  xclemulation::drm_xocl_bo* bo = xclGetBoByHandle(importedBo);
+  if(!bo)
+  {
+    std::cout<<"ERROR HERE in importBO "<<std::endl;
+    return -1;
   }
-  return -1;
+  bo->fd = boGlobalHandle;
+  bool ack;
+  xclImportBO_RPC_CALL(xclImportBO,fileName,bo->base,size);
+  if(!ack)
+    return -1;
+  PRINTENDFUNC;
+  return importedBo;
 }
 /***************************************************************************************/
 
 /******************************** xclCopyBO *******************************************/
 int CpuemShim::xclCopyBO(unsigned int dst_boHandle, unsigned int src_boHandle, size_t size, size_t dst_offset, size_t src_offset)
 {
-  std::lock_guard<std::mutex> lk(mApiMtx);
   //TODO
   if (mLogStream.is_open()) 
   {
@@ -1230,10 +1446,15 @@ int CpuemShim::xclCopyBO(unsigned int dst_boHandle, unsigned int src_boHandle, s
   }
 
   int ack = false;
-  auto fItr = mFdToFileNameMap.find(dBO->fd);
-  if(fItr != mFdToFileNameMap.end())
+  std::string sFileName;
+  {
+    std::lock_guard<std::mutex> lk(mFdToFileNameMapMtx);
+    auto fItr = mFdToFileNameMap.find(dBO->fd);
+    if(fItr != mFdToFileNameMap.end())
+      sFileName = std::get<0>((*fItr).second);
+  }
+  if(!sFileName.empty())
   {
-    const std::string& sFileName = std::get<0>((*fItr).second);
     xclCopyBO_RPC_CALL(xclCopyBO,sBO->base,sFileName,size,src_offset,dst_offset);
   }
   if(!ack)
@@ -1246,7 +1467,6 @@ int CpuemShim::xclCopyBO(unsigned int dst_boHandle, unsigned int src_boHandle, s
 /******************************** xclMapBO *********************************************/
 void *CpuemShim::xclMapBO(unsigned int boHandle, bool write)
 {
-  std::lock_guard<std::mutex> lk(mApiMtx);
   if (mLogStream.is_open()) 
   {
     mLogStream << __func__ << ", " << std::this_thread::get_id() << ", " << std::hex << boHandle << " , " << write << std::endl;
@@ -1278,7 +1498,10 @@ void *CpuemShim::xclMapBO(unsigned int boHandle, bool write)
       munmap(data,bo->size);
       return nullptr;
     }
-    mFdToFileNameMap [fd] = std::make_tuple(sFileName,bo->size,(void*)data);
+    {
+      std::lock_guard<std::mutex> lk(mFdToFileNameMapMtx);
+      mFdToFileNameMap [fd] = std::make_tuple(sFileName,bo->size,(void*)data);
+    }
     bo->buf = data;
     PRINTENDFUNC;
     return data;
@@ -1300,7 +1523,6 @@ void *CpuemShim::xclMapBO(unsigned int boHandle, bool write)
 /******************************** xclSyncBO *******************************************/
 int CpuemShim::xclSyncBO(unsigned int boHandle, xclBOSyncDirection dir, size_t size, size_t offset)
 {
-  std::lock_guard<std::mutex> lk(mApiMtx);
   if (mLogStream.is_open()) 
   {
     mLogStream << __func__ << ", " << std::this_thread::get_id() << ", " << std::hex << boHandle << " , " << std::endl;
@@ -1331,22 +1553,25 @@ int CpuemShim::xclSyncBO(unsigned int boHandle, xclBOSyncDirection dir, size_t s
 /******************************** xclFreeBO *******************************************/
 void CpuemShim::xclFreeBO(unsigned int boHandle)
 {
-  std::lock_guard<std::mutex> lk(mApiMtx);
   if (mLogStream.is_open()) 
   {
     mLogStream << __func__ << ", " << std::this_thread::get_id() << ", " << std::hex << boHandle << std::endl;
   }
-  auto it = mXoclObjMap.find(boHandle);
-  if(it == mXoclObjMap.end())
+  xclemulation::drm_xocl_bo* bo = nullptr;
   {
-    PRINTENDFUNC;
-    return;
+    std::lock_guard<std::mutex> lk(mBOMapMtx);
+    auto it = mXoclObjMap.find(boHandle);
+    if(it == mXoclObjMap.end())
+    {
+      PRINTENDFUNC;
+      return;
+    }
+    bo = (*it).second;
+    mXoclObjMap.erase(it);
   }
-  xclemulation::drm_xocl_bo* bo = (*it).second;;
   if(bo)
   {
     xclFreeDeviceBuffer(bo->base);
-    mXoclObjMap.erase(it);
   }
   PRINTENDFUNC;
 }
@@ -1355,7 +1580,6 @@ void CpuemShim::xclFreeBO(unsigned int boHandle)
 /******************************** xclWriteBO *******************************************/
 size_t CpuemShim::xclWriteBO(unsigned int boHandle, const void *src, size_t size, size_t seek)
 {
-  std::lock_guard<std::mutex> lk(mApiMtx);
   if (mLogStream.is_open()) 
   {
     mLogStream << __func__ << ", " << std::this_thread::get_id() << ", " << std::hex << boHandle << " , "<< src <<" , "<< size << ", " << seek << std::endl;
@@ -1375,7 +1599,6 @@ size_t CpuemShim::xclWriteBO(unsigned int boHandle, const void *src, size_t size
 /******************************** xclReadBO *******************************************/
 size_t CpuemShim::xclReadBO(unsigned int boHandle, void *dst, size_t size, size_t skip)
 {
-  std::lock_guard<std::mutex> lk(mApiMtx);
   if (mLogStream.is_open()) 
   {
     mLogStream << __func__ << ", " << std::this_thread::get_id() << ", " << std::hex << boHandle << " , "<< dst <<" , "<< size << ", " << skip << std::endl;
@@ -1393,17 +1616,276 @@ size_t CpuemShim::xclReadBO(unsigned int boHandle, void *dst, size_t size, size_
 /***************************************************************************************/
 /********************************************** QDMA APIs IMPLEMENTATION START **********************************************/
 
+// Write queues stream their data through the todevice ring, read queues
+// only descriptors; completions of all queues share one ring
+static const uint64_t STREAM_DATA_RING_SIZE = 4 << 20;
+static const uint64_t STREAM_CONTROL_RING_SIZE = 256 << 10;
+
+// Waits for room in a ring or for completions, mReqListMtx is released
+// meanwhile
+static void streamBackoff(std::unique_lock<std::mutex>& lk, unsigned& spins)
+{
+  lk.unlock();
+  if (++spins < 64)
+    std::this_thread::yield();
+  else
+    std::this_thread::sleep_for(std::chrono::microseconds(20));
+  lk.lock();
+}
+
+/*
+ * createStreamQueue()
+ *
+ * Offers rings for the new queue, falls back to RPCs if the device
+ * process does not take them.  Returns the queue handle, 0 on failure.
+ */
+uint64_t CpuemShim::createStreamQueue(xclQueueContext *q_ctx, bool write)
+{
+  std::shared_ptr<StreamQueue> queue(new StreamQueue);
+  queue->write = write;
+  queue->destroyed = false;
+  bool offer = false;
+  {
+    std::lock_guard<std::mutex> lk(mReqListMtx);
+    if (!mStreamCompletions.valid())
+      mStreamCompletions.create(STREAM_CONTROL_RING_SIZE);
+    offer = mStreamCompletions.valid()
+      && queue->todevice.create(write ? STREAM_DATA_RING_SIZE : STREAM_CONTROL_RING_SIZE)
+      && (write || queue->fromdevice.create(STREAM_DATA_RING_SIZE));
+  }
+
+  uint64_t q_handle = 0;
+  bool ring = false;
+  if (offer)
+  {
+    xclCreateStreamQueue_RPC_CALL(xclCreateQueue,q_ctx,write,queue);
+  }
+  else
+  {
+    xclCreateQueue_RPC_CALL(xclCreateQueue,q_ctx,write);
+  }
+  if (q_handle > 0 && ring)
+  {
+    std::lock_guard<std::mutex> lk(mReqListMtx);
+    mStreamQueues[q_handle] = std::move(queue);
+  }
+  return q_handle;
+}
+
+/*
+ * findStreamQueue()
+ *
+ * Returns the queue served through rings, null for RPC queues
+ */
+std::shared_ptr<CpuemShim::StreamQueue> CpuemShim::findStreamQueue(uint64_t q_hdl)
+{
+  std::lock_guard<std::mutex> lk(mReqListMtx);
+  auto it = mStreamQueues.find(q_hdl);
+  return (it == mStreamQueues.end()) ? nullptr : it->second;
+}
+
+/*
+ * addStreamRequest()
+ *
+ * Takes the next request counter and keeps the requests that complete
+ * later, called with mReqListMtx held
+ */
+uint64_t CpuemShim::addStreamRequest(uint64_t q_hdl, xclQueueRequest *req, bool ring)
+{
+  uint64_t reqCounter = mReqCounter++;
+  bool nonBlocking = (req->flag & XCL_QUEUE_REQ_NONBLOCKING);
+  if (!ring && !nonBlocking)
+    return reqCounter;
+
+  StreamRequest& sreq = mReqList[reqCounter];
+  sreq.queue = q_hdl;
+  sreq.priv_data = req->priv_data;
+  sreq.bufs.assign(req->bufs, req->bufs + req->buf_num);
+  sreq.nonBlocking = nonBlocking;
+  sreq.ring = ring;
+  sreq.buf = 0;
+  sreq.offset = 0;
+  sreq.bytes = 0;
+  sreq.done = false;
+  return reqCounter;
+}
+
+/*
+ * postStreamRequest()
+ *
+ * Puts the data of a write request or the descriptors of a read request
+ * on the todevice ring of queue, waiting for room as needed.  Data
+ * records are at most a quarter of the ring so that the device process
+ * consumes while the shim produces.  Called with the producer mutex of
+ * queue and mReqListMtx held.  Stops early if the queue is destroyed
+ * meanwhile.  Returns the bytes posted.
+ */
+uint64_t CpuemShim::postStreamRequest(StreamQueue& queue, uint64_t reqCounter, xclQueueRequest *req,
+                                      std::unique_lock<std::mutex>& lk)
+{
+  xclemulation::StreamRing& ring = queue.todevice;
+  const uint64_t chunk = std::max<uint64_t>(ring.maxPayload() / 4, 8);
+  uint64_t fullSize = 0;
+  unsigned spins = 0;
+
+  for (unsigned i = 0; i < req->buf_num || (i == 0 && req->buf_num == 0); i++)
+  {
+    const bool lastBuf = (i + 1 >= req->buf_num);
+    const char* src = req->buf_num ? req->bufs[i].buf : nullptr;
+    const uint64_t len = req->buf_num ? req->bufs[i].len : 0;
+    uint64_t done = 0;
+    do
+    {
+      xclemulation::StreamRecord rec;
+      rec.req = reqCounter;
+      rec.size = queue.write ? 0 : len;
+      rec.len = queue.write ? std::min(len - done, chunk) : 0;
+      rec.flags = 0;
+      if (lastBuf && (!queue.write || done + rec.len == len))
+      {
+        rec.flags |= xclemulation::StreamRing::RECORD_LAST;
+        if (req->flag & XCL_QUEUE_REQ_EOT)
+          rec.flags |= xclemulation::StreamRing::RECORD_EOT;
+      }
+      while (!ring.push(rec, src + done))
+      {
+        drainStreamRings();
+        streamBackoff(lk, spins);
+        // the device process no longer serves the queue
+        if (queue.destroyed)
+          return fullSize + done;
+      }
+      spins = 0;
+      done += queue.write ? rec.len : len;
+    } while (done < len);
+    fullSize += len;
+  }
+  return fullSize;
+}
+
+/*
+ * drainStreamRings()
+ *
+ * Copies data of read queues to the buffers of their requests and marks
+ * completed requests, called with mReqListMtx held.  The device process
+ * posts the data of a read request before its completion, so the data
+ * rings are drained after the completions are taken.
+ */
+void CpuemShim::drainStreamRings()
+{
+  std::vector<xclemulation::StreamRecord> completions;
+  xclemulation::StreamRecord rec;
+  while (mStreamCompletions.peek(rec))
+  {
+    completions.push_back(rec);
+    mStreamCompletions.pop(nullptr);
+  }
+
+  std::vector<char> scatter;
+  for (auto& it : mStreamQueues)
+  {
+    xclemulation::StreamRing& ring = it.second->fromdevice;
+    if (!ring.valid())
+      continue;
+    while (ring.peek(rec))
+    {
+      auto rit = mReqList.find(rec.req);
+      if (rit == mReqList.end())
+      {
+        // request of a destroyed queue
+        ring.pop(nullptr);
+        continue;
+      }
+      StreamRequest& sreq = rit->second;
+      if (sreq.buf < sreq.bufs.size() && rec.len <= sreq.bufs[sreq.buf].len - sreq.offset)
+      {
+        ring.pop(sreq.bufs[sreq.buf].buf + sreq.offset);
+        sreq.offset += rec.len;
+      }
+      else
+      {
+        // record spans buffers of the request
+        scatter.resize(rec.len);
+        ring.pop(scatter.data());
+        uint64_t copied = 0;
+        while (copied < rec.len && sreq.buf < sreq.bufs.size())
+        {
+          uint64_t size = std::min<uint64_t>(rec.len - copied, sreq.bufs[sreq.buf].len - sreq.offset);
+          memcpy(sreq.bufs[sreq.buf].buf + sreq.offset, scatter.data() + copied, size);
+          copied += size;
+          sreq.offset += size;
+          if (sreq.offset == sreq.bufs[sreq.buf].len)
+          {
+            sreq.buf++;
+            sreq.offset = 0;
+          }
+        }
+      }
+      if (sreq.buf < sreq.bufs.size() && sreq.offset == sreq.bufs[sreq.buf].len)
+      {
+        sreq.buf++;
+        sreq.offset = 0;
+      }
+    }
+  }
+
+  for (auto& completion : completions)
+  {
+    auto rit = mReqList.find(completion.req);
+    if (rit == mReqList.end())
+      continue;
+    rit->second.bytes = completion.size;
+    rit->second.done = true;
+  }
+}
+
+/*
+ * waitStreamRequest()
+ *
+ * Waits for the completion of a blocking request on a ring, returns the
+ * bytes the device process reported
+ */
+uint64_t CpuemShim::waitStreamRequest(uint64_t reqCounter, std::unique_lock<std::mutex>& lk)
+{
+  unsigned spins = 0;
+  for (;;)
+  {
+    drainStreamRings();
+    auto it = mReqList.find(reqCounter);
+    if (it == mReqList.end())
+      return 0;
+    if (it->second.done)
+    {
+      uint64_t bytes = it->second.bytes;
+      mReqList.erase(it);
+      return bytes;
+    }
+    streamBackoff(lk, spins);
+  }
+}
+
+/*
+ * releaseStreamQueues()
+ */
+void CpuemShim::releaseStreamQueues()
+{
+  std::lock_guard<std::mutex> lk(mReqListMtx);
+  mReqList.clear();
+  for (auto& it : mStreamQueues)
+    it.second->destroyed = true;
+  mStreamQueues.clear();
+  mStreamCompletions.release();
+}
+
 /*
  * xclCreateWriteQueue()
  */
 int CpuemShim::xclCreateWriteQueue(xclQueueContext *q_ctx, uint64_t *q_hdl)
 {
-  std::lock_guard<std::mutex> lk(mApiMtx);
   if (mLogStream.is_open()) 
     mLogStream << __func__ << ", " << std::this_thread::get_id() << std::endl;
 
-  uint64_t q_handle = 0;
-  xclCreateQueue_RPC_CALL(xclCreateQueue,q_ctx,true);
+  uint64_t q_handle = createStreamQueue(q_ctx,true);
   if(q_handle <= 0)
   {
     if (mLogStream.is_open()) 
@@ -1421,13 +1903,11 @@ int CpuemShim::xclCreateWriteQueue(xclQueueContext *q_ctx, uint64_t *q_hdl)
  */
 int CpuemShim::xclCreateReadQueue(xclQueueContext *q_ctx, uint64_t *q_hdl)
 {
-  std::lock_guard<std::mutex> lk(mApiMtx);
   if (mLogStream.is_open()) 
   {
     mLogStream << __func__ << ", " << std::this_thread::get_id() << std::endl;
   }
-  uint64_t q_handle = 0;
-  xclCreateQueue_RPC_CALL(xclCreateQueue,q_ctx,false);
+  uint64_t q_handle = createStreamQueue(q_ctx,false);
   if(q_handle <= 0)
   {
     if (mLogStream.is_open()) 
@@ -1445,7 +1925,6 @@ int CpuemShim::xclCreateReadQueue(xclQueueContext *q_ctx, uint64_t *q_hdl)
  */
 int CpuemShim::xclDestroyQueue(uint64_t q_hdl)
 {
-  std::lock_guard<std::mutex> lk(mApiMtx);
   if (mLogStream.is_open()) 
   {
     mLogStream << __func__ << ", " << std::this_thread::get_id() << std::endl;
@@ -1461,6 +1940,24 @@ int CpuemShim::xclDestroyQueue(uint64_t q_hdl)
     return -1;
   }
 
+  {
+    // requests still pending on the queue are dropped with it
+    std::lock_guard<std::mutex> lk(mReqListMtx);
+    for (auto it = mReqList.begin(); it != mReqList.end(); )
+    {
+      if (it->second.queue == q_hdl)
+        mReqList.erase(it++);
+      else
+        it++;
+    }
+    // writers and readers still posting to the queue stop on destroyed
+    auto it = mStreamQueues.find(q_hdl);
+    if (it != mStreamQueues.end())
+    {
+      it->second->destroyed = true;
+      mStreamQueues.erase(it);
+    }
+  }
   PRINTENDFUNC;
   return 0;
 }
@@ -1470,7 +1967,6 @@ int CpuemShim::xclDestroyQueue(uint64_t q_hdl)
  */
 ssize_t CpuemShim::xclWriteQueue(uint64_t q_hdl, xclQueueRequest *wr)
 {
-  std::lock_guard<std::mutex> lk(mApiMtx);
   if (mLogStream.is_open()) 
   {
     mLogStream << __func__ << ", " << std::this_thread::get_id() << std::endl;
@@ -1482,23 +1978,40 @@ ssize_t CpuemShim::xclWriteQueue(uint64_t q_hdl, xclQueueRequest *wr)
   
   bool nonBlocking = false;
   if (wr->flag & XCL_QUEUE_REQ_NONBLOCKING) 
-  {
-    std::map<uint64_t,uint64_t> vaLenMap;
-    for (unsigned i = 0; i < wr->buf_num; i++) 
+    nonBlocking = true;
+
+  uint64_t reqCounter = 0;
+  uint64_t fullSize = 0;
+  std::shared_ptr<StreamQueue> queue = findStreamQueue(q_hdl);
+  if (queue)
+  {
+    // one request at a time so records of requests do not interleave on
+    // the ring
+    std::unique_lock<std::mutex> plk(queue->producerMtx);
+    std::unique_lock<std::mutex> lk(mReqListMtx);
+    if (queue->destroyed)
     {
-      vaLenMap[wr->bufs[i].va] = wr->bufs[i].len;
+      PRINTENDFUNC;
+      return 0;
     }
-    mReqList.push_back(std::make_tuple(mReqCounter, wr->priv_data, vaLenMap));
-    nonBlocking = true;
+    reqCounter = addStreamRequest(q_hdl, wr, true);
+    fullSize = postStreamRequest(*queue, reqCounter, wr, lk);
+    plk.unlock();
+    if (!nonBlocking)
+      fullSize = waitStreamRequest(reqCounter, lk);
+    PRINTENDFUNC;
+    return fullSize;
+  }
+  {
+    std::lock_guard<std::mutex> lk(mReqListMtx);
+    reqCounter = addStreamRequest(q_hdl, wr, false);
   }
-  uint64_t fullSize = 0;
   for (unsigned i = 0; i < wr->buf_num; i++) 
   {
     xclWriteQueue_RPC_CALL(xclWriteQueue,q_hdl, wr->bufs[i].va, wr->bufs[i].len);
     fullSize += written_size;
   }
   PRINTENDFUNC;
-  mReqCounter++;
   return fullSize;
 }
 
@@ -1518,19 +2031,37 @@ ssize_t CpuemShim::xclReadQueue(uint64_t q_hdl, xclQueueRequest *rd)
 
   bool nonBlocking = false;
   if (rd->flag & XCL_QUEUE_REQ_NONBLOCKING) 
-  {
     nonBlocking = true;
-    std::map<uint64_t,uint64_t> vaLenMap;
-    for (unsigned i = 0; i < rd->buf_num; i++) 
+
+  uint64_t reqCounter = 0;
+  uint64_t fullSize = 0;
+  std::shared_ptr<StreamQueue> queue = findStreamQueue(q_hdl);
+  if (queue)
+  {
+    // one request at a time so records of requests do not interleave on
+    // the ring
+    std::unique_lock<std::mutex> plk(queue->producerMtx);
+    std::unique_lock<std::mutex> lk(mReqListMtx);
+    if (queue->destroyed)
     {
-      vaLenMap[rd->bufs[i].va] = rd->bufs[i].len;
+      PRINTENDFUNC;
+      return 0;
     }
-    mReqList.push_back(std::make_tuple(mReqCounter,rd->priv_data, vaLenMap));
+    reqCounter = addStreamRequest(q_hdl, rd, true);
+    fullSize = postStreamRequest(*queue, reqCounter, rd, lk);
+    plk.unlock();
+    if (!nonBlocking)
+      fullSize = waitStreamRequest(reqCounter, lk);
+    PRINTENDFUNC;
+    return fullSize;
+  }
+  {
+    std::lock_guard<std::mutex> lk(mReqListMtx);
+    reqCounter = addStreamRequest(q_hdl, rd, false);
   }
 
   void *dest;
 
-  uint64_t fullSize = 0;
   for (unsigned i = 0; i < rd->buf_num; i++) 
   {
     dest = (void *)rd->bufs[i].va;
@@ -1541,7 +2072,6 @@ ssize_t CpuemShim::xclReadQueue(uint64_t q_hdl, xclQueueRequest *rd)
     } while (read_size == 0 && !nonBlocking);
     fullSize += read_size;
   }
-  mReqCounter++;
   PRINTENDFUNC;
   return fullSize;
 
@@ -1555,31 +2085,43 @@ int CpuemShim::xclPollCompletion(int min_compl, int max_compl, xclReqCompletion
   {
     mLogStream << __func__ << ", " << std::this_thread::get_id() << " , "<< max_compl <<", "<<min_compl<<" ," << *actual <<" ," << timeout << std::endl;
   }
-//  struct timespec time, *ptime = NULL;
-//
-//  if (timeout > 0) 
-//  {
-//    memset(&time, 0, sizeof(time));
-//    time.tv_sec = timeout / 1000;
-//    time.tv_nsec = (timeout % 1000) * 1000000;
-//    ptime = &time;
-//  }
 
   *actual = 0;
+  auto start = std::chrono::steady_clock::now();
+  unsigned spins = 0;
+  // queue writes and reads may add requests while the lock is released
+  // between passes
+  std::unique_lock<std::mutex> lk(mReqListMtx);
   while(*actual < min_compl)
   {
-    std::list<std::tuple<uint64_t ,void*, std::map<uint64_t,uint64_t> > >::iterator it = mReqList.begin();
-    while ( it != mReqList.end() )
+    drainStreamRings();
+    auto it = mReqList.begin();
+    while ( it != mReqList.end() && *actual < max_compl )
     {
-      unsigned numBytesProcessed = 0;
-      uint64_t reqCounter = std::get<0>(*it);
-      void* priv_data = std::get<1>(*it);
-      std::map<uint64_t,uint64_t>vaLenMap = std::get<2>(*it);
-      xclPollCompletion_RPC_CALL(xclPollCompletion,reqCounter,vaLenMap);
-      if(numBytesProcessed > 0)
+      StreamRequest& sreq = it->second;
+      if (!sreq.nonBlocking)
+      {
+        it++;
+        continue;
+      }
+      if (!sreq.ring)
+      {
+        unsigned numBytesProcessed = 0;
+        uint64_t reqCounter = it->first;
+        std::map<uint64_t,uint64_t> vaLenMap;
+        for (auto& buf : sreq.bufs)
+          vaLenMap[buf.va] = buf.len;
+        xclPollCompletion_RPC_CALL(xclPollCompletion,reqCounter,vaLenMap);
+        if(numBytesProcessed > 0)
+        {
+          sreq.bytes = numBytesProcessed;
+          sreq.done = true;
+        }
+      }
+      if (sreq.done)
       {
-        comps[*actual].priv_data = priv_data;
-        comps[*actual].nbytes = numBytesProcessed;
+        comps[*actual].priv_data = sreq.priv_data;
+        comps[*actual].nbytes = sreq.bytes;
         (*actual)++;
         mReqList.erase(it++);
       }
@@ -1588,6 +2130,11 @@ int CpuemShim::xclPollCompletion(int min_compl, int max_compl, xclReqCompletion
         it++;
       }
     }
+    if (*actual >= min_compl)
+      break;
+    if (timeout > 0 && std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(timeout))
+      break;
+    streamBackoff(lk, spins);
   }
   PRINTENDFUNC;
   return (*actual);
@@ -1598,7 +2145,6 @@ int CpuemShim::xclPollCompletion(int min_compl, int max_compl, xclReqCompletion
  */
 void * CpuemShim::xclAllocQDMABuf(size_t size, uint64_t *buf_hdl)
 {
-  std::lock_guard<std::mutex> lk(mApiMtx);
   if (mLogStream.is_open()) 
   {
     mLogStream << __func__ << ", " << std::this_thread::get_id() << std::endl;
@@ -1621,7 +2167,6 @@ void * CpuemShim::xclAllocQDMABuf(size_t size, uint64_t *buf_hdl)
  */
 int CpuemShim::xclFreeQDMABuf(uint64_t buf_hdl)
 {
-  std::lock_guard<std::mutex> lk(mApiMtx);
   if (mLogStream.is_open()) 
   {
     mLogStream << __func__ << ", " << std::this_thread::get_id() << std::endl;
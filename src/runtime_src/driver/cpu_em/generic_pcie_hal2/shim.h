@@ -21,6 +21,8 @@
 #include "config.h"
 #include "em_defines.h"
 #include "memorymanager.h"
+#include "shared_memory.h"
+#include "device_pool.h"
 #include "rpc_messages.pb.h"
 
 #include "xclperf.h"
@@ -32,6 +34,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <memory>
 #include <thread>
 #include <tuple>
 #include <sys/wait.h>
@@ -92,6 +95,11 @@ namespace xclcpuemhal2 {
       // Raw read/write
       size_t xclWrite(xclAddressSpace space, uint64_t offset, const void *hostBuf, size_t size);
       size_t xclRead(xclAddressSpace space, uint64_t offset, void *hostBuf, size_t size);
+      // Several kernel control register blocks in one message, in order
+      size_t xclWriteRegisters(const std::vector<xclemulation::register_block>& blocks);
+      // Read the 32-bit kernel control registers at offsets until one has a
+      // bit of mask set or timeout microseconds have passed (0: read once)
+      int xclWaitRegisters(const std::vector<uint64_t>& offsets, uint32_t mask, uint32_t timeout, std::vector<uint32_t>& values);
 
       // Buffer management
       uint64_t xclAllocDeviceBuffer(size_t size);
@@ -166,6 +174,7 @@ namespace xclcpuemhal2 {
       std::string dec2bin(uint32_t n);
       std::string dec2bin(uint32_t n, unsigned bits);
 
+      // RPC channel: sock and the message buffers, taken by RPC_PROLOGUE
       std::mutex mtx;
       unsigned int message_size;
       bool simulator_started;
@@ -184,6 +193,15 @@ namespace xclcpuemhal2 {
       void launchTempProcess();
       void initMemoryManager(std::list<xclemulation::DDRBank>& DDRBankList);
       std::vector<xclemulation::MemoryManager *> mDDRMemoryManager;
+      void initSharedMemory();
+      xclemulation::SharedDeviceMemory mSharedMemory;
+      // Device process takes batched register messages.  Kernel control
+      // writes are then posted and go out with the next start of a CU or
+      // before the next read.
+      bool mRegisterBatch;
+      std::mutex mPostedMtx;
+      std::vector<std::pair<uint64_t,std::string>> mPostedWrites;
+      bool flushPostedWrites();
 
       void* ci_buf;
       call_packet_info ci_msg;
@@ -204,19 +222,65 @@ namespace xclcpuemhal2 {
       int mDSAMinorVersion;
       unsigned int mDeviceIndex;
       bool mCloseAll;
+      bool mKeepAlive;
+      DeviceServerPool* mServerPool;
       
       std::mutex mProcessLaunchMtx;
+      std::mutex mTempProcessMtx;
+      // Device teardown.  Buffer objects, the memory managers and the RPC
+      // channel have their own locks so that copies of different BOs and
+      // register accesses do not wait for each other.
       std::mutex mApiMtx;
       static bool mFirstBinary;
       bool bUnified;
       bool bXPR;
       // HAL2 RELATED member variables start
+      std::mutex mBOMapMtx; // mXoclObjMap and mBufferCount
       std::map<int, xclemulation::drm_xocl_bo*> mXoclObjMap;
       static unsigned int mBufferCount;
+      static std::mutex mFdToFileNameMapMtx;
       static std::map<int, std::tuple<std::string,int,void*> > mFdToFileNameMap;
       // HAL2 RELATED member variables end 
-      std::list<std::tuple<uint64_t ,void*, std::map<uint64_t , uint64_t> > > mReqList;
+      // Stream queues.  Queues the device process serves through shared
+      // memory rings take requests on their todevice ring (data of write
+      // queues, descriptors of read queues), give the data of read queues
+      // back on their fromdevice ring and complete every request on
+      // mStreamCompletions.  Other queues take one RPC per buffer.
+      struct StreamQueue
+      {
+        bool write;
+        bool destroyed;  // set under mReqListMtx when the queue goes away
+        std::mutex producerMtx;  // held while a request is posted, taken before mReqListMtx
+        xclemulation::StreamRing todevice;
+        xclemulation::StreamRing fromdevice;
+      };
+      struct StreamRequest
+      {
+        uint64_t queue;
+        void* priv_data;
+        std::vector<xclReqBuffer> bufs;
+        bool nonBlocking;
+        bool ring;
+        size_t buf;       // buffer and offset the next data of a read
+        uint64_t offset;  // request goes to
+        uint64_t bytes;
+        bool done;
+      };
+      std::mutex mReqListMtx; // stream queues, mReqList and mReqCounter
+      // writers and readers keep a queue alive while they post to it
+      std::map<uint64_t, std::shared_ptr<StreamQueue>> mStreamQueues;
+      xclemulation::StreamRing mStreamCompletions;
+      // nonblocking requests and the requests on rings, by request counter
+      std::map<uint64_t, StreamRequest> mReqList;
       uint64_t mReqCounter;
+      uint64_t createStreamQueue(xclQueueContext *q_ctx, bool write);
+      uint64_t addStreamRequest(uint64_t q_hdl, xclQueueRequest *req, bool ring);
+      std::shared_ptr<StreamQueue> findStreamQueue(uint64_t q_hdl);
+      uint64_t postStreamRequest(StreamQueue& queue, uint64_t reqCounter, xclQueueRequest *req,
+                                 std::unique_lock<std::mutex>& lk);
+      uint64_t waitStreamRequest(uint64_t reqCounter, std::unique_lock<std::mutex>& lk);
+      void drainStreamRings();
+      void releaseStreamQueues();
       FeatureRomHeader mFeatureRom;
 
   };
@@ -1,5 +1,9 @@
-#include "shim.h"
+#include "mbscheduler.h"
 #include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <cstdlib>
+#include <unistd.h>
 //#define EM_DEBUG_KDS
 namespace xclhwemhal2 {
 
@@ -30,6 +34,7 @@ namespace xclhwemhal2 {
     poll = 0;
     stop = false;
     pSch = _sch ;
+    exec = NULL;
     pthread_mutex_init(&state_lock,NULL);
     pthread_cond_init(&state_cond,NULL);
     scheduler_thread = 0;
@@ -43,8 +48,9 @@ namespace xclhwemhal2 {
     poll = 0;
     stop = false;
     pSch = NULL ;
-    pthread_mutex_init(&state_lock,NULL);
-    pthread_cond_init(&state_cond,NULL);
+    exec = NULL;
+    pthread_mutex_destroy(&state_lock);
+    pthread_cond_destroy(&state_cond);
   }
 
   exec_core::exec_core()
@@ -93,18 +99,18 @@ namespace xclhwemhal2 {
   {
   }
 
-  MBScheduler::MBScheduler(HwEmShim* _parent)
+  MBScheduler::MBScheduler(sched_device* _parent)
   {
     mParent = _parent;
-    mScheduler = new xocl_sched(this);
-    num_pending = 0;
+    num_completed = 0;
   }
 
   MBScheduler::~MBScheduler()
   {
-    delete mScheduler;
-    mScheduler = NULL;
-    num_pending = 0;
+    fini_scheduler_thread();
+    for (auto xcmd : free_cmds)
+      delete xcmd;
+    free_cmds.clear();
   }
  
 //KDS FLOW STARTED...
@@ -118,7 +124,8 @@ namespace xclhwemhal2 {
     uint32_t cu_addr = cu_idx_to_addr(exec,cu_idx);
 
     uint32_t mask = 0;
-    mParent->xclRead(XCL_ADDR_KERNEL_CTRL, exec->base + cu_addr, (void*)&mask, 4);
+    if (!take_done_register(exec, exec->base + cu_addr, mask))
+      mask = mParent->read_register(exec->base + cu_addr);
     /* done is indicated by AP_DONE(2) alone or by AP_DONE(2) | AP_IDLE(4)
      * but not by AP_IDLE itself.  Since 0x10 | (0x10 | 0x100) = 0x110
      * checking for 0x10 is sufficient. */
@@ -139,11 +146,12 @@ namespace xclhwemhal2 {
     return acquire_slot_idx(xcmd->exec);
   }
   
-  unsigned int getFirstSetBitPos(int n) 
+  unsigned int getFirstSetBitPos(uint32_t n) 
   { 
     if(!n)
       return -1;
-    return log2(n & -n) ; 
+    /* unsigned, CU 31 is bit 31 */
+    return log2(n & (~n + 1)) ; 
   } 
 
   int MBScheduler::get_free_cu(struct xocl_cmd *xcmd)
@@ -156,7 +164,7 @@ namespace xclhwemhal2 {
       int cu_idx = getFirstSetBitPos((cmd_mask | busy_mask) ^ busy_mask);
       if (cu_idx>=0) 
       {
-        xcmd->exec->cu_status[mask_idx] ^= 1<<cu_idx;
+        xcmd->exec->cu_status[mask_idx] ^= 1U<<cu_idx;
         return cu_idx_from_mask(cu_idx,mask_idx);
       }
     }
@@ -188,11 +196,13 @@ namespace xclhwemhal2 {
     /* can't get memcpy_toio to work */
     /* memcpy_toio(user_bar + cu_addr + 4,ecmd->data + ecmd->extra_cu_masks + 1,(size-1)*4); */
 
-    mParent->xclWrite(XCL_ADDR_KERNEL_CTRL,exec->base + cu_addr + 4 , ecmd->data + ecmd->extra_cu_masks + 1 , size*4);
+    std::vector<xclemulation::register_block> blocks;
+    blocks.push_back({exec->base + cu_addr + 4, ecmd->data + ecmd->extra_cu_masks + 1, size*4});
 
     /* start CU at base + 0x0 */
     int ap_start = 0x1;
-    mParent->xclWrite(XCL_ADDR_KERNEL_CTRL,exec->base + cu_addr, (void*)&ap_start , 4 );
+    blocks.push_back({exec->base + cu_addr, &ap_start, 4});
+    mParent->write_registers(blocks);
   } 
 
   static unsigned int get_cu_idx(struct exec_core *exec, unsigned int cmd_idx)
@@ -263,9 +273,12 @@ namespace xclhwemhal2 {
       bool waitForResp = false;
       if (opcode(xcmd)==ERT_CONFIGURE)
         waitForResp = true;
-      do{
-        mParent->xclRead(XCL_ADDR_KERNEL_CTRL, xcmd->exec->base + csr_addr, (void*)&mask, 4);
-      }while(waitForResp && !mask);
+      if (!take_done_register(exec, exec->base + csr_addr, mask) || (waitForResp && !mask))
+      {
+        do{
+          mask = mParent->read_register(exec->base + csr_addr);
+        }while(waitForResp && !mask);
+      }
       
       if (mask)
       {
@@ -310,22 +323,22 @@ namespace xclhwemhal2 {
 
     slot_addr = ERT_CQ_BASE_ADDR + xcmd->slot_idx*slot_size(xcmd->exec);
 
-    /* TODO write packet minus header */
-    mParent->xclWrite(XCL_ADDR_KERNEL_CTRL, xcmd->exec->base + slot_addr + 4, xcmd->packet->data,(packet_size(xcmd)-1)*sizeof(uint32_t)); 
+    /* packet minus header, then header and interrupt in one message */
+    std::vector<xclemulation::register_block> blocks;
+    blocks.push_back({xcmd->exec->base + slot_addr + 4, xcmd->packet->data, (packet_size(xcmd)-1)*sizeof(uint32_t)});
     //memcpy_toio(xcmd->exec->base + slot_addr + 4,xcmd->packet->data,(packet_size(xcmd)-1)*sizeof(uint32_t));
 
-    /* TODO write header */
-    mParent->xclWrite(XCL_ADDR_KERNEL_CTRL, xcmd->exec->base + slot_addr, (void*)(&xcmd->packet->header) ,4); 
+    blocks.push_back({xcmd->exec->base + slot_addr, &xcmd->packet->header, 4});
     //iowrite32(xcmd->packet->header,xcmd->exec->base + slot_addr);
 
     /* trigger interrupt to embedded scheduler if feature is enabled */
+    uint32_t mask = 1<<slot_idx_in_mask(xcmd->slot_idx);
     if (xcmd->exec->cq_interrupt) {
       uint32_t cq_int_addr = ERT_CQ_STATUS_REGISTER_ADDR + (slot_mask_idx(xcmd->slot_idx)<<2);
-      uint32_t mask = 1<<slot_idx_in_mask(xcmd->slot_idx);
-      //TODO 
-      mParent->xclWrite(XCL_ADDR_KERNEL_CTRL,xcmd->exec->base + cq_int_addr, (void*)(&mask) ,4);
+      blocks.push_back({xcmd->exec->base + cq_int_addr, &mask, 4});
         //iowrite32(mask,xcmd->exec->base + cq_int_addr);
     }
+    mParent->write_registers(blocks);
 #ifdef EM_DEBUG_KDS
     std::cout<<"Submitted the command CXMD: "<<xcmd<<" PACKET: "<<xcmd->packet<< " BO: "<< xcmd->bo << std::endl <<std::endl;;
 #endif
@@ -355,7 +368,7 @@ namespace xclhwemhal2 {
         exec->cu_addr_map[i] = cfg->data[i];
       }
 
-      if (cfg->ert && mParent->isMBSchedulerEnabled())
+      if (cfg->ert && mParent->ert_enabled())
       {
         exec->ert=true;
         exec->polling_mode = 1; //cfg->polling;
@@ -389,6 +402,11 @@ namespace xclhwemhal2 {
       client_ctx* entry = it;
       entry->trigger++;
     }
+
+    /* wake up the host waiting in wait_for_completion */
+    std::lock_guard<std::mutex> lk(m_complete_mutex);
+    num_completed++;
+    m_complete_cond.notify_all();
   }
 
   void MBScheduler::mark_cmd_complete(xocl_cmd *xcmd)
@@ -396,7 +414,7 @@ namespace xclhwemhal2 {
     xcmd->exec->submitted_cmds[xcmd->slot_idx] = NULL;
     set_cmd_state(xcmd,ERT_CMD_STATE_COMPLETED);
     if (xcmd->exec->polling_mode)
-      mScheduler->poll--;
+      xcmd->exec->scheduler->poll--;
     release_slot_idx(xcmd->exec,xcmd->slot_idx);
 #ifdef EM_DEBUG_KDS
     std::cout<<"Marking command Complete XCMD: " <<xcmd<<" PACKET: "<<xcmd->packet<< " BO: "<< xcmd->bo << std::endl;
@@ -447,7 +465,7 @@ namespace xclhwemhal2 {
     if ( submitted ) {
       set_cmd_state(xcmd,ERT_CMD_STATE_RUNNING);
       if (xcmd->exec->polling_mode)
-        mScheduler->poll++;
+        xcmd->exec->scheduler->poll++;
       xcmd->exec->submitted_cmds[xcmd->slot_idx] = xcmd;
       retval = true;
     }
@@ -467,13 +485,28 @@ namespace xclhwemhal2 {
 
   xocl_cmd* MBScheduler::get_free_xocl_cmd(void)
   {
-    xocl_cmd* cmd = new xocl_cmd;
+    std::lock_guard<std::mutex> lk(free_cmds_mutex);
+    if (free_cmds.empty())
+      return new xocl_cmd;
+    xocl_cmd* cmd = free_cmds.front();
+    free_cmds.pop_front();
     return cmd;
   } 
+
+  void MBScheduler::complete_to_free(xocl_cmd *xcmd)
+  {
+    xcmd->bo = NULL;
+    xcmd->packet = NULL;
+    std::lock_guard<std::mutex> lk(free_cmds_mutex);
+    free_cmds.push_back(xcmd);
+  }
   
   int MBScheduler::add_cmd(exec_core *exec, xclemulation::drm_xocl_bo* bo)
   {
-    std::lock_guard<std::mutex> lk(pending_cmds_mutex);
+    if (init_scheduler_thread(exec))
+      return -1;
+    xocl_sched *xs = exec->scheduler;
+
     xocl_cmd *xcmd = get_free_xocl_cmd();
     xcmd->packet = (struct ert_packet*)bo->buf;
     xcmd->bo=bo;
@@ -485,79 +518,114 @@ namespace xclhwemhal2 {
 #endif
 
     set_cmd_state(xcmd,ERT_CMD_STATE_NEW);
-    pending_cmds.push_back(xcmd);
-    num_pending++;
-    scheduler_wait_condition();
+    pthread_mutex_lock(&xs->state_lock);
+    xs->pending_cmds.push_back(xcmd);
+    pthread_cond_signal(&xs->state_cond);
+    pthread_mutex_unlock(&xs->state_lock);
     return 0;
   }
 
-  
-  
-  int MBScheduler::scheduler_wait_condition()
+  /* called with xs->state_lock held */
+  void MBScheduler::scheduler_queue_cmds(xocl_sched *xs)
   {
-    bool bSchComeOutOfCond = false;
-    if (mScheduler->stop || mScheduler->error) {
-      bSchComeOutOfCond = true;
-    }
-
-    if (num_pending > 0) {
-      bSchComeOutOfCond = true;
-    }
-
-    if (mScheduler->intc > 0) {
-      mScheduler->intc = 0;
-      bSchComeOutOfCond = true;
-    }
-
-    if (mScheduler->poll >0 ) {
-      bSchComeOutOfCond = true;
-    }
-    if(bSchComeOutOfCond)
-    {
-      pthread_cond_signal(&mScheduler->state_cond);
-      return 0;
-    }
-    return 1;
-  }
-
-  void MBScheduler::scheduler_queue_cmds()
-  {
-    if(pending_cmds.empty())
+    if(xs->pending_cmds.empty())
       return;
 
 #ifdef EM_DEBUG_KDS
     std::cout<<"Iterating on pending commands and adding to Scheduler command_queue  "<< std::endl;
 #endif
-    for(auto it: pending_cmds)
+    for(auto it: xs->pending_cmds)
     {
       xocl_cmd *xcmd = it;
-      mScheduler->command_queue.push_back(xcmd);
+      xs->command_queue.push_back(xcmd);
       xcmd->state = ERT_CMD_STATE_QUEUED;
 #ifdef EM_DEBUG_KDS
     std::cout<<xcmd <<" ADDED to Scheduler command_queue  "<< std::endl;
 #endif
-      num_pending--;
     }
-    pending_cmds.clear();
+    xs->pending_cmds.clear();
   }
 
-  void MBScheduler::scheduler_iterate_cmds()
+  /* A pass that has nothing to submit waits in the device for a running
+   * command to finish instead of polling it from here.  The wait holds the
+   * simulator connection, keep it short so new commands and host transfers
+   * are not held up. */
+  static const uint32_t DONE_WAIT_US = 250;
+
+  void MBScheduler::read_done_registers(xocl_sched *xs, bool wait)
   {
-     auto end = mScheduler->command_queue.end();
-#ifdef EM_DEBUG_KDS
-     //if(mScheduler->command_queue.size() > 0)
-     //  std::cout<<" command_queue size is "<<mScheduler->command_queue.size()<< std::endl;
-#endif
-     for (auto itr=mScheduler->command_queue.begin(); itr!=end; ) 
+    xs->done_regs.clear();
+    std::vector<uint64_t> offsets;
+    uint32_t mask = 0;
+    for (auto xcmd : xs->command_queue)
+    {
+      if (xcmd->state != ERT_CMD_STATE_RUNNING)
+        continue;
+      exec_core *exec = xcmd->exec;
+      uint64_t addr = 0;
+      if (exec->ert && opcode(xcmd)!=ERT_CONFIGURE)
+      {
+        addr = exec->base + ERT_STATUS_REGISTER_ADDR + (slot_mask_idx(xcmd->slot_idx)<<2);
+        mask = XOCL_U32_MASK;
+      }
+      else if (!exec->ert && opcode(xcmd)==ERT_START_CU)
+      {
+        addr = exec->base + cu_idx_to_addr(exec,xcmd->cu_idx);
+        mask |= 2; /* AP_DONE */
+      }
+      else
+        continue;
+      if (xs->done_regs.emplace(addr,0).second)
+        offsets.push_back(addr);
+    }
+    if (offsets.empty())
+      return;
+
+    std::vector<uint32_t> values;
+    if (mParent->wait_registers(offsets, mask, wait ? DONE_WAIT_US : 0, values))
+    {
+      xs->done_regs.clear();
+      return;
+    }
+    for (size_t i = 0; i < offsets.size(); i++)
+      xs->done_regs[offsets[i]] = values[i];
+  }
+
+  bool MBScheduler::take_done_register(exec_core *exec, uint64_t addr, uint32_t& value)
+  {
+    std::map<uint64_t,uint32_t>& done_regs = exec->scheduler->done_regs;
+    auto it = done_regs.find(addr);
+    if (it == done_regs.end())
+      return false;
+    /* reading clears them, later queries of the same register see 0 */
+    value = it->second;
+    it->second = 0;
+    return true;
+  }
+
+  void MBScheduler::scheduler_iterate_cmds(xocl_sched *xs)
+  {
+     /* submit first so that one message reads the done registers of
+      * everything that is running, new commands included */
+     bool submitted = false;
+     for (auto xcmd : xs->command_queue)
      {
-       xocl_cmd *xcmd = *itr;
        if (xcmd->state == ERT_CMD_STATE_QUEUED)
        {
 #ifdef EM_DEBUG_KDS
          std::cout<<xcmd << " is in QUEUED state  "<< std::endl;
 #endif
-         queued_to_running(xcmd);
+         if (queued_to_running(xcmd))
+           submitted = true;
        }
+     }
+
+     read_done_registers(xs, !submitted);
+
+     auto end = xs->command_queue.end();
+     for (auto itr=xs->command_queue.begin(); itr!=end; ) 
+     {
+       xocl_cmd *xcmd = *itr;
        if (xcmd->state == ERT_CMD_STATE_RUNNING)
        {
          running_to_complete(xcmd);
@@ -568,9 +636,9 @@ namespace xclhwemhal2 {
 #ifdef EM_DEBUG_KDS
          std::cout<<xcmd << " is in COMPLETED state  "<< std::endl;
 #endif
+         itr = xs->command_queue.erase(itr);
+         end = xs->command_queue.end();
          complete_to_free(xcmd);
-         itr = mScheduler->command_queue.erase(itr);
-         end = mScheduler->command_queue.end();
        }
        else {
          ++itr;
@@ -582,15 +650,23 @@ namespace xclhwemhal2 {
   void scheduler_loop(xocl_sched *xs)
   {
     MBScheduler* pSch = xs->pSch;
-    std::lock_guard<std::mutex> lk(pSch->pending_cmds_mutex);
 
-    if (xs->error) { return; }
+    /* sleep until the host adds a command, there is nothing to poll */
+    pthread_mutex_lock(&xs->state_lock);
+    while (!xs->stop && !xs->error && xs->pending_cmds.empty() && xs->command_queue.empty())
+      pthread_cond_wait(&xs->state_cond, &xs->state_lock);
+
+    if (xs->stop || xs->error) {
+      pthread_mutex_unlock(&xs->state_lock);
+      return;
+    }
 
     /* queue new pending commands */
-    pSch->scheduler_queue_cmds();
+    pSch->scheduler_queue_cmds(xs);
+    pthread_mutex_unlock(&xs->state_lock);
 
-    /* iterate all commands */
-    pSch->scheduler_iterate_cmds();
+    /* iterate all commands, only this thread touches command_queue */
+    pSch->scheduler_iterate_cmds(xs);
   }
 
   void* scheduler(void* data)
@@ -599,55 +675,88 @@ namespace xclhwemhal2 {
     while (!xs->stop && !xs->error)
     {
       scheduler_loop(xs);
-      usleep(10);
     }
     return NULL;
   }
 
-  int MBScheduler::init_scheduler_thread(void)
+  int MBScheduler::init_scheduler_thread(exec_core *exec)
   {
+    std::lock_guard<std::mutex> lk(m_add_cmd_mutex);
+    xocl_sched *xs = exec->scheduler;
+    if (!xs)
+    {
+      xs = new xocl_sched(this);
+      xs->exec = exec;
+      exec->scheduler = xs;
+      mSchedulers.push_back(xs);
+    }
 
-    if (mScheduler->bThreadCreated)
+    if (xs->bThreadCreated)
       return 0;
 
 #ifdef EM_DEBUG_KDS
     std::cout<<"Scheduler Thread started "<< std::endl;
 #endif
 
-    int returnStatus  =  pthread_create(&(mScheduler->scheduler_thread) , NULL, scheduler, (void *)mScheduler);
+    int returnStatus  =  pthread_create(&(xs->scheduler_thread) , NULL, scheduler, (void *)xs);
 
     if (returnStatus != 0) 
     {
       std::cout << __func__ <<  " pthread_create failed " << " " << returnStatus<< std::endl;
       exit(1);
     }
-    mScheduler->bThreadCreated = true;
+    xs->bThreadCreated = true;
 
     return 0;
   }
   
   int MBScheduler::fini_scheduler_thread(void)
   {
-    if (!mScheduler->bThreadCreated)
-      return 0;
-
+    std::lock_guard<std::mutex> lk(m_add_cmd_mutex);
+    int retval = 0;
+    for (auto xs : mSchedulers)
+    {
+      if (xs->bThreadCreated)
+      {
 #ifdef EM_DEBUG_KDS
-    std::cout<<"Scheduler Thread ended "<< std::endl;
+        std::cout<<"Scheduler Thread ended "<< std::endl;
 #endif
+        pthread_mutex_lock(&xs->state_lock);
+        xs->stop = true;
+        pthread_cond_signal(&xs->state_cond);
+        pthread_mutex_unlock(&xs->state_lock);
+        xs->bThreadCreated = false;
+        int ret = pthread_join(xs->scheduler_thread,NULL);
+        if (ret)
+          retval = ret;
+      }
 
-    mScheduler->stop= true;
-    scheduler_wait_condition();
-    mScheduler->bThreadCreated = false;
-
-    int retval = pthread_join(mScheduler->scheduler_thread,NULL);
-
-    pending_cmds.clear();
-    mScheduler->command_queue.clear();
-    free_cmds.clear();
+      for (auto xcmd : xs->pending_cmds)
+        complete_to_free(xcmd);
+      for (auto xcmd : xs->command_queue)
+        complete_to_free(xcmd);
+      xs->pending_cmds.clear();
+      xs->command_queue.clear();
+      if (xs->exec)
+        xs->exec->scheduler = NULL;
+      delete xs;
+    }
+    mSchedulers.clear();
 
     return retval;
   } 
 
+  bool MBScheduler::wait_for_completion(int timeoutMilliSec)
+  {
+    std::unique_lock<std::mutex> lk(m_complete_mutex);
+    if (!num_completed && timeoutMilliSec > 0)
+      m_complete_cond.wait_for(lk, std::chrono::milliseconds(timeoutMilliSec),
+                               [this] { return num_completed > 0; });
+    bool completed = num_completed > 0;
+    num_completed = 0;
+    return completed;
+  }
+
   int MBScheduler::add_exec_buffer(exec_core* exec, xclemulation::drm_xocl_bo *buf)
   {
     return add_cmd(exec, buf);
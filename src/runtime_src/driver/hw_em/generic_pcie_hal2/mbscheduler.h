@@ -2,10 +2,15 @@
 #define _MB_SCHEDULER_H_
 
 #include <list>
+#include <map>
+#include <vector>
 #include <mutex>
+#include <condition_variable>
 #include <math.h>
 #include <stdint.h>
+#include <pthread.h>
 #include "ert.h"
+#include "em_defines.h"
 
 #define XOCL_U32_MASK 0xFFFFFFFF
 
@@ -25,20 +30,41 @@ namespace xclhwemhal2 {
     int		trigger;
     std::mutex mLock;
   };
+
+  /* Kernel control register access of the scheduler.  HwEmShim forwards it
+   * to the simulator, the benchmark under test/ to a mock device. */
+  class sched_device
+  {
+    public:
+      virtual ~sched_device() {}
+      virtual void write_registers(const std::vector<xclemulation::register_block>& blocks) = 0;
+      virtual uint32_t read_register(uint64_t offset) = 0;
+      /* values of the registers at offsets once one of them has a bit of
+       * mask set or after timeout microseconds; nonzero on error */
+      virtual int wait_registers(const std::vector<uint64_t>& offsets, uint32_t mask, uint32_t timeout,
+                                 std::vector<uint32_t>& values) = 0;
+      virtual bool ert_enabled() = 0;
+  };
   
+  /* Scheduler of one exec_core, each runs its own thread */
   class xocl_sched
   {
     public:
       pthread_t                   scheduler_thread;
-      pthread_mutex_t             state_lock;
-      pthread_cond_t              state_cond;
-      std::list<xocl_cmd*>        command_queue;
+      pthread_mutex_t             state_lock;     /* pending_cmds and stop */
+      pthread_cond_t              state_cond;     /* new command or stop */
+      std::list<xocl_cmd*>        pending_cmds;   /* added by the host */
+      std::list<xocl_cmd*>        command_queue;  /* scheduler thread only */
       bool                        bThreadCreated;
       unsigned int                error;
       int                         intc;
       int                         poll;
       bool                        stop;
       MBScheduler*              pSch;
+      exec_core*                  exec;
+      /* CU control and ERT status registers of the running commands, read
+         in one message per pass and consumed by the queries */
+      std::map<uint64_t,uint32_t> done_regs;
       xocl_sched(MBScheduler*);
       ~xocl_sched();
   };
@@ -137,38 +163,43 @@ namespace xclhwemhal2 {
     void mark_mask_complete(exec_core *exec, uint32_t mask, unsigned int mask_idx);
     int queued_to_running(xocl_cmd *xcmd) ;
     void running_to_complete(xocl_cmd *xcmd) ;
-    void complete_to_free(xocl_cmd *xcmd) { }
+    void complete_to_free(xocl_cmd *xcmd) ;
     xocl_cmd* get_free_xocl_cmd(void) ; 
     int add_cmd(exec_core *exec, xclemulation::drm_xocl_bo* bo) ;
-    int scheduler_wait_condition() ;
-    void scheduler_queue_cmds();
-    void scheduler_iterate_cmds();
+    void scheduler_queue_cmds(xocl_sched *xs);
+    void scheduler_iterate_cmds(xocl_sched *xs);
     int get_free_cu(struct xocl_cmd *xcmd);
     void configure_cu(struct xocl_cmd *xcmd, int cu_idx);
     bool cu_done(struct exec_core *exec, unsigned int cu_idx);
     uint32_t cu_masks(struct xocl_cmd *xcmd);
     uint32_t regmap_size(struct xocl_cmd* xcmd);
+    void read_done_registers(xocl_sched *xs, bool wait);
+    bool take_done_register(exec_core *exec, uint64_t addr, uint32_t& value);
 
     friend void scheduler_loop(xocl_sched *xs);
     friend void* scheduler(void* data) ;
 
-    int init_scheduler_thread(void) ;
+    /* start the scheduler thread of exec, add_cmd does it on first use */
+    int init_scheduler_thread(exec_core *exec) ;
     int fini_scheduler_thread(void) ;
     int add_exec_buffer(exec_core *eCore , xclemulation::drm_xocl_bo *buf) ;
+    /* wait until a command completes, false after timeoutMilliSec */
+    bool wait_for_completion(int timeoutMilliSec);
 
-    xocl_sched* mScheduler;
-    MBScheduler(HwEmShim* _parent);
+    MBScheduler(sched_device* _parent);
     ~MBScheduler();
-    HwEmShim* mParent;
+    sched_device* mParent;
     private:
     std::list<xocl_cmd*> free_cmds;
     std::mutex free_cmds_mutex;
     
-    std::list<xocl_cmd*> pending_cmds;
-    std::mutex pending_cmds_mutex;
-    
     std::mutex m_add_cmd_mutex;
-    int num_pending;
+    std::list<xocl_sched*> mSchedulers;
+
+    /* completions not yet seen by wait_for_completion */
+    std::mutex m_complete_mutex;
+    std::condition_variable m_complete_cond;
+    unsigned int num_completed;
   };
 }
 
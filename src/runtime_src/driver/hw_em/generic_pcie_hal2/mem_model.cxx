@@ -16,17 +16,45 @@
 
 #include "mem_model.h"
 
+#include <string.h> // memcpy
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <sstream>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
 mem_model::~ mem_model()
 {
-  serialize();
+  sync();
+  for (auto& it : mBanks)
+  {
+    munmap(it.data, it.size);
+    close(it.fd);
+  }
 }
 
 mem_model::mem_model(std::string deviceName):
+  mLastBank(0),
   mDeviceName(deviceName),
   module_name("dr_wrapper_dr_i_sdaccel_generic_pcie_0.sdaccel_generic_pcie_model.ddrx_top_tlm_model_0.axi_app_tlm_model_0")
 {
 }
 
+mem_model::mem_model(std::string deviceName, const std::vector<std::pair<uint64_t,uint64_t>>& banks):
+  mem_model(deviceName)
+{
+  for (auto& it : banks)
+  {
+    if (it.second)
+      add_bank(it.first, it.second);
+  }
+}
+
   unsigned int mem_model::writeDevMem(uint64_t offset, const void* src, unsigned int size)
   {
 #ifdef DEBUGMSG
@@ -35,25 +63,13 @@ mem_model::mem_model(std::string deviceName):
       uint64_t written_bytes = 0;
       uint64_t addr = offset;
       while(written_bytes < size){
-          uint64_t src_offset = written_bytes;
-
-          unsigned char* page_ptr  = get_page(addr);
-          uint64_t       page_addr = addr & ~(-1 << ADDRBITS);
-
-          unsigned char* dest_buf_ptr = page_ptr + page_addr;
-          unsigned char* src_buf_ptr  = (unsigned char*)(src)      + src_offset;
+          uint64_t avail = 0;
+          unsigned char* dest_buf_ptr = get_addr(addr, avail);
+          const unsigned char* src_buf_ptr = (const unsigned char*)(src) + written_bytes;
 
-          uint64_t remaining_bytes_to_write = size - written_bytes;
-          uint64_t unaligned_bytes_in_addr = (addr & ~(-1 << ADDRBITS));
-          uint64_t bytes_upto_next_alignment = (0x1 << ADDRBITS) - unaligned_bytes_in_addr;
-
-          uint64_t buf_size = 0;
-          if(bytes_upto_next_alignment > remaining_bytes_to_write)
-          {
-              buf_size = remaining_bytes_to_write;
-          }else{
-              buf_size = bytes_upto_next_alignment;
-          }
+          uint64_t buf_size = size - written_bytes;
+          if(buf_size > avail)
+            buf_size = avail;
 
           memcpy(dest_buf_ptr,src_buf_ptr,buf_size);
 
@@ -82,26 +98,15 @@ mem_model::mem_model(std::string deviceName):
 	  uint64_t read_bytes = 0;
 	  uint64_t addr = offset;
 	  while(read_bytes < size){
-		  uint64_t dest_offset = read_bytes;
-
-		  unsigned char* page_ptr  = get_page(addr);
-		  uint64_t       page_addr = addr & ~(-1 << ADDRBITS);
-
-		  unsigned char* src_buf_ptr = page_ptr + page_addr;
-		  unsigned char* dest_buf_ptr  = (unsigned char*)(dest)      + dest_offset;
-
-		  uint64_t remaining_bytes_to_read = size - read_bytes;
-		  uint64_t unaligned_bytes_in_addr = (addr & ~(-1 << ADDRBITS));
-		  uint64_t bytes_upto_next_alignment = (0x1 << ADDRBITS) - unaligned_bytes_in_addr;
-
-		  uint64_t buf_size = 0;
-		  if(bytes_upto_next_alignment > remaining_bytes_to_read)
-		  {
-			  buf_size = remaining_bytes_to_read;
-		  }else{
-			  buf_size = bytes_upto_next_alignment;
-		  }
-	  memcpy(dest_buf_ptr,src_buf_ptr,buf_size);
+		  uint64_t avail = 0;
+		  unsigned char* src_buf_ptr = get_addr(addr, avail);
+		  unsigned char* dest_buf_ptr  = (unsigned char*)(dest) + read_bytes;
+
+		  uint64_t buf_size = size - read_bytes;
+		  if(buf_size > avail)
+			  buf_size = avail;
+
+		  memcpy(dest_buf_ptr,src_buf_ptr,buf_size);
 		  read_bytes += buf_size;
 		  addr += buf_size;
 	  }
@@ -118,66 +123,262 @@ mem_model::mem_model(std::string deviceName):
 
 	  return 0;
   }
-  unsigned char* mem_model::get_page(uint64_t offset) {
-	  uint64_t page_idx = offset >> ADDRBITS;
-	  std::string file_name = get_mem_file_name(page_idx);
-	  if(pageCache.size() > N_1MBARRAYS)
-	  {
-		  std::cerr << "Out of Memory. DDR model does not support this much of memory\n";
-		  exit(1);
-	  } else {
-      FILE* pFile = NULL;
-		  if(pageCache.find(page_idx) != pageCache.end())
-		  {
-			  return pageCache[page_idx];
-		  } else if(((pFile = fopen(file_name.c_str(),"r")) != NULL)) {
-			  int fhandle = fileno(pFile);
-
-			  if (deserialize_msg.ParseFromFileDescriptor(fhandle) == false)
-        {
-          fclose(pFile);
-          exit(1);
-        }
-			  pageCache[page_idx] = new unsigned char[PAGESIZE];
-
-			  memcpy(pageCache[page_idx],deserialize_msg.data().c_str(),PAGESIZE);
-			  fclose(pFile);
-			  return pageCache[page_idx];
-		  } else {
-			  pageCache[page_idx] = new unsigned char[PAGESIZE];
-			  return pageCache[page_idx];
-		  }
-	  }
+
+  // Host address of device address offset and the number of bytes up to
+  // the end of its bank.  Consecutive accesses mostly hit the same bank, so
+  // that one is checked first.
+  unsigned char* mem_model::get_addr(uint64_t offset, uint64_t& avail) {
+    size_t idx = mLastBank;
+    if (idx >= mBanks.size() || offset - mBanks[idx].base >= mBanks[idx].size)
+    {
+      for (idx = 0; idx < mBanks.size(); idx++)
+      {
+        if (offset - mBanks[idx].base < mBanks[idx].size)
+          break;
+      }
+      if (idx == mBanks.size())
+        idx = add_bank(offset & ~(SEGMENTSIZE - 1), SEGMENTSIZE);
+      mLastBank = idx;
+    }
+    bank& b = mBanks[idx];
+    avail = b.size - (offset - b.base);
+    return b.data + (offset - b.base);
+  }
+
+  size_t mem_model::add_bank(uint64_t base, uint64_t size) {
+    std::string file_name = get_mem_file_name(base);
+    int fd = open(file_name.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+    struct stat statBuf;
+    if (fd == -1 || fstat(fd, &statBuf) == -1)
+    {
+      std::cerr << "unable to open/create mem file " << file_name << std::endl;
+      exit(1);
+    }
+    // keep the contents of an existing file, grow it as a hole otherwise
+    if ((uint64_t)statBuf.st_size < size && ftruncate(fd, size) == -1)
+    {
+      std::cerr << "Out of Memory. DDR model does not support this much of memory\n";
+      exit(1);
+    }
+    void* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_NORESERVE, fd, 0);
+    if (data == MAP_FAILED)
+    {
+      std::cerr << "Out of Memory. DDR model does not support this much of memory\n";
+      exit(1);
+    }
+    mBanks.push_back(bank{base, size, static_cast<unsigned char*>(data), fd, {}});
+    return mBanks.size() - 1;
+  }
+
+  void mem_model::sync() {
+    for (auto& it : mBanks)
+      msync(it.data, it.size, MS_SYNC);
   }
 
+  // Snapshot file:
+  //   snapshot_header
+  //   snapshot_bank[banks]  base and size of each bank and its pages
+  //   uint64_t[pages]       offset in its bank of every page, bank by bank
+  //   pages of SNAPSHOTPAGESIZE bytes, in index order, from the first
+  //   multiple of SNAPSHOTPAGESIZE after the index, so that every page can
+  //   be mapped on its own.  The last page of a bank may be short, the
+  //   rest of it is a hole.
+  static const char SNAPSHOT_MAGIC[8] = {'X','C','L','D','D','R','S','N'};
+  static const uint32_t SNAPSHOT_VERSION = 1;
 
-  void mem_model::serialize() {
-     FILE *pFile;
-     int fhandle;
-     for (pageCacheItr=pageCache.begin(); pageCacheItr != pageCache.end(); ++pageCacheItr)
-     {
-        std::string file_name = get_mem_file_name(pageCacheItr->first);
-        pFile = fopen(file_name.c_str(),"w+");
-        if(!pFile)
+  struct snapshot_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t page_size;
+    uint64_t banks;
+    uint64_t pages;
+  };
+
+  struct snapshot_bank {
+    uint64_t base;
+    uint64_t size;
+    uint64_t first_page;
+    uint64_t pages;
+  };
+
+  static bool write_all(int fd, const void* buf, uint64_t size, uint64_t offset)
+  {
+    const char* src = static_cast<const char*>(buf);
+    while (size) {
+      ssize_t written = pwrite(fd, src, size, offset);
+      if (written <= 0)
+        return false;
+      src += written;
+      size -= written;
+      offset += written;
+    }
+    return true;
+  }
+
+  static bool read_all(int fd, void* buf, uint64_t size, uint64_t offset)
+  {
+    char* dst = static_cast<char*>(buf);
+    while (size) {
+      ssize_t count = pread(fd, dst, size, offset);
+      if (count <= 0)
+        return false;
+      dst += count;
+      size -= count;
+      offset += count;
+    }
+    return true;
+  }
+
+  static uint64_t snapshot_data_offset(uint64_t banks, uint64_t pages)
+  {
+    uint64_t index_end = sizeof(snapshot_header) + banks * sizeof(snapshot_bank) + pages * sizeof(uint64_t);
+    return (index_end + SNAPSHOTPAGESIZE - 1) / SNAPSHOTPAGESIZE * SNAPSHOTPAGESIZE;
+  }
+
+  // Pages of the bank files with data, found through the holes of the
+  // sparse files, and the pages restored from a snapshot are saved.  The
+  // pages are written by several threads straight from the mappings into
+  // a temporary file that replaces file_name once it is complete.
+  bool mem_model::save_snapshot(const std::string& file_name) {
+    std::vector<snapshot_bank> banks;
+    std::vector<uint64_t> index;
+    std::vector<std::pair<const unsigned char*, uint64_t>> pages;
+    for (auto& b : mBanks)
+    {
+      std::set<uint64_t> touched(b.restored);
+      off_t data = lseek(b.fd, 0, SEEK_DATA);
+      while (data != -1 && (uint64_t)data < b.size)
+      {
+        off_t hole = lseek(b.fd, data, SEEK_HOLE);
+        if (hole == -1 || (uint64_t)hole > b.size)
+          hole = b.size;
+        for (uint64_t page = data / SNAPSHOTPAGESIZE; page * SNAPSHOTPAGESIZE < (uint64_t)hole; page++)
+          touched.insert(page);
+        data = lseek(b.fd, hole, SEEK_DATA);
+      }
+      banks.push_back(snapshot_bank{b.base, b.size, index.size(), touched.size()});
+      for (auto page : touched)
+      {
+        uint64_t offset = page * SNAPSHOTPAGESIZE;
+        index.push_back(offset);
+        pages.emplace_back(b.data + offset, std::min<uint64_t>(SNAPSHOTPAGESIZE, b.size - offset));
+      }
+    }
+
+    snapshot_header header;
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.page_size = SNAPSHOTPAGESIZE;
+    header.banks = banks.size();
+    header.pages = pages.size();
+    const uint64_t data_offset = snapshot_data_offset(banks.size(), pages.size());
+
+    std::string tmp_name = file_name + ".tmp";
+    int fd = open(tmp_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fd == -1)
+      return false;
+    uint64_t offset = 0;
+    bool ok = ftruncate(fd, data_offset + pages.size() * SNAPSHOTPAGESIZE) == 0
+      && write_all(fd, &header, sizeof(header), offset)
+      && write_all(fd, banks.data(), banks.size() * sizeof(snapshot_bank), offset += sizeof(header))
+      && write_all(fd, index.data(), index.size() * sizeof(uint64_t), offset += banks.size() * sizeof(snapshot_bank));
+
+    std::atomic<size_t> next(0);
+    std::atomic<bool> failed(!ok);
+    auto writer = [&]() {
+      for (size_t i = next++; i < pages.size() && !failed; i = next++)
+      {
+        if (!write_all(fd, pages[i].first, pages[i].second, data_offset + i * SNAPSHOTPAGESIZE))
+          failed = true;
+      }
+    };
+    unsigned int count = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1U), 8);
+    count = std::min<size_t>(count, pages.size());
+    std::vector<std::thread> writers;
+    for (unsigned int i = 1; i < count; i++)
+      writers.emplace_back(writer);
+    writer();
+    for (auto& it : writers)
+      it.join();
+
+    ok = !failed && fdatasync(fd) == 0;
+    ok = (close(fd) == 0) && ok;
+    if (!ok || rename(tmp_name.c_str(), file_name.c_str()) == -1)
+    {
+      unlink(tmp_name.c_str());
+      return false;
+    }
+    return true;
+  }
+
+  // Every page is mapped copy-on-write from the snapshot over its bank.
+  // Pages that do not sit on host page boundaries of a single bank are
+  // copied in instead.
+  bool mem_model::load_snapshot(const std::string& file_name) {
+    int fd = open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+      return false;
+
+    snapshot_header header;
+    struct stat statBuf;
+    if (!read_all(fd, &header, sizeof(header), 0) || fstat(fd, &statBuf) == -1
+        || memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic))
+        || header.version != SNAPSHOT_VERSION || header.page_size != SNAPSHOTPAGESIZE
+        || header.banks > (uint64_t)statBuf.st_size || header.pages > (uint64_t)statBuf.st_size)
+    {
+      close(fd);
+      return false;
+    }
+    const uint64_t data_offset = snapshot_data_offset(header.banks, header.pages);
+    std::vector<snapshot_bank> banks(header.banks);
+    std::vector<uint64_t> index(header.pages);
+    if (data_offset + header.pages * SNAPSHOTPAGESIZE > (uint64_t)statBuf.st_size
+        || !read_all(fd, banks.data(), banks.size() * sizeof(snapshot_bank), sizeof(header))
+        || !read_all(fd, index.data(), index.size() * sizeof(uint64_t),
+                     sizeof(header) + banks.size() * sizeof(snapshot_bank)))
+    {
+      close(fd);
+      return false;
+    }
+
+    const uint64_t host_page = sysconf(_SC_PAGESIZE);
+    std::vector<unsigned char> buf;
+    for (auto& sb : banks)
+    {
+      for (uint64_t i = sb.first_page; i < sb.first_page + sb.pages && i < index.size(); i++)
+      {
+        if (index[i] >= sb.size)
           continue;
-        fhandle = fileno(pFile);
-        if(fhandle == -1)
+        const uint64_t addr = sb.base + index[i];
+        const uint64_t len = std::min<uint64_t>(SNAPSHOTPAGESIZE, sb.size - index[i]);
+        const uint64_t file_offset = data_offset + i * SNAPSHOTPAGESIZE;
+        uint64_t avail = 0;
+        unsigned char* host = get_addr(addr, avail);
+        bank& b = mBanks[mLastBank];
+        if (avail >= len && (uintptr_t)host % host_page == 0
+            && mmap(host, (len + host_page - 1) / host_page * host_page, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_FIXED, fd, file_offset) != MAP_FAILED)
         {
-          fclose(pFile);
-          exit(1);
+          const uint64_t offset = host - b.data;
+          for (uint64_t page = offset / SNAPSHOTPAGESIZE; page * SNAPSHOTPAGESIZE < offset + len; page++)
+            b.restored.insert(page);
+          continue;
         }
-
-        serialize_msg.set_data(reinterpret_cast<const char*>(pageCacheItr->second),PAGESIZE);
-        if(serialize_msg.SerializeToFileDescriptor(fhandle) == false)
+        buf.resize(len);
+        if (!read_all(fd, buf.data(), len, file_offset))
         {
-          fclose(pFile);
-          exit(1);
+          close(fd);
+          return false;
         }
-        fclose(pFile);
-     }
+        writeDevMem(addr, buf.data(), len);
+      }
+    }
+    // the mappings keep the snapshot open
+    close(fd);
+    return true;
   }
 
- std::string mem_model::get_mem_file_name(uint64_t pageIdx)
+ std::string mem_model::get_mem_file_name(uint64_t base)
  {
    std::string file_name("");
    std::string user("");
@@ -198,11 +399,11 @@ mem_model::mem_model(std::string deviceName):
      int rV = system(mkdirCommand.str().c_str());
      if(rV == -1) {std::cout<<"unable to open/create mem file"<<std::endl;}
    }
-    file_name = file_path + module_name + "_" + std::to_string(pageIdx);
+    std::stringstream base_str;
+    base_str << std::hex << base;
+    file_name = file_path + module_name + "_0x" + base_str.str();
 #ifdef DEBUGMSG
       cout<<"ddr fmodel file_name: "<< file_name<<endl;
 #endif
     return file_name;
  }
-
-
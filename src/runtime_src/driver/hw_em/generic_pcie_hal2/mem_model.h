@@ -16,44 +16,60 @@
 
 #ifndef OCL_PLATFORM_H
 #define OCL_PLATFORM_H
-#include <math.h>
+#include <stdint.h>
 #include <iostream>
-
-#include <string.h> // memcpy
-#include <sstream> // memcpy
-#include <stdlib.h> //realloc
-#include <map> //realloc
-#include <sys/stat.h>
-#include <sys/types.h>
-#include <unistd.h>
-
-#include "rpc_messages.pb.h"
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
 
 #define ONE_KB (0x400)
 #define ONE_MB (ONE_KB * ONE_KB)
-#define PAGESIZE (ONE_MB)
-#define ADDRBITS (20)
-#define N_1MBARRAYS 4096
+// Addresses outside the banks given to the model are backed in segments of
+// this size
+#define SEGMENTBITS (32)
+#define SEGMENTSIZE (1ULL << SEGMENTBITS)
+// Unit of memory snapshots
+#define SNAPSHOTPAGESIZE ONE_MB
 
+// DDR model used while the simulator is not running.  Every bank is a
+// sparse file mapped with MAP_NORESERVE, so untouched memory costs neither
+// RAM nor disk and the contents persist in the file.
 class mem_model{
 public:
 unsigned int writeDevMem(uint64_t offset, const void* src, unsigned int size);
 unsigned int readDevMem(uint64_t offset, void* dest, unsigned int size);
+// write the dirty pages of all banks back to their files
+void sync();
+// Write the touched pages of all banks to a snapshot file, in parallel
+bool save_snapshot(const std::string& file_name);
+// Map the pages of a snapshot over the banks, creating banks as needed;
+// pages are read from the snapshot on first access and are private to
+// the model, sync() does not write them to the bank files
+bool load_snapshot(const std::string& file_name);
 
 protected:
 private:
-  unsigned char* get_page(uint64_t offset);
-  std::string get_mem_file_name(uint64_t pageIdx);
-  std::map<uint64_t,unsigned char*> pageCache;
-  std::map<uint64_t,unsigned char*>::iterator pageCacheItr;
-
-  ddr_mem_msg serialize_msg;
-  ddr_mem_msg deserialize_msg;
-  void serialize();
+  struct bank {
+    uint64_t base;
+    uint64_t size;
+    unsigned char* data;
+    int fd;
+    // snapshot pages (SNAPSHOTPAGESIZE) mapped over the bank
+    std::set<uint64_t> restored;
+  };
+  unsigned char* get_addr(uint64_t offset, uint64_t& avail);
+  size_t add_bank(uint64_t base, uint64_t size);
+  std::string get_mem_file_name(uint64_t base);
+  std::vector<bank> mBanks;
+  size_t mLastBank;
+
   std::string mDeviceName;
   std::string module_name;
 public:
   mem_model(std::string deviceName);
+  // banks are (base address, size) pairs
+  mem_model(std::string deviceName, const std::vector<std::pair<uint64_t,uint64_t>>& banks);
   ~ mem_model();
 };
 
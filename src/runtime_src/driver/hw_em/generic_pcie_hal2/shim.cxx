@@ -18,6 +18,7 @@
 #include <string.h>
 #include <boost/property_tree/xml_parser.hpp>
 #include <unistd.h>
+#include <chrono>
 
 namespace xclhwemhal2 {
 
@@ -235,7 +236,7 @@ namespace xclhwemhal2 {
     }
     mCore = new exec_core;
     mMBSch = new MBScheduler(this);
-    mMBSch->init_scheduler_thread();
+    mMBSch->init_scheduler_thread(mCore);
 
     delete[] zipFile;
     delete[] debugFile;
@@ -261,6 +262,9 @@ namespace xclhwemhal2 {
 #endif
     if(mMemModel)
     {
+      std::string snapshot = getMemModelSnapshot();
+      if (!snapshot.empty() && !mMemModel->save_snapshot(snapshot) && mLogStream.is_open())
+        mLogStream << __func__ << ", unable to save DDR snapshot " << snapshot << std::endl;
       delete mMemModel;
       mMemModel = NULL;
     }
@@ -598,8 +602,9 @@ namespace xclhwemhal2 {
     {
       mEnvironmentNameValueMap["enable_pr"] = "false";
     }
+    initSharedMemory();
     sock = new unix_socket;
-    if(sock && mEnvironmentNameValueMap.empty() == false)
+    if(sock && (mEnvironmentNameValueMap.empty() == false || mSharedMemory.empty() == false))
     {
       //send environment information to device
       bool ack = true;
@@ -676,72 +681,9 @@ namespace xclhwemhal2 {
        case XCL_ADDR_KERNEL_CTRL:
          {
            std::map<uint64_t,std::pair<std::string,unsigned int>> offsetArgInfo;
-           unsigned int paddingFactor = xclemulation::config::getInstance()->getPaddingFactor();
-
-           std::string kernelName("");
-           uint32_t *hostBuf32 = ((uint32_t*)hostBuf);
-          // if(hostBuf32[0] & CONTROL_AP_START)
-           {
-             auto offsetKernelArgInfoItr = mKernelOffsetArgsInfoMap.find(offset);
-             if(offsetKernelArgInfoItr != mKernelOffsetArgsInfoMap.end())
-             {
-               unsigned char* axibuf=((unsigned char*) hostBuf);
-               std::map<uint64_t, KernelArg> kernelArgInfo = (*offsetKernelArgInfoItr).second;
-               for (auto i : kernelArgInfo)
-               {
-                 uint64_t argOffset = i.first;
-                 KernelArg kArg = i.second;
-                 uint64_t argPointer = 0;
-                 std::memcpy(&argPointer,axibuf+ argOffset,kArg.size);
-                 std::map<uint64_t,uint64_t>::iterator it = mAddrMap.find(argPointer);
-                 if(it != mAddrMap.end())
-                 {
-                   uint64_t offsetSize =  (*it).second;
-                   uint64_t padding = (paddingFactor == 0) ? 0 : offsetSize/(1+(paddingFactor*2));
-                   std::pair<std::string,unsigned int> sizeNamePair(kArg.name,offsetSize);
-                   if(hostBuf32[0] & CONTROL_AP_START)
-                     offsetArgInfo[argPointer-padding] = sizeNamePair;
-                   size_t pos = kArg.name.find(":");
-                   if(pos != std::string::npos)
-                   {
-                     kernelName = kArg.name.substr(0,pos);
-                   }
-                 }
-               }
-             }
-           }
-
-           auto controlStreamItr = mOffsetInstanceStreamMap.find(offset);
-           if(controlStreamItr != mOffsetInstanceStreamMap.end())
-           {
-             std::ofstream* controlStream = (*controlStreamItr).second;
-             if(hostBuf32[0] & CONTROL_AP_START)
-               printMem(*controlStream,4, offset, (void*)hostBuf, 4 );
-             else
-               printMem(*controlStream,4, offset, (void*)hostBuf, size );
-           }
-
-           if(hostBuf32[0] & CONTROL_AP_START)
-           {
-             std::string dMsg ="INFO: [SDx-EM 04-0] Sending start signal to the kernel " + kernelName;
-             logMessage(dMsg,1);
-           }
-           else
-           {
-             std::string dMsg ="INFO: [SDx-EM 03-0] Configuring registers for the kernel " + kernelName +" Started";
-             logMessage(dMsg,1);
-           }
+           std::string kernelName = beginKernelCtrlWrite(offset, hostBuf, size, offsetArgInfo);
            xclWriteAddrKernelCtrl_RPC_CALL(xclWriteAddrKernelCtrl,space,offset,hostBuf,size,offsetArgInfo);
-           if(hostBuf32[0] & CONTROL_AP_START)
-           {
-             std::string dMsg ="INFO: [SDx-EM 04-1] Kernel " + kernelName +" is Started";
-             logMessage(dMsg,1);
-           }
-           else
-           {
-             std::string dMsg ="INFO: [SDx-EM 03-1] Configuring registers for the kernel " + kernelName +" Ended";
-             logMessage(dMsg,1);
-           }
+           endKernelCtrlWrite(hostBuf, kernelName);
            PRINTENDFUNC;
            return size;
          }
@@ -754,6 +696,169 @@ namespace xclhwemhal2 {
 
    }
 
+  std::string HwEmShim::beginKernelCtrlWrite(uint64_t offset, const void *hostBuf, size_t size,
+                                             std::map<uint64_t,std::pair<std::string,unsigned int>>& offsetArgInfo)
+  {
+    unsigned int paddingFactor = xclemulation::config::getInstance()->getPaddingFactor();
+
+    std::string kernelName("");
+    const uint32_t *hostBuf32 = ((const uint32_t*)hostBuf);
+    // if(hostBuf32[0] & CONTROL_AP_START)
+    {
+      auto offsetKernelArgInfoItr = mKernelOffsetArgsInfoMap.find(offset);
+      if(offsetKernelArgInfoItr != mKernelOffsetArgsInfoMap.end())
+      {
+        const unsigned char* axibuf=((const unsigned char*) hostBuf);
+        std::map<uint64_t, KernelArg> kernelArgInfo = (*offsetKernelArgInfoItr).second;
+        for (auto i : kernelArgInfo)
+        {
+          uint64_t argOffset = i.first;
+          KernelArg kArg = i.second;
+          uint64_t argPointer = 0;
+          std::memcpy(&argPointer,axibuf+ argOffset,kArg.size);
+          std::map<uint64_t,uint64_t>::iterator it = mAddrMap.find(argPointer);
+          if(it != mAddrMap.end())
+          {
+            uint64_t offsetSize =  (*it).second;
+            uint64_t padding = (paddingFactor == 0) ? 0 : offsetSize/(1+(paddingFactor*2));
+            std::pair<std::string,unsigned int> sizeNamePair(kArg.name,offsetSize);
+            if(hostBuf32[0] & CONTROL_AP_START)
+              offsetArgInfo[argPointer-padding] = sizeNamePair;
+            size_t pos = kArg.name.find(":");
+            if(pos != std::string::npos)
+            {
+              kernelName = kArg.name.substr(0,pos);
+            }
+          }
+        }
+      }
+    }
+
+    auto controlStreamItr = mOffsetInstanceStreamMap.find(offset);
+    if(controlStreamItr != mOffsetInstanceStreamMap.end())
+    {
+      std::ofstream* controlStream = (*controlStreamItr).second;
+      if(hostBuf32[0] & CONTROL_AP_START)
+        printMem(*controlStream,4, offset, (void*)hostBuf, 4 );
+      else
+        printMem(*controlStream,4, offset, (void*)hostBuf, size );
+    }
+
+    if(hostBuf32[0] & CONTROL_AP_START)
+    {
+      std::string dMsg ="INFO: [SDx-EM 04-0] Sending start signal to the kernel " + kernelName;
+      logMessage(dMsg,1);
+    }
+    else
+    {
+      std::string dMsg ="INFO: [SDx-EM 03-0] Configuring registers for the kernel " + kernelName +" Started";
+      logMessage(dMsg,1);
+    }
+    return kernelName;
+  }
+
+  void HwEmShim::endKernelCtrlWrite(const void *hostBuf, const std::string& kernelName)
+  {
+    const uint32_t *hostBuf32 = ((const uint32_t*)hostBuf);
+    if(hostBuf32[0] & CONTROL_AP_START)
+    {
+      std::string dMsg ="INFO: [SDx-EM 04-1] Kernel " + kernelName +" is Started";
+      logMessage(dMsg,1);
+    }
+    else
+    {
+      std::string dMsg ="INFO: [SDx-EM 03-1] Configuring registers for the kernel " + kernelName +" Ended";
+      logMessage(dMsg,1);
+    }
+  }
+
+  size_t HwEmShim::xclWriteRegisters(const std::vector<xclemulation::register_block>& blocks)
+  {
+    if (!simulator_started)
+      return 0;
+
+    if (mLogStream.is_open()) {
+      mLogStream << __func__ << ", " << std::this_thread::get_id() << ", " << blocks.size() << std::endl;
+    }
+
+    size_t size = 0;
+    if (!mRegisterBatch)
+    {
+      for (auto& block : blocks)
+      {
+        if (xclWrite(XCL_ADDR_KERNEL_CTRL, block.offset, block.data, block.size) != block.size)
+          return -1;
+        size += block.size;
+      }
+      return size;
+    }
+
+    std::map<uint64_t,std::pair<std::string,unsigned int>> offsetArgInfo;
+    std::vector<std::string> kernelNames;
+    for (auto& block : blocks)
+    {
+      kernelNames.push_back(beginKernelCtrlWrite(block.offset, block.data, block.size, offsetArgInfo));
+      size += block.size;
+    }
+    bool valid = false;
+    xclWriteRegisters_RPC_CALL(xclWriteRegisters,blocks,offsetArgInfo);
+    for (size_t i = 0; i < blocks.size(); i++)
+      endKernelCtrlWrite(blocks[i].data, kernelNames[i]);
+    PRINTENDFUNC;
+    return valid ? size : -1;
+  }
+
+  int HwEmShim::xclWaitRegisters(const std::vector<uint64_t>& offsets, uint32_t mask, uint32_t timeout, std::vector<uint32_t>& values)
+  {
+    values.assign(offsets.size(), 0);
+    if (!simulator_started)
+      return 0;
+
+    if (mLogStream.is_open()) {
+      mLogStream << __func__ << ", " << std::this_thread::get_id() << ", " << offsets.size() << ", " << mask << ", " << timeout << std::endl;
+    }
+
+    if (!mRegisterBatch)
+    {
+      // Poll from here, one message per register
+      auto start = std::chrono::steady_clock::now();
+      do
+      {
+        for (size_t i = 0; i < offsets.size(); i++)
+        {
+          xclRead(XCL_ADDR_KERNEL_CTRL, offsets[i], &values[i], 4);
+          if (values[i] & mask)
+            return 0;
+        }
+      } while (std::chrono::steady_clock::now() - start < std::chrono::microseconds(timeout));
+      return 0;
+    }
+
+    xclGetDebugMessages();
+    bool valid = false;
+    xclWaitRegisters_RPC_CALL(xclWaitRegisters,offsets,mask,timeout,values);
+    PRINTENDFUNC;
+    return valid ? 0 : -1;
+  }
+
+  void HwEmShim::write_registers(const std::vector<xclemulation::register_block>& blocks)
+  {
+    xclWriteRegisters(blocks);
+  }
+
+  uint32_t HwEmShim::read_register(uint64_t offset)
+  {
+    uint32_t value = 0;
+    xclRead(XCL_ADDR_KERNEL_CTRL, offset, &value, 4);
+    return value;
+  }
+
+  int HwEmShim::wait_registers(const std::vector<uint64_t>& offsets, uint32_t mask, uint32_t timeout,
+                               std::vector<uint32_t>& values)
+  {
+    return xclWaitRegisters(offsets, mask, timeout, values);
+  }
+
   size_t HwEmShim::xclRead(xclAddressSpace space, uint64_t offset, void *hostBuf, size_t size) {
 
     if(tracecount_calls < xclemulation::config::getInstance()->getMaxTraceCount())
@@ -834,6 +939,47 @@ namespace xclhwemhal2 {
 
   }
 
+  void HwEmShim::initMemModel()
+  {
+    if (mMemModel)
+      return;
+    std::vector<std::pair<uint64_t,uint64_t>> banks;
+    for (auto i : mDDRMemoryManager)
+      banks.emplace_back(i->start(), i->size());
+    mMemModel = new mem_model(deviceName, banks);
+    std::string snapshot = getMemModelSnapshot();
+    struct stat statBuf;
+    if (!snapshot.empty() && stat(snapshot.c_str(), &statBuf) == 0
+        && !mMemModel->load_snapshot(snapshot) && mLogStream.is_open())
+      mLogStream << __func__ << ", unable to load DDR snapshot " << snapshot << std::endl;
+  }
+
+  // DDR model contents are restored from and saved to this file when
+  // ddr_snapshot_dir is set, so that runs resume from a warm memory image
+  std::string HwEmShim::getMemModelSnapshot()
+  {
+    std::string dir = xclemulation::config::getInstance()->getDDRSnapshotDir();
+    if (dir.empty())
+      return dir;
+    return dir + "/" + deviceName + ".ddr";
+  }
+
+  void HwEmShim::initSharedMemory()
+  {
+    if (!mSharedMemory.empty())
+      return;
+    // offered to the simulator with xclSetEnvironment; copies stay on the
+    // socket unless it maps the banks
+    for (auto& it : mMembanks)
+    {
+      if (!mSharedMemory.addRegion(it.base_addr, it.size, getAddressSpace(it.index)))
+      {
+        mSharedMemory.release();
+        return;
+      }
+    }
+  }
+
 uint32_t HwEmShim::getAddressSpace (uint32_t topology)
 {
   if(mMembanks.size() <= topology)
@@ -852,8 +998,7 @@ uint32_t HwEmShim::getAddressSpace (uint32_t topology)
   {
     if(!sock)
     {
-      if(!mMemModel)
-        mMemModel = new mem_model(deviceName);
+      initMemModel();
       mMemModel->writeDevMem(dest,src,size);
       return size;
     }
@@ -863,6 +1008,14 @@ uint32_t HwEmShim::getAddressSpace (uint32_t topology)
     }
     std::string dMsg ="INFO: [SDx-EM 02-0] Copying buffer from host to device started : size = " + std::to_string(size);
     logMessage(dMsg,1);
+    if(mSharedMemory.write(dest, src, size, getAddressSpace(topology)))
+    {
+      dMsg ="INFO: [SDx-EM 02-1] Copying buffer from host to device ended";
+      logMessage(dMsg,1);
+      PRINTENDFUNC;
+      printMem(mGlobalInMemStream, 16 , dest , (void*)src, size );
+      return size;
+    }
     void *handle = this;
 
     unsigned int messageSize = xclemulation::config::getInstance()->getPacketSize();
@@ -899,8 +1052,7 @@ uint32_t HwEmShim::getAddressSpace (uint32_t topology)
     dest = ((unsigned char*)dest) + skip;
     if(!sock)
     {
-      if(!mMemModel)
-        mMemModel = new mem_model(deviceName);
+      initMemModel();
       mMemModel->readDevMem(src,dest,size);
       return size;
     }
@@ -911,6 +1063,14 @@ uint32_t HwEmShim::getAddressSpace (uint32_t topology)
 
     std::string dMsg ="INFO: [SDx-EM 05-0] Copying buffer from device to host started. size := " + std::to_string(size);
     logMessage(dMsg,1);
+    if(mSharedMemory.read(src, dest, size, getAddressSpace(topology)))
+    {
+      dMsg ="INFO: [SDx-EM 05-1] Copying buffer from device to host ended";
+      logMessage(dMsg,1);
+      PRINTENDFUNC;
+      printMem(mGlobalOutMemStream, 16 , src , dest , size );
+      return size;
+    }
     void *handle = this;
 
     unsigned int messageSize = xclemulation::config::getInstance()->getPacketSize();
@@ -1278,6 +1438,7 @@ uint32_t HwEmShim::getAddressSpace (uint32_t topology)
     //ProfilerStop();
     delete sock;
     sock = NULL;
+    mSharedMemory.release();
     PRINTENDFUNC;
     if(mMBSch && mCore)
     {
@@ -1398,6 +1559,8 @@ uint32_t HwEmShim::getAddressSpace (uint32_t topology)
     
     last_clk_time = clock();
     mCloseAll = false;
+    mKeepAlive = false;
+    mRegisterBatch = false;
     mMemModel = NULL;
 
     // Delete detailed kernel trace data mining results file
@@ -2098,17 +2261,10 @@ int HwEmShim::xclExecWait(int timeoutMilliSec)
  //   mLogStream << __func__ << ", " << std::this_thread::get_id() << ", " << timeoutMilliSec << std::endl;
   }
 
-  unsigned int tSec = 0;
-  static bool bConfig = true;
-  tSec = timeoutMilliSec/1000;
-  if(bConfig)
-  {
-    tSec = timeoutMilliSec/100;
-    bConfig = false;
-  }
-  sleep(tSec);
-  //PRINTENDFUNC;
-  return 1;
+  /* the scheduler threads signal every completed command */
+  if (!mMBSch)
+    return -1;
+  return mMBSch->wait_for_completion(timeoutMilliSec) ? 1 : 0;
 }
 
 
@@ -2210,6 +2366,7 @@ ssize_t HwEmShim::xclWriteQueue(uint64_t q_hdl, xclQueueRequest *wr)
     mReqList.push_back(std::make_tuple(mReqCounter, wr->priv_data, vaLenMap));
     nonBlocking = true;
   }
+  uint64_t reqCounter = mReqCounter;
   uint64_t fullSize = 0;
   for (unsigned i = 0; i < wr->buf_num; i++) 
   {
@@ -2249,6 +2406,7 @@ ssize_t HwEmShim::xclReadQueue(uint64_t q_hdl, xclQueueRequest *rd)
 
   void *dest;
 
+  uint64_t reqCounter = mReqCounter;
   uint64_t fullSize = 0;
   for (unsigned i = 0; i < rd->buf_num; i++) 
   {
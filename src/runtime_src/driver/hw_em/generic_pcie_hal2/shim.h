@@ -22,6 +22,7 @@
 #include "config.h"
 #include "em_defines.h"
 #include "memorymanager.h"
+#include "shared_memory.h"
 #include "rpc_messages.pb.h"
 
 #include "xclperf.h"
@@ -76,7 +77,7 @@ using addr_type = uint64_t;
    unsigned int size;
  } KernelArg;
 
-  class HwEmShim {
+  class HwEmShim : public sched_device {
 
     public:
 
@@ -122,9 +123,21 @@ using addr_type = uint64_t;
       // Raw read/write
       size_t xclWrite(xclAddressSpace space, uint64_t offset, const void *hostBuf, size_t size);
       size_t xclRead(xclAddressSpace space, uint64_t offset, void *hostBuf, size_t size);
+      // Several kernel control register blocks in one message, in order
+      size_t xclWriteRegisters(const std::vector<xclemulation::register_block>& blocks);
+      // Read the 32-bit kernel control registers at offsets until one has a
+      // bit of mask set or timeout microseconds have passed (0: read once)
+      int xclWaitRegisters(const std::vector<uint64_t>& offsets, uint32_t mask, uint32_t timeout, std::vector<uint32_t>& values);
       size_t xclReadModifyWrite(uint64_t offset, const void *hostBuf, size_t size);
       size_t xclReadSkipCopy(uint64_t offset, void *hostBuf, size_t size);
 
+      // sched_device, the kernel control registers as seen by MBScheduler
+      void write_registers(const std::vector<xclemulation::register_block>& blocks) override;
+      uint32_t read_register(uint64_t offset) override;
+      int wait_registers(const std::vector<uint64_t>& offsets, uint32_t mask, uint32_t timeout,
+                         std::vector<uint32_t>& values) override;
+      bool ert_enabled() override { return isMBSchedulerEnabled(); }
+
       // Buffer management
       uint64_t xclAllocDeviceBuffer(size_t size);
       uint64_t xclAllocDeviceBuffer2(size_t& size, xclMemoryDomains domain, unsigned flags,bool p2pBuffer, std::string &sFileName);
@@ -216,6 +229,14 @@ using addr_type = uint64_t;
 
       void initMemoryManager(std::list<xclemulation::DDRBank>& DDRBankList);
       std::vector<xclemulation::MemoryManager *> mDDRMemoryManager;
+      void initMemModel();
+      std::string getMemModelSnapshot();
+      void initSharedMemory();
+      // Argument info, control stream and messages around a kernel control write
+      std::string beginKernelCtrlWrite(uint64_t offset, const void *hostBuf, size_t size,
+                                       std::map<uint64_t,std::pair<std::string,unsigned int>>& offsetArgInfo);
+      void endKernelCtrlWrite(const void *hostBuf, const std::string& kernelName);
+      xclemulation::SharedDeviceMemory mSharedMemory;
       std::list<xclemulation::DDRBank> mDdrBanks;
       std::map<uint64_t,std::map<uint64_t, KernelArg>> mKernelOffsetArgsInfoMap;
       std::map<uint64_t,uint64_t> mAddrMap;
@@ -253,6 +274,8 @@ using addr_type = uint64_t;
       unsigned int mDeviceIndex;
       clock_t last_clk_time;
       bool mCloseAll;
+      bool mKeepAlive; // never set, hw_emu has no device process pool
+      bool mRegisterBatch; // simulator takes xclWriteRegisters and xclWaitRegisters
       mem_model* mMemModel;
       bool bUnified;
       bool bXPR;
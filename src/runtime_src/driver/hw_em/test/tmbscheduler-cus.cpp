@@ -0,0 +1,238 @@
+/**
+ * Copyright (C) 2016-2018 Xilinx, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "mbscheduler.h"
+
+/**
+ * Command throughput of the hw_emu scheduler with many CUs on one or more
+ * exec cores, against a mock simulator in which every CU is done a fixed
+ * time after it was started.  The host keeps two commands per CU in flight
+ * and waits for completions the way XRT does.
+ * Compile command: g++ -O2 -std=c++11 -I ../generic_pcie_hal2 -I ../../common_em -I ../../include -I ../../xclng/include tmbscheduler-cus.cpp ../generic_pcie_hal2/mbscheduler.cxx -lpthread
+ */
+
+using namespace xclhwemhal2;
+typedef std::chrono::steady_clock clock_type;
+
+static const unsigned regmapWords = 8;
+static const unsigned packetWords = 256;
+static const unsigned totalCmds = 20000;
+
+/* CU control registers: started by AP_START, AP_DONE after latency, cleared
+ * by the read that sees it */
+class mock_device : public sched_device
+{
+  public:
+    mock_device(std::chrono::microseconds latency) : mLatency(latency), mMessages(0) {}
+
+    void write_registers(const std::vector<xclemulation::register_block>& blocks) override
+    {
+      std::lock_guard<std::mutex> lk(mMutex);
+      mMessages++;
+      for (auto& block : blocks) {
+        auto it = mDone.find(block.offset);
+        if (it != mDone.end() && block.size == 4 && (*(const uint32_t*)block.data & 1))
+          it->second = clock_type::now() + mLatency;
+      }
+    }
+
+    uint32_t read_register(uint64_t offset) override
+    {
+      std::lock_guard<std::mutex> lk(mMutex);
+      mMessages++;
+      return take(offset, clock_type::now());
+    }
+
+    /* a simulator signals AP_DONE, it does not have to be polled */
+    int wait_registers(const std::vector<uint64_t>& offsets, uint32_t mask, uint32_t timeout,
+                       std::vector<uint32_t>& values) override
+    {
+      std::unique_lock<std::mutex> lk(mMutex);
+      mMessages++;
+      auto deadline = clock_type::now() + std::chrono::microseconds(timeout);
+      auto first = clock_type::time_point::max();
+      for (auto offset : offsets) {
+        auto it = mDone.find(offset);
+        if (it != mDone.end())
+          first = std::min(first, it->second);
+      }
+      first = std::min(first, deadline);
+      lk.unlock();
+      if (first > clock_type::now())
+        std::this_thread::sleep_until(first);
+      lk.lock();
+      auto now = clock_type::now();
+      values.clear();
+      for (auto offset : offsets)
+        values.push_back(take(offset, now));
+      return 0;
+    }
+
+    bool ert_enabled() override { return false; }
+
+    void add_cu(uint64_t addr) { mDone[addr] = clock_type::time_point::max(); }
+    unsigned long messages() const { return mMessages; }
+
+  private:
+    uint32_t take(uint64_t offset, clock_type::time_point now)
+    {
+      auto it = mDone.find(offset);
+      if (it == mDone.end() || it->second > now)
+        return 0;
+      it->second = clock_type::time_point::max();
+      return 0x6; /* AP_DONE | AP_IDLE */
+    }
+
+    std::chrono::microseconds mLatency;
+    std::mutex mMutex;
+    std::map<uint64_t, clock_type::time_point> mDone;
+    unsigned long mMessages;
+};
+
+struct host_cmd
+{
+  std::vector<uint32_t> words;
+  xclemulation::drm_xocl_bo bo;
+  unsigned core;
+  host_cmd() : words(packetWords, 0), core(0) { bo.buf = words.data(); }
+  ert_packet* packet() { return (ert_packet*)words.data(); }
+};
+
+static bool
+wait_all(MBScheduler& sch, std::vector<host_cmd*>& cmds)
+{
+  for (auto cmd : cmds)
+    while (cmd->packet()->state != ERT_CMD_STATE_COMPLETED)
+      if (!sch.wait_for_completion(1000))
+        return false;
+  return true;
+}
+
+static double
+run(unsigned cores, unsigned cus, std::chrono::microseconds latency, unsigned long& messages)
+{
+  mock_device device(latency);
+  MBScheduler sch(&device);
+  std::vector<exec_core*> execs;
+
+  for (unsigned c = 0; c < cores; c++) {
+    exec_core* exec = new exec_core;
+    execs.push_back(exec);
+
+    host_cmd cfg;
+    ert_configure_cmd* ecmd = (ert_configure_cmd*)cfg.packet();
+    ecmd->opcode = ERT_CONFIGURE;
+    ecmd->count = 5 + cus;
+    ecmd->slot_size = ERT_CQ_SIZE / MAX_SLOTS;
+    ecmd->num_cus = cus;
+    ecmd->cu_shift = 16;
+    for (unsigned i = 0; i < cus; i++) {
+      ecmd->data[i] = (c * MAX_CUS + i) << 16;
+      device.add_cu(ecmd->data[i]);
+    }
+    std::vector<host_cmd*> cfgs(1, &cfg);
+    sch.add_exec_buffer(exec, &cfg.bo);
+    if (!wait_all(sch, cfgs)) {
+      std::cerr << "configure timed out" << std::endl;
+      exit(1);
+    }
+  }
+
+  /* two commands per CU in flight on every core */
+  std::vector<host_cmd*> cmds;
+  for (unsigned c = 0; c < cores; c++) {
+    for (unsigned i = 0; i < 2 * cus; i++) {
+      host_cmd* cmd = new host_cmd;
+      ert_start_kernel_cmd* ecmd = (ert_start_kernel_cmd*)cmd->packet();
+      ecmd->opcode = ERT_START_CU;
+      ecmd->count = 1 + regmapWords;
+      for (unsigned m = 0; m < ((cus - 1) >> 5) + 1; m++)
+        (&ecmd->cu_mask)[m] = m < (cus >> 5) ? 0xFFFFFFFF : (1U << (cus & 31)) - 1;
+      ecmd->extra_cu_masks = (cus - 1) >> 5;
+      ecmd->count += ecmd->extra_cu_masks;
+      cmd->core = c;
+      cmds.push_back(cmd);
+    }
+  }
+
+  auto start = clock_type::now();
+  unsigned submitted = 0, completed = 0;
+  for (auto cmd : cmds) {
+    cmd->packet()->state = ERT_CMD_STATE_NEW;
+    sch.add_exec_buffer(execs[cmd->core], &cmd->bo);
+    submitted++;
+  }
+  while (completed < totalCmds) {
+    if (!sch.wait_for_completion(1000)) {
+      std::cerr << "commands timed out" << std::endl;
+      exit(1);
+    }
+    for (auto cmd : cmds) {
+      if (cmd->packet()->state != ERT_CMD_STATE_COMPLETED)
+        continue;
+      completed++;
+      cmd->packet()->state = ERT_CMD_STATE_NEW;
+      if (submitted < totalCmds) {
+        sch.add_exec_buffer(execs[cmd->core], &cmd->bo);
+        submitted++;
+      }
+      else
+        cmd->packet()->state = ERT_CMD_STATE_ABORT;
+    }
+  }
+  std::chrono::duration<double> elapsed = clock_type::now() - start;
+
+  sch.fini_scheduler_thread();
+  for (auto cmd : cmds)
+    delete cmd;
+  for (auto exec : execs)
+    delete exec;
+  messages = device.messages();
+  return totalCmds / elapsed.count();
+}
+
+int main(int argc, char** argv)
+{
+  std::chrono::microseconds latency(argc > 1 ? std::atoi(argv[1]) : 100);
+  std::cout << "CU latency " << latency.count() << " us, " << totalCmds << " commands" << std::endl;
+  std::cout << "cores    CUs     cmds/s   messages" << std::endl;
+  for (unsigned cores = 1; cores <= 4; cores *= 4) {
+    for (unsigned cus : {1, 16, 64, MAX_CUS}) {
+      unsigned long messages = 0;
+      double rate = run(cores, cus, latency, messages);
+      std::cout.width(5);
+      std::cout << cores << " ";
+      std::cout.width(6);
+      std::cout << cus << " ";
+      std::cout.width(10);
+      std::cout << (unsigned long)rate << " ";
+      std::cout.width(10);
+      std::cout << messages << std::endl;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,131 @@
+/**
+ * Copyright (C) 2016-2018 Xilinx, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <unistd.h>
+
+#include "mem_model.h"
+
+/**
+ * Save and restore of the hw_emu DDR model through a snapshot file.  Fills
+ * part of two 16 GB banks, saves, restores into a fresh model and checks
+ * sampled pages, then changes a restored page and saves over the snapshot
+ * it was mapped from.  Pass the GB to fill, 2 by default.
+ * Compile command: g++ -O2 -std=c++11 -I ../generic_pcie_hal2 tmem_model-snapshot.cpp ../generic_pcie_hal2/mem_model.cxx -lpthread
+ */
+
+static const uint64_t bankSize = 16ULL << 30;
+typedef std::chrono::steady_clock clock_type;
+
+static double
+seconds(clock_type::time_point start)
+{
+  std::chrono::duration<double> elapsed = clock_type::now() - start;
+  return elapsed.count();
+}
+
+/* every page starts with its address, the rest of it depends on the page */
+static void
+fill_page(uint64_t addr, std::vector<char>& page)
+{
+  std::memset(page.data(), int(addr >> 20), page.size());
+  std::memcpy(page.data(), &addr, sizeof(addr));
+}
+
+static bool
+check(mem_model& model, const std::vector<uint64_t>& pages)
+{
+  std::vector<char> page(ONE_MB), expected(ONE_MB);
+  std::mt19937_64 gen(pages.size());
+  for (unsigned i = 0; i < 1024; i++) {
+    uint64_t addr = pages[gen() % pages.size()];
+    fill_page(addr, expected);
+    model.readDevMem(addr, page.data(), page.size());
+    if (page != expected)
+      return false;
+  }
+  /* untouched memory reads as zeros */
+  uint64_t zero = 1;
+  model.readDevMem(bankSize - 8, &zero, sizeof(zero));
+  return zero == 0;
+}
+
+int main(int argc, char** argv)
+{
+  const uint64_t fill = (argc > 1 ? std::atoi(argv[1]) : 2) * (1ULL << 30);
+  std::vector<std::pair<uint64_t,uint64_t>> banks = {{0, bankSize}, {bankSize, bankSize}};
+  std::string snapshot = "/tmp/tmem_model-snapshot." + std::to_string(getpid()) + ".ddr";
+
+  /* half of the pages in each bank, spread out */
+  std::vector<uint64_t> pages;
+  for (uint64_t addr = 0; pages.size() * ONE_MB < fill; addr += 2 * ONE_MB)
+    pages.push_back(addr % (2 * bankSize) + (addr / (2 * bankSize)) * ONE_MB);
+
+  bool passed = true;
+  {
+    mem_model model("mem_model_save", banks);
+    std::vector<char> page(ONE_MB);
+    for (auto addr : pages) {
+      fill_page(addr, page);
+      model.writeDevMem(addr, page.data(), page.size());
+    }
+    auto start = clock_type::now();
+    passed = model.save_snapshot(snapshot) && passed;
+    double elapsed = seconds(start);
+    std::cout << "save    " << fill / elapsed / 1e6 << " MB/s, " << elapsed << " s\n";
+  }
+
+  {
+    mem_model model("mem_model_load", banks);
+    auto start = clock_type::now();
+    passed = model.load_snapshot(snapshot) && passed;
+    std::cout << "load    " << seconds(start) << " s\n";
+    start = clock_type::now();
+    passed = check(model, pages) && passed;
+    std::cout << "sample  " << seconds(start) << " s for 1024 pages\n";
+
+    /* resave a changed, restored page over its own snapshot */
+    const char pattern[] = "mem_model";
+    model.writeDevMem(pages[1] + 64, pattern, sizeof(pattern));
+    start = clock_type::now();
+    passed = model.save_snapshot(snapshot) && passed;
+    double elapsed = seconds(start);
+    std::cout << "resave  " << fill / elapsed / 1e6 << " MB/s, " << elapsed << " s\n";
+  }
+
+  {
+    mem_model model("mem_model_reload", banks);
+    passed = model.load_snapshot(snapshot) && passed;
+    char changed[sizeof("mem_model")] = {0};
+    model.readDevMem(pages[1] + 64, changed, sizeof(changed));
+    passed = std::strcmp(changed, "mem_model") == 0 && passed;
+    model.writeDevMem(pages[1] + 64, std::vector<char>(sizeof(changed), int(pages[1] >> 20)).data(), sizeof(changed));
+    passed = check(model, pages) && passed;
+  }
+
+  std::string user = getenv("USER") ? getenv("USER") : "";
+  std::string cleanup = "rm -rf /tmp/" + user + "/" + std::to_string(getpid()) + " " + snapshot;
+  if (std::system(cleanup.c_str()) == -1)
+    std::cout << "unable to remove mem files\n";
+  std::cout << (passed ? "PASSED TEST\n" : "FAILED TEST\n");
+  return passed ? 0 : 1;
+}
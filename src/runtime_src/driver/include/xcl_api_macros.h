@@ -65,9 +65,12 @@ mtx.unlock();
     namevalpair->set_name(i.first); \
     namevalpair->set_value(i.second); \
   }\
+  mSharedMemory.describe(c_msg);
 
 #define xclSetEnvironment_SET_PROTO_RESPONSE() \
-    ack = r_msg.ack()
+    ack = r_msg.ack(); \
+    mSharedMemory.setEnabled(r_msg.sharedmem()); \
+    mRegisterBatch = r_msg.regbatch()
 
 
 #define xclSetEnvironment_RETURN()\
@@ -95,9 +98,12 @@ mtx.unlock();
     xclLoadBitstream_call_ddrbank* ddrbank = c_msg.add_ddrbanks(); \
     ddrbank->set_size(bankSize); \
   }\
+  mSharedMemory.describe(c_msg);
 
 #define xclLoadBitstream_SET_PROTO_RESPONSE() \
-    ack = r_msg.ack()
+    ack = r_msg.ack(); \
+    mSharedMemory.setEnabled(r_msg.sharedmem()); \
+    mRegisterBatch = r_msg.regbatch()
 
 
 #define xclLoadBitstream_RETURN()\
@@ -207,6 +213,49 @@ mtx.unlock();
     FREE_BUFFERS(); \
     xclWriteAddrKernelCtrl_RETURN();
 
+//--------------------xclWriteRegisters--------------------------------
+#define xclWriteRegisters_SET_PROTOMESSAGE(func_name,blocks,kernelArgsInfo) \
+    for (auto& b : blocks) { \
+      xclRegisterBlock* block = c_msg.add_block(); \
+      block->set_addr(b.offset); \
+      block->set_data((char*) b.data, b.size); \
+    } \
+    for (auto i : kernelArgsInfo) { \
+      xclWriteAddrKernelCtrl_call_kernelInfo* kernelInfo = c_msg.add_kernel_info();\
+      kernelInfo->set_addr(i.first);\
+      kernelInfo->set_size(i.second.second);\
+      kernelInfo->set_name(i.second.first);\
+    }
+
+#define xclWriteRegisters_SET_PROTO_RESPONSE() \
+    valid = r_msg.valid();
+
+#define xclWriteRegisters_RPC_CALL(func_name,blocks,kernelArgsInfo) \
+    RPC_PROLOGUE(func_name); \
+    xclWriteRegisters_SET_PROTOMESSAGE(func_name,blocks,kernelArgsInfo); \
+    SERIALIZE_AND_SEND_MSG(func_name)\
+    xclWriteRegisters_SET_PROTO_RESPONSE(); \
+    FREE_BUFFERS();
+
+//--------------------xclWaitRegisters--------------------------------
+#define xclWaitRegisters_SET_PROTOMESSAGE(func_name,offsets,mask,timeout) \
+    for (auto offset : offsets) \
+      c_msg.add_addr(offset); \
+    c_msg.set_mask(mask); \
+    c_msg.set_timeout(timeout);
+
+#define xclWaitRegisters_SET_PROTO_RESPONSE(offsets,values) \
+    valid = r_msg.valid() && r_msg.value_size() == (int)offsets.size(); \
+    if (valid) \
+      values.assign(r_msg.value().begin(), r_msg.value().end());
+
+#define xclWaitRegisters_RPC_CALL(func_name,offsets,mask,timeout,values) \
+    RPC_PROLOGUE(func_name); \
+    xclWaitRegisters_SET_PROTOMESSAGE(func_name,offsets,mask,timeout); \
+    SERIALIZE_AND_SEND_MSG(func_name)\
+    xclWaitRegisters_SET_PROTO_RESPONSE(offsets,values); \
+    FREE_BUFFERS();
+
 //-----------------------xclReadAddrSpaceDeviceRam----------------------------
 //Generate call and info message
 #define xclReadAddrSpaceDeviceRam_SET_PROTOMESSAGE(func_name,address_space,addr,data,size) \
@@ -261,10 +310,12 @@ mtx.unlock();
 //-------------------xclClose---------------------------------
 #define xclClose_SET_PROTOMESSAGE(func_name,dev_handle) \
     c_msg.set_xcldevicehandle((char*)dev_handle);\
-    c_msg.set_closeall(mCloseAll);
+    c_msg.set_closeall(mCloseAll);\
+    c_msg.set_keepalive(mKeepAlive);
 
 #define xclClose_SET_PROTO_RESPONSE() \
-  simulator_started = false;
+  simulator_started = false;\
+  mKeepAlive = mKeepAlive && r_msg.keepalive();
 
 #define xclClose_RETURN() \
 	return;
@@ -585,12 +636,31 @@ mtx.unlock();
   xclCreateQueue_SET_PROTO_RESPONSE(); \
   FREE_BUFFERS();
 
+//offers the rings of queue, ring tells if the device process took them
+#define xclCreateQueue_SET_PROTO_RINGS(queue) \
+    queue->todevice.describe(c_msg.mutable_todevice()); \
+    if (queue->fromdevice.valid()) \
+      queue->fromdevice.describe(c_msg.mutable_fromdevice()); \
+    mStreamCompletions.describe(c_msg.mutable_completion());
+
+#define xclCreateQueue_SET_PROTO_RING_RESPONSE() \
+  q_handle = r_msg.q_handle(); \
+  ring = r_msg.ring();
+
+#define xclCreateStreamQueue_RPC_CALL(func_name, q_ctx,bWrite,queue) \
+  RPC_PROLOGUE(func_name); \
+  xclCreateQueue_SET_PROTOMESSAGE(q_ctx, bWrite); \
+  xclCreateQueue_SET_PROTO_RINGS(queue); \
+  SERIALIZE_AND_SEND_MSG(func_name) \
+  xclCreateQueue_SET_PROTO_RING_RESPONSE(); \
+  FREE_BUFFERS();
+
 //----------xclWriteQueue-------------------
 #define xclWriteQueue_SET_PROTOMESSAGE(q_handle,src,size) \
     c_msg.set_q_handle(q_handle); \
     c_msg.set_src((char*)src,size); \
     c_msg.set_size(size); \
-    c_msg.set_req(mReqCounter);\
+    c_msg.set_req(reqCounter);\
     c_msg.set_nonblocking(nonBlocking);\
     c_msg.set_eot(eot);
 
@@ -609,7 +679,7 @@ mtx.unlock();
     c_msg.set_q_handle(q_handle); \
     c_msg.set_dest((char*)dest,size); \
     c_msg.set_size(size); \
-    c_msg.set_req(mReqCounter);\
+    c_msg.set_req(reqCounter);\
     c_msg.set_nonblocking(nonBlocking);\
     c_msg.set_eot(eot);
 
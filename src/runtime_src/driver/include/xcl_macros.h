@@ -58,5 +58,7 @@
 
 #define xclPerfMonReadCounters_Streaming_n 30
 #define xclPerfMonReadTrace_Streaming_n 31
+#define xclWriteRegisters_n 32
+#define xclWaitRegisters_n 33
 
 #endif
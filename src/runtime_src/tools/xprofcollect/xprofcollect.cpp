@@ -0,0 +1,343 @@
+/**
+ * Copyright (C) 2018 Xilinx, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+// Merge the profile channels of all processes of a profiling session
+// (Debug.profile_session) into one timeline and one summary of per
+// process compute unit and memory bandwidth share.
+//
+// % xprofcollect -s <session> [-o <prefix>] [-u]
+
+#include "xdp/profile/rt_profile_channel.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <queue>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <getopt.h>
+#include <sys/mman.h>
+
+namespace {
+
+using namespace XCL::ProfileChannelLayout;
+
+struct process
+{
+  uint32_t pid;
+  std::string name;
+  std::unique_ptr<XCL::ProfileChannelReader> reader;
+  std::vector<Record> records;
+  uint64_t lost = 0;
+};
+
+// Merged event with strings resolved
+struct event
+{
+  uint64_t start;
+  uint64_t end;
+  uint64_t bytes;
+  uint16_t kind;
+  const process* proc;
+  std::string device;
+  std::string name;
+};
+
+// key: device, cu or bank, pid
+using share_key = std::tuple<std::string,std::string,uint32_t>;
+
+struct cu_share
+{
+  const process* proc = nullptr;
+  uint64_t executions = 0;
+  uint64_t busy = 0;
+};
+
+struct bank_share
+{
+  const process* proc = nullptr;
+  uint64_t read_bytes = 0;
+  uint64_t write_bytes = 0;
+  uint64_t busy = 0;
+};
+
+static void
+usage(const char* exe)
+{
+  std::cout << "usage: " << exe << " -s <session> [-o <prefix>] [-u]\n"
+            << "  -s <session>  profile session name (Debug.profile_session)\n"
+            << "  -o <prefix>   output file prefix (default xprofcollect_<session>)\n"
+            << "  -u            unlink session segments after collecting\n";
+}
+
+static double
+to_msec(uint64_t nsec)
+{
+  return nsec / 1.0e6;
+}
+
+static const char*
+kind_to_string(uint16_t kind)
+{
+  switch (kind) {
+  case CU_START:
+  case CU_END:
+    return "COMPUTE_UNIT";
+  case READ_BUFFER:
+    return "READ_BUFFER";
+  case WRITE_BUFFER:
+    return "WRITE_BUFFER";
+  default:
+    return "UNKNOWN";
+  }
+}
+
+// Time during which transfers of at least two processes are in flight
+static uint64_t
+get_concurrent_time(const std::vector<const event*>& transfers)
+{
+  // +1 at start, -1 at end, per process
+  std::vector<std::tuple<uint64_t,int,const process*>> edges;
+  for (auto ev : transfers) {
+    edges.emplace_back(ev->start,1,ev->proc);
+    edges.emplace_back(ev->end,-1,ev->proc);
+  }
+  std::sort(edges.begin(),edges.end(),
+            [](const std::tuple<uint64_t,int,const process*>& e1,
+               const std::tuple<uint64_t,int,const process*>& e2) {
+              // ends before starts at same time
+              return std::get<0>(e1) < std::get<0>(e2)
+                || (std::get<0>(e1) == std::get<0>(e2) && std::get<1>(e1) < std::get<1>(e2));
+            });
+
+  std::map<const process*,int> inflight;
+  size_t active = 0;
+  uint64_t last = 0;
+  uint64_t concurrent = 0;
+  for (auto& edge : edges) {
+    if (active >= 2)
+      concurrent += std::get<0>(edge) - last;
+    last = std::get<0>(edge);
+    auto& count = inflight[std::get<2>(edge)];
+    if (std::get<1>(edge) > 0 && count++ == 0)
+      ++active;
+    else if (std::get<1>(edge) < 0 && --count == 0)
+      --active;
+  }
+  return concurrent;
+}
+
+static void
+write_timeline(const std::string& file, const std::vector<event>& events, uint64_t zero)
+{
+  std::ofstream ofs(file);
+  ofs << std::fixed << std::setprecision(6);
+  ofs << "Time (ms),PID,Process,Device,Event,Name,Stage,Duration (ms),Size (bytes)\n";
+  for (auto& ev : events) {
+    const char* stage = (ev.kind == CU_START) ? "START" : (ev.kind == CU_END) ? "END" : "COMPLETE";
+    ofs << to_msec(ev.start - zero) << "," << ev.proc->pid << "," << ev.proc->name << ","
+        << ev.device << "," << kind_to_string(ev.kind) << "," << ev.name << "," << stage << ","
+        << to_msec(ev.end - ev.start) << "," << ev.bytes << "\n";
+  }
+}
+
+static void
+write_summary(const std::string& file, const std::vector<process>& procs,
+              const std::vector<event>& events)
+{
+  std::map<share_key,cu_share> cus;
+  std::map<share_key,bank_share> banks;
+  std::map<std::pair<std::string,std::string>,std::vector<const event*>> transfers;
+  std::map<share_key,std::queue<uint64_t>> starts;
+  uint64_t first = UINT64_MAX, last = 0;
+
+  for (auto& ev : events) {
+    first = std::min(first,ev.start);
+    last = std::max(last,ev.end);
+    share_key key(ev.device,ev.name,ev.proc->pid);
+    if (ev.kind == CU_START) {
+      starts[key].push(ev.start);
+    }
+    else if (ev.kind == CU_END) {
+      auto& queue = starts[key];
+      if (queue.empty())
+        continue;
+      auto& share = cus[key];
+      share.proc = ev.proc;
+      share.executions++;
+      share.busy += ev.end - queue.front();
+      queue.pop();
+    }
+    else {
+      auto& share = banks[key];
+      share.proc = ev.proc;
+      share.busy += ev.end - ev.start;
+      if (ev.kind == READ_BUFFER)
+        share.read_bytes += ev.bytes;
+      else
+        share.write_bytes += ev.bytes;
+      transfers[std::make_pair(ev.device,ev.name)].push_back(&ev);
+    }
+  }
+
+  std::ofstream ofs(file);
+  ofs << std::fixed << std::setprecision(3);
+  ofs << "Cross-Process Profile Summary\n";
+  ofs << "Processes:," << procs.size() << "\n";
+  ofs << "Duration (ms):," << ((last > first) ? to_msec(last - first) : 0.0) << "\n";
+  for (auto& proc : procs)
+    if (proc.lost)
+      ofs << "Records lost (ring overrun):," << proc.pid << "," << proc.name << "," << proc.lost << "\n";
+
+  // Total busy time per CU across processes
+  std::map<std::pair<std::string,std::string>,uint64_t> cu_total;
+  for (auto& cu : cus)
+    cu_total[std::make_pair(std::get<0>(cu.first),std::get<1>(cu.first))] += cu.second.busy;
+
+  ofs << "\nCompute Unit Share\n";
+  ofs << "Device,Compute Unit,PID,Process,Number Of Calls,Busy Time (ms),Share Of CU Busy Time (%)\n";
+  for (auto& cu : cus) {
+    auto total = cu_total[std::make_pair(std::get<0>(cu.first),std::get<1>(cu.first))];
+    ofs << std::get<0>(cu.first) << "," << std::get<1>(cu.first) << "," << cu.second.proc->pid << ","
+        << cu.second.proc->name << "," << cu.second.executions << "," << to_msec(cu.second.busy) << ","
+        << (total ? (100.0 * cu.second.busy / total) : 0.0) << "\n";
+  }
+
+  // Total bytes per bank across processes
+  std::map<std::pair<std::string,std::string>,uint64_t> bank_total;
+  for (auto& bank : banks)
+    bank_total[std::make_pair(std::get<0>(bank.first),std::get<1>(bank.first))]
+      += bank.second.read_bytes + bank.second.write_bytes;
+
+  ofs << "\nBandwidth Share\n";
+  ofs << "Device,Memory Resources,PID,Process,Read Bytes,Write Bytes,Transfer Time (ms),"
+      << "Average Bandwidth (MB/s),Share Of Bank Bytes (%)\n";
+  for (auto& bank : banks) {
+    auto total = bank_total[std::make_pair(std::get<0>(bank.first),std::get<1>(bank.first))];
+    auto bytes = bank.second.read_bytes + bank.second.write_bytes;
+    ofs << std::get<0>(bank.first) << "," << std::get<1>(bank.first) << "," << bank.second.proc->pid << ","
+        << bank.second.proc->name << "," << bank.second.read_bytes << "," << bank.second.write_bytes << ","
+        << to_msec(bank.second.busy) << ","
+        << (bank.second.busy ? (bytes * 1000.0 / bank.second.busy) : 0.0) << ","
+        << (total ? (100.0 * bytes / total) : 0.0) << "\n";
+  }
+
+  ofs << "\nTransfer Contention\n";
+  ofs << "Device,Memory Resources,Number Of Transfers,Concurrent Transfer Time (ms)\n";
+  for (auto& t : transfers)
+    ofs << t.first.first << "," << t.first.second << "," << t.second.size() << ","
+        << to_msec(get_concurrent_time(t.second)) << "\n";
+}
+
+static int
+run(int argc, char** argv)
+{
+  std::string session;
+  std::string prefix;
+  bool unlink = false;
+
+  int c;
+  while ((c = getopt(argc,argv,"s:o:uh")) != -1) {
+    switch (c) {
+    case 's':
+      session = optarg;
+      break;
+    case 'o':
+      prefix = optarg;
+      break;
+    case 'u':
+      unlink = true;
+      break;
+    default:
+      usage(argv[0]);
+      return (c == 'h') ? 0 : 1;
+    }
+  }
+
+  if (session.empty()) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (prefix.empty())
+    prefix = "xprofcollect_" + session;
+
+  std::vector<process> procs;
+  for (auto& name : XCL::ProfileChannelReader::list(session)) {
+    try {
+      process proc;
+      proc.reader.reset(new XCL::ProfileChannelReader(name));
+      proc.pid = proc.reader->getPid();
+      proc.name = proc.reader->getProcess();
+      proc.lost = proc.reader->read(proc.records);
+      procs.push_back(std::move(proc));
+    }
+    catch (const std::exception& ex) {
+      std::cerr << "xprofcollect: skipping " << name << ": " << ex.what() << "\n";
+    }
+  }
+
+  if (procs.empty()) {
+    std::cerr << "xprofcollect: no processes found for session '" << session << "'\n";
+    return 1;
+  }
+
+  std::vector<event> events;
+  for (auto& proc : procs) {
+    for (auto& record : proc.records) {
+      event ev;
+      ev.start = record.StartNsec;
+      ev.end = record.EndNsec;
+      ev.bytes = record.Bytes;
+      ev.kind = record.Kind;
+      ev.proc = &proc;
+      ev.device = proc.reader->getString(record.Device);
+      ev.name = proc.reader->getString(record.Name);
+      events.push_back(std::move(ev));
+    }
+  }
+  std::stable_sort(events.begin(),events.end(),
+                   [](const event& e1, const event& e2) { return e1.start < e2.start; });
+  uint64_t zero = events.empty() ? 0 : events.front().start;
+
+  write_timeline(prefix + "_timeline.csv",events,zero);
+  write_summary(prefix + "_summary.csv",procs,events);
+  std::cout << "xprofcollect: merged " << events.size() << " records from "
+            << procs.size() << " processes into " << prefix << "_{timeline,summary}.csv\n";
+
+  if (unlink)
+    for (auto& proc : procs)
+      shm_unlink(proc.reader->getName().c_str());
+
+  return 0;
+}
+
+} // namespace
+
+int
+main(int argc, char** argv)
+{
+  try {
+    return run(argc,argv);
+  }
+  catch (const std::exception& ex) {
+    std::cerr << "xprofcollect: " << ex.what() << "\n";
+  }
+  return 1;
+}
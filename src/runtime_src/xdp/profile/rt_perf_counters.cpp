@@ -152,6 +152,11 @@ namespace XCL {
     CallCount[functionName].logEnd(timePoint);
   }
 
+  void PerformanceCounter::logFunctionCallsSampledOut(const std::string& functionName, uint32_t numCalls)
+  {
+    CallCount[functionName].logSampledOutCalls(numCalls);
+  }
+
   void PerformanceCounter::logKernelExecutionStart(const std::string& kernelName, const std::string& deviceName,
                                                    double timePoint)
   {
@@ -388,8 +393,7 @@ namespace XCL {
       std::string name = cuIter->first;
       name = name.substr(0, name.find_last_of("|"));
       if (name.find(deviceName) != std::string::npos && name.find(cuName) != std::string::npos) {
-        TimeStats cuStats = cuIter->second;
-        return cuStats.getNoOfCalls();
+        return cuIter->second.getNoOfCalls();
       }
       cuIter++;
     }
@@ -412,6 +416,70 @@ namespace XCL {
     return getTotalKernelExecutionTime(deviceName);
   }
 
+  LatencyHistogram PerformanceCounter::getLatencyHistogram(e_latency_kind kind,
+      const std::string& name) const
+  {
+    LatencyHistogram histogram;
+
+    switch (kind) {
+    case LATENCY_API: {
+      auto iter = CallCount.find(name);
+      if (iter != CallCount.end())
+        histogram.merge(iter->second.getLatency());
+      break;
+    }
+    case LATENCY_KERNEL:
+      //"name" is of the form "kernelName|objId|programId"
+      for (const auto &pair : KernelExecutionStats) {
+        if (pair.first.substr(0, pair.first.find_first_of("|")) == name)
+          histogram.merge(pair.second.getLatency());
+      }
+      break;
+    case LATENCY_COMPUTE_UNIT:
+      //"name" is of the form "deviceName|kernelName|globalSize|localSize|cuName|objId"
+      for (const auto &pair : ComputeUnitExecutionStats) {
+        auto cuName = pair.first.substr(0, pair.first.find_last_of("|"));
+        cuName = cuName.substr(cuName.find_last_of("|") + 1);
+        if (cuName == name)
+          histogram.merge(pair.second.getLatency());
+      }
+      break;
+    case LATENCY_HOST_READ:
+#ifdef BUFFER_STAT_PER_CONTEXT
+      for (const auto &pair : BufferReadStat)
+        histogram.merge(pair.second.getLatency());
+#else
+      histogram.merge(BufferReadStat.getLatency());
+#endif
+      break;
+    case LATENCY_HOST_WRITE:
+#ifdef BUFFER_STAT_PER_CONTEXT
+      for (const auto &pair : BufferWriteStat)
+        histogram.merge(pair.second.getLatency());
+#else
+      histogram.merge(BufferWriteStat.getLatency());
+#endif
+      break;
+    case LATENCY_DEVICE_READ:
+      histogram.merge(DeviceBufferReadStat.getLatency());
+      break;
+    case LATENCY_DEVICE_WRITE:
+      histogram.merge(DeviceBufferWriteStat.getLatency());
+      break;
+    case LATENCY_DEVICE_KERNEL:
+      histogram.merge(DeviceKernelStat.getLatency());
+      break;
+    }
+
+    return histogram;
+  }
+
+  double PerformanceCounter::getLatencyPercentile(e_latency_kind kind,
+      const std::string& name, double percentile) const
+  {
+    return getLatencyHistogram(kind, name).getPercentile(percentile);
+  }
+
   void PerformanceCounter::writeKernelSummary(WriterI* writer) const
   {
     for (const auto &pair : KernelExecutionStats) {
@@ -535,4 +603,38 @@ namespace XCL {
     writer->writeSummary(transferType, *bufferStat);
   }
 
+
+  // Latency percentiles of API calls, kernels, compute units, and transfers
+  void PerformanceCounter::writeLatencySummary(WriterI* writer) const
+  {
+    for (const auto &pair : CallCount)
+      writer->writeLatencySummary("API", pair.first, pair.second.getLatency());
+
+    // Kernels and CUs are merged across all object IDs
+    std::map<std::string, LatencyHistogram> kernelLatency;
+    for (const auto &pair : KernelExecutionStats) {
+      auto kernelName = pair.first.substr(0, pair.first.find_first_of("|"));
+      kernelLatency[kernelName].merge(pair.second.getLatency());
+    }
+    for (const auto &pair : kernelLatency)
+      writer->writeLatencySummary("Kernel", pair.first, pair.second);
+
+    for (const auto &pair : ComputeUnitExecutionStats) {
+      auto cuName = pair.first.substr(0, pair.first.find_last_of("|"));
+      writer->writeLatencySummary("Compute Unit", cuName, pair.second.getLatency());
+    }
+
+    writer->writeLatencySummary("Host Transfer", "READ",
+        getLatencyHistogram(LATENCY_HOST_READ, ""));
+    writer->writeLatencySummary("Host Transfer", "WRITE",
+        getLatencyHistogram(LATENCY_HOST_WRITE, ""));
+    writer->writeLatencySummary("Device Transfer", "READ", DeviceBufferReadStat.getLatency());
+    writer->writeLatencySummary("Device Transfer", "WRITE", DeviceBufferWriteStat.getLatency());
+    writer->writeLatencySummary("Device Transfer", "KERNEL", DeviceKernelStat.getLatency());
+    for (const auto &pair : DeviceKernelReadSummaryStats)
+      writer->writeLatencySummary("Kernel Transfer READ", pair.first, pair.second.getLatency());
+    for (const auto &pair : DeviceKernelWriteSummaryStats)
+      writer->writeLatencySummary("Kernel Transfer WRITE", pair.first, pair.second.getLatency());
+  }
+
 }
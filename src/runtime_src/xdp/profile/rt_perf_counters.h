@@ -54,6 +54,19 @@ namespace XCL {
 
   // Performance counters
   class PerformanceCounter {
+  public:
+    // Categories of latency histograms available for queries
+    enum e_latency_kind {
+      LATENCY_API = 0x1,
+      LATENCY_KERNEL = 0x2,
+      LATENCY_COMPUTE_UNIT = 0x3,
+      LATENCY_HOST_READ = 0x4,
+      LATENCY_HOST_WRITE = 0x5,
+      LATENCY_DEVICE_READ = 0x6,
+      LATENCY_DEVICE_WRITE = 0x7,
+      LATENCY_DEVICE_KERNEL = 0x8
+    };
+
   public:
     PerformanceCounter();
     ~PerformanceCounter() {};
@@ -69,6 +82,12 @@ namespace XCL {
 
     double getComputeUnitTotalTime(const std::string& deviceName, const std::string& cuName) const;
 
+    // Latency distributions
+    // NOTE: name is the API, kernel, or compute unit name; it is ignored for transfers.
+    //       All matching histograms (e.g., all CUs of a given name) are merged.
+    LatencyHistogram getLatencyHistogram(e_latency_kind kind, const std::string& name) const;
+    double getLatencyPercentile(e_latency_kind kind, const std::string& name, double percentile) const;
+
   public:
     void logBufferRead(size_t size, double duration, uint32_t contextId, uint32_t numDevices);
     void logBufferWrite(size_t size, double duration, uint32_t contextId, uint32_t numDevices);
@@ -79,6 +98,7 @@ namespace XCL {
                                  uint32_t bitWidth, double clockFreqMhz, bool isRead);
     void logFunctionCallStart(const std::string& functionName, double timePoint);
     void logFunctionCallEnd(const std::string& functionName, double timePoint);
+    void logFunctionCallsSampledOut(const std::string& functionName, uint32_t numCalls);
     void logKernelExecutionStart(const std::string& kernelName, const std::string& deviceName, double timePoint);
     void logKernelExecutionEnd(const std::string& kernelName, const std::string& deviceName, double timePoint);
     void logComputeUnitDeviceStart(const std::string& deviceName, double timePoint);
@@ -112,6 +132,7 @@ namespace XCL {
     	bool isRead, uint64_t totalBytes, uint64_t totalTranx, double totalKernelTimeMsec,
         double totalTransferTimeMsec, double maxTransferRateMBps) const;
     void writeDeviceTransferSummary(WriterI* writer, bool isRead) const;
+    void writeLatencySummary(WriterI* writer) const;
 
     void writeAcceleratorSummary(WriterI* writer) const;
     void writeTopHardwareSummary(WriterI* writer) const;
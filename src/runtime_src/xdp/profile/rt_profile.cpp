@@ -21,6 +21,8 @@
 #include "rt_profile_device.h"
 #include "rt_profile_rule_checks.h"
 #include "rt_perf_counters.h"
+#include "rt_profile_checkpoint.h"
+#include "rt_profile_channel.h"
 #include "xdp/rt_singleton.h"
 #include "debug.h"
 
@@ -36,11 +38,57 @@
 #include <algorithm>
 #include <ctime>
 #include <cassert>
+#include <cstring>
+#include <cstdio>
 
 // Uncomment to use device-based timestamps in timeline trace
 //#define USE_DEVICE_TIMELINE
 
+// Maximum number of traces and kernel starts waiting for completion
+// NOTE: bounds memory of long runs where some END events never arrive
+#define MAX_INFLIGHT_TRACES 4096
+
 namespace XCL {
+  // Add an in-flight trace; once limit is exceeded, drop the oldest traces
+  // still waiting for completion (never the one being added)
+  template <typename T>
+  static void addInflightTrace(std::map<uint64_t, T*>& traceMap,
+      std::deque<std::pair<uint64_t, uint64_t>>& traceOrder, uint64_t& sequence,
+      uint64_t id, T* traceObject)
+  {
+    traceObject->Sequence = ++sequence;
+    traceMap[id] = traceObject;
+    traceOrder.emplace_back(id, traceObject->Sequence);
+
+    // An entry is stale if its trace completed (or its ID was reused since)
+    auto isLive = [&traceMap](const std::pair<uint64_t, uint64_t>& entry) {
+      auto itr = traceMap.find(entry.first);
+      return (itr != traceMap.end() && itr->second->Sequence == entry.second);
+    };
+
+    while (traceMap.size() > MAX_INFLIGHT_TRACES) {
+      auto oldest = traceOrder.front();
+      if (oldest.second == traceObject->Sequence)
+        break;
+      traceOrder.pop_front();
+      if (!isLive(oldest))
+        continue;
+      auto itr = traceMap.find(oldest.first);
+      T::recycle(itr->second);
+      traceMap.erase(itr);
+    }
+
+    // Forget completed traces so order stays bounded
+    if (traceOrder.size() > 2 * MAX_INFLIGHT_TRACES) {
+      std::deque<std::pair<uint64_t, uint64_t>> liveOrder;
+      for (const auto& entry : traceOrder) {
+        if (isLive(entry))
+          liveOrder.push_back(entry);
+      }
+      traceOrder.swap(liveOrder);
+    }
+  }
+
   // ***********************
   // Top-Level Profile Class
   // ***********************
@@ -52,13 +100,22 @@ namespace XCL {
     DeviceTraceOption(DEVICE_TRACE_OFF),
     StallTraceOption(STALL_TRACE_OFF),
     CurrentContextId(0),
-    PerfCounters()
+    PerfCounters(),
+    TraceSequence(0),
+    FunctionSampleRate(1),
+    FunctionCallCounters()
   {
     // Create device profiler (may or may not be used during given run)
     DeviceProfile = new RTProfileDevice();
 
     // Profile rule checks
     RuleChecks = new ProfileRuleChecks();
+
+    // Periodic summary checkpoints (started on request)
+    Checkpoint = nullptr;
+
+    // Cross-process trace channel (started on request)
+    Channel = nullptr;
     
     // Indeces are now same for HW and emulation
     OclSlotIndex  = XPAR_SPM0_FIRST_KERNEL_SLOT;
@@ -67,6 +124,9 @@ namespace XCL {
 
   RTProfile::~RTProfile()
   {
+    stopProfileCheckpoints();
+    stopProfileChannel();
+
     if (ProfileFlags)
       writeProfileSummary();
 
@@ -294,7 +354,7 @@ namespace XCL {
     auto itr = BufferTraceMap.find(objId);
     if (itr == BufferTraceMap.end()) {
       traceObject = BufferTrace::reuse();
-      BufferTraceMap[objId] = traceObject;
+      addInflightTrace(BufferTraceMap, BufferTraceOrder, TraceSequence, objId, traceObject);
     }
     else {
       traceObject = itr->second;
@@ -322,6 +382,14 @@ namespace XCL {
         break;
       }
 
+      // Host traffic per memory bank (used by placement advice)
+      if (!bank.empty())
+        BankTransferBytesMap[bank] += objSize;
+
+      if (Channel != nullptr)
+        Channel->logDataTransfer(objKind == READ_BUFFER, deviceName, bank,
+            traceObject->Start, traceObject->End, objSize);
+
       // Mark and keep top trace data
       // Data can be additionally streamed to a data transfer record
       traceObject->Address = address;
@@ -329,11 +397,19 @@ namespace XCL {
       traceObject->ContextId = contextId;
       traceObject->CommandQueueId = commandQueueId;
       auto itr = BufferTraceMap.find(objId);
-      BufferTraceMap.erase(itr);
+      if (itr != BufferTraceMap.end())
+        BufferTraceMap.erase(itr);
 
       // Store thread IDs into set
       addToThreadIds(threadId);
     }
+    else if (objStage == END) {
+      auto itr = BufferTraceMap.find(objId);
+      if (itr != BufferTraceMap.end()) {
+        BufferTraceMap.erase(itr);
+        BufferTrace::recycle(traceObject);
+      }
+    }
 
     writeTimelineTrace(timeStamp, commandString, stageString, eventString, dependString,
                        objSize, address, bank, threadId);
@@ -405,7 +481,10 @@ namespace XCL {
       std::string newKernelName = kernelName + "|" + std::to_string(objId) + "|"  + std::to_string(programId);
       if (objStage == START) {
         // Queue STARTS because events come in async order
-        KernelStartsMap[newKernelName].push(deviceTimeStamp);
+        auto& starts = KernelStartsMap[newKernelName];
+        starts.push(deviceTimeStamp);
+        if (starts.size() > MAX_INFLIGHT_TRACES)
+          starts.pop();
         XOCL_DEBUGF("logKernelExecution: kernel START @ %.3f msec for %s\n", deviceTimeStamp, newKernelName.c_str());
       }
       else if (objStage == END) {
@@ -415,6 +494,8 @@ namespace XCL {
           PerfCounters.logKernelExecutionStart(newKernelName, newDeviceName, it->second.front());
           PerfCounters.logKernelExecutionEnd(newKernelName, newDeviceName, deviceTimeStamp);
           it->second.pop();
+          if (it->second.empty())
+            KernelStartsMap.erase(it);
         }
       }
 
@@ -423,7 +504,7 @@ namespace XCL {
       auto itr = KernelTraceMap.find(eventId);
       if(itr == KernelTraceMap.end()) {
         traceObject = KernelTrace::reuse();
-        KernelTraceMap[eventId] = traceObject;
+        addInflightTrace(KernelTraceMap, KernelTraceOrder, TraceSequence, eventId, traceObject);
       } else {
         traceObject = itr->second;
       }
@@ -443,11 +524,15 @@ namespace XCL {
         traceObject->LocalWorkSize[2] = localWorkDim[2];
 
         auto itr = KernelTraceMap.find(eventId);
-        KernelTraceMap.erase(itr);
+        if (itr != KernelTraceMap.end())
+          KernelTraceMap.erase(itr);
         // Only log Valid trace objects
         if (traceObject->getStart() > 0.0 && traceObject->getStart() < deviceTimeStamp) {
           PerfCounters.pushToSortedTopUsage(traceObject);
         }
+        else {
+          KernelTrace::recycle(traceObject);
+        }
       }
 
       // Write all states to timeline trace
@@ -481,6 +566,9 @@ namespace XCL {
         PerfCounters.logComputeUnitExecutionEnd(cuName, deviceTimeStamp);
       }
 
+      if (Channel != nullptr && (objStage == START || objStage == END))
+        Channel->logComputeUnit(objStage == START, newDeviceName, cu_name, timeStamp);
+
       // Store mapping of CU name to kernel name
       ComputeUnitKernelNameMap[cu_name] = kernelName;
 
@@ -584,8 +672,74 @@ else if (functionName.find("clEnqueueMigrateMemObjects") != std::string::npos)
     return XCL_PERF_MON_IGNORE_EVENT;
   }
 
+  // Sampling state of API calls in flight on this thread: bit N is set if the
+  // call at nesting depth N is timed (deeper calls are always timed)
+  static thread_local uint64_t tSampledCalls = 0;
+  static thread_local unsigned int tSampledDepth = 0;
+
+  // Decide if this API call is timed when sampling is enabled (Debug.profile_sample_rate)
+  // NOTE: sampled-out calls are only counted so API summaries can be scaled;
+  // this path takes no lock so it stays cheap with many threads
+  bool RTProfile::isFunctionCallSampled(const char* functionName)
+  {
+    uint64_t calls = 0;
+    size_t slot = (reinterpret_cast<uintptr_t>(functionName) >> 3) % FUNCTION_COUNTER_SLOTS;
+    for (size_t i = 0; i < FUNCTION_COUNTER_SLOTS; ++i) {
+      auto& counter = FunctionCallCounters[(slot + i) % FUNCTION_COUNTER_SLOTS];
+      const char* name = counter.Name.load(std::memory_order_acquire);
+      if (name == nullptr && counter.Name.compare_exchange_strong(name, functionName))
+        name = functionName;
+      if (name == functionName) {
+        calls = counter.Calls.fetch_add(1, std::memory_order_relaxed);
+        break;
+      }
+    }
+
+    // NOTE: APIs that do not fit in the table are always timed
+    bool sampled = (calls % FunctionSampleRate) == 0;
+    if (tSampledDepth < 64) {
+      uint64_t bit = 1ULL << tSampledDepth;
+      tSampledCalls = sampled ? (tSampledCalls | bit) : (tSampledCalls & ~bit);
+    }
+    ++tSampledDepth;
+    return sampled;
+  }
+
+  // Was the API call now ending on this thread timed?
+  bool RTProfile::isFunctionCallEndSampled()
+  {
+    // Start was not seen (e.g., profiling turned on mid-call)
+    if (tSampledDepth == 0)
+      return true;
+    --tSampledDepth;
+    return (tSampledDepth >= 64) || ((tSampledCalls >> tSampledDepth) & 1);
+  }
+
+  // Fold counts of sampled-out calls into API stats
+  void RTProfile::logSampledOutFunctionCalls()
+  {
+    std::lock_guard<std::mutex> lock(LogMutex);
+    for (auto& counter : FunctionCallCounters) {
+      const char* name = counter.Name.load(std::memory_order_acquire);
+      if (name == nullptr)
+        continue;
+      uint64_t calls = counter.Calls.load(std::memory_order_relaxed);
+      uint64_t sampledOut = calls - (calls + FunctionSampleRate - 1) / FunctionSampleRate;
+      if (sampledOut > counter.ReportedOut)
+        PerfCounters.logFunctionCallsSampledOut(name, sampledOut - counter.ReportedOut);
+      counter.ReportedOut = sampledOut;
+    }
+  }
+
   void RTProfile::logFunctionCallStart(const char* functionName, long long queueAddress, unsigned int functionID)
   {
+    // Used by PRCs so always keep it exact
+    if (std::strstr(functionName, "MigrateMem") != nullptr)
+      MigrateMemCalls++;
+
+    if (FunctionSampleRate > 1 && !isFunctionCallSampled(functionName))
+      return;
+
 #ifdef USE_DEVICE_TIMELINE
     double timeStamp = getDeviceTimeStamp(getTraceTime(), CurrentDeviceName);
 #else
@@ -593,9 +747,6 @@ else if (functionName.find("clEnqueueMigrateMemObjects") != std::string::npos)
 #endif
 
     std::string name(functionName);
-    if (name.find("MigrateMem") != std::string::npos)
-      MigrateMemCalls++;
-
     if (queueAddress == 0)
       name += "|General";
     else
@@ -615,10 +766,16 @@ else if (functionName.find("clEnqueueMigrateMemObjects") != std::string::npos)
 
   void RTProfile::logFunctionCallEnd(const char* functionName, long long queueAddress, unsigned int functionID)
   {
+    if (FunctionSampleRate > 1 && !isFunctionCallEndSampled())
+      return;
+
     // Log function call start if not done so already
     // NOTE: this addresses a race condition when constructing the singleton (CR 963297)
-    if (!FunctionStartLogged)
+    if (!FunctionStartLogged) {
       logFunctionCallStart(functionName, queueAddress, functionID);
+      if (FunctionSampleRate > 1)
+        isFunctionCallEndSampled();
+    }
 
 #ifdef USE_DEVICE_TIMELINE
     double timeStamp = getDeviceTimeStamp(getTraceTime(), CurrentDeviceName);
@@ -1468,6 +1625,11 @@ else if (functionName.find("clEnqueueMigrateMemObjects") != std::string::npos)
     PerfCounters.writeDeviceTransferSummary(writer, false);
   }
 
+  void RTProfile::writeLatencySummary(WriterI* writer) const
+  {
+    PerfCounters.writeLatencySummary(writer);
+  }
+
   void RTProfile::writeTopDataTransferSummary(WriterI* writer, bool isRead) const
   {
     PerfCounters.writeTopDataTransferSummary(writer, isRead);
@@ -1488,15 +1650,228 @@ else if (functionName.find("clEnqueueMigrateMemObjects") != std::string::npos)
     RuleChecks->writeProfileRuleCheckSummary(writer, this);
   }
 
+  // Total bytes (read + write) per kernel port, keyed on "cu/port"
+  void RTProfile::getKernelPortBytes(std::map<std::string, uint64_t>& portBytes) const
+  {
+    for (auto& result : FinalCounterResultsMap) {
+      std::string key = result.first;
+      std::string deviceName = key.substr(0, key.find_first_of("|"));
+      if (!isDeviceActive(deviceName) || (DeviceBinaryDataSlotsMap.find(key) == DeviceBinaryDataSlotsMap.end()))
+        continue;
+
+      const xclCounterResults& counterResults = result.second;
+
+      xclCounterResults rolloverResults;
+      if (RolloverCounterResultsMap.find(key) != RolloverCounterResultsMap.end())
+        rolloverResults = RolloverCounterResultsMap.at(key);
+      else
+        memset(&rolloverResults, 0, sizeof(xclCounterResults));
+
+      xclCounterResults rolloverCounts;
+      if (RolloverCountsMap.find(key) != RolloverCountsMap.end())
+        rolloverCounts = RolloverCountsMap.at(key);
+      else
+        memset(&rolloverCounts, 0, sizeof(xclCounterResults));
+
+      uint32_t numSlots = DeviceBinaryDataSlotsMap.at(key).size();
+      uint32_t numHostSlots = XCL::RTSingleton::Instance()->getProfileNumberSlots(XCL_PERF_MON_HOST, deviceName);
+
+      unsigned int s = (HostSlotIndex == 0) ? numHostSlots : 0;
+      for (; s < numSlots; ++s) {
+        if (s == HostSlotIndex)
+          continue;
+
+        std::string cuPortName = DeviceBinaryDataSlotsMap.at(key)[s];
+        std::transform(cuPortName.begin(), cuPortName.end(), cuPortName.begin(), ::tolower);
+
+        uint64_t totalBytes = counterResults.ReadBytes[s] + rolloverResults.ReadBytes[s]
+                              + (rolloverCounts.ReadBytes[s] * 4294967296UL)
+                              + counterResults.WriteBytes[s] + rolloverResults.WriteBytes[s]
+                              + (rolloverCounts.WriteBytes[s] * 4294967296UL);
+        portBytes[cuPortName] += totalBytes;
+      }
+    }
+  }
+
+  void RTProfile::getPlacementProfile(xrt::placement::profile& prof) const
+  {
+    std::map<std::string, uint64_t> portBytes;
+    getKernelPortBytes(portBytes);
+
+    // Arguments keyed on "kernel/arg"; candidate banks are the intersection
+    // over all CUs of the kernel since buffers are shared by all CUs
+    std::map<std::string, xrt::placement::arg_usage> argMap;
+
+    auto platform = XCL::RTSingleton::Instance()->getcl_platform_id();
+    for (auto device_id : platform->get_device_range()) {
+      std::string deviceName = device_id->get_unique_name();
+      if (!isDeviceActive(deviceName) || !device_id->is_active())
+        continue;
+
+      prof.device_msec = std::max(prof.device_msec, getTotalKernelExecutionTime(deviceName));
+
+      for (auto& cu : xocl::xocl(device_id)->get_cus()) {
+        xrt::placement::cu_usage cuUsage;
+        cuUsage.kernel = cu->get_kernel_name();
+        cuUsage.cu = cu->get_name();
+        cuUsage.calls = PerfCounters.getComputeUnitCalls(deviceName, cuUsage.cu);
+        // NOTE: total time defaults to device time for unused CUs
+        if (cuUsage.calls > 0)
+          cuUsage.busy_msec = PerfCounters.getComputeUnitTotalTime(deviceName, cuUsage.cu);
+        prof.cus.push_back(cuUsage);
+
+        // Number of arguments sharing each port
+        auto symbol = cu->get_symbol();
+        std::map<std::string, uint32_t> portArgs;
+        for (auto& arg : symbol->arguments) {
+          if (arg.address_qualifier != 1 || arg.atype != xocl::xclbin::symbol::arg::argtype::indexed)
+            continue;
+          auto portName = arg.port;
+          std::transform(portName.begin(), portName.end(), portName.begin(), ::tolower);
+          portArgs[portName]++;
+        }
+
+        for (auto& arg : symbol->arguments) {
+          if (arg.address_qualifier != 1 || arg.atype != xocl::xclbin::symbol::arg::argtype::indexed)
+            continue;
+
+          std::vector<std::string> banks;
+          try {
+            auto memidx_mask = cu->get_memidx(std::stoi(arg.id));
+            for (unsigned int memidx=0; memidx<memidx_mask.size(); ++memidx) {
+              if (memidx_mask.test(memidx))
+                banks.push_back(device_id->get_xclbin().memidx_to_banktag(memidx));
+            }
+          }
+          catch (const std::exception&) {
+            continue;
+          }
+
+          auto portName = arg.port;
+          std::transform(portName.begin(), portName.end(), portName.begin(), ::tolower);
+          std::string cuPortName = cuUsage.cu + "/" + portName;
+          std::transform(cuPortName.begin(), cuPortName.end(), cuPortName.begin(), ::tolower);
+          auto itr = portBytes.find(cuPortName);
+          uint64_t bytes = (itr == portBytes.end()) ? 0 : itr->second / portArgs[portName];
+
+          std::string argKey = cuUsage.kernel + "/" + arg.name;
+          auto argItr = argMap.find(argKey);
+          if (argItr == argMap.end()) {
+            auto& argUsage = argMap[argKey];
+            argUsage.kernel = cuUsage.kernel;
+            argUsage.arg = arg.name;
+            argUsage.banks = banks;
+            argUsage.bytes = bytes;
+            continue;
+          }
+
+          auto& argUsage = argItr->second;
+          argUsage.bytes += bytes;
+          auto& candidates = argUsage.banks;
+          candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+              [&banks](const std::string& bank) {
+                return std::find(banks.begin(), banks.end(), bank) == banks.end();
+              }), candidates.end());
+        }
+      }
+    }
+
+    for (auto& arg : argMap)
+      prof.args.push_back(arg.second);
+    prof.bank_bytes = BankTransferBytesMap;
+  }
+
+  void RTProfile::writePlacementPlan(const std::string& fileName) const
+  {
+    if (!this->isApplicationProfileOn())
+      return;
+
+    xrt::placement::profile prof;
+    getPlacementProfile(prof);
+    auto plan = xrt::placement::advise(prof);
+
+    std::ofstream ofs(fileName);
+    if (!ofs.is_open()) {
+      xrt::message::send(xrt::message::severity_level::WARNING,
+          "Unable to write placement plan " + fileName);
+      return;
+    }
+    xrt::placement::write(plan, ofs);
+  }
+
   void RTProfile::writeProfileSummary() {
     if(!this->isApplicationProfileOn())
       return;
 
+    if (FunctionSampleRate > 1)
+      logSampledOutFunctionCalls();
+
     for (auto w : Writers) {
       w->writeSummary(this);
     }
   }
 
+  void RTProfile::writeProfileSummaryCheckpoint(const std::string& fileName) {
+    if(!this->isApplicationProfileOn())
+      return;
+
+    if (FunctionSampleRate > 1)
+      logSampledOutFunctionCalls();
+
+    // Write to temporary file first so readers never see a partial summary
+    // NOTE: CSV writer appends the file extension
+    std::string tempName = fileName + ".tmp";
+    try {
+      std::lock_guard<std::mutex> lock(LogMutex);
+      CSVWriter writer(tempName, "", "Xilinx");
+      writer.writeSummary(this);
+    }
+    catch (const std::exception& ex) {
+      xrt::message::send(xrt::message::severity_level::WARNING,
+          std::string("Unable to write profile summary checkpoint: ") + ex.what());
+      return;
+    }
+    std::rename((tempName + ".csv").c_str(), (fileName + ".csv").c_str());
+  }
+
+  void RTProfile::startProfileCheckpoints(const std::string& fileName,
+      unsigned int intervalSec, bool dumpOnSignal) {
+    if (Checkpoint != nullptr || (intervalSec == 0 && !dumpOnSignal))
+      return;
+
+    Checkpoint = new ProfileCheckpoint(this, fileName, intervalSec, dumpOnSignal);
+    Checkpoint->start();
+  }
+
+  void RTProfile::stopProfileCheckpoints() {
+    if (Checkpoint == nullptr)
+      return;
+
+    Checkpoint->stop();
+    delete Checkpoint;
+    Checkpoint = nullptr;
+  }
+
+  void RTProfile::startProfileChannel(const std::string& session) {
+    if (Channel != nullptr || session.empty())
+      return;
+
+    try {
+      Channel = new ProfileChannel(session);
+      XDP_LOG("startProfileChannel: publishing to %s\n", Channel->getName().c_str());
+    }
+    catch (const std::exception& ex) {
+      xrt::message::send(xrt::message::severity_level::WARNING,
+          std::string("Unable to open profile session: ") + ex.what());
+    }
+  }
+
+  void RTProfile::stopProfileChannel() {
+    std::lock_guard<std::mutex> lock(LogMutex);
+    delete Channel;
+    Channel = nullptr;
+  }
+
   // Add to the active devices.
   // Called thru device::load_program in xocl/core/device.cpp
   void RTProfile::addToActiveDevices(const std::string& deviceName)
@@ -1511,6 +1886,12 @@ else if (functionName.find("clEnqueueMigrateMemObjects") != std::string::npos)
 
     ActiveDevices.insert(deviceName);
 
+    // Reference point for device timestamps of this process
+    if (Channel != nullptr) {
+      std::string name = deviceName;
+      Channel->calibrateDevice(XCL::RTSingleton::Instance()->getDeviceTimestamp(name));
+    }
+
     // Store arguments and banks for each CU and its ports
     setArgumentsBank(deviceName);
   }
@@ -1743,6 +2124,12 @@ else if (functionName.find("clEnqueueMigrateMemObjects") != std::string::npos)
     return PerfCounters.getComputeUnitCalls(deviceName, cuName);
   }
 
+  double RTProfile::getLatencyPercentile(PerformanceCounter::e_latency_kind kind,
+      const std::string& name, double percentile) {
+    std::lock_guard<std::mutex> lock(LogMutex);
+    return PerfCounters.getLatencyPercentile(kind, name, percentile);
+  }
+
   void RTProfile::getKernelFromComputeUnit(const std::string& cuName, std::string& kernelName) const {
     auto iter = ComputeUnitKernelNameMap.find(cuName);
     if (iter != ComputeUnitKernelNameMap.end())
@@ -22,6 +22,7 @@
 #include "rt_profile_results.h"
 #include "rt_profile_xocl.h"
 #include "xrt/util/time.h"
+#include "xrt/util/placement.h"
 //#include <chrono>
 //#include <time.h>
 
@@ -35,6 +36,9 @@
 #include <thread>
 #include <mutex>
 #include <queue>
+#include <deque>
+#include <array>
+#include <atomic>
 
 // Separator used for CU port and memory resource (must match HW linker)
 #define PORT_MEM_SEP ":"
@@ -46,6 +50,8 @@ namespace XCL {
   class BufferTrace;
   class DeviceTrace;
   class ProfileRuleChecks;
+  class ProfileCheckpoint;
+  class ProfileChannel;
 
   // **************************************************************************
   // Top-level profile class
@@ -127,6 +133,8 @@ namespace XCL {
 
     void setTransferTrace(const std::string traceStr);
     void setStallTrace(const std::string traceStr);
+    void setFunctionSampleRate(unsigned int sampleRate) { FunctionSampleRate = (sampleRate > 0) ? sampleRate : 1; }
+    unsigned int getFunctionSampleRate() const { return FunctionSampleRate; }
     e_device_trace getTransferTrace() {return DeviceTraceOption;}
     e_stall_trace getStallTrace() {return StallTraceOption;}
 
@@ -181,6 +189,14 @@ namespace XCL {
 
   public:
     void writeProfileSummary();
+    // Write summary of run so far (thread safe; file is replaced atomically)
+    void writeProfileSummaryCheckpoint(const std::string& fileName);
+    void startProfileCheckpoints(const std::string& fileName, unsigned int intervalSec,
+                                 bool dumpOnSignal);
+    void stopProfileCheckpoints();
+    // Publish CU and transfer records to cross-process session (see xprofcollect)
+    void startProfileChannel(const std::string& session);
+    void stopProfileChannel();
 
     // Summaries of counts
     void writeAPISummary(WriterI* writer) const;
@@ -191,6 +207,7 @@ namespace XCL {
     void writeHostTransferSummary(WriterI* writer) const;
     void writeKernelTransferSummary(WriterI* writer) const;
     void writeDeviceTransferSummary(WriterI* writer) const;
+    void writeLatencySummary(WriterI* writer) const;
     // Top offenders lists
     void writeTopKernelSummary(WriterI* writer) const;
     void writeTopKernelTransferSummary(WriterI* writer) const;
@@ -199,6 +216,9 @@ namespace XCL {
     // Profile Rule Checks
     void getProfileRuleCheckSummary();
     void writeProfileRuleCheckSummary(WriterI* writer);
+    // Placement advice for next run
+    void getPlacementProfile(xrt::placement::profile& prof) const;
+    void writePlacementPlan(const std::string& fileName) const;
     // Unified summaries
     void writeAcceleratorSummary(WriterI* writer) const;
     void writeTopHardwareSummary(WriterI* writer) const;
@@ -229,6 +249,10 @@ namespace XCL {
     void getKernelFromComputeUnit(const std::string& cuName, std::string& kernelName) const;
     void getTraceStringFromComputeUnit(const std::string& deviceName, const std::string& cuName, std::string& traceString) const;
 
+    // Latency percentiles (in msec) of API calls, kernels, CUs, and transfers
+    double getLatencyPercentile(PerformanceCounter::e_latency_kind kind,
+        const std::string& name, double percentile);
+
   public:
     double getTraceTime();
 
@@ -263,8 +287,12 @@ namespace XCL {
         std::string& stageString) const;
     void setTimeStamp(e_profile_command_state objStage, TimeTrace* traceObject, double timeStamp);
     xclPerfMonEventID getFunctionEventID(const std::string &functionName, long long queueAddress);
+    bool isFunctionCallSampled(const char* functionName);
+    bool isFunctionCallEndSampled();
+    void logSampledOutFunctionCalls();
 
     void setArgumentsBank(const std::string& deviceName);
+    void getKernelPortBytes(std::map<std::string, uint64_t>& portBytes) const;
 
   public:
     void getArgumentsBank(const std::string& deviceName, const std::string& cuName,
@@ -308,15 +336,33 @@ namespace XCL {
     std::map<std::string, std::vector<std::string>> DeviceBinaryStrSlotsMap;
     std::map<uint64_t, KernelTrace*> KernelTraceMap;
     std::map<uint64_t, BufferTrace*> BufferTraceMap;
-    std::map<uint64_t, DeviceTrace*> DeviceTraceMap;
+    // Insertion order of in-flight traces as (ID, sequence) pairs
+    // NOTE: used to drop the oldest ones when their END never arrives
+    std::deque<std::pair<uint64_t, uint64_t>> KernelTraceOrder;
+    std::deque<std::pair<uint64_t, uint64_t>> BufferTraceOrder;
+    uint64_t TraceSequence;
     std::mutex LogMutex;
+    // API call sampling: only 1 in FunctionSampleRate calls of each API is timed
+    // NOTE: lock-free table of call counters keyed on function name pointer
+    // (API names are string literals); slots are never freed
+    struct FunctionCallCounter {
+      std::atomic<const char*> Name;
+      std::atomic<uint64_t> Calls;
+      uint64_t ReportedOut;  // sampled-out calls already folded (under LogMutex)
+    };
+    static const size_t FUNCTION_COUNTER_SLOTS = 512;
+    unsigned int FunctionSampleRate;
+    std::array<FunctionCallCounter, FUNCTION_COUNTER_SLOTS> FunctionCallCounters;
     RTProfileDevice* DeviceProfile;
     ProfileRuleChecks* RuleChecks;
+    ProfileCheckpoint* Checkpoint;
+    ProfileChannel* Channel;
 
   private:
     std::vector<WriterI*> Writers;
     std::set<std::string> ActiveDevices;
     std::map<std::string, int> CUPortsToMemoryMap;
+    std::map<std::string, uint64_t> BankTransferBytesMap;
 
   // Platform data and Device data
   private:
@@ -0,0 +1,283 @@
+/**
+ * Copyright (C) 2018 Xilinx, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "rt_profile_channel.h"
+#include "xrt/util/time.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace XCL {
+  using namespace ProfileChannelLayout;
+
+  static size_t getSegmentSize(uint32_t capacity)
+  {
+    return sizeof(Header) + capacity * sizeof(Record);
+  }
+
+  static uint64_t getMonotonicNsec()
+  {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000UL + (uint64_t) now.tv_nsec;
+  }
+
+  static std::string getProcessName()
+  {
+    char buf[256] = {0};
+    auto len = ::readlink("/proc/self/exe", buf, sizeof(buf) - 1);
+    std::string path(buf, (len > 0) ? len : 0);
+    return path.substr(path.find_last_of("/") + 1);
+  }
+
+  // Offset between trace clock and common clock. Take the tightest of a
+  // few bracketed samples to keep the error in the sub-usec range.
+  static int64_t getClockOffsetNsec()
+  {
+    int64_t offset = 0;
+    uint64_t bestWindow = UINT64_MAX;
+    for (int i = 0; i < 8; ++i) {
+      uint64_t t0 = xrt::time_ns();
+      uint64_t mono = getMonotonicNsec();
+      uint64_t t1 = xrt::time_ns();
+      if (t1 - t0 < bestWindow) {
+        bestWindow = t1 - t0;
+        offset = (int64_t)mono - (int64_t)(t0 + (t1 - t0) / 2);
+      }
+    }
+    return offset;
+  }
+
+  // ***********************
+  // Writer
+  // ***********************
+  ProfileChannel::ProfileChannel(const std::string& session, uint32_t capacity)
+  : mName(getSegmentPrefix(session) + std::to_string(getpid())),
+    mSize(getSegmentSize(capacity)),
+    mHeader(nullptr),
+    mRecords(nullptr)
+  {
+    // Stale segment of an earlier process with same pid
+    shm_unlink(mName.c_str());
+
+    int fd = shm_open(mName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0666);
+    if (fd < 0)
+      throw std::runtime_error("cannot create profile channel " + mName + ": " + strerror(errno));
+
+    if (ftruncate(fd, mSize) != 0) {
+      close(fd);
+      shm_unlink(mName.c_str());
+      throw std::runtime_error("cannot size profile channel " + mName + ": " + strerror(errno));
+    }
+
+    void* addr = mmap(nullptr, mSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+      shm_unlink(mName.c_str());
+      throw std::runtime_error("cannot map profile channel " + mName + ": " + strerror(errno));
+    }
+
+    // Segment is zero filled by ftruncate
+    mHeader = static_cast<Header*>(addr);
+    mRecords = reinterpret_cast<Record*>(mHeader + 1);
+    mHeader->Version = VERSION;
+    mHeader->Pid = getpid();
+    mHeader->Capacity = capacity;
+    mHeader->ClockOffsetNsec = getClockOffsetNsec();
+    strncpy(mHeader->Process, getProcessName().c_str(), sizeof(mHeader->Process) - 1);
+
+    // String 0 is reserved for unknown names
+    mHeader->NumStrings.store(1, std::memory_order_release);
+    mStrings[""] = 0;
+
+    // Publish last, readers ignore segments without magic
+    std::atomic_thread_fence(std::memory_order_release);
+    mHeader->Magic = MAGIC;
+  }
+
+  // NOTE: segment is not unlinked, the collector reads it after exit
+  ProfileChannel::~ProfileChannel()
+  {
+    if (mHeader != nullptr)
+      munmap(mHeader, mSize);
+  }
+
+  void ProfileChannel::calibrateDevice(uint64_t deviceTimestamp)
+  {
+    if (deviceTimestamp == 0 || mHeader->DeviceTimestamp != 0)
+      return;
+    mHeader->DeviceHostNsec = xrt::time_ns() + mHeader->ClockOffsetNsec;
+    mHeader->DeviceTimestamp = deviceTimestamp;
+  }
+
+  uint32_t ProfileChannel::getStringIndex(const std::string& str)
+  {
+    auto itr = mStrings.find(str);
+    if (itr != mStrings.end())
+      return itr->second;
+
+    uint32_t index = mHeader->NumStrings.load(std::memory_order_relaxed);
+    if (index >= MAX_STRINGS)
+      return 0;
+
+    strncpy(mHeader->Strings[index], str.c_str(), MAX_STRING_LENGTH - 1);
+    mHeader->NumStrings.store(index + 1, std::memory_order_release);
+    mStrings[str] = index;
+    return index;
+  }
+
+  uint64_t ProfileChannel::toCommonNsec(double traceMsec) const
+  {
+    return (uint64_t)(traceMsec * 1.0e6) + mHeader->ClockOffsetNsec;
+  }
+
+  void ProfileChannel::push(const Record& record)
+  {
+    uint64_t head = mHeader->Head.load(std::memory_order_relaxed);
+    mRecords[head % mHeader->Capacity] = record;
+    mHeader->Head.store(head + 1, std::memory_order_release);
+  }
+
+  void ProfileChannel::logComputeUnit(bool isStart, const std::string& deviceName,
+      const std::string& cuName, double timeMsec)
+  {
+    Record record;
+    record.StartNsec = record.EndNsec = toCommonNsec(timeMsec);
+    record.Bytes = 0;
+    record.Name = getStringIndex(cuName);
+    record.Device = getStringIndex(deviceName);
+    record.Kind = isStart ? CU_START : CU_END;
+    push(record);
+  }
+
+  void ProfileChannel::logDataTransfer(bool isRead, const std::string& deviceName,
+      const std::string& bank, double startMsec, double endMsec, uint64_t bytes)
+  {
+    Record record;
+    record.StartNsec = toCommonNsec(startMsec);
+    record.EndNsec = toCommonNsec(endMsec);
+    record.Bytes = bytes;
+    record.Name = getStringIndex(bank);
+    record.Device = getStringIndex(deviceName);
+    record.Kind = isRead ? READ_BUFFER : WRITE_BUFFER;
+    push(record);
+  }
+
+  // ***********************
+  // Reader
+  // ***********************
+  ProfileChannelReader::ProfileChannelReader(const std::string& name)
+  : mName(name),
+    mSize(0),
+    mHeader(nullptr),
+    mRecords(nullptr),
+    mTail(0)
+  {
+    int fd = shm_open(mName.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+      throw std::runtime_error("cannot open profile channel " + mName + ": " + strerror(errno));
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Header)) {
+      close(fd);
+      throw std::runtime_error("bad profile channel " + mName);
+    }
+
+    mSize = st.st_size;
+    void* addr = mmap(nullptr, mSize, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+      throw std::runtime_error("cannot map profile channel " + mName + ": " + strerror(errno));
+
+    mHeader = static_cast<const Header*>(addr);
+    mRecords = reinterpret_cast<const Record*>(mHeader + 1);
+    if (mHeader->Magic != MAGIC || mHeader->Version != VERSION
+        || mSize < getSegmentSize(mHeader->Capacity)) {
+      munmap(const_cast<Header*>(mHeader), mSize);
+      throw std::runtime_error("bad profile channel " + mName);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+  }
+
+  ProfileChannelReader::~ProfileChannelReader()
+  {
+    munmap(const_cast<Header*>(mHeader), mSize);
+  }
+
+  uint64_t ProfileChannelReader::read(std::vector<Record>& records)
+  {
+    uint64_t capacity = mHeader->Capacity;
+    uint64_t head = mHeader->Head.load(std::memory_order_acquire);
+    uint64_t lost = 0;
+    if (head - mTail > capacity) {
+      lost = head - capacity - mTail;
+      mTail = head - capacity;
+    }
+
+    auto first = records.size();
+    for (uint64_t i = mTail; i < head; ++i)
+      records.push_back(mRecords[i % capacity]);
+
+    // Drop records the writer may have overwritten while copying
+    uint64_t after = mHeader->Head.load(std::memory_order_acquire);
+    if (after - mTail > capacity) {
+      uint64_t stale = std::min(after - capacity - mTail, head - mTail);
+      records.erase(records.begin() + first, records.begin() + first + stale);
+      lost += stale;
+    }
+
+    mTail = head;
+    return lost;
+  }
+
+  std::string ProfileChannelReader::getString(uint32_t index) const
+  {
+    if (index >= mHeader->NumStrings.load(std::memory_order_acquire))
+      return "";
+    const char* str = mHeader->Strings[index];
+    return std::string(str, strnlen(str, MAX_STRING_LENGTH));
+  }
+
+  std::vector<std::string> ProfileChannelReader::list(const std::string& session)
+  {
+    // POSIX shared memory objects live in /dev/shm on Linux
+    std::vector<std::string> names;
+    std::string prefix = getSegmentPrefix(session).substr(1);
+    DIR* dir = opendir("/dev/shm");
+    if (dir == nullptr)
+      return names;
+
+    while (struct dirent* entry = readdir(dir)) {
+      // Segment names end with the writer pid
+      std::string name(entry->d_name);
+      if (name.size() > prefix.size() && name.compare(0, prefix.size(), prefix) == 0
+          && name.find_first_not_of("0123456789", prefix.size()) == std::string::npos)
+        names.push_back("/" + name);
+    }
+    closedir(dir);
+    std::sort(names.begin(), names.end());
+    return names;
+  }
+
+};
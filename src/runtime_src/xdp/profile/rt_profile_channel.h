@@ -0,0 +1,139 @@
+/**
+ * Copyright (C) 2018 Xilinx, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef __XILINX_RT_PROFILE_CHANNEL_H
+#define __XILINX_RT_PROFILE_CHANNEL_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// Shared memory trace channel used to correlate profiles of several
+// processes sharing a device (see Debug.profile_session).
+//
+// Each process owns one segment /xrt_profile_<session>_<pid> holding a
+// header, a string table and a ring of fixed size records.  The owning
+// process is the only writer.  Times are in nsec on a clock common to
+// all processes (CLOCK_MONOTONIC); each process calibrates the offset
+// of its own trace clock (xrt::time_ns) once when the channel opens.
+//
+// NOTE: this file does not depend on the rest of the runtime so that
+//       the collector (xprofcollect) can build it standalone.
+
+namespace XCL {
+
+  namespace ProfileChannelLayout {
+    const uint32_t MAGIC = 0x46525058;   // "XPRF"
+    const uint32_t VERSION = 1;
+    const uint32_t MAX_STRINGS = 1024;
+    const uint32_t MAX_STRING_LENGTH = 64;
+    const uint32_t DEFAULT_CAPACITY = 65536;
+
+    enum e_record_kind {
+      CU_START = 1,
+      CU_END,
+      READ_BUFFER,
+      WRITE_BUFFER
+    };
+
+    // 32 bytes per record
+    struct Record {
+      uint64_t StartNsec;
+      uint64_t EndNsec;
+      uint64_t Bytes;
+      uint32_t Name;     // string index: CU name or memory bank
+      uint16_t Device;   // string index: device name
+      uint16_t Kind;
+    };
+
+    struct Header {
+      uint32_t Magic;
+      uint32_t Version;
+      uint32_t Pid;
+      uint32_t Capacity;
+      int64_t  ClockOffsetNsec;   // common clock = trace clock + offset
+      uint64_t DeviceHostNsec;    // device timestamp calibration pair,
+      uint64_t DeviceTimestamp;   // zero if device has no timestamp
+      char     Process[256];
+      std::atomic<uint32_t> NumStrings;
+      uint32_t Reserved;
+      std::atomic<uint64_t> Head; // total records ever written
+      char     Strings[MAX_STRINGS][MAX_STRING_LENGTH];
+    };
+
+    inline std::string getSegmentPrefix(const std::string& session) {
+      return "/xrt_profile_" + session + "_";
+    }
+  }
+
+  // Writer side, owned by RTProfile (calls are serialized by LogMutex)
+  class ProfileChannel {
+  public:
+    ProfileChannel(const std::string& session, uint32_t capacity = ProfileChannelLayout::DEFAULT_CAPACITY);
+    ~ProfileChannel();
+
+  public:
+    // Record device timestamp (as returned by xclGetDeviceTimestamp) for reference
+    void calibrateDevice(uint64_t deviceTimestamp);
+    void logComputeUnit(bool isStart, const std::string& deviceName,
+        const std::string& cuName, double timeMsec);
+    void logDataTransfer(bool isRead, const std::string& deviceName,
+        const std::string& bank, double startMsec, double endMsec, uint64_t bytes);
+    const std::string& getName() const {return mName;}
+
+  private:
+    uint32_t getStringIndex(const std::string& str);
+    uint64_t toCommonNsec(double traceMsec) const;
+    void push(const ProfileChannelLayout::Record& record);
+
+  private:
+    std::string mName;
+    size_t mSize;
+    ProfileChannelLayout::Header* mHeader;
+    ProfileChannelLayout::Record* mRecords;
+    std::unordered_map<std::string, uint32_t> mStrings;
+  };
+
+  // Reader side, used by the collector
+  class ProfileChannelReader {
+  public:
+    explicit ProfileChannelReader(const std::string& name);
+    ~ProfileChannelReader();
+
+  public:
+    // Append records written since last read, returns number of records lost
+    // because the writer wrapped around the ring
+    uint64_t read(std::vector<ProfileChannelLayout::Record>& records);
+    std::string getString(uint32_t index) const;
+    uint32_t getPid() const {return mHeader->Pid;}
+    std::string getProcess() const {return mHeader->Process;}
+    const std::string& getName() const {return mName;}
+
+    // Names of all segments of a session
+    static std::vector<std::string> list(const std::string& session);
+
+  private:
+    std::string mName;
+    size_t mSize;
+    const ProfileChannelLayout::Header* mHeader;
+    const ProfileChannelLayout::Record* mRecords;
+    uint64_t mTail;
+  };
+
+};
+#endif
@@ -0,0 +1,129 @@
+/**
+ * Copyright (C) 2018 Xilinx, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "rt_profile_checkpoint.h"
+#include "rt_profile.h"
+#include "debug.h"
+
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace XCL {
+  // Self-pipe used to wake up the checkpoint thread
+  // NOTE: index 0 is read by the thread, index 1 is written by the
+  //       signal handler (only async-signal-safe calls are allowed there)
+  static int gCheckpointPipe[2] = {-1, -1};
+
+  // Wake-up reasons written to the pipe
+  static const char CHECKPOINT_DUMP = 'd';
+  static const char CHECKPOINT_STOP = 's';
+
+  ProfileCheckpoint::ProfileCheckpoint(RTProfile* profile, const std::string& fileName,
+                                       unsigned int intervalSec, bool dumpOnSignal)
+  : mProfile(profile),
+    mFileName(fileName),
+    mIntervalSec(intervalSec),
+    mDumpOnSignal(dumpOnSignal),
+    mRunning(false)
+  {
+  }
+
+  ProfileCheckpoint::~ProfileCheckpoint()
+  {
+    stop();
+  }
+
+  void ProfileCheckpoint::signalHandler(int signum)
+  {
+    int saved_errno = errno;
+    if (gCheckpointPipe[1] != -1) {
+      ssize_t ret = ::write(gCheckpointPipe[1], &CHECKPOINT_DUMP, 1);
+      (void)ret;
+    }
+    errno = saved_errno;
+  }
+
+  void ProfileCheckpoint::start()
+  {
+    if (mRunning || (mIntervalSec == 0 && !mDumpOnSignal))
+      return;
+
+    if (::pipe(gCheckpointPipe) != 0)
+      return;
+    ::fcntl(gCheckpointPipe[1], F_SETFL, O_NONBLOCK);
+
+    if (mDumpOnSignal) {
+      struct sigaction action = {};
+      action.sa_handler = &ProfileCheckpoint::signalHandler;
+      sigemptyset(&action.sa_mask);
+      action.sa_flags = SA_RESTART;
+      sigaction(SIGUSR1, &action, &mOldAction);
+    }
+
+    mRunning = true;
+    mThread = std::thread(&ProfileCheckpoint::run, this);
+  }
+
+  void ProfileCheckpoint::stop()
+  {
+    if (!mRunning)
+      return;
+
+    if (mDumpOnSignal)
+      sigaction(SIGUSR1, &mOldAction, nullptr);
+
+    ssize_t ret = ::write(gCheckpointPipe[1], &CHECKPOINT_STOP, 1);
+    (void)ret;
+    mThread.join();
+    mRunning = false;
+
+    ::close(gCheckpointPipe[0]);
+    ::close(gCheckpointPipe[1]);
+    gCheckpointPipe[0] = gCheckpointPipe[1] = -1;
+  }
+
+  void ProfileCheckpoint::run()
+  {
+    struct pollfd pfd = {gCheckpointPipe[0], POLLIN, 0};
+    int timeoutMsec = (mIntervalSec > 0) ? static_cast<int>(mIntervalSec * 1000) : -1;
+
+    while (true) {
+      int ret = ::poll(&pfd, 1, timeoutMsec);
+      if (ret < 0) {
+        if (errno == EINTR)
+          continue;
+        return;
+      }
+
+      // Drain pending requests; stop has priority
+      if (ret > 0) {
+        char buf[16];
+        ssize_t len = ::read(gCheckpointPipe[0], buf, sizeof(buf));
+        for (ssize_t i=0; i < len; ++i) {
+          if (buf[i] == CHECKPOINT_STOP)
+            return;
+        }
+      }
+
+      XDP_LOG("ProfileCheckpoint: writing %s\n", mFileName.c_str());
+      mProfile->writeProfileSummaryCheckpoint(mFileName);
+    }
+  }
+
+} // XCL
@@ -0,0 +1,57 @@
+/**
+ * Copyright (C) 2018 Xilinx, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef __XILINX_RT_PROFILE_CHECKPOINT_H
+#define __XILINX_RT_PROFILE_CHECKPOINT_H
+
+#include <csignal>
+#include <string>
+#include <thread>
+
+// Use this class to periodically write the profile summary of a
+// running application to disk, and to write it on demand when the
+// process receives SIGUSR1.
+
+namespace XCL {
+  class RTProfile;
+
+  class ProfileCheckpoint {
+  public:
+    ProfileCheckpoint(RTProfile* profile, const std::string& fileName,
+                      unsigned int intervalSec, bool dumpOnSignal);
+    ~ProfileCheckpoint();
+
+  public:
+    void start();
+    void stop();
+
+  private:
+    void run();
+    static void signalHandler(int signum);
+
+  private:
+    RTProfile* mProfile;
+    std::string mFileName;
+    unsigned int mIntervalSec;
+    bool mDumpOnSignal;
+    bool mRunning;
+    std::thread mThread;
+    // SIGUSR1 action of the application, restored by stop()
+    struct sigaction mOldAction;
+  };
+
+};
+#endif
@@ -21,6 +21,7 @@
 #include <chrono>
 #include <iomanip>
 #include <algorithm>
+#include <cmath>
 #include <time.h>
 // #include <unistd.h>
 #include "rt_profile_results.h"
@@ -34,6 +35,62 @@ XCL::DeviceTrace* XCL::DeviceTrace::RecycleHead = nullptr;
 
 namespace XCL {
 
+  //
+  // LatencyHistogram
+  //
+
+  void LatencyHistogram::merge(const LatencyHistogram& other)
+  {
+    if (other.Counts.empty())
+      return;
+    if (Counts.empty())
+      Counts.resize(BucketCount, 0);
+    for (unsigned int i=0; i < BucketCount; ++i)
+      Counts[i] += other.Counts[i];
+    Count += other.Count;
+    if (other.MaxMsec > MaxMsec)
+      MaxMsec = other.MaxMsec;
+  }
+
+  void LatencyHistogram::reset()
+  {
+    // Release the buckets too
+    std::vector<uint64_t>().swap(Counts);
+    Count = 0;
+    MaxMsec = 0.0;
+  }
+
+  uint64_t LatencyHistogram::getBucketMidpointNsec(unsigned int index)
+  {
+    if (index < SubBucketCount)
+      return index;
+    unsigned int shift = (index >> SubBucketBits) - 1;
+    uint64_t subBucket = (index & (SubBucketCount - 1)) + SubBucketCount;
+    uint64_t lower = subBucket << shift;
+    return lower + ((1ULL << shift) >> 1);
+  }
+
+  double LatencyHistogram::getPercentile(double percentile) const
+  {
+    if (Count == 0)
+      return 0.0;
+    if (percentile > 100.0)
+      percentile = 100.0;
+
+    // Rank of the requested sample (1-based)
+    uint64_t rank = static_cast<uint64_t>(std::ceil((percentile / 100.0) * Count));
+    if (rank == 0)
+      rank = 1;
+
+    uint64_t total = 0;
+    for (unsigned int i=0; i < BucketCount; ++i) {
+      total += Counts[i];
+      if (total >= rank)
+        return getBucketMidpointNsec(i) / 1.0e6;
+    }
+    return getBucketMidpointNsec(BucketCount - 1) / 1.0e6;
+  }
+
   //
   // BufferStats
   //
@@ -47,6 +104,7 @@ namespace XCL {
     // size is in bytes, divide that 1000 to get KB and then divide
     // by ms duration to get MB/s
     double transferRate = (size / (1000.0 * duration));
+    Latency.record(duration);
     AveTransferRate = (AveTransferRate * Count + transferRate) / (Count + 1);
     Count++;
     if (Max < size)
@@ -77,6 +135,7 @@ namespace XCL {
     TotalTime += time;
     AveTime = (AveTime * NoOfCalls + time) / (NoOfCalls + 1);
     NoOfCalls++;
+    Latency.record(time);
     if (MaxTime < time)
       MaxTime = time;
     if (MinTime > time)
@@ -36,6 +36,66 @@
 namespace XCL {
   class WriterI;
 
+  // Class to record a latency distribution in a fixed amount of memory
+  // Log-linear (HDR-style) buckets: values below 2^SubBucketBits ns are
+  // recorded exactly, above that each power of two is split into
+  // 2^SubBucketBits linear sub-buckets (~3% relative error).
+  // Histograms with the same layout can be merged by adding counts.
+  // Buckets (~9 KB) are allocated on first record or merge, so stats
+  // that never see a sample stay small.
+  // All recorded and reported times are in ms
+  class LatencyHistogram {
+  public:
+    static const unsigned int SubBucketBits = 5;
+    static const unsigned int SubBucketCount = 1 << SubBucketBits;
+    // Largest tracked value is 2^MaxValueBits ns (~18 minutes)
+    static const unsigned int MaxValueBits = 40;
+    static const unsigned int BucketCount = (MaxValueBits - SubBucketBits + 1) * SubBucketCount;
+
+  public:
+    LatencyHistogram()
+      : Count( 0 ),
+        MaxMsec( 0.0 )
+      {};
+    ~LatencyHistogram() {};
+  public:
+    inline void record(double durationMsec) {
+      uint64_t valueNsec = (durationMsec > 0.0) ? static_cast<uint64_t>(durationMsec * 1.0e6) : 0;
+      if (Counts.empty())
+        Counts.resize(BucketCount, 0);
+      Counts[getBucketIndex(valueNsec)]++;
+      Count++;
+      if (durationMsec > MaxMsec)
+        MaxMsec = durationMsec;
+    }
+    void merge(const LatencyHistogram& other);
+    void reset();
+    // Percentile is in range [0, 100]; returns 0 if nothing was recorded
+    double getPercentile(double percentile) const;
+    inline uint64_t getCount() const { return Count; }
+    // Exact maximum, unlike the 100th percentile which is a bucket midpoint
+    inline double getMax() const { return MaxMsec; }
+
+  private:
+    static inline unsigned int getBucketIndex(uint64_t valueNsec) {
+      if (valueNsec < SubBucketCount)
+        return static_cast<unsigned int>(valueNsec);
+      if (valueNsec >= (1ULL << MaxValueBits))
+        return BucketCount - 1;
+      unsigned int msb = 63 - __builtin_clzll(valueNsec);
+      unsigned int shift = msb - SubBucketBits;
+      unsigned int subBucket = static_cast<unsigned int>(valueNsec >> shift) - SubBucketCount;
+      return ((shift + 1) << SubBucketBits) + subBucket;
+    }
+    static uint64_t getBucketMidpointNsec(unsigned int index);
+
+  private:
+    uint64_t Count;
+    double MaxMsec;
+    // Empty until the first sample
+    std::vector<uint64_t> Counts;
+  };
+
   // Class to record stats on buffer read and writes
   // All sizes are in bytes and times are in ms
   class BufferStats {
@@ -86,6 +146,7 @@ namespace XCL {
     inline void setBitWidth(uint32_t bitWidth) { BitWidth = bitWidth; }
     inline void setClockFreqMhz(double clockFreqMhz) { ClockFreqMhz = clockFreqMhz; }
     inline void setDeviceName(std::string& deviceName) { DeviceName = deviceName; }
+    inline const LatencyHistogram& getLatency() const { return Latency; }
 
   private:
     size_t Count;
@@ -102,6 +163,7 @@ namespace XCL {
     double AveTransferRate;
     double ClockFreqMhz;
     std::string DeviceName;
+    LatencyHistogram Latency;
   };
 
   // Class to record stats on time such as time spent in an API call
@@ -117,6 +179,7 @@ namespace XCL {
         MaxTime( 0 ),
         MinTime( (std::numeric_limits<double>::max)() ),
         NoOfCalls( 0 ),
+        NoOfSampledOutCalls( 0 ),
         ClockFreqMhz( 300 )
       {};
     ~TimeStats() {};
@@ -125,12 +188,21 @@ namespace XCL {
     void logEnd(double timePoint);
     void logStats(double totalTimeStat, double maxTimeStat, 
                   double minTimeStat, uint32_t totalCalls, uint32_t clockFreqMhz);
-    inline double getTotalTime() const { return TotalTime; }
+    // Calls that were counted but not timed (see Debug.profile_sample_rate)
+    inline void logSampledOutCalls(uint32_t numCalls) { NoOfSampledOutCalls += numCalls; }
+    // NOTE: when calls were sampled out, total time is scaled up from the timed calls
+    inline double getTotalTime() const {
+      if (NoOfSampledOutCalls == 0 || NoOfCalls == 0)
+        return TotalTime;
+      return TotalTime * (NoOfCalls + NoOfSampledOutCalls) / NoOfCalls;
+    }
     inline double getAveTime() const {return AveTime; }
     inline double getMaxTime() const {return MaxTime; }
     inline double getMinTime() const {return MinTime; }
-    inline uint32_t getNoOfCalls() const {return NoOfCalls; }
+    inline uint32_t getNoOfCalls() const {return NoOfCalls + NoOfSampledOutCalls; }
+    inline uint32_t getNoOfSampledCalls() const {return NoOfCalls; }
     inline uint32_t getClockFreqMhz() const { return ClockFreqMhz; }
+    inline const LatencyHistogram& getLatency() const { return Latency; }
   private:
     double TotalTime;
     double StartTime;
@@ -139,7 +211,9 @@ namespace XCL {
     double MaxTime;
     double MinTime;
     uint32_t NoOfCalls;
+    uint32_t NoOfSampledOutCalls;
     uint32_t ClockFreqMhz;
+    LatencyHistogram Latency;
   };
 
   // Class to store time trace of kernel execution, buffer read, or buffer write
@@ -154,6 +228,7 @@ namespace XCL {
       , Start( 0.0 )
       , End( 0.0 )
       , Complete( 0.0 )
+      , Sequence( 0 )
       {}
     ~TimeTrace() {};
   public:
@@ -189,6 +264,8 @@ namespace XCL {
     double End;
     double Complete;
 
+    // Insertion order while waiting for completion (see RTProfile)
+    uint64_t Sequence;
   };
 
   class KernelTrace : public TimeTrace {
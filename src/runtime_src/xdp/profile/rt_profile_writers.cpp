@@ -217,6 +217,15 @@ namespace XCL {
       profile->writeTopKernelTransferSummary(this);
     }
     writeTableFooter(getSummaryStream());
+
+    // Table 8: Latency Percentiles
+    std::vector<std::string> LatencyColumnLabels = {
+        "Category", "Name", "Number Of Samples", "Median Time (ms)",
+        "99th Percentile Time (ms)", "99.9th Percentile Time (ms)", "Maximum Time (ms)"
+    };
+    writeTableHeader(getSummaryStream(), "Latency Percentiles", LatencyColumnLabels);
+    profile->writeLatencySummary(this);
+    writeTableFooter(getSummaryStream());
   }
 
   // Tables 1 and 2: API Call and Kernel Execution Summary: Name, Number Of Calls,
@@ -489,6 +498,22 @@ namespace XCL {
     writeTableRowEnd(getSummaryStream());
   }
 
+  // Table 8: Latency Percentiles
+  // Category, Name, Number Of Samples, Median Time (ms), 99th Percentile Time (ms),
+  // 99.9th Percentile Time (ms), Maximum Time (ms)
+  void WriterI::writeLatencySummary(const std::string& category, const std::string& name,
+      const LatencyHistogram& latency)
+  {
+    if (latency.getCount() == 0)
+      return;
+
+    writeTableRowStart(getSummaryStream());
+    writeTableCells(getSummaryStream(), category, name, latency.getCount(),
+        latency.getPercentile(50.0), latency.getPercentile(99.0),
+        latency.getPercentile(99.9), latency.getMax());
+    writeTableRowEnd(getSummaryStream());
+  }
+
   void WriterI::writeSummary(const std::string& name,
       const BufferStats& stats)
   {
@@ -1446,7 +1471,16 @@ namespace XCL {
     profile->writeTopDataTransferSummary(this, true); // Reads
     writeTableFooter(getSummaryStream());
 
-    // Table 10: Parameters used in PRCs
+    // Table 10: Latency Percentiles
+    std::vector<std::string> LatencyColumnLabels = {
+        "Category", "Name", "Number Of Samples", "Median Time (ms)",
+        "99th Percentile Time (ms)", "99.9th Percentile Time (ms)", "Maximum Time (ms)"
+    };
+    writeTableHeader(getSummaryStream(), "Latency Percentiles", LatencyColumnLabels);
+    profile->writeLatencySummary(this);
+    writeTableFooter(getSummaryStream());
+
+    // Table 11: Parameters used in PRCs
     std::vector<std::string> PRCParameterColumnLabels = {
       "Parameter", "Element", "Value"
     };
@@ -70,6 +70,9 @@ namespace XCL {
 	    virtual void writeComputeUnitSummary(const std::string& name, const TimeStats& stats);
 	    // Write accelerator table
 	    virtual void writeAcceleratorSummary(const std::string& name, const TimeStats& stats);
+	    // Write latency percentiles table
+	    virtual void writeLatencySummary(const std::string& category, const std::string& name,
+	        const LatencyHistogram& latency);
 
 	    // Write Read/Write Buffer transfer stats
       virtual void writeHostTransferSummary(const std::string& name,
@@ -116,6 +116,7 @@ namespace XCL {
     std::string stall_trace = xrt::config::get_stall_trace();
     ProfileMgr->setTransferTrace(data_transfer_trace);
     ProfileMgr->setStallTrace(stall_trace);
+    ProfileMgr->setFunctionSampleRate(xrt::config::get_profile_sample_rate());
 
     turnOnProfile(RTProfile::PROFILE_DEVICE_COUNTERS);
     // HW trace is controlled at HAL layer
@@ -167,14 +168,29 @@ namespace XCL {
     // Add functions to callback for profiling kernel/CU scheduling
     xocl::add_command_start_callback(xdp::profile::get_cu_start);
     xocl::add_command_done_callback(xdp::profile::get_cu_done);
+
+    // Checkpoints of summary for long runs (periodic and/or on SIGUSR1)
+    ProfileMgr->startProfileCheckpoints("sdaccel_profile_summary_checkpoint",
+        xrt::config::get_profile_checkpoint_interval(),
+        xrt::config::get_profile_dump_on_signal());
+
+    // Cross-process profiling session (merged by xprofcollect)
+    ProfileMgr->startProfileChannel(xrt::config::get_profile_session());
   }
 
   // Wrap up profiling by writing files
   void RTSingleton::endProfiling() {
     if (applicationProfilingOn()) {
+      ProfileMgr->stopProfileCheckpoints();
+      ProfileMgr->stopProfileChannel();
+
       // Write out reports
       ProfileMgr->writeProfileSummary();
 
+      // Write placement plan for next run (as requested)
+      if (xrt::config::get_placement_advice())
+        ProfileMgr->writePlacementPlan("sdaccel_placement_plan.ini");
+
       // Close writers
       for (auto& w: Writers) {
         ProfileMgr->detach(w);
@@ -23,6 +23,7 @@
 #include "xocl/api/plugin/xdp/debug.h"
 #include "xocl/xclbin/xclbin.h"
 #include "xrt/scheduler/scheduler.h"
+#include "xrt/util/placement.h"
 
 #include <iostream>
 #include <fstream>
@@ -581,6 +582,22 @@ allocate_buffer_object(memory* mem)
     }
   }
 
+  // If no bank was specified, then prefer the default bank
+  // advised by the placement plan if any.
+  auto& plan = xrt::placement::get_plan();
+  if (!plan.default_bank.empty() && is_active() && !(mem->get_flags() & CL_MEM_EXT_PTR_XILINX)) {
+    auto planidx = m_xclbin.banktag_to_memidx(plan.default_bank);
+    if (planidx>=0) {
+      try {
+        auto boh = alloc(mem,planidx);
+        XOCL_DEBUG(std::cout,"memory(",mem->get_uid(),") allocated on device(",m_uid,") in planned bank with idx(",planidx,")\n");
+        return boh;
+      }
+      catch (const std::bad_alloc&) {
+      }
+    }
+  }
+
   // If buffer could not be allocated on the requested bank,
   // or if no bank was specified, then allocate on the bank
   // (memidx) matching the CU connectivity of CUs in device.
@@ -20,11 +20,13 @@
 
 #include "xrt/scheduler/command.h"
 #include "xrt/scheduler/scheduler.h"
+#include "xrt/util/placement.h"
 
 #include "impl/spir.h"
 
 #include <iostream>
 #include <fstream>
+#include <algorithm>
 
 namespace {
 
@@ -244,6 +246,7 @@ void
 execution_context::
 add_compute_units(device* device)
 {
+  std::vector<compute_unit*> cus;
   for (auto& scu : device->get_cus()) {
     auto cu = scu.get();
     // Check that the kernel symbol is the same between the CU kernel and
@@ -251,15 +254,31 @@ add_compute_units(device* device)
     // the same name but have different symbol from xclbin.  This will go
     // away once we ensure that only one kernel per symbol is created in
     // which case the kernel object address can be used from comparison.
-    if(cu->get_symbol()->uid==m_kernel.get()->get_symbol_uid()) {
+    if(cu->get_symbol()->uid==m_kernel.get()->get_symbol_uid())
+      cus.push_back(cu);
+  }
 
-      // Check context creation
-      if (!device->acquire_context(cu))
-        continue;
+  // Try CUs that the placement plan found idle only if no other CU
+  // can be acquired, so the idle CUs are free for other contexts
+  auto& plan = xrt::placement::get_plan();
+  auto idle = [&plan](const compute_unit* cu) {
+    return !plan.cus.empty()
+      && plan.get_cu_state(cu->get_name())==xrt::placement::cu_state::idle;
+  };
+  auto first_idle = std::stable_partition(cus.begin(),cus.end(),
+                                          [&idle](const compute_unit* cu) { return !idle(cu); });
+
+  for (auto itr=cus.begin(); itr!=cus.end(); ++itr) {
+    auto cu = *itr;
+    if (itr==first_idle && !m_cus.empty())
+      break;
+
+    // Check context creation
+    if (!device->acquire_context(cu))
+      continue;
 
-      XOCL_DEBUGF("execution_context(%d) adding cu(%d)\n",m_uid,cu->get_uid());
-      m_cus.push_back(cu);
-    }
+    XOCL_DEBUGF("execution_context(%d) adding cu(%d)\n",m_uid,cu->get_uid());
+    m_cus.push_back(cu);
   }
 }
 
@@ -17,8 +17,10 @@
 #include "memory.h"
 #include "device.h"
 #include "context.h"
+#include "kernel.h"
 #include "error.h"
 
+#include "xrt/util/placement.h"
 
 #include <iostream>
 
@@ -47,6 +49,24 @@ singleContextDevice(cl_context context)
     : nullptr;
 }
 
+// Memory index advised by placement plan for kernel argument, -1
+// if there is no advice.
+static int
+get_planned_memidx(const xocl::device* device, const xocl::kernel* kernel, unsigned long argidx)
+{
+  auto& plan = xrt::placement::get_plan();
+  if (plan.arg_bank.empty())
+    return -1;
+
+  for (auto& arg : kernel->get_indexed_argument_range()) {
+    if (arg->get_argidx()!=argidx)
+      continue;
+    auto bank = plan.get_arg_bank(kernel->get_name(),arg->get_name());
+    return bank.empty() ? -1 : device->get_xclbin().banktag_to_memidx(bank);
+  }
+  return -1;
+}
+
 static xocl::memory::memory_callback_list sg_constructor_callbacks;
 static xocl::memory::memory_callback_list sg_destructor_callbacks;
 
@@ -166,7 +186,16 @@ get_buffer_object(kernel* kernel, unsigned long argidx)
     }
     else {
       // This buffer is not currently allocated on device, allocate
+      // in bank advised by placement plan if connected, otherwise
       // in first available bank for argument
+      auto planidx = get_planned_memidx(device,kernel,argidx);
+      if (planidx>=0 && static_cast<size_t>(planidx)<cu_memidx_mask.size() && cu_memidx_mask.test(planidx)) {
+        try {
+          return (m_bomap[device] = device->allocate_buffer_object(this,planidx));
+        }
+        catch (const std::bad_alloc&) {
+        }
+      }
       for (size_t idx=0; idx<cu_memidx_mask.size(); ++idx) {
         if (cu_memidx_mask.test(idx)) {
           try {
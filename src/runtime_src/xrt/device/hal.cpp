@@ -151,6 +151,13 @@ loadDevices()
 {
   hal::device_list devices;
 
+  // a recording stands in for all drivers
+  auto replay_dir = xrt::config::get_hal_replay();
+  if (!replay_dir.empty()) {
+    hal2::createReplayDevices(devices,replay_dir);
+    return devices;
+  }
+
   // xrt
   bfs::path xrt(emptyOrValue(getenv("XILINX_XRT")));
   if (!xrt.empty() && !isEmulationMode()) {
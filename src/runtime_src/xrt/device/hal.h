@@ -641,6 +641,17 @@ namespace hal2 {
 void
 createDevices(hal::device_list&,const std::string&,void*,unsigned int,void* pmd=nullptr);
 
+/**
+ * Populate hal device list with hal2 devices served from a recording
+ *
+ * @param devices
+ *   List to populate with hal2 devices
+ * @param dir
+ *   Directory of the recording, see xrt/device/halrecord.h
+ */
+void
+createReplayDevices(hal::device_list&,const std::string& dir);
+
 } // namespace hal2
 
 } // xrt
@@ -15,7 +15,9 @@
  */
 
 #include "hal2.h"
+#include "halrecord.h"
 #include "xrt/util/thread.h"
+#include "xrt/util/config_reader.h"
 
 #include <cstring> // for std::memcpy
 #include <iostream>
@@ -665,10 +667,21 @@ createDevices(hal::device_list& devices,
               const std::string& dll, void* driverHandle, unsigned int deviceCount,void*)
 {
   auto halops = std::make_shared<operations>(dll,driverHandle,deviceCount);
+  auto record_dir = xrt::config::get_hal_record();
+  if (!record_dir.empty())
+    record(*halops,record_dir,deviceCount);
   for (unsigned int idx=0; idx<deviceCount; ++idx)
     devices.emplace_back(std::make_unique<xrt::hal2::device>(halops,idx));
 }
 #endif
 
+void
+createReplayDevices(hal::device_list& devices, const std::string& dir)
+{
+  auto halops = replay(dir);
+  for (unsigned int idx=0; idx<halops->getDeviceCount(); ++idx)
+    devices.emplace_back(std::make_unique<xrt::hal2::device>(halops,idx));
+}
+
 
 }} // hal2,xrt
@@ -75,6 +75,10 @@ operations(const std::string &fileName, void *fileHandle, unsigned int count)
   ,mReadQueue(0)
   ,mPollQueues(0)
 {
+  // filled in by the caller, e.g. replay of a recording
+  if (!mDriverHandle)
+    return;
+
   mProbe = (probeFuncType)dlsym(const_cast<void *>(mDriverHandle), "xclProbe");
   if (!mProbe)
     return;
@@ -165,7 +169,8 @@ operations(const std::string &fileName, void *fileHandle, unsigned int count)
 operations::
 ~operations()
 {
-  dlclose(const_cast<void *>(mDriverHandle));
+  if (mDriverHandle)
+    dlclose(const_cast<void *>(mDriverHandle));
 }
 
 }} // hal2,xrt
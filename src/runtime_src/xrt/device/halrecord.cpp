@@ -0,0 +1,1297 @@
+/**
+ * Copyright (C) 2018 Xilinx, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "halrecord.h"
+#include "driver/include/ert.h"
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace bfs = boost::filesystem;
+
+namespace {
+
+using namespace xrt::hal2;
+
+// Recorded calls, the numbers are part of the file format
+enum class api : uint32_t {
+  open = 0,
+  close,
+  load_xclbin,
+  alloc_bo,
+  alloc_userptr_bo,
+  free_bo,
+  write_bo,
+  read_bo,
+  sync_bo,
+  copy_bo,
+  map_bo,
+  get_bo_properties,
+  exec_buf,
+  exec_wait,
+  exec_done,      // command seen completed after an exec_wait
+  open_context,
+  close_context,
+  write,
+  read,
+  get_device_info,
+  lock_device,
+  unlock_device,
+  reclock2,
+  export_bo,
+  import_bo,
+  max
+};
+
+static const char* api_names[] = {
+  "xclOpen", "xclClose", "xclLoadXclBin", "xclAllocBO", "xclAllocUserPtrBO",
+  "xclFreeBO", "xclWriteBO", "xclReadBO", "xclSyncBO", "xclCopyBO", "xclMapBO",
+  "xclGetBOProperties", "xclExecBuf", "xclExecWait", "exec done",
+  "xclOpenContext", "xclCloseContext", "xclWrite", "xclRead",
+  "xclGetDeviceInfo2", "xclLockDevice", "xclUnlockDevice", "xclReClock2",
+  "xclExportBO", "xclImportBO"
+};
+static_assert(sizeof(api_names)/sizeof(api_names[0]) == static_cast<size_t>(api::max),
+              "a name for every recorded call");
+
+// 128 bit content hash, all zero for no content
+struct digest
+{
+  uint64_t lo = 0;
+  uint64_t hi = 0;
+
+  bool
+  empty() const
+  {
+    return !lo && !hi;
+  }
+
+  bool
+  operator==(const digest& rhs) const
+  {
+    return lo==rhs.lo && hi==rhs.hi;
+  }
+
+  bool
+  operator<(const digest& rhs) const
+  {
+    return lo<rhs.lo || (lo==rhs.lo && hi<rhs.hi);
+  }
+
+  std::string
+  str() const
+  {
+    char buf[33];
+    std::snprintf(buf,sizeof(buf),"%016llx%016llx",
+                  (unsigned long long)hi,(unsigned long long)lo);
+    return buf;
+  }
+};
+
+struct digest_hash
+{
+  size_t operator()(const digest& d) const { return d.lo; }
+};
+
+struct call_record
+{
+  uint32_t api;
+  uint32_t device;   // index passed to xclOpen
+  uint64_t arg[5];
+  int64_t  ret;
+  digest   in;       // buffer passed to the call
+  digest   out;      // buffer returned by the call
+};
+
+static const char log_magic[8] = {'X','R','T','H','A','L','R','C'};
+static const uint32_t log_version = 2;
+
+struct log_header
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t count;    // devices probed
+};
+
+static inline uint64_t
+rotl(uint64_t x, int r)
+{
+  return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t
+fmix(uint64_t k)
+{
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdULL;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53ULL;
+  k ^= k >> 33;
+  return k;
+}
+
+// Two multiply-rotate lanes over 64 bit words, not cryptographic but
+// fast enough to hash every buffer that crosses the HAL
+static digest
+compute_digest(const void* data, size_t size)
+{
+  digest d;
+  if (!size)
+    return d;
+  auto bytes = static_cast<const char*>(data);
+  uint64_t h1 = 0x9e3779b97f4a7c15ULL ^ size;
+  uint64_t h2 = 0xc2b2ae3d27d4eb4fULL + size;
+  size_t words = size / 8;
+  for (size_t i = 0; i < words; ++i) {
+    uint64_t w;
+    std::memcpy(&w,bytes + i*8,8);
+    h1 = rotl((h1 ^ w) * 0x87c37b91114253d5ULL,31);
+    h2 = rotl((h2 + w) * 0x4cf5ad432745937fULL,29);
+  }
+  uint64_t tail = 0;
+  std::memcpy(&tail,bytes + words*8,size % 8);
+  h1 = fmix(h1 ^ tail ^ h2);
+  h2 = fmix(h2 + tail + h1);
+  d.lo = h1;
+  d.hi = h2 ? h2 : 1;   // never the empty digest
+  return d;
+}
+
+// Blob encoding: the size, then segments of zero words to skip and
+// literal words to copy, then the bytes of a partial last word
+static void
+encode(const char* data, size_t size, std::vector<char>& out)
+{
+  static const size_t min_zeros = 8;   // shorter runs stay literal
+  const uint64_t size64 = size;
+  out.clear();
+  out.insert(out.end(),(const char*)&size64,(const char*)&size64 + 8);
+
+  auto words = reinterpret_cast<const uint64_t*>(data);
+  size_t nwords = size / 8;
+  auto zero_run = [&](size_t i) {
+    size_t j = i;
+    while (j < nwords && !words[j])
+      ++j;
+    return j - i;
+  };
+
+  size_t i = 0;
+  while (i < nwords) {
+    uint32_t zeros = 0, literals = 0;
+    while (i < nwords && !words[i] && zeros < UINT32_MAX) {
+      ++zeros;
+      ++i;
+    }
+    size_t start = i;
+    while (i < nwords && literals < UINT32_MAX) {
+      if (!words[i] && zero_run(i) >= min_zeros)
+        break;
+      ++literals;
+      ++i;
+    }
+    out.insert(out.end(),(const char*)&zeros,(const char*)&zeros + 4);
+    out.insert(out.end(),(const char*)&literals,(const char*)&literals + 4);
+    out.insert(out.end(),(const char*)(words + start),(const char*)(words + start + literals));
+  }
+  out.insert(out.end(),data + nwords*8,data + size);
+}
+
+static bool
+decode(const std::vector<char>& in, std::vector<char>& out)
+{
+  uint64_t size = 0;
+  if (in.size() < 8)
+    return false;
+  std::memcpy(&size,in.data(),8);
+  out.assign(size,0);
+  size_t pos = 8, word = 0, nwords = size / 8;
+  while (word < nwords) {
+    uint32_t zeros, literals;
+    if (pos + 8 > in.size())
+      return false;
+    std::memcpy(&zeros,in.data() + pos,4);
+    std::memcpy(&literals,in.data() + pos + 4,4);
+    pos += 8;
+    word += zeros;
+    if (word + literals > nwords || pos + literals*8ULL > in.size())
+      return false;
+    std::memcpy(out.data() + word*8,in.data() + pos,literals*8ULL);
+    word += literals;
+    pos += literals*8ULL;
+  }
+  if (in.size() - pos != size % 8)
+    return false;
+  if (size % 8)
+    std::memcpy(out.data() + nwords*8,in.data() + pos,size % 8);
+  return true;
+}
+
+// Content addressed buffers of a recording
+class blob_store
+{
+  bfs::path m_dir;
+  std::mutex m_mutex;
+  std::set<digest> m_stored;
+  std::unordered_map<digest,std::shared_ptr<const std::vector<char>>,digest_hash> m_cache;
+
+public:
+  explicit
+  blob_store(const bfs::path& dir)
+    : m_dir(dir / "blobs")
+  {}
+
+  void
+  create()
+  {
+    bfs::create_directories(m_dir);
+  }
+
+  digest
+  put(const void* data, size_t size)
+  {
+    auto d = compute_digest(data,size);
+    if (d.empty())
+      return d;
+    {
+      std::lock_guard<std::mutex> lk(m_mutex);
+      if (!m_stored.insert(d).second)
+        return d;
+    }
+
+    // identical contents of earlier recordings are kept
+    auto path = m_dir / d.str();
+    if (bfs::exists(path))
+      return d;
+
+    std::vector<char> encoded;
+    encode(static_cast<const char*>(data),size,encoded);
+    auto tmp = path.string() + ".tmp";
+    auto f = std::fopen(tmp.c_str(),"wb");
+    if (!f)
+      throw std::runtime_error("hal record: cannot write '" + tmp + "'");
+    bool ok = std::fwrite(encoded.data(),1,encoded.size(),f) == encoded.size();
+    ok = (std::fclose(f) == 0) && ok;
+    if (!ok || std::rename(tmp.c_str(),path.c_str()))
+      throw std::runtime_error("hal record: cannot write '" + path.string() + "'");
+    return d;
+  }
+
+  std::shared_ptr<const std::vector<char>>
+  get(const digest& d)
+  {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    auto itr = m_cache.find(d);
+    if (itr != m_cache.end())
+      return itr->second;
+
+    auto path = (m_dir / d.str()).string();
+    auto f = std::fopen(path.c_str(),"rb");
+    if (!f)
+      throw std::runtime_error("hal replay: missing blob '" + path + "'");
+    std::vector<char> encoded;
+    char buf[1<<16];
+    size_t n;
+    while ((n = std::fread(buf,1,sizeof(buf),f)) > 0)
+      encoded.insert(encoded.end(),buf,buf + n);
+    std::fclose(f);
+
+    auto data = std::make_shared<std::vector<char>>();
+    if (!decode(encoded,*data))
+      throw std::runtime_error("hal replay: corrupt blob '" + path + "'");
+    m_cache.emplace(d,data);
+    return data;
+  }
+};
+
+////////////////////////////////////////////////////////////////
+// Recording
+////////////////////////////////////////////////////////////////
+class recorder
+{
+public:
+  // the functions of the shim that is recorded
+  decltype(operations::mOpen) open;
+  decltype(operations::mClose) close;
+  decltype(operations::mLoadXclBin) load_xclbin;
+  decltype(operations::mAllocBO) alloc_bo;
+  decltype(operations::mAllocUserPtrBO) alloc_userptr_bo;
+  decltype(operations::mFreeBO) free_bo;
+  decltype(operations::mWriteBO) write_bo;
+  decltype(operations::mReadBO) read_bo;
+  decltype(operations::mSyncBO) sync_bo;
+  decltype(operations::mCopyBO) copy_bo;
+  decltype(operations::mMapBO) map_bo;
+  decltype(operations::mGetBOProperties) get_bo_properties;
+  decltype(operations::mExecBuf) exec_buf;
+  decltype(operations::mExecWait) exec_wait;
+  decltype(operations::mOpenContext) open_context;
+  decltype(operations::mCloseContext) close_context;
+  decltype(operations::mWrite) write;
+  decltype(operations::mRead) read;
+  decltype(operations::mGetDeviceInfo) get_device_info;
+  decltype(operations::mLockDevice) lock_device;
+  decltype(operations::mUnlockDevice) unlock_device;
+  decltype(operations::mReClock2) reclock2;
+  decltype(operations::mExportBO) export_bo;
+  decltype(operations::mImportBO) import_bo;
+
+  blob_store blobs;
+
+private:
+  struct bo_info
+  {
+    size_t size = 0;
+    char* data = nullptr;  // mapped or user pointer
+  };
+
+  struct running_cmd
+  {
+    xclDeviceHandle handle;
+    unsigned int bo;
+    uint64_t seq;
+  };
+
+  std::mutex m_mutex;
+  std::FILE* m_log;
+  std::map<xclDeviceHandle,unsigned int> m_devices;
+  std::map<std::pair<xclDeviceHandle,unsigned int>,bo_info> m_bos;
+  std::vector<running_cmd> m_running;
+  uint64_t m_exec_seq = 0;
+
+  unsigned int
+  index(xclDeviceHandle handle)
+  {
+    auto itr = m_devices.find(handle);
+    return itr==m_devices.end() ? 0 : itr->second;
+  }
+
+  void
+  append(const call_record& rec)
+  {
+    std::fwrite(&rec,sizeof(rec),1,m_log);
+  }
+
+public:
+  recorder(const bfs::path& dir, unsigned int count)
+    : blobs(dir)
+  {
+    bfs::create_directories(dir);
+    blobs.create();
+    auto path = (dir / "calls.log").string();
+    m_log = std::fopen(path.c_str(),"wb");
+    if (!m_log)
+      throw std::runtime_error("hal record: cannot create '" + path + "'");
+    log_header header;
+    std::memcpy(header.magic,log_magic,sizeof(log_magic));
+    header.version = log_version;
+    header.count = count;
+    std::fwrite(&header,sizeof(header),1,m_log);
+  }
+
+  ~recorder()
+  {
+    std::fclose(m_log);
+  }
+
+  void
+  log(api a, xclDeviceHandle handle, std::initializer_list<uint64_t> args, int64_t ret,
+      const digest& in = digest(), const digest& out = digest())
+  {
+    call_record rec = {};
+    rec.api = static_cast<uint32_t>(a);
+    std::copy(args.begin(),args.end(),rec.arg);
+    rec.ret = ret;
+    rec.in = in;
+    rec.out = out;
+    std::lock_guard<std::mutex> lk(m_mutex);
+    rec.device = index(handle);
+    append(rec);
+  }
+
+  void
+  add_device(xclDeviceHandle handle, unsigned int idx)
+  {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    m_devices[handle] = idx;
+  }
+
+  void
+  remove_device(xclDeviceHandle handle)
+  {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    record_done(handle);
+    m_devices.erase(handle);
+    std::fflush(m_log);
+  }
+
+  void
+  set_bo(xclDeviceHandle handle, unsigned int bo, size_t size, char* data)
+  {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    auto& info = m_bos[{handle,bo}];
+    if (size)
+      info.size = size;
+    if (data)
+      info.data = data;
+  }
+
+  bo_info
+  get_bo(xclDeviceHandle handle, unsigned int bo)
+  {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    auto itr = m_bos.find({handle,bo});
+    return itr==m_bos.end() ? bo_info() : itr->second;
+  }
+
+  void
+  remove_bo(xclDeviceHandle handle, unsigned int bo)
+  {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    m_bos.erase({handle,bo});
+  }
+
+  // Log a command submission; a command the shim accepted is tracked
+  // until completion.  Logged under m_mutex with the registration so
+  // that its completion is never logged first.
+  void
+  log_exec_buf(xclDeviceHandle handle, unsigned int bo, int ret)
+  {
+    call_record rec = {};
+    rec.api = static_cast<uint32_t>(api::exec_buf);
+    rec.arg[0] = bo;
+    rec.ret = ret;
+    std::lock_guard<std::mutex> lk(m_mutex);
+    if (ret == 0) {
+      m_running.push_back({handle,bo,++m_exec_seq});
+      rec.arg[1] = m_exec_seq;
+    }
+    rec.device = index(handle);
+    append(rec);
+  }
+
+  // Log the commands whose packet the shim has marked completed,
+  // called with m_mutex held
+  void
+  record_done(xclDeviceHandle handle)
+  {
+    for (auto itr = m_running.begin(); itr != m_running.end(); ) {
+      auto bo = m_bos.find({itr->handle,itr->bo});
+      if (itr->handle != handle || bo == m_bos.end() || !bo->second.data) {
+        ++itr;
+        continue;
+      }
+      uint32_t header;
+      std::memcpy(&header,bo->second.data,sizeof(header));
+      if ((header & 0xf) < ERT_CMD_STATE_COMPLETED) {
+        ++itr;
+        continue;
+      }
+      call_record rec = {};
+      rec.api = static_cast<uint32_t>(api::exec_done);
+      rec.device = index(handle);
+      rec.arg[0] = itr->bo;
+      rec.arg[1] = itr->seq;
+      rec.arg[2] = header;
+      append(rec);
+      itr = m_running.erase(itr);
+    }
+  }
+
+  void
+  exec_waited(xclDeviceHandle handle)
+  {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    record_done(handle);
+  }
+};
+
+static recorder* s_recorder = nullptr;
+
+static xclDeviceHandle
+record_open(unsigned idx, const char* logFileName, xclVerbosityLevel level)
+{
+  auto handle = s_recorder->open(idx,logFileName,level);
+  if (handle)
+    s_recorder->add_device(handle,idx);
+  s_recorder->log(api::open,handle,{idx,(uint64_t)level},handle ? 0 : -1);
+  return handle;
+}
+
+static void
+record_close(xclDeviceHandle handle)
+{
+  s_recorder->log(api::close,handle,{},0);
+  s_recorder->remove_device(handle);
+  s_recorder->close(handle);
+}
+
+static int
+record_load_xclbin(xclDeviceHandle handle, const xclBin* buffer)
+{
+  auto in = s_recorder->blobs.put(buffer,buffer->m_header.m_length);
+  auto ret = s_recorder->load_xclbin(handle,buffer);
+  s_recorder->log(api::load_xclbin,handle,{buffer->m_header.m_length},ret,in);
+  return ret;
+}
+
+static unsigned int
+record_alloc_bo(xclDeviceHandle handle, size_t size, xclBOKind domain, unsigned flags)
+{
+  auto bo = s_recorder->alloc_bo(handle,size,domain,flags);
+  s_recorder->set_bo(handle,bo,size,nullptr);
+  s_recorder->log(api::alloc_bo,handle,{size,(uint64_t)domain,flags},bo);
+  return bo;
+}
+
+static unsigned int
+record_alloc_userptr_bo(xclDeviceHandle handle, void* userptr, size_t size, unsigned flags)
+{
+  auto bo = s_recorder->alloc_userptr_bo(handle,userptr,size,flags);
+  s_recorder->set_bo(handle,bo,size,static_cast<char*>(userptr));
+  s_recorder->log(api::alloc_userptr_bo,handle,{size,flags},bo);
+  return bo;
+}
+
+static void
+record_free_bo(xclDeviceHandle handle, unsigned int bo)
+{
+  s_recorder->log(api::free_bo,handle,{bo},0);
+  s_recorder->remove_bo(handle,bo);
+  s_recorder->free_bo(handle,bo);
+}
+
+static size_t
+record_write_bo(xclDeviceHandle handle, unsigned int bo, const void* src, size_t size, size_t seek)
+{
+  auto in = s_recorder->blobs.put(src,size);
+  auto ret = s_recorder->write_bo(handle,bo,src,size,seek);
+  s_recorder->log(api::write_bo,handle,{bo,size,seek},ret,in);
+  return ret;
+}
+
+static size_t
+record_read_bo(xclDeviceHandle handle, unsigned int bo, void* dst, size_t size, size_t skip)
+{
+  auto ret = s_recorder->read_bo(handle,bo,dst,size,skip);
+  auto out = s_recorder->blobs.put(dst,size);
+  s_recorder->log(api::read_bo,handle,{bo,size,skip},ret,digest(),out);
+  return ret;
+}
+
+static int
+record_sync_bo(xclDeviceHandle handle, unsigned int bo, xclBOSyncDirection dir, size_t size, size_t offset)
+{
+  auto info = s_recorder->get_bo(handle,bo);
+  digest in, out;
+  if (info.data && dir==XCL_BO_SYNC_BO_TO_DEVICE)
+    in = s_recorder->blobs.put(info.data + offset,size);
+  auto ret = s_recorder->sync_bo(handle,bo,dir,size,offset);
+  if (info.data && dir==XCL_BO_SYNC_BO_FROM_DEVICE)
+    out = s_recorder->blobs.put(info.data + offset,size);
+  s_recorder->log(api::sync_bo,handle,{bo,(uint64_t)dir,size,offset},ret,in,out);
+  return ret;
+}
+
+static int
+record_copy_bo(xclDeviceHandle handle, unsigned int dst, unsigned int src,
+               size_t size, size_t dst_offset, size_t src_offset)
+{
+  auto ret = s_recorder->copy_bo(handle,dst,src,size,dst_offset,src_offset);
+  s_recorder->log(api::copy_bo,handle,{dst,src,size,dst_offset,src_offset},ret);
+  return ret;
+}
+
+static void*
+record_map_bo(xclDeviceHandle handle, unsigned int bo, bool write)
+{
+  auto data = s_recorder->map_bo(handle,bo,write);
+  s_recorder->set_bo(handle,bo,0,static_cast<char*>(data));
+  auto info = s_recorder->get_bo(handle,bo);
+  s_recorder->log(api::map_bo,handle,{bo,write,info.size},data ? 0 : -1);
+  return data;
+}
+
+static int
+record_get_bo_properties(xclDeviceHandle handle, unsigned int bo, xclBOProperties* properties)
+{
+  auto ret = s_recorder->get_bo_properties(handle,bo,properties);
+  auto out = s_recorder->blobs.put(properties,sizeof(*properties));
+  s_recorder->log(api::get_bo_properties,handle,{bo},ret,digest(),out);
+  return ret;
+}
+
+static unsigned int
+record_exec_buf(xclDeviceHandle handle, unsigned int bo)
+{
+  auto ret = s_recorder->exec_buf(handle,bo);
+  s_recorder->log_exec_buf(handle,bo,ret);
+  return ret;
+}
+
+static int
+record_exec_wait(xclDeviceHandle handle, int timeout)
+{
+  auto ret = s_recorder->exec_wait(handle,timeout);
+  s_recorder->log(api::exec_wait,handle,{(uint64_t)timeout},ret);
+  s_recorder->exec_waited(handle);
+  return ret;
+}
+
+static int
+record_open_context(xclDeviceHandle handle, const uuid_t xclbinId, unsigned int ip, bool shared)
+{
+  auto in = s_recorder->blobs.put(xclbinId,sizeof(uuid_t));
+  auto ret = s_recorder->open_context(handle,xclbinId,ip,shared);
+  s_recorder->log(api::open_context,handle,{ip,shared},ret,in);
+  return ret;
+}
+
+static int
+record_close_context(xclDeviceHandle handle, const uuid_t xclbinId, unsigned int ip)
+{
+  auto in = s_recorder->blobs.put(xclbinId,sizeof(uuid_t));
+  auto ret = s_recorder->close_context(handle,xclbinId,ip);
+  s_recorder->log(api::close_context,handle,{ip},ret,in);
+  return ret;
+}
+
+static size_t
+record_write(xclDeviceHandle handle, xclAddressSpace space, uint64_t offset, const void* buf, size_t size)
+{
+  auto in = s_recorder->blobs.put(buf,size);
+  auto ret = s_recorder->write(handle,space,offset,buf,size);
+  s_recorder->log(api::write,handle,{(uint64_t)space,offset,size},ret,in);
+  return ret;
+}
+
+static size_t
+record_read(xclDeviceHandle handle, xclAddressSpace space, uint64_t offset, void* buf, size_t size)
+{
+  auto ret = s_recorder->read(handle,space,offset,buf,size);
+  auto out = s_recorder->blobs.put(buf,size);
+  s_recorder->log(api::read,handle,{(uint64_t)space,offset,size},ret,digest(),out);
+  return ret;
+}
+
+static int
+record_get_device_info(xclDeviceHandle handle, xclDeviceInfo2* info)
+{
+  auto ret = s_recorder->get_device_info(handle,info);
+  auto out = s_recorder->blobs.put(info,sizeof(*info));
+  s_recorder->log(api::get_device_info,handle,{},ret,digest(),out);
+  return ret;
+}
+
+static int
+record_lock_device(xclDeviceHandle handle)
+{
+  auto ret = s_recorder->lock_device(handle);
+  s_recorder->log(api::lock_device,handle,{},ret);
+  return ret;
+}
+
+static int
+record_unlock_device(xclDeviceHandle handle)
+{
+  auto ret = s_recorder->unlock_device(handle);
+  s_recorder->log(api::unlock_device,handle,{},ret);
+  return ret;
+}
+
+static int
+record_reclock2(xclDeviceHandle handle, unsigned short region, const unsigned short* freqs)
+{
+  auto ret = s_recorder->reclock2(handle,region,freqs);
+  s_recorder->log(api::reclock2,handle,{region},ret);
+  return ret;
+}
+
+static unsigned int
+record_export_bo(xclDeviceHandle handle, unsigned int bo)
+{
+  auto ret = s_recorder->export_bo(handle,bo);
+  s_recorder->log(api::export_bo,handle,{bo},(int)ret);
+  return ret;
+}
+
+static unsigned int
+record_import_bo(xclDeviceHandle handle, int fd, unsigned flags)
+{
+  auto bo = s_recorder->import_bo(handle,fd,flags);
+  xclBOProperties p;
+  size_t size = 0;
+  if (s_recorder->get_bo_properties && !s_recorder->get_bo_properties(handle,bo,&p))
+    size = p.size;
+  s_recorder->set_bo(handle,bo,size,nullptr);
+  s_recorder->log(api::import_bo,handle,{(uint64_t)fd,flags,size},bo);
+  return bo;
+}
+
+// Replace a function with its recording wrapper if the shim has it
+template <typename F>
+static void
+wrap(F& op, F& real, F wrapper)
+{
+  real = op;
+  if (op)
+    op = wrapper;
+}
+
+////////////////////////////////////////////////////////////////
+// Replay
+////////////////////////////////////////////////////////////////
+class player
+{
+  struct bo_info
+  {
+    size_t size = 0;
+    char* userptr = nullptr;
+    std::unique_ptr<char[]> data;
+
+    char*
+    map()
+    {
+      if (userptr)
+        return userptr;
+      if (!data && size)
+        data.reset(new char[size]());
+      return data.get();
+    }
+  };
+
+  struct running_cmd
+  {
+    unsigned int bo;
+    uint64_t seq;
+  };
+
+public:
+  struct device
+  {
+    unsigned int index = 0;
+    std::array<std::deque<call_record>,static_cast<size_t>(api::max)> calls;
+    std::map<uint64_t,uint32_t> done;   // exec sequence -> completed header
+    std::map<unsigned int,bo_info> bos;
+    std::vector<running_cmd> running;
+  };
+
+private:
+  blob_store m_blobs;
+  std::vector<std::unique_ptr<device>> m_devices;
+  std::mutex m_mutex;
+  std::array<size_t,static_cast<size_t>(api::max)> m_missing {};
+  size_t m_differ = 0;
+
+public:
+  explicit
+  player(const bfs::path& dir)
+    : m_blobs(dir)
+  {
+    auto path = (dir / "calls.log").string();
+    auto f = std::fopen(path.c_str(),"rb");
+    if (!f)
+      throw std::runtime_error("hal replay: no recording '" + path + "'");
+    log_header header;
+    if (std::fread(&header,sizeof(header),1,f) != 1
+        || std::memcmp(header.magic,log_magic,sizeof(log_magic))
+        || header.version != log_version) {
+      std::fclose(f);
+      throw std::runtime_error("hal replay: '" + path + "' is not a recording");
+    }
+    for (unsigned int idx = 0; idx < header.count; ++idx) {
+      m_devices.push_back(std::make_unique<device>());
+      m_devices.back()->index = idx;
+    }
+
+    call_record rec;
+    while (std::fread(&rec,sizeof(rec),1,f) == 1) {
+      if (rec.device >= m_devices.size() || rec.api >= static_cast<uint32_t>(api::max))
+        continue;
+      auto& dev = *m_devices[rec.device];
+      if (rec.api == static_cast<uint32_t>(api::exec_done))
+        dev.done[rec.arg[1]] = rec.arg[2];
+      else
+        dev.calls[rec.api].push_back(rec);
+    }
+    std::fclose(f);
+  }
+
+  ~player()
+  {
+    for (size_t a = 0; a < m_missing.size(); ++a)
+      if (m_missing[a])
+        std::cerr << "hal replay: " << m_missing[a] << " " << api_names[a]
+                  << " calls not in the recording\n";
+    if (m_differ)
+      std::cerr << "hal replay: " << m_differ << " calls with inputs that differ from the recording\n";
+  }
+
+  unsigned int
+  count() const
+  {
+    return m_devices.size();
+  }
+
+  std::mutex&
+  mutex()
+  {
+    return m_mutex;
+  }
+
+  device*
+  get_device(unsigned int idx)
+  {
+    return idx < m_devices.size() ? m_devices[idx].get() : nullptr;
+  }
+
+  // Next recorded call of kind a, the caller holds the mutex
+  bool
+  next(xclDeviceHandle handle, api a, call_record& rec)
+  {
+    auto dev = static_cast<device*>(handle);
+    auto& calls = dev->calls[static_cast<size_t>(a)];
+    if (calls.empty()) {
+      ++m_missing[static_cast<size_t>(a)];
+      return false;
+    }
+    rec = calls.front();
+    calls.pop_front();
+    return true;
+  }
+
+  void
+  check(const call_record& rec, const void* data, size_t size)
+  {
+    if (!(compute_digest(data,size) == rec.in))
+      ++m_differ;
+  }
+
+  void
+  check(const call_record& rec, std::initializer_list<uint64_t> args)
+  {
+    if (!std::equal(args.begin(),args.end(),rec.arg))
+      ++m_differ;
+  }
+
+  // Copy the recorded output of rec to dst
+  void
+  copy_out(const call_record& rec, void* dst, size_t size)
+  {
+    if (rec.out.empty() || !dst) {
+      if (dst)
+        std::memset(dst,0,size);
+      return;
+    }
+    auto data = m_blobs.get(rec.out);
+    std::memcpy(dst,data->data(),std::min(size,data->size()));
+  }
+
+  bo_info&
+  bo(xclDeviceHandle handle, unsigned int bo)
+  {
+    return static_cast<device*>(handle)->bos[bo];
+  }
+
+  // Apply the recorded completion of all commands that have one
+  bool
+  complete(xclDeviceHandle handle)
+  {
+    auto dev = static_cast<device*>(handle);
+    bool completed = false;
+    for (auto itr = dev->running.begin(); itr != dev->running.end(); ) {
+      auto done = dev->done.find(itr->seq);
+      if (done == dev->done.end()) {
+        ++itr;
+        continue;
+      }
+      auto data = dev->bos[itr->bo].map();
+      if (data)
+        std::memcpy(data,&done->second,sizeof(uint32_t));
+      completed = true;
+      itr = dev->running.erase(itr);
+    }
+    return completed;
+  }
+
+  void
+  add_running(xclDeviceHandle handle, unsigned int bo, uint64_t seq)
+  {
+    static_cast<device*>(handle)->running.push_back({bo,seq});
+  }
+};
+
+static player* s_player = nullptr;
+
+#define REPLAY(a,fail)                                      \
+  std::lock_guard<std::mutex> lk(s_player->mutex());       \
+  call_record rec;                                          \
+  if (!s_player->next(handle,a,rec))                        \
+    return fail
+
+static unsigned
+replay_probe()
+{
+  return s_player->count();
+}
+
+static xclDeviceHandle
+replay_open(unsigned idx, const char*, xclVerbosityLevel)
+{
+  xclDeviceHandle handle = s_player->get_device(idx);
+  if (!handle)
+    return nullptr;
+  REPLAY(api::open,nullptr);
+  return rec.ret ? nullptr : handle;
+}
+
+static void
+replay_close(xclDeviceHandle handle)
+{
+  REPLAY(api::close,);
+}
+
+static int
+replay_load_xclbin(xclDeviceHandle handle, const xclBin* buffer)
+{
+  REPLAY(api::load_xclbin,-EINVAL);
+  s_player->check(rec,buffer,buffer->m_header.m_length);
+  return rec.ret;
+}
+
+static unsigned int
+replay_alloc_bo(xclDeviceHandle handle, size_t size, xclBOKind, unsigned)
+{
+  REPLAY(api::alloc_bo,0xffffffff);
+  s_player->bo(handle,rec.ret).size = size;
+  return rec.ret;
+}
+
+static unsigned int
+replay_alloc_userptr_bo(xclDeviceHandle handle, void* userptr, size_t size, unsigned)
+{
+  REPLAY(api::alloc_userptr_bo,0xffffffff);
+  auto& bo = s_player->bo(handle,rec.ret);
+  bo.size = size;
+  bo.userptr = static_cast<char*>(userptr);
+  return rec.ret;
+}
+
+static void
+replay_free_bo(xclDeviceHandle handle, unsigned int bo)
+{
+  REPLAY(api::free_bo,);
+  static_cast<player::device*>(handle)->bos.erase(bo);
+}
+
+static size_t
+replay_write_bo(xclDeviceHandle handle, unsigned int, const void* src, size_t size, size_t)
+{
+  REPLAY(api::write_bo,-EINVAL);
+  s_player->check(rec,src,size);
+  return rec.ret;
+}
+
+static size_t
+replay_read_bo(xclDeviceHandle handle, unsigned int, void* dst, size_t size, size_t)
+{
+  REPLAY(api::read_bo,-EINVAL);
+  s_player->copy_out(rec,dst,size);
+  return rec.ret;
+}
+
+static int
+replay_sync_bo(xclDeviceHandle handle, unsigned int bo, xclBOSyncDirection dir, size_t size, size_t offset)
+{
+  REPLAY(api::sync_bo,-EINVAL);
+  auto& info = s_player->bo(handle,bo);
+  if (!info.size)
+    info.size = offset + size;
+  auto data = info.map();
+  if (data && offset + size <= info.size) {
+    if (dir==XCL_BO_SYNC_BO_TO_DEVICE)
+      s_player->check(rec,data + offset,size);
+    else if (!rec.out.empty())
+      s_player->copy_out(rec,data + offset,size);
+  }
+  return rec.ret;
+}
+
+static int
+replay_copy_bo(xclDeviceHandle handle, unsigned int dst, unsigned int src,
+               size_t size, size_t dst_offset, size_t src_offset)
+{
+  REPLAY(api::copy_bo,-EINVAL);
+  s_player->check(rec,{dst,src,size,dst_offset,src_offset});
+  return rec.ret;
+}
+
+static void*
+replay_map_bo(xclDeviceHandle handle, unsigned int bo, bool)
+{
+  REPLAY(api::map_bo,nullptr);
+  auto& info = s_player->bo(handle,bo);
+  if (!info.size)
+    info.size = rec.arg[2];
+  return rec.ret ? nullptr : info.map();
+}
+
+static int
+replay_get_bo_properties(xclDeviceHandle handle, unsigned int, xclBOProperties* properties)
+{
+  REPLAY(api::get_bo_properties,-EINVAL);
+  s_player->copy_out(rec,properties,sizeof(*properties));
+  return rec.ret;
+}
+
+static unsigned int
+replay_exec_buf(xclDeviceHandle handle, unsigned int bo)
+{
+  REPLAY(api::exec_buf,-EINVAL);
+  if (rec.ret == 0)
+    s_player->add_running(handle,bo,rec.arg[1]);
+  return rec.ret;
+}
+
+static int
+replay_exec_wait(xclDeviceHandle handle, int)
+{
+  // the number of waits depends on timing, they are not matched
+  std::lock_guard<std::mutex> lk(s_player->mutex());
+  return s_player->complete(handle) ? 1 : 0;
+}
+
+static int
+replay_open_context(xclDeviceHandle handle, const uuid_t xclbinId, unsigned int, bool)
+{
+  REPLAY(api::open_context,-EINVAL);
+  s_player->check(rec,xclbinId,sizeof(uuid_t));
+  return rec.ret;
+}
+
+static int
+replay_close_context(xclDeviceHandle handle, const uuid_t xclbinId, unsigned int)
+{
+  REPLAY(api::close_context,-EINVAL);
+  s_player->check(rec,xclbinId,sizeof(uuid_t));
+  return rec.ret;
+}
+
+static size_t
+replay_write(xclDeviceHandle handle, xclAddressSpace, uint64_t, const void* buf, size_t size)
+{
+  REPLAY(api::write,-EINVAL);
+  s_player->check(rec,buf,size);
+  return rec.ret;
+}
+
+static size_t
+replay_read(xclDeviceHandle handle, xclAddressSpace, uint64_t, void* buf, size_t size)
+{
+  REPLAY(api::read,-EINVAL);
+  s_player->copy_out(rec,buf,size);
+  return rec.ret;
+}
+
+static int
+replay_get_device_info(xclDeviceHandle handle, xclDeviceInfo2* info)
+{
+  REPLAY(api::get_device_info,-EINVAL);
+  s_player->copy_out(rec,info,sizeof(*info));
+  return rec.ret;
+}
+
+static int
+replay_lock_device(xclDeviceHandle handle)
+{
+  REPLAY(api::lock_device,-EINVAL);
+  return rec.ret;
+}
+
+static int
+replay_unlock_device(xclDeviceHandle handle)
+{
+  REPLAY(api::unlock_device,-EINVAL);
+  return rec.ret;
+}
+
+static int
+replay_reclock2(xclDeviceHandle handle, unsigned short, const unsigned short*)
+{
+  REPLAY(api::reclock2,-EINVAL);
+  return rec.ret;
+}
+
+static unsigned int
+replay_export_bo(xclDeviceHandle handle, unsigned int)
+{
+  REPLAY(api::export_bo,-EINVAL);
+  return rec.ret;
+}
+
+static unsigned int
+replay_import_bo(xclDeviceHandle handle, int, unsigned)
+{
+  REPLAY(api::import_bo,0xffffffff);
+  s_player->bo(handle,rec.ret).size = rec.arg[2];
+  return rec.ret;
+}
+
+#undef REPLAY
+
+// Streams are not recorded
+static int
+replay_create_queue(xclDeviceHandle, xclQueueContext*, uint64_t*)
+{
+  return -ENOSYS;
+}
+
+static int
+replay_destroy_queue(xclDeviceHandle, uint64_t)
+{
+  return -ENOSYS;
+}
+
+static void*
+replay_alloc_qdma_buf(xclDeviceHandle, size_t, uint64_t*)
+{
+  return nullptr;
+}
+
+static int
+replay_free_qdma_buf(xclDeviceHandle, uint64_t)
+{
+  return -ENOSYS;
+}
+
+static ssize_t
+replay_queue(xclDeviceHandle, uint64_t, xclQueueRequest*)
+{
+  return -ENOSYS;
+}
+
+static int
+replay_poll_queues(xclDeviceHandle, int, int, xclReqCompletion*, int* actual, int)
+{
+  if (actual)
+    *actual = 0;
+  return -ENOSYS;
+}
+
+} // namespace
+
+namespace xrt { namespace hal2 {
+
+bool
+record(operations& ops, const std::string& dir, unsigned int count)
+{
+  if (s_recorder)
+    return false;
+
+  // lives until the process exits, shim functions may still be called
+  // from static destructors
+  static std::unique_ptr<recorder> s_owner;
+  s_owner = std::make_unique<recorder>(dir,count);
+  auto r = s_recorder = s_owner.get();
+
+  wrap(ops.mOpen,r->open,&record_open);
+  wrap(ops.mClose,r->close,&record_close);
+  wrap(ops.mLoadXclBin,r->load_xclbin,&record_load_xclbin);
+  wrap(ops.mAllocBO,r->alloc_bo,&record_alloc_bo);
+  wrap(ops.mAllocUserPtrBO,r->alloc_userptr_bo,&record_alloc_userptr_bo);
+  wrap(ops.mFreeBO,r->free_bo,&record_free_bo);
+  wrap(ops.mWriteBO,r->write_bo,&record_write_bo);
+  wrap(ops.mReadBO,r->read_bo,&record_read_bo);
+  wrap(ops.mSyncBO,r->sync_bo,&record_sync_bo);
+  wrap(ops.mCopyBO,r->copy_bo,&record_copy_bo);
+  wrap(ops.mMapBO,r->map_bo,&record_map_bo);
+  wrap(ops.mGetBOProperties,r->get_bo_properties,&record_get_bo_properties);
+  wrap(ops.mExecBuf,r->exec_buf,&record_exec_buf);
+  wrap(ops.mExecWait,r->exec_wait,&record_exec_wait);
+  wrap(ops.mOpenContext,r->open_context,&record_open_context);
+  wrap(ops.mCloseContext,r->close_context,&record_close_context);
+  wrap(ops.mWrite,r->write,&record_write);
+  wrap(ops.mRead,r->read,&record_read);
+  wrap(ops.mGetDeviceInfo,r->get_device_info,&record_get_device_info);
+  wrap(ops.mLockDevice,r->lock_device,&record_lock_device);
+  wrap(ops.mUnlockDevice,r->unlock_device,&record_unlock_device);
+  wrap(ops.mReClock2,r->reclock2,&record_reclock2);
+  wrap(ops.mExportBO,r->export_bo,&record_export_bo);
+  wrap(ops.mImportBO,r->import_bo,&record_import_bo);
+  return true;
+}
+
+std::shared_ptr<operations>
+replay(const std::string& dir)
+{
+  static std::unique_ptr<player> s_owner;
+  if (!s_player) {
+    s_owner = std::make_unique<player>(dir);
+    s_player = s_owner.get();
+  }
+
+  auto ops = std::make_shared<operations>("replay:" + dir,nullptr,s_player->count());
+  ops->mProbe = &replay_probe;
+  ops->mOpen = &replay_open;
+  ops->mClose = &replay_close;
+  ops->mLoadXclBin = &replay_load_xclbin;
+  ops->mAllocBO = &replay_alloc_bo;
+  ops->mAllocUserPtrBO = &replay_alloc_userptr_bo;
+  ops->mFreeBO = &replay_free_bo;
+  ops->mWriteBO = &replay_write_bo;
+  ops->mReadBO = &replay_read_bo;
+  ops->mSyncBO = &replay_sync_bo;
+  ops->mCopyBO = &replay_copy_bo;
+  ops->mMapBO = &replay_map_bo;
+  ops->mGetBOProperties = &replay_get_bo_properties;
+  ops->mExecBuf = &replay_exec_buf;
+  ops->mExecWait = &replay_exec_wait;
+  ops->mOpenContext = &replay_open_context;
+  ops->mCloseContext = &replay_close_context;
+  ops->mWrite = &replay_write;
+  ops->mRead = &replay_read;
+  ops->mGetDeviceInfo = &replay_get_device_info;
+  ops->mLockDevice = &replay_lock_device;
+  ops->mUnlockDevice = &replay_unlock_device;
+  ops->mReClock2 = &replay_reclock2;
+  ops->mExportBO = &replay_export_bo;
+  ops->mImportBO = &replay_import_bo;
+  ops->mCreateWriteQueue = &replay_create_queue;
+  ops->mCreateReadQueue = &replay_create_queue;
+  ops->mDestroyQueue = &replay_destroy_queue;
+  ops->mAllocQDMABuf = &replay_alloc_qdma_buf;
+  ops->mFreeQDMABuf = &replay_free_qdma_buf;
+  ops->mWriteQueue = &replay_queue;
+  ops->mReadQueue = &replay_queue;
+  ops->mPollQueues = &replay_poll_queues;
+  return ops;
+}
+
+}} // hal2,xrt
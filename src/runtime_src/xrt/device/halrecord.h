@@ -0,0 +1,73 @@
+/**
+ * Copyright (C) 2018 Xilinx, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef xrt_device_halrecord_h
+#define xrt_device_halrecord_h
+
+#include "xrt/device/halops2.h"
+
+#include <memory>
+#include <string>
+
+/**
+ * Record and replay of the calls into a HAL shim library.
+ *
+ * A recording is a directory with a log of fixed size call records
+ * (calls.log) and the buffers passed to and returned by the calls,
+ * stored once per content under blobs/ with runs of zeros left out.
+ *
+ * Replay serves the recorded results from memory without a driver,
+ * card or emulator, so that host side overheads of the runtime can be
+ * measured and profiled on their own.  Calls of each kind are matched
+ * to the recording in order, per device; inputs that differ from the
+ * recording and calls missing from it are reported when the process
+ * exits.  Commands complete on the first xclExecWait after their
+ * xclExecBuf, with the state the recording saw.
+ *
+ * Streaming (QDMA) and profiling calls are not recorded.
+ */
+
+namespace xrt { namespace hal2 {
+
+/**
+ * Record all calls made through @ops to directory @dir
+ *
+ * @param ops
+ *   Operations of a HAL shim, their functions are replaced with
+ *   recording wrappers
+ * @param dir
+ *   Directory to record to, created if missing
+ * @param count
+ *   Number of devices probed by the shim
+ * @return
+ *   true if recording, only the first table of a process is recorded
+ */
+bool
+record(operations& ops, const std::string& dir, unsigned int count);
+
+/**
+ * Operations serving the recording in directory @dir
+ *
+ * @return
+ *   Operations for the recorded number of devices, throws if @dir
+ *   holds no recording
+ */
+std::shared_ptr<operations>
+replay(const std::string& dir);
+
+}} // hal2,xrt
+
+#endif
@@ -0,0 +1,233 @@
+/**
+ * Copyright (C) 2018 Xilinx, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+////////////////////////////////////////////////////////////////
+// Unit testing of xrt/device/halrecord.h against a fake shim
+////////////////////////////////////////////////////////////////
+#include <boost/test/unit_test.hpp>
+
+#include "xrt/device/halrecord.h"
+#include "driver/include/ert.h"
+
+#include <boost/filesystem/operations.hpp>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE ( test_halrecord )
+
+namespace {
+
+using namespace xrt::hal2;
+
+// One device whose buffers have a host and a device copy, sync from
+// device swaps the bytes of every word, commands complete on the next
+// wait
+struct fake_bo
+{
+  std::vector<char> host;
+  std::vector<char> dev;
+};
+
+struct fake_device
+{
+  std::map<unsigned int,fake_bo> bos;
+  std::vector<unsigned int> running;
+  unsigned int next = 1;
+  uint32_t reg = 0x1234;
+};
+
+static fake_device s_fake;
+
+static xclDeviceHandle
+fake_open(unsigned, const char*, xclVerbosityLevel)
+{
+  return &s_fake;
+}
+
+static void
+fake_close(xclDeviceHandle)
+{
+}
+
+static unsigned int
+fake_alloc_bo(xclDeviceHandle, size_t size, xclBOKind, unsigned)
+{
+  s_fake.bos[s_fake.next].host.resize(size);
+  s_fake.bos[s_fake.next].dev.resize(size);
+  return s_fake.next++;
+}
+
+static void
+fake_free_bo(xclDeviceHandle, unsigned int bo)
+{
+  s_fake.bos.erase(bo);
+}
+
+static void*
+fake_map_bo(xclDeviceHandle, unsigned int bo, bool)
+{
+  return s_fake.bos[bo].host.data();
+}
+
+static int
+fake_sync_bo(xclDeviceHandle, unsigned int bo, xclBOSyncDirection dir, size_t size, size_t offset)
+{
+  auto& fbo = s_fake.bos[bo];
+  if (dir==XCL_BO_SYNC_BO_TO_DEVICE) {
+    std::memcpy(fbo.dev.data() + offset,fbo.host.data() + offset,size);
+    return 0;
+  }
+  auto src = reinterpret_cast<const uint32_t*>(fbo.dev.data() + offset);
+  auto dst = reinterpret_cast<uint32_t*>(fbo.host.data() + offset);
+  for (size_t i = 0; i < size/4; ++i)
+    dst[i] = __builtin_bswap32(src[i]);
+  return 0;
+}
+
+static size_t
+fake_write_bo(xclDeviceHandle, unsigned int bo, const void* src, size_t size, size_t seek)
+{
+  std::memcpy(s_fake.bos[bo].dev.data() + seek,src,size);
+  return size;
+}
+
+static size_t
+fake_read_bo(xclDeviceHandle, unsigned int bo, void* dst, size_t size, size_t skip)
+{
+  std::memcpy(dst,s_fake.bos[bo].dev.data() + skip,size);
+  return size;
+}
+
+static size_t
+fake_read(xclDeviceHandle, xclAddressSpace, uint64_t, void* buf, size_t size)
+{
+  std::memcpy(buf,&s_fake.reg,std::min(size,sizeof(s_fake.reg)));
+  s_fake.reg++;
+  return size;
+}
+
+static unsigned int
+fake_exec_buf(xclDeviceHandle, unsigned int bo)
+{
+  auto packet = reinterpret_cast<ert_packet*>(s_fake.bos[bo].host.data());
+  if (packet->state != ERT_CMD_STATE_NEW)
+    return -EINVAL;
+  s_fake.running.push_back(bo);
+  return 0;
+}
+
+static int
+fake_exec_wait(xclDeviceHandle, int)
+{
+  for (auto bo : s_fake.running) {
+    auto packet = reinterpret_cast<ert_packet*>(s_fake.bos[bo].host.data());
+    packet->state = ERT_CMD_STATE_COMPLETED;
+  }
+  bool completed = !s_fake.running.empty();
+  s_fake.running.clear();
+  return completed ? 1 : 0;
+}
+
+struct results
+{
+  std::vector<char> synced;
+  std::vector<char> read;
+  uint32_t reg = 0;
+  uint32_t state = 0;
+};
+
+// The same calls, first recorded against the fake shim then replayed
+static results
+run(operations& ops)
+{
+  results r;
+  auto handle = ops.mOpen(0,nullptr,XCL_QUIET);
+  BOOST_REQUIRE(handle);
+
+  auto bo = ops.mAllocBO(handle,4096,XCL_BO_DEVICE_RAM,0);
+  auto data = static_cast<char*>(ops.mMapBO(handle,bo,true));
+  BOOST_REQUIRE(data);
+  for (int i = 0; i < 4096; ++i)
+    data[i] = i < 1024 ? 0 : i;     // zeros and literals
+  BOOST_CHECK_EQUAL(ops.mSyncBO(handle,bo,XCL_BO_SYNC_BO_TO_DEVICE,4096,0),0);
+  BOOST_CHECK_EQUAL(ops.mSyncBO(handle,bo,XCL_BO_SYNC_BO_FROM_DEVICE,2048,1024),0);
+  r.synced.assign(data,data + 4096);
+
+  std::vector<char> src(100,0x5a);
+  BOOST_CHECK_EQUAL(ops.mWriteBO(handle,bo,src.data(),src.size(),8),src.size());
+  r.read.resize(128);
+  BOOST_CHECK_EQUAL(ops.mReadBO(handle,bo,r.read.data(),r.read.size(),0),r.read.size());
+  BOOST_CHECK_EQUAL(ops.mRead(handle,XCL_ADDR_KERNEL_CTRL,0x10,&r.reg,4),4);
+
+  auto cmd = ops.mAllocBO(handle,4096,XCL_BO_SHARED_VIRTUAL,0);
+  auto packet = static_cast<ert_packet*>(ops.mMapBO(handle,cmd,true));
+  BOOST_REQUIRE(packet);
+  packet->state = ERT_CMD_STATE_QUEUED;
+  BOOST_CHECK(ops.mExecBuf(handle,cmd)!=0);   // rejected, never completes
+  packet->state = ERT_CMD_STATE_NEW;
+  BOOST_CHECK_EQUAL(ops.mExecBuf(handle,cmd),0);
+  while (ops.mExecWait(handle,1000)==0)
+    ;
+  r.state = packet->state;
+
+  ops.mFreeBO(handle,cmd);
+  ops.mFreeBO(handle,bo);
+  ops.mClose(handle);
+  return r;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE( test_halrecord_replay )
+{
+  auto dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+
+  operations fake("fake",nullptr,1);
+  fake.mOpen = &fake_open;
+  fake.mClose = &fake_close;
+  fake.mAllocBO = &fake_alloc_bo;
+  fake.mFreeBO = &fake_free_bo;
+  fake.mMapBO = &fake_map_bo;
+  fake.mSyncBO = &fake_sync_bo;
+  fake.mWriteBO = &fake_write_bo;
+  fake.mReadBO = &fake_read_bo;
+  fake.mRead = &fake_read;
+  fake.mExecBuf = &fake_exec_buf;
+  fake.mExecWait = &fake_exec_wait;
+
+  BOOST_REQUIRE(record(fake,dir.string(),1));
+  auto recorded = run(fake);
+  BOOST_CHECK_EQUAL(recorded.reg,0x1234);
+  BOOST_CHECK_EQUAL(recorded.state,ERT_CMD_STATE_COMPLETED);
+
+  // nothing of the fake shim is used by the replay
+  s_fake = fake_device();
+  s_fake.reg = 0;
+  auto ops = replay(dir.string());
+  BOOST_CHECK_EQUAL(ops->getDeviceCount(),1);
+  auto replayed = run(*ops);
+  BOOST_CHECK(replayed.synced == recorded.synced);
+  BOOST_CHECK(replayed.read == recorded.read);
+  BOOST_CHECK_EQUAL(replayed.reg,recorded.reg);
+  BOOST_CHECK_EQUAL(replayed.state,ERT_CMD_STATE_COMPLETED);
+  BOOST_CHECK(s_fake.bos.empty());
+
+  boost::filesystem::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,146 @@
+/**
+ * Copyright (C) 2018 Xilinx, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+////////////////////////////////////////////////////////////////
+// Unit testing of xrt/util/placement.h
+////////////////////////////////////////////////////////////////
+#include <boost/test/unit_test.hpp>
+
+#include "xrt/util/placement.h"
+
+#include <sstream>
+
+BOOST_AUTO_TEST_SUITE ( test_placement )
+
+namespace {
+
+using namespace xrt::placement;
+
+static cu_usage
+make_cu(const std::string& kernel, const std::string& cu, unsigned int calls, double busy)
+{
+  cu_usage usage;
+  usage.kernel = kernel;
+  usage.cu = cu;
+  usage.calls = calls;
+  usage.busy_msec = busy;
+  return usage;
+}
+
+static arg_usage
+make_arg(const std::string& kernel, const std::string& arg,
+         std::vector<std::string> banks, uint64_t bytes)
+{
+  arg_usage usage;
+  usage.kernel = kernel;
+  usage.arg = arg;
+  usage.banks = std::move(banks);
+  usage.bytes = bytes;
+  return usage;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE( test_placement_banks )
+{
+  // Two heavy args sharing two banks must be split, light arg goes
+  // to the bank that ends up least loaded
+  profile prof;
+  prof.args.push_back(make_arg("vadd","a",{"DDR[0]","DDR[1]"},1000));
+  prof.args.push_back(make_arg("vadd","b",{"DDR[0]","DDR[1]"},900));
+  prof.args.push_back(make_arg("vadd","c",{"DDR[0]","DDR[1]"},50));
+  prof.args.push_back(make_arg("vadd","d",{"DDR[1]"},10));
+
+  auto p = advise(prof);
+  BOOST_CHECK_EQUAL(p.get_arg_bank("vadd","a"),"DDR[0]");
+  BOOST_CHECK_EQUAL(p.get_arg_bank("vadd","b"),"DDR[1]");
+  BOOST_CHECK_EQUAL(p.get_arg_bank("vadd","c"),"DDR[1]");
+  BOOST_CHECK_EQUAL(p.get_arg_bank("vadd","d"),"DDR[1]");
+  BOOST_CHECK_EQUAL(p.default_bank,"DDR[1]");
+  BOOST_CHECK_EQUAL(p.get_arg_bank("vadd","bogus"),"");
+}
+
+BOOST_AUTO_TEST_CASE( test_placement_host_traffic )
+{
+  // Host traffic already saturates DDR[0]
+  profile prof;
+  prof.bank_bytes["DDR[0]"] = 1 << 20;
+  prof.bank_bytes["DDR[1]"] = 0;
+  prof.args.push_back(make_arg("mmult","in",{"DDR[0]","DDR[1]"},4096));
+  prof.args.push_back(make_arg("mmult","out",{"DDR[0]"},4096));
+  prof.args.push_back(make_arg("mmult","unconnected",{},4096));
+
+  auto p = advise(prof);
+  BOOST_CHECK_EQUAL(p.get_arg_bank("mmult","in"),"DDR[1]");
+  BOOST_CHECK_EQUAL(p.get_arg_bank("mmult","out"),"DDR[0]");
+  BOOST_CHECK_EQUAL(p.get_arg_bank("mmult","unconnected"),"");
+  BOOST_CHECK_EQUAL(p.default_bank,"DDR[1]");
+
+  // No kernel args, default bank from host traffic alone
+  profile host;
+  host.bank_bytes["DDR[0]"] = 10;
+  host.bank_bytes["DDR[1]"] = 20;
+  BOOST_CHECK_EQUAL(advise(host).default_bank,"DDR[0]");
+}
+
+BOOST_AUTO_TEST_CASE( test_placement_cus )
+{
+  profile prof;
+  prof.device_msec = 100.0;
+  prof.cus.push_back(make_cu("vadd","vadd_1",20,90.0));
+  prof.cus.push_back(make_cu("vadd","vadd_2",5,50.0));
+  prof.cus.push_back(make_cu("vadd","vadd_3",1,5.0));
+  prof.cus.push_back(make_cu("vadd","vadd_4",0,0.0));
+
+  auto p = advise(prof);
+  BOOST_CHECK(p.get_cu_state("vadd_1")==cu_state::over);
+  BOOST_CHECK(p.get_cu_state("vadd_2")==cu_state::balanced);
+  BOOST_CHECK(p.get_cu_state("vadd_3")==cu_state::under);
+  BOOST_CHECK(p.get_cu_state("vadd_4")==cu_state::idle);
+  BOOST_CHECK(p.get_cu_state("bogus")==cu_state::balanced);
+
+  // No device time recorded, every called CU is under subscribed
+  prof.device_msec = 0.0;
+  BOOST_CHECK(advise(prof).get_cu_state("vadd_1")==cu_state::under);
+}
+
+BOOST_AUTO_TEST_CASE( test_placement_roundtrip )
+{
+  profile prof;
+  prof.device_msec = 10.0;
+  prof.cus.push_back(make_cu("vadd","vadd_1",4,9.0));
+  prof.cus.push_back(make_cu("vadd","vadd_2",0,0.0));
+  prof.args.push_back(make_arg("vadd","a",{"bank0","bank1"},100));
+  prof.args.push_back(make_arg("vadd","b",{"bank0","bank1"},100));
+
+  auto p1 = advise(prof);
+  std::stringstream ss;
+  write(p1,ss);
+  auto p2 = read(ss);
+
+  BOOST_CHECK_EQUAL(p2.default_bank,p1.default_bank);
+  BOOST_CHECK(p2.arg_bank==p1.arg_bank);
+  BOOST_CHECK(p2.cus==p1.cus);
+  BOOST_CHECK(!p2.empty());
+
+  std::stringstream empty;
+  BOOST_CHECK(read(empty).empty());
+
+  std::stringstream bad("[cu]\nvadd_1=busy\n");
+  BOOST_CHECK_THROW(read(bad),std::runtime_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -130,6 +130,41 @@ get_stall_trace()
   return value;
 }
 
+inline unsigned int
+get_profile_sample_rate()
+{
+  static unsigned int value = (!get_profile()) ? 1 : detail::get_uint_value("Debug.profile_sample_rate",1);
+  return value;
+}
+
+inline unsigned int
+get_profile_checkpoint_interval()
+{
+  static unsigned int value = (!get_profile()) ? 0 : detail::get_uint_value("Debug.profile_checkpoint_interval",0);
+  return value;
+}
+
+inline bool
+get_profile_dump_on_signal()
+{
+  static bool value = get_profile() && detail::get_bool_value("Debug.profile_dump_on_signal",false);
+  return value;
+}
+
+inline std::string
+get_profile_session()
+{
+  static std::string value = (!get_profile()) ? "" : detail::get_string_value("Debug.profile_session","");
+  return value;
+}
+
+inline bool
+get_placement_advice()
+{
+  static bool value = get_profile() && detail::get_bool_value("Debug.placement_advice",false);
+  return value;
+}
+
 inline bool
 get_timeline_trace()
 {
@@ -278,6 +313,13 @@ get_ert_slotsize()
   return value;
 }
 
+inline std::string
+get_placement_plan()
+{
+  static std::string value = detail::get_string_value("Runtime.placement_plan","");
+  return value;
+}
+
 inline std::string
 get_hw_em_driver()
 {
@@ -292,6 +334,27 @@ get_sw_em_driver()
   return value;
 }
 
+/**
+ * Directory to record the calls into the HAL shim to
+ */
+inline std::string
+get_hal_record()
+{
+  static std::string value = detail::get_string_value("Runtime.hal_record","");
+  return value;
+}
+
+/**
+ * Directory with a recording to serve the HAL calls from instead of a
+ * shim, no card or emulator is used
+ */
+inline std::string
+get_hal_replay()
+{
+  static std::string value = detail::get_string_value("Runtime.hal_replay","");
+  return value;
+}
+
 }}
 
 #endif
@@ -0,0 +1,222 @@
+/**
+ * Copyright (C) 2018 Xilinx, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "placement.h"
+#include "config_reader.h"
+#include "message.h"
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/ini_parser.hpp>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+static std::string
+arg_key(const std::string& kernel, const std::string& arg)
+{
+  return kernel + "/" + arg;
+}
+
+// Least loaded bank among candidates, first candidate wins ties
+static std::string
+least_loaded(const std::vector<std::string>& candidates,
+             const std::map<std::string,uint64_t>& load)
+{
+  std::string bank;
+  uint64_t min = 0;
+  for (auto& candidate : candidates) {
+    auto itr = load.find(candidate);
+    auto bytes = (itr == load.end()) ? 0 : (*itr).second;
+    if (bank.empty() || bytes < min) {
+      bank = candidate;
+      min = bytes;
+    }
+  }
+  return bank;
+}
+
+static xrt::placement::plan
+load_plan()
+{
+  xrt::placement::plan p;
+  auto path = xrt::config::get_placement_plan();
+  if (path.empty())
+    return p;
+
+  std::ifstream istr(path);
+  if (!istr) {
+    xrt::message::send(xrt::message::severity_level::WARNING,
+                       "Unable to open placement plan '" + path + "'");
+    return p;
+  }
+
+  try {
+    p = xrt::placement::read(istr);
+  }
+  catch (const std::exception& ex) {
+    xrt::message::send(xrt::message::severity_level::WARNING,
+                       "Ignoring placement plan '" + path + "': " + ex.what());
+  }
+  return p;
+}
+
+} // namespace
+
+namespace xrt { namespace placement {
+
+std::string
+plan::
+get_arg_bank(const std::string& kernel, const std::string& arg) const
+{
+  auto itr = arg_bank.find(arg_key(kernel,arg));
+  return (itr == arg_bank.end()) ? "" : (*itr).second;
+}
+
+cu_state
+plan::
+get_cu_state(const std::string& cu) const
+{
+  auto itr = cus.find(cu);
+  return (itr == cus.end()) ? cu_state::balanced : (*itr).second;
+}
+
+plan
+advise(const profile& prof)
+{
+  plan p;
+
+  // Bank load starts out with host traffic
+  auto load = prof.bank_bytes;
+
+  // Place heaviest arguments first
+  std::vector<const arg_usage*> args;
+  for (auto& arg : prof.args)
+    if (!arg.banks.empty())
+      args.push_back(&arg);
+  std::stable_sort(args.begin(),args.end(),
+                   [](const arg_usage* a1, const arg_usage* a2) { return a1->bytes > a2->bytes; });
+
+  std::vector<std::string> connected;
+  for (auto arg : args) {
+    auto key = arg_key(arg->kernel,arg->arg);
+    if (p.arg_bank.count(key))
+      continue;
+    auto bank = least_loaded(arg->banks,load);
+    p.arg_bank[key] = bank;
+    load[bank] += arg->bytes;
+    for (auto& candidate : arg->banks)
+      if (std::find(connected.begin(),connected.end(),candidate) == connected.end())
+        connected.push_back(candidate);
+  }
+
+  // Buffers without kernel affinity go to the least loaded bank that
+  // is reachable from some kernel, or any bank if none is known
+  if (connected.empty())
+    for (auto& bb : prof.bank_bytes)
+      connected.push_back(bb.first);
+  p.default_bank = least_loaded(connected,load);
+
+  for (auto& cu : prof.cus) {
+    auto util = (prof.device_msec > 0.0) ? cu.busy_msec / prof.device_msec : 0.0;
+    if (cu.calls == 0)
+      p.cus[cu.cu] = cu_state::idle;
+    else if (util < under_threshold)
+      p.cus[cu.cu] = cu_state::under;
+    else if (util > over_threshold)
+      p.cus[cu.cu] = cu_state::over;
+    else
+      p.cus[cu.cu] = cu_state::balanced;
+  }
+
+  return p;
+}
+
+std::string
+to_string(cu_state state)
+{
+  switch (state) {
+  case cu_state::idle:
+    return "idle";
+  case cu_state::under:
+    return "under";
+  case cu_state::over:
+    return "over";
+  default:
+    return "balanced";
+  }
+}
+
+cu_state
+to_cu_state(const std::string& str)
+{
+  if (str == "idle")
+    return cu_state::idle;
+  if (str == "under")
+    return cu_state::under;
+  if (str == "over")
+    return cu_state::over;
+  if (str == "balanced")
+    return cu_state::balanced;
+  throw std::runtime_error("bad cu state '" + str + "'");
+}
+
+void
+write(const plan& p, std::ostream& ostr)
+{
+  ostr << "[default]\n";
+  if (!p.default_bank.empty())
+    ostr << "bank=" << p.default_bank << "\n";
+
+  ostr << "\n[arg_bank]\n";
+  for (auto& ab : p.arg_bank)
+    ostr << ab.first << "=" << ab.second << "\n";
+
+  ostr << "\n[cu]\n";
+  for (auto& cu : p.cus)
+    ostr << cu.first << "=" << to_string(cu.second) << "\n";
+}
+
+plan
+read(std::istream& istr)
+{
+  boost::property_tree::ptree tree;
+  boost::property_tree::ini_parser::read_ini(istr,tree);
+
+  plan p;
+  if (auto section = tree.get_child_optional("default"))
+    p.default_bank = section->get<std::string>("bank","");
+
+  if (auto section = tree.get_child_optional("arg_bank"))
+    for (auto& ab : *section)
+      p.arg_bank[ab.first] = ab.second.data();
+
+  if (auto section = tree.get_child_optional("cu"))
+    for (auto& cu : *section)
+      p.cus[cu.first] = to_cu_state(cu.second.data());
+
+  return p;
+}
+
+const plan&
+get_plan()
+{
+  static plan p = load_plan();
+  return p;
+}
+
+}} // placement,xrt
@@ -0,0 +1,155 @@
+/**
+ * Copyright (C) 2018 Xilinx, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef xrt_util_placement_h_
+#define xrt_util_placement_h_
+
+#include <map>
+#include <string>
+#include <vector>
+#include <iosfwd>
+#include <cstdint>
+
+namespace xrt { namespace placement {
+
+/**
+ * Profile guided placement
+ *
+ * The profiler summarizes a run into a placement::profile, which is
+ * turned into a placement::plan by advise().  The plan is written
+ * as an ini file and loaded by the runtime on a later run (see
+ * Runtime.placement_plan) where it steers buffer bank allocation
+ * and compute unit selection.
+ */
+
+/**
+ * Recorded usage of one compute unit
+ */
+struct cu_usage
+{
+  std::string kernel;
+  std::string cu;
+  unsigned int calls = 0;
+  double busy_msec = 0.0;
+};
+
+/**
+ * Recorded device side traffic of one kernel argument
+ *
+ * @banks lists the memory banks (bank tags) the argument is connected
+ * to in the xclbin, these are the only legal placements.
+ */
+struct arg_usage
+{
+  std::string kernel;
+  std::string arg;
+  std::vector<std::string> banks;
+  uint64_t bytes = 0;
+};
+
+struct profile
+{
+  // Total time the device was busy
+  double device_msec = 0.0;
+  std::vector<cu_usage> cus;
+  std::vector<arg_usage> args;
+  // Host transfer bytes per memory bank
+  std::map<std::string,uint64_t> bank_bytes;
+};
+
+enum class cu_state { balanced, idle, under, over };
+
+/**
+ * Utilization thresholds (fraction of device busy time) that
+ * classify a compute unit as under or over subscribed
+ */
+constexpr double under_threshold = 0.2;
+constexpr double over_threshold = 0.8;
+
+struct plan
+{
+  // Bank for buffers with no kernel argument affinity
+  std::string default_bank;
+  // "kernel/arg" -> bank tag
+  std::map<std::string,std::string> arg_bank;
+  // cu name -> state
+  std::map<std::string,cu_state> cus;
+
+  bool
+  empty() const
+  {
+    return default_bank.empty() && arg_bank.empty() && cus.empty();
+  }
+
+  /**
+   * @return
+   *   Bank tag for kernel argument, or empty string if plan has no
+   *   advice for the argument
+   */
+  std::string
+  get_arg_bank(const std::string& kernel, const std::string& arg) const;
+
+  /**
+   * @return
+   *   State of compute unit, balanced if plan has no advice for the CU
+   */
+  cu_state
+  get_cu_state(const std::string& cu) const;
+};
+
+/**
+ * Compute a placement plan from a recorded profile
+ *
+ * Arguments are placed greedily, largest traffic first, on the least
+ * loaded of their connected banks.  Bank load is seeded with the host
+ * transfer bytes.  Compute units are classified by utilization.
+ */
+plan
+advise(const profile& prof);
+
+std::string
+to_string(cu_state state);
+
+cu_state
+to_cu_state(const std::string& str);
+
+/**
+ * Write plan in ini format
+ */
+void
+write(const plan& p, std::ostream& ostr);
+
+/**
+ * Read plan in ini format
+ *
+ * @return
+ *   Parsed plan, throws on malformed input
+ */
+plan
+read(std::istream& istr);
+
+/**
+ * Get the plan named by Runtime.placement_plan
+ *
+ * The plan is loaded once, an empty plan is returned if no plan file
+ * is configured or if it cannot be read.
+ */
+const plan&
+get_plan();
+
+}} // placement,xrt
+
+#endif
@@ -69,6 +69,9 @@ extern "C" {
  * @typedef XmaFrameFormatDesc
  * Member data structure describing video format and frame count
  *
+ * @typedef XmaFramePool
+ * Opaque pool of frames backed by pre-allocated device buffers
+ *
 */
 
 /**
@@ -104,6 +107,8 @@ typedef struct XmaBufferRef
     XmaBufferType   buffer_type; /**< location of buffer */
     void           *buffer; /**< data */
     bool            is_clone; /**< buffer member allocated externally */
+    uint32_t        bo_handle; /**< device buffer handle (XMA_DEVICE_BUFFER_TYPE only) */
+    uint64_t        paddr; /**< device physical address (XMA_DEVICE_BUFFER_TYPE only) */
 } XmaBufferRef;
 
 /**
@@ -131,6 +136,9 @@ typedef struct XmaFrameProperties
     int32_t         bits_per_pixel; /**< bits per pixel of primary plane */
 } XmaFrameProperties;
 
+typedef struct XmaSession XmaSession;
+typedef struct XmaFramePool XmaFramePool;
+
 /**
  * @struct XmaFrame
  * Data structure describing a raw video frame and its buffers
@@ -145,6 +153,7 @@ typedef struct XmaFrame
     int32_t            is_idr; /**< flag indicating that frame should be treated as an IDR frame */
     int32_t            do_not_encode; /**< flag instruction to not encode frame */
     int32_t            is_last_frame; /**< flag indicating this is the last frame to encode */
+    XmaFramePool      *pool; /**< pool the frame returns to when freed, NULL if none */
 } XmaFrame;
 
 /**
@@ -199,6 +208,22 @@ xma_frame_alloc(XmaFrameProperties *frame_props);
 int32_t
 xma_frame_planes_get(XmaFrameProperties *frame_props);
 
+/**
+ * Return the size in bytes of one plane of the frame specified
+ *
+ * Chroma planes of YUV420 are subsampled horizontally and vertically,
+ * those of YUV422 horizontally only.  bits_per_pixel is the depth of
+ * one component, except that RGB888 also takes the depth of a whole
+ * pixel (24 or more).  Components deeper than 8 bits occupy two bytes.
+ *
+ * @param [in] frame_props Properties of frame being queried
+ * @param [in] plane Index of plane
+ *
+ * @returns size of plane in bytes, 0 if plane is not part of the format
+*/
+size_t
+xma_frame_plane_size_get(XmaFrameProperties *frame_props, int32_t plane);
+
 /**
  * Wraps buffers described in XmaFrameData into XmaFrame container
  *
@@ -224,6 +249,92 @@ xma_frame_from_buffers_clone(XmaFrameProperties *frame_props,
 void
 xma_frame_free(XmaFrame *frame);
 
+/**
+ * Take an additional reference on all planes of a frame
+ *
+ * @param frame frame instance to reference
+ *
+ * @note: Each reference must be released with @ref xma_frame_free().
+ * Reference counts are updated atomically so a frame may be released
+ * from a different thread than the one that referenced it.
+*/
+void
+xma_frame_add_ref(XmaFrame *frame);
+
+/**
+ * Create a pool of frames backed by device buffers of a session
+ *
+ * Every plane of every frame is allocated once as a device buffer in
+ * the DDR bank of the session and mapped into host memory.  Frames
+ * obtained with @ref xma_frame_pool_get() are of type
+ * XMA_DEVICE_BUFFER_TYPE: the application fills the mapped planes in
+ * place and the plugin only needs to sync them to the device, saving
+ * the host copies of @ref xma_frame_alloc() frames.
+ *
+ * @param [in] session Session whose device and DDR bank back the pool
+ *  (e.g. (XmaSession*)enc_session)
+ * @param [in] frame_props Description of the frames of the pool
+ * @param [in] num_frames Number of frames in the pool
+ *
+ * @returns XmaFramePool pointer, NULL on failure
+*/
+XmaFramePool*
+xma_frame_pool_create(XmaSession         *session,
+                      XmaFrameProperties *frame_props,
+                      int32_t             num_frames);
+
+/**
+ * Get a free frame from a frame pool
+ *
+ * @param [in] pool Pool to get frame from
+ *
+ * @returns XmaFrame pointer with a single reference, NULL if all frames
+ *  of the pool are in use
+ *
+ * @note: The frame returns to the pool when its last reference is
+ * released with @ref xma_frame_free().
+*/
+XmaFrame*
+xma_frame_pool_get(XmaFramePool *pool);
+
+/**
+ * Get a free frame from a frame pool, waiting for one to be released
+ *
+ * @param [in] pool Pool to get frame from
+ * @param [in] timeout_ms Maximum time to wait in milliseconds, -1 to
+ *  wait until a frame is released
+ *
+ * @returns XmaFrame pointer with a single reference, NULL if no frame
+ *  was released in time
+*/
+XmaFrame*
+xma_frame_pool_get_wait(XmaFramePool *pool, int32_t timeout_ms);
+
+/**
+ * Free a frame pool and its device buffers
+ *
+ * @param [in] pool Pool to destroy
+ *
+ * @returns XMA_SUCCESS on success, XMA_ERROR if frames of the pool are
+ *  still in use (pool is left intact)
+ *
+ * @note: Must be called before the session backing the pool is destroyed.
+*/
+int32_t
+xma_frame_pool_destroy(XmaFramePool *pool);
+
+/**
+ * Give up ownership of a frame pool
+ *
+ * The pool and its device buffers are freed once all of its frames have
+ * been released, immediately if none is in use.  The pool must not be
+ * used after this call other than by releasing frames.
+ *
+ * @param [in] pool Pool to release
+*/
+void
+xma_frame_pool_release(XmaFramePool *pool);
+
 /**
  * Allocate a single buffer and return as XmaDataBuffer pointer
  *
@@ -54,6 +54,12 @@ extern "C" {
  *  @li @ref xma_enc_session_send_frame()
  *  @li @ref xma_enc_session_recv_data()
  *
+ *  Sessions can optionally pipeline frames with:
+ *
+ *  @li @ref xma_enc_session_async_start()
+ *  @li @ref xma_enc_session_send_frame_async()
+ *  @li @ref xma_enc_session_async_flush()
+ *
  *  A media framework (such as FFmpeg) is responsible for creating an encoder
  *  session.  The encoder session contains state information used by the
  *  encoder plugin to manage the hardware associated with a Xilinx accelerator
@@ -381,6 +387,71 @@ int32_t
 xma_enc_session_recv_data(XmaEncoderSession *session,
                           XmaDataBuffer     *data,
                           int32_t           *data_size);
+
+/**
+ *  @brief Callback reporting a frame sent with
+ *  xma_enc_session_send_frame_async() has been encoded
+ *
+ *  Called on an XMA thread, in submission order.  status is the value
+ *  xma_enc_session_send_frame() would have returned, or the error of the
+ *  stage that failed.  data and data_size hold the encoded output, if any.
+*/
+typedef void (*XmaEncoderAsyncDone)(XmaEncoderSession *session,
+                                    XmaFrame          *frame,
+                                    XmaDataBuffer     *data,
+                                    int32_t            data_size,
+                                    int32_t            status,
+                                    void              *user_data);
+
+/**
+ *  @brief Switch an encoder session to pipelined (asynchronous) mode
+ *
+ *  Up to depth frames are in flight at once.  Transfer to the device,
+ *  kernel execution and transfer back run on separate threads so that
+ *  consecutive frames overlap when the plugin supports it (see
+ *  plg/xmaasync.h).  Once enabled, frames must be sent with
+ *  xma_enc_session_send_frame_async() until the session is destroyed.
+ *
+ *  @param session Pointer to session created by xma_enc_session_create
+ *  @param depth   Maximum number of frames in flight; may be lowered to
+ *                 the number of buffer sets of the plugin
+ *  @param done    Completion callback, called once per frame
+ *
+ *  @return XMA_SUCCESS on success
+ *  @return XMA_ERROR_INVALID if already enabled or arguments are invalid
+*/
+int32_t
+xma_enc_session_async_start(XmaEncoderSession   *session,
+                            int32_t              depth,
+                            XmaEncoderAsyncDone  done);
+
+/**
+ *  @brief Queue a frame on an asynchronous encoder session
+ *
+ *  Returns as soon as the frame is queued; blocks while depth frames
+ *  are in flight.  frame and data must stay valid until the completion
+ *  callback for this frame has been called.
+ *
+ *  @param session   Pointer to session in asynchronous mode
+ *  @param frame     Frame to encode
+ *  @param data      Buffer receiving the encoded output of this frame
+ *  @param user_data Passed back to the completion callback
+ *
+ *  @return XMA_SUCCESS on success
+ *  @return XMA_ERROR_INVALID if the session is not in asynchronous mode
+*/
+int32_t
+xma_enc_session_send_frame_async(XmaEncoderSession *session,
+                                 XmaFrame          *frame,
+                                 XmaDataBuffer     *data,
+                                 void              *user_data);
+
+/**
+ *  @brief Wait until all frames queued on an asynchronous encoder
+ *  session have completed
+*/
+int32_t
+xma_enc_session_async_flush(XmaEncoderSession *session);
 /**
  * @}
  */
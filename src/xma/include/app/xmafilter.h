@@ -193,6 +193,58 @@ xma_filter_session_send_frame(XmaFilterSession *session,
 int32_t
 xma_filter_session_recv_frame(XmaFilterSession *session,
                               XmaFrame         *frame);
+
+/**
+ *  @brief Callback reporting a frame sent with
+ *  xma_filter_session_send_frame_async() has been filtered
+ *
+ *  Called on an XMA thread, in submission order, with the output frame
+ *  passed to the send call.
+*/
+typedef void (*XmaFilterAsyncDone)(XmaFilterSession *session,
+                                   XmaFrame         *frame,
+                                   XmaFrame         *output,
+                                   int32_t           status,
+                                   void             *user_data);
+
+/**
+ *  @brief Switch a filter session to pipelined (asynchronous) mode
+ *
+ *  See xma_enc_session_async_start().
+ *
+ *  @param session Pointer to session created by xma_filter_session_create
+ *  @param depth   Maximum number of frames in flight
+ *  @param done    Completion callback, called once per frame
+ *
+ *  @return XMA_SUCCESS on success
+ *  @return XMA_ERROR_INVALID if already enabled or arguments are invalid
+*/
+int32_t
+xma_filter_session_async_start(XmaFilterSession   *session,
+                               int32_t             depth,
+                               XmaFilterAsyncDone  done);
+
+/**
+ *  @brief Queue a frame on an asynchronous filter session
+ *
+ *  frame and output must stay valid until the completion callback for
+ *  this frame has been called.
+ *
+ *  @return XMA_SUCCESS on success
+ *  @return XMA_ERROR_INVALID if the session is not in asynchronous mode
+*/
+int32_t
+xma_filter_session_send_frame_async(XmaFilterSession *session,
+                                    XmaFrame         *frame,
+                                    XmaFrame         *output,
+                                    void             *user_data);
+
+/**
+ *  @brief Wait until all frames queued on an asynchronous filter
+ *  session have completed
+*/
+int32_t
+xma_filter_session_async_flush(XmaFilterSession *session);
 /**
  * @}
  */
@@ -59,6 +59,31 @@ typedef enum XmaLogLevelType
 */
 typedef void (*XmaLoggerCallback)(char *msg); 
 
+/**
+ * @typedef XmaLogSite
+ * Logging state of one xma_logmsg() call site. Used internally.
+*/
+
+/** Maximum number of arguments of a deferred log message */
+#define XMA_LOG_MAX_ARGS 16
+
+/**
+ * @struct XmaLogSite
+ * Logging state of one xma_logmsg() call site. Used internally.
+*/
+typedef struct XmaLogSite
+{
+    int32_t   parsed; /**< 1 if arg_type is valid, -1 if format is not deferrable */
+    int32_t   num_args; /**< number of arguments of format */
+    uint8_t   arg_type[XMA_LOG_MAX_ARGS]; /**< argument types of format */
+    uint64_t  window; /**< current rate limit window in seconds */
+    uint32_t  count; /**< messages logged in current window */
+    uint32_t  suppressed; /**< messages suppressed since last logged */
+} XmaLogSite;
+
+/** Highest level any log destination accepts. Used internally. */
+extern int32_t xma_log_level_max;
+
 /**
  * @brief Log a message
  *
@@ -78,6 +103,54 @@ typedef void (*XmaLoggerCallback)(char *msg);
 void
 xma_logmsg(XmaLogLevelType level, const char *name, const char *msg, ...);
 
+/**
+ * @brief Log a message from a call site
+ *
+ * Implementation of the xma_logmsg() macro.  Messages are timestamped
+ * and queued unformatted: the format string is kept by pointer, so it
+ * must be a string literal or otherwise outlive the message.  String
+ * arguments are copied.  Formatting and output happen on the logger
+ * thread.
+ *
+ * @param site  Call site state
+ * @param level Logging level associated with the message
+ * @param name  Name of the entity generating the log message
+ * @param msg   Format string, must remain valid after the call
+ * @param ...   Arguments of the format string
+*/
+void
+xma_logmsg_site(XmaLogSite *site, XmaLogLevelType level, const char *name,
+                const char *msg, ...);
+
+/**
+ * @brief Limit the rate of log messages per call site
+ *
+ * Each xma_logmsg() call site emits at most msgs_per_sec messages per
+ * second, further messages are counted and the count is reported with
+ * the next message of that call site.
+ *
+ * @param msgs_per_sec Maximum messages per second and call site, 0 for
+ *                     no limit (default)
+*/
+void
+xma_logger_rate_limit_set(uint32_t msgs_per_sec);
+
+/*
+ * Messages above the configured levels cost a single compare.  Each
+ * call site caches its parsed format and rate limiting state.
+ *
+ * The format is queued by pointer, so it must be a string literal: the
+ * "" msg "" concatenation rejects any other format at compile time.  Log
+ * a run time string with "%s" or call (xma_logmsg)() instead.
+ */
+#define xma_logmsg(level, name, msg, ...)                                  \
+    do {                                                                   \
+        static XmaLogSite xma_log_site_;                                   \
+        if ((int32_t)(level) <= xma_log_level_max)                         \
+            xma_logmsg_site(&xma_log_site_, (level), (name), "" msg "",    \
+                            ##__VA_ARGS__);                                \
+    } while (0)
+
 /**
  * @brief Register a callback for XMA log msgs
  *
@@ -53,6 +53,12 @@ extern "C" {
  *  @li @ref xma_scaler_session_send_frame()
  *  @li @ref xma_scaler_session_recv_frame_list()
  *
+ *  Sessions can optionally pipeline frames with:
+ *
+ *  @li @ref xma_scaler_session_async_start()
+ *  @li @ref xma_scaler_session_send_frame_async()
+ *  @li @ref xma_scaler_session_async_flush()
+ *
  *  A media framework (such as FFmpeg) is responsible for creating a scaler
  *  session.  The scaler session contains state information used by the
  *  scaler plugin to manage the hardware associated with a Xilinx accelerator
@@ -253,6 +259,9 @@ extern "C" {
  * @typedef XmaScalerFilterProperties
  * Filter coefficients to be used by kernel
  *
+ * @typedef XmaScalerCoeffTable
+ * Polyphase filter bank generated for one scaling ratio
+ *
  * @typedef XmaScalerSession
  * Opaque pointer to a scaler kernel instance. Used to specify the scaler
  * instance for all scaler application interface APIs
@@ -306,6 +315,18 @@ typedef struct XmaScalerFilterProperties
     int16_t         v_coeff3[64][12]; /**< vertical coefficients 4 */
 } XmaScalerFilterProperties;
 
+/**
+ * @struct XmaScalerCoeffTable
+ * Polyphase filter bank generated for one scaling ratio
+ */
+typedef struct XmaScalerCoeffTable
+{
+    int32_t         in_size; /**< input width or height */
+    int32_t         out_size; /**< output width or height */
+    int32_t         taps; /**< taps per phase, centered in the 12 columns */
+    int16_t         coeff[64][12]; /**< 64 phases, each summing to 4096 */
+} XmaScalerCoeffTable;
+
 /* Forward declaration */
 typedef struct XmaSession XmaSession;
 typedef struct XmaScalerSession XmaScalerSession;
@@ -360,6 +381,27 @@ typedef struct XmaScalerProperties
 */
 void xma_scaler_default_filter_coeff_set(XmaScalerFilterProperties *props);
 
+/**
+ *  @brief Get the polyphase filter bank for a scaling ratio
+ *
+ *  This helper returns windowed sinc coefficients for scaling in_size
+ *  pixels to out_size pixels with a filter of taps taps.  Tables are
+ *  generated once per process and shared, so the sessions of an ABR
+ *  ladder with the same input and output sizes reuse them.  Copy
+ *  the coeff member into XmaScalerFilterProperties or the kernel.
+ *
+ *  @param in_size  Input width or height in pixels
+ *  @param out_size Output width or height in pixels
+ *  @param taps     Even number of taps from 2 to 12
+ *
+ *  @return         Table valid for the lifetime of the process
+ *  @return         NULL on invalid arguments or allocation failure
+ *
+ *  @note Thread safe.
+*/
+const XmaScalerCoeffTable*
+xma_scaler_filter_coeff_get(int32_t in_size, int32_t out_size, int32_t taps);
+
 /**
  *  @brief Create a scaler session
  *
@@ -443,6 +485,58 @@ xma_scaler_session_send_frame(XmaScalerSession *session,
 int32_t
 xma_scaler_session_recv_frame_list(XmaScalerSession *session,
                                   XmaFrame          **frame_list);
+
+/**
+ *  @brief Callback reporting a frame sent with
+ *  xma_scaler_session_send_frame_async() has been scaled
+ *
+ *  Called on an XMA thread, in submission order, with the frame list
+ *  passed to the send call.
+*/
+typedef void (*XmaScalerAsyncDone)(XmaScalerSession  *session,
+                                   XmaFrame          *frame,
+                                   XmaFrame         **frame_list,
+                                   int32_t            status,
+                                   void              *user_data);
+
+/**
+ *  @brief Switch a scaler session to pipelined (asynchronous) mode
+ *
+ *  See xma_enc_session_async_start().
+ *
+ *  @param session Pointer to session created by xma_scaler_session_create
+ *  @param depth   Maximum number of frames in flight
+ *  @param done    Completion callback, called once per frame
+ *
+ *  @return XMA_SUCCESS on success
+ *  @return XMA_ERROR_INVALID if already enabled or arguments are invalid
+*/
+int32_t
+xma_scaler_session_async_start(XmaScalerSession   *session,
+                               int32_t             depth,
+                               XmaScalerAsyncDone  done);
+
+/**
+ *  @brief Queue a frame on an asynchronous scaler session
+ *
+ *  frame and frame_list must stay valid until the completion callback
+ *  for this frame has been called.
+ *
+ *  @return XMA_SUCCESS on success
+ *  @return XMA_ERROR_INVALID if the session is not in asynchronous mode
+*/
+int32_t
+xma_scaler_session_send_frame_async(XmaScalerSession  *session,
+                                    XmaFrame          *frame,
+                                    XmaFrame         **frame_list,
+                                    void              *user_data);
+
+/**
+ *  @brief Wait until all frames queued on an asynchronous scaler
+ *  session have completed
+*/
+int32_t
+xma_scaler_session_async_flush(XmaScalerSession *session);
 /**
  * @}
  */
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2018, Xilinx Inc - All rights reserved
+ * Xilinx SDAccel Media Accelerator API
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+#ifndef _XMAAPP_STATS_H_
+#define _XMAAPP_STATS_H_
+
+/**
+ * @ingroup xma_app_intf
+ * @file app/xmastats.h
+ * XMA application interface to per-session performance statistics
+ */
+
+#include <stdint.h>
+#include <sys/types.h>
+#include "lib/xmalimits.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ *  @ingroup xma
+ *  @addtogroup xmastats xmastats.h
+ *  @{
+ *  @section xmastats_intro Xilinx Media Accelerator Session Statistics
+ *  Every decoder, encoder, scaler, filter and kernel session owns a block
+ *  of counters in the XMA resource database.  The counters are updated by
+ *  the session calls of the owning process and can be read at any time by
+ *  other processes, such as a monitoring tool, with xma_stats_list().
+ *  Reading does not require xma_initialize() and takes no locks; each
+ *  counter is consistent on its own but a block may mix counters from
+ *  before and after a concurrent update.
+ *
+ *  @code
+ *  #include <xma.h>
+ *
+ *  XmaSessionStats stats[MAX_STATS_SESSIONS];
+ *  int32_t i, cnt = xma_stats_list(stats, MAX_STATS_SESSIONS);
+ *
+ *  for (i = 0; i < cnt; i++)
+ *      printf("%d %s %lu frames\n", stats[i].pid, stats[i].vendor,
+ *             stats[i].frames_out);
+ *  @endcode
+ */
+
+/**
+ * @enum XmaStatsStage
+ * Latency histograms kept for each session
+*/
+typedef enum XmaStatsStage
+{
+    XMA_STATS_SEND = 0, /**< send_frame()/send_data()/write() call */
+    XMA_STATS_RECV,     /**< recv_frame()/recv_data()/read() call */
+    XMA_STATS_XFER_IN,  /**< asynchronous input transfer stage */
+    XMA_STATS_EXECUTE,  /**< asynchronous execute stage */
+    XMA_STATS_XFER_OUT, /**< asynchronous output transfer stage */
+    XMA_STATS_STAGES
+} XmaStatsStage;
+
+/** Number of latency histogram buckets */
+#define XMA_STATS_BUCKETS 32
+
+/**
+ * @struct XmaStatsHist
+ * Latency histogram.  Bucket 0 counts calls under 1 us and bucket n
+ * calls of 2^(n-1) us up to 2^n us; the last bucket is open ended.
+*/
+typedef struct XmaStatsHist
+{
+    uint64_t count;    /**< calls recorded */
+    uint64_t total_ns; /**< sum of latencies */
+    uint64_t max_ns;   /**< highest latency */
+    uint64_t buckets[XMA_STATS_BUCKETS]; /**< calls per latency range */
+} XmaStatsHist;
+
+/**
+ * @struct XmaSessionStats
+ * Counters of one session
+*/
+typedef struct XmaSessionStats
+{
+    pid_t        pid;          /**< owning process, 0 for an unused entry */
+    int32_t      session_type; /**< XmaSessionType of the session */
+    char         vendor[MAX_VENDOR_NAME]; /**< plugin vendor */
+    int32_t      dev_id;       /**< device of the kernel */
+    int32_t      kern_idx;     /**< kernel instance on the device */
+    int32_t      chan_id;      /**< channel id or -1 */
+    uint64_t     start_ns;     /**< CLOCK_MONOTONIC time of creation */
+    uint64_t     frames_in;    /**< frames or buffers sent to the plugin */
+    uint64_t     frames_out;   /**< frames or buffers received from it */
+    uint64_t     bytes_in;     /**< bytes sent to the plugin */
+    uint64_t     bytes_out;    /**< bytes received from the plugin */
+    uint64_t     plugin_ns;    /**< time spent in plugin callbacks */
+    int32_t      queue_depth;  /**< frames in flight (asynchronous mode) */
+    int32_t      queue_max;    /**< highest queue_depth */
+    XmaStatsHist latency[XMA_STATS_STAGES]; /**< per stage latencies */
+} XmaSessionStats;
+
+/**
+ *  @brief Copy the counters of all live sessions of all processes
+ *
+ *  Maps the XMA resource database read-only.  May be called by a process
+ *  that has not called xma_initialize().
+ *
+ *  @param stats Array receiving the counters
+ *  @param max   Number of entries in stats
+ *
+ *  @return      Number of entries copied, 0 if no XMA process is running,
+ *               or XMA_ERROR_INVALID on invalid arguments
+*/
+int32_t xma_stats_list(XmaSessionStats *stats, int32_t max);
+
+/**
+ *  @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
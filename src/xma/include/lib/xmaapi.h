@@ -37,6 +37,7 @@ typedef struct XmaSingleton
     XmaKernelPlugin   kernelcfg[MAX_PLUGINS];
     XmaResources      shm_res_cfg;
     bool              shm_freed;
+    struct XmaCfgCache *cfg_cache; /* startup snapshot, NULL once stored */
 } XmaSingleton;
 
 #ifdef __cplusplus
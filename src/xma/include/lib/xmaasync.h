@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2018, Xilinx Inc - All rights reserved
+ * Xilinx SDAccel Media Accelerator API
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+#ifndef _XMA_ASYNC_LIB_H_
+#define _XMA_ASYNC_LIB_H_
+
+#include "plg/xmaasync.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Called on the last stage thread once a job has left the pipeline */
+typedef void (*XmaAsyncComplete)(XmaSession *session, XmaAsyncJob *job,
+                                 void (*done)(void));
+
+/* Start the stage threads of session.  depth frames may be in flight,
+ * capped by stages->max_depth.  done is the application callback, passed
+ * back to complete as is. */
+int32_t xma_async_start(XmaSession           *session,
+                        const XmaAsyncPlugin *stages,
+                        int32_t               depth,
+                        XmaAsyncComplete      complete,
+                        void                (*done)(void));
+
+/* Queue a frame, waiting while depth frames are in flight.  frame is
+ * given to the stages, app_frame to the completion callback. */
+int32_t xma_async_submit(XmaSession *session,
+                         XmaFrame   *frame,
+                         XmaFrame   *app_frame,
+                         void       *output,
+                         void       *user_data);
+
+/* Wait until all queued frames have completed */
+int32_t xma_async_flush(XmaSession *session);
+
+/* Flush and stop the stage threads; no-op if session is not async */
+void xma_async_stop(XmaSession *session);
+
+static inline bool xma_async_enabled(XmaSession *session)
+{
+    return session->async != NULL;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
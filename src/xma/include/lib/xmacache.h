@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2018, Xilinx Inc - All rights reserved
+ * Xilinx SDAccel Media Accelerator API
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+#ifndef _XMA_CACHE_H_
+#define _XMA_CACHE_H_
+
+#include "lib/xmacfg.h"
+#include "lib/xmaxclbin.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ *  @file
+ *  Snapshot of the parsed system configuration and of the IP layout of
+ *  its xclbins, kept next to the resource database so that later
+ *  processes skip YAML and xclbin parsing.  The snapshot is keyed by a
+ *  hash of the YAML file and, per xclbin, by its device, inode, size and
+ *  modification time; any change makes XMA parse the files again.
+ */
+#define XMA_CFG_CACHE_FILE "xma_cfg_cache"
+
+/**
+ *  Snapshots are trusted only if they belong to the user running XMA and
+ *  nobody else can write them: the configuration names plugin libraries.
+ */
+
+/**
+ * @addtogroup xmacfg
+ * @{
+ */
+typedef struct XmaXclbinStamp
+{
+    uint64_t     dev;
+    uint64_t     ino;
+    uint64_t     size;
+    uint64_t     mtime_ns;
+} XmaXclbinStamp;
+
+typedef struct XmaCfgCache
+{
+    uint32_t       magic;
+    uint32_t       size;        /* sizeof(XmaCfgCache) of the writer */
+    uint64_t       cfg_hash;    /* hash of the YAML file contents */
+    XmaSystemCfg   systemcfg;
+    int32_t        num_xclbins;
+    XmaXclbinStamp stamps[MAX_IMAGE_CONFIGS];
+    XmaXclbinInfo  xclbins[MAX_IMAGE_CONFIGS];
+    bool           dirty;       /* changed since loaded, not stored */
+    uint64_t       checksum;    /* of all preceding members */
+} XmaCfgCache;
+
+/**
+ *  @brief Snapshot file of the user running XMA
+ *
+ *  @param path Filled with $XDG_RUNTIME_DIR/XMA_CFG_CACHE_FILE, or with
+ *              /tmp/XMA_CFG_CACHE_FILE.<euid> without a runtime directory
+ *  @param size Size of path
+ */
+void xma_cfg_cache_path(char *path, size_t size);
+
+/**
+ *  @brief Load the snapshot made from a YAML configuration file
+ *
+ *  @param cache   Snapshot to fill
+ *  @param path    Snapshot file, normally from xma_cfg_cache_path()
+ *  @param cfgfile YAML system configuration file
+ *
+ *  @return        XMA_SUCCESS if path holds a valid snapshot of cfgfile
+ *                 as it is now; cache->systemcfg is then usable.
+ *  @return        XMA_ERROR otherwise; cache is reset for cfgfile and
+ *                 the caller must parse it and call
+ *                 @ref xma_cfg_cache_systemcfg_set().
+ */
+int32_t xma_cfg_cache_load(XmaCfgCache *cache, const char *path,
+                           const char *cfgfile);
+
+/**
+ *  @brief Snapshot being built by xma_initialize(), NULL otherwise
+ */
+XmaCfgCache *xma_cfg_cache_get(void);
+
+/**
+ *  @brief Record the parsed system configuration
+ */
+void xma_cfg_cache_systemcfg_set(XmaCfgCache        *cache,
+                                 const XmaSystemCfg *systemcfg);
+
+/**
+ *  @brief Get the IP layout of an unchanged xclbin
+ *
+ *  @return        XMA_SUCCESS if info was filled from the snapshot
+ *  @return        XMA_ERROR if the xclbin is unknown or has changed
+ */
+int32_t xma_cfg_cache_xclbin_get(XmaCfgCache   *cache,
+                                 const char    *xclbin,
+                                 XmaXclbinInfo *info);
+
+/**
+ *  @brief Record the IP layout parsed from an xclbin
+ */
+void xma_cfg_cache_xclbin_set(XmaCfgCache         *cache,
+                              const char          *xclbin,
+                              const XmaXclbinInfo *info);
+
+/**
+ *  @brief Write the snapshot if it changed since it was loaded
+ *
+ *  The file is replaced atomically so processes starting concurrently
+ *  read either the old or the new snapshot.
+ *
+ *  @return        XMA_SUCCESS on success or if nothing changed
+ *  @return        XMA_ERROR on failure
+ */
+int32_t xma_cfg_cache_store(XmaCfgCache *cache, const char *path);
+/**
+ *  @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
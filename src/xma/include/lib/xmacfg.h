@@ -61,12 +61,22 @@ typedef struct XmaImageCfg
     XmaKernelCfg kernelcfg[MAX_KERNEL_CONFIGS];
 } XmaImageCfg;
 
+/**
+ * Policy used to pick a kernel instance for a new session
+*/
+typedef enum XmaPlacement
+{
+    XMA_PLACEMENT_PACK = 0, /**< first kernel with room, in device order */
+    XMA_PLACEMENT_SPREAD    /**< least loaded device, then kernel */
+} XmaPlacement;
+
 typedef struct XmaSystemCfg
 {
     char        dsa[MAX_DSA_NAME];
     bool        logger_initialized;
     char        logfile[PATH_MAX];
     int32_t     loglevel;
+    XmaPlacement placement;
     char        pluginpath[PATH_MAX];
     char        xclbinpath[PATH_MAX];
     int32_t     num_images;
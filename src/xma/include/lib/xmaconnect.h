@@ -17,6 +17,8 @@
 #ifndef _XMA_CONNECT_H_
 #define _XMA_CONNECT_H_
 
+#include "app/xmabuffers.h"
+
 /**
  *  @file
  */
@@ -50,6 +52,25 @@ extern "C" {
  *  of the conditions cannot be met, then communication between kernels falls
  *  back to copying data to host memory.
  *
+ *  Frames cross an active connection in device buffers owned by the
+ *  connection: a pool of MAX_CONNECTION_FRAMES frames allocated on the
+ *  device and DDR bank of the sender the first time one is requested.  The
+ *  sender plugin gets a frame with xma_plg_connect_frame_get(), has its
+ *  kernel write the output there and queues it with
+ *  xma_plg_connect_frame_send(), which also records the device buffers in
+ *  the frame returned to the application.  When the application passes
+ *  that frame to the receiving session, XMA hands the queued device frame
+ *  to the receiver plugin instead; no pixel data goes through host memory.
+ *  A device frame returns to the pool when its last reference is released,
+ *  so a receiver plugin keeping a frame past send_frame must take a
+ *  reference with xma_frame_add_ref().  When all frames of the pool are in
+ *  use the sender waits in xma_plg_connect_frame_get(), which throttles it
+ *  to the rate of the receiver.
+ *
+ *  The connection table is shared by all threads of a process and
+ *  protected by a lock; sessions on either side of a connection may be
+ *  used and destroyed from different threads.
+ *
  *  Since higher-level frameworks such as FFmpeg separate components into discrete
  *  plugins, the XMA Connection Management API must hook into session creation,
  *  send, and receive functions.  During session creation, a pending connection
@@ -81,6 +102,9 @@ extern "C" {
  *
  *  @li @ref xma_connect_alloc()
  *  @li @ref xma_connect_free()
+ *  @li @ref xma_connect_frame_get()
+ *  @li @ref xma_connect_frame_send()
+ *  @li @ref xma_connect_frame_recv()
  *
  */
 
@@ -130,6 +154,10 @@ typedef struct XmaConnect
     XmaConnectState     state;
     XmaEndpoint        *sender;
     XmaEndpoint        *receiver;
+    XmaFramePool       *pool; /**< device frames of the connection */
+    XmaFrame           *queue[MAX_CONNECTION_FRAMES]; /**< sent, not received */
+    int32_t             queue_head;
+    int32_t             queue_cnt;
 } XmaConnect;
 
 /**
@@ -175,6 +203,55 @@ xma_connect_alloc(XmaEndpoint *endpt, XmaConnectType type);
 int32_t
 xma_connect_free(int32_t c_handle, XmaConnectType type);
 
+/**
+ *  @brief Get a device frame to send over a connection
+ *
+ *  Waits while all device frames of the connection are in use.
+ *
+ *  @param c_handle   Sender connection handle
+ *  @param timeout_ms Maximum time to wait in milliseconds, -1 for no limit
+ *
+ *  @return           Frame with a single reference
+ *                    NULL if the connection is not active or on timeout
+*/
+XmaFrame*
+xma_connect_frame_get(int32_t c_handle, int32_t timeout_ms);
+
+/**
+ *  @brief Queue a device frame for the receiver of a connection
+ *
+ *  On success the reference to dev_frame passes to the connection and
+ *  frame, the frame returned to the application, is set to refer to the
+ *  device buffers of dev_frame.
+ *
+ *  @param c_handle  Sender connection handle
+ *  @param dev_frame Frame from @ref xma_connect_frame_get()
+ *  @param frame     Application frame describing the output
+ *
+ *  @return          XMA_SUCCESS on success
+ *                   XMA_ERROR if the receiver is gone; the caller keeps
+ *                   its reference to dev_frame
+*/
+int32_t
+xma_connect_frame_send(int32_t   c_handle,
+                       XmaFrame *dev_frame,
+                       XmaFrame *frame);
+
+/**
+ *  @brief Take the device frame matching an application frame
+ *
+ *  Returns the frame at the head of the connection queue if frame refers
+ *  to its device buffers, copying the timing and encode flags of frame.
+ *
+ *  @param c_handle  Receiver connection handle
+ *  @param frame     Frame passed by the application to the receiver
+ *
+ *  @return          Device frame, the reference passes to the caller
+ *                   NULL if frame did not come over the connection
+*/
+XmaFrame*
+xma_connect_frame_recv(int32_t c_handle, XmaFrame *frame);
+
 /**
  * @}
  */
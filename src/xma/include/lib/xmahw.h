@@ -19,6 +19,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include "lib/xmacfg.h"
 #include "lib/xmalimits.h"
 
@@ -127,6 +128,36 @@ bool xma_hw_is_compatible(XmaHwCfg *hwcfg, XmaSystemCfg *systemcfg);
  */
 bool xma_hw_configure(XmaHwCfg *hwcfg, XmaSystemCfg *systemcfg, bool hw_cfg_status);
 
+/**
+ *  @brief Allocate a mapped device buffer
+ *
+ *  This function allocates a buffer object in the DDR bank of the
+ *  session and maps it into the address space of the caller so that
+ *  host writes land directly in the buffer object backing store.
+ *
+ *  @param session   Hardware session owning the buffer
+ *  @param size      Size in bytes of the buffer
+ *  @param handle    Returns the buffer object handle
+ *  @param map       Returns the host address of the mapped buffer
+ *  @param paddr     Returns the device physical address of the buffer
+ *
+ *  @return          0 on success
+ *                  -1 on failure
+ */
+int32_t xma_hw_buffer_alloc(XmaHwSession *session, size_t size,
+                            uint32_t *handle, void **map, uint64_t *paddr);
+
+/**
+ *  @brief Unmap and free a device buffer
+ *
+ *  @param session   Hardware session owning the buffer
+ *  @param handle    Handle returned by @ref xma_hw_buffer_alloc()
+ *  @param map       Host address returned by @ref xma_hw_buffer_alloc()
+ *  @param size      Size in bytes of the buffer
+ */
+void xma_hw_buffer_free(XmaHwSession *session, uint32_t handle,
+                        void *map, size_t size);
+
 /**
  *  @}
  */
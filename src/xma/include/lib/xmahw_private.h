@@ -26,6 +26,10 @@ typedef struct XmaHwInterface
     bool    (*is_compatible)(XmaHwCfg *hwcfg, XmaSystemCfg *systemcfg);
     bool    (*configure)(XmaHwCfg *hwcfg, XmaSystemCfg *systemcfg,
                          bool hw_cfg_status);
+    int32_t (*buffer_alloc)(XmaHwSession *session, size_t size,
+                            uint32_t *handle, void **map, uint64_t *paddr);
+    void    (*buffer_free)(XmaHwSession *session, uint32_t handle,
+                           void *map, size_t size);
 } XmaHwInterface;
 
 #endif
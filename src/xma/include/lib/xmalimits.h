@@ -34,4 +34,6 @@
 #define XMA_MAX_PLANES           3
 #define MAX_PLUGINS             16
 #define MAX_CONNECTION_ENTRIES  64
+#define MAX_CONNECTION_FRAMES    8
+#define MAX_STATS_SESSIONS     256
 #endif
@@ -49,15 +49,30 @@ void xma_thread_start(XmaThread *thread);
 bool xma_thread_is_running(XmaThread *thread);
 void xma_thread_join(XmaThread *thread);
 
-/* Data structure for XmaMsgQ */
+/* Data structure for XmaMsgQ
+ *
+ * Lock-free single producer/single consumer ring of fixed size slots.
+ * head and tail are free running counters, each written by one side
+ * only and kept on separate cache lines.  Messages are built in place
+ * (reserve/commit) and consumed in place (peek/release) so a message
+ * is never copied through an intermediate buffer.
+ */
+#define XMA_MSGQ_CACHELINE     64
+
 typedef struct XmaMsgQ
 {
     uint8_t     *msg_array;
     size_t       msg_size;
-    size_t       max_msg_entries;
-    int32_t      num_entries;
-    int32_t      front;
-    int32_t      back;
+    size_t       slot_size;
+    size_t       max_msg_entries;  /* power of 2 */
+    /* producer side */
+    uint32_t     head __attribute__((aligned(XMA_MSGQ_CACHELINE)));
+    uint32_t     tail_cache;
+    int32_t      producer_waiting;
+    /* consumer side */
+    uint32_t     tail __attribute__((aligned(XMA_MSGQ_CACHELINE)));
+    uint32_t     head_cache;
+    int32_t      consumer_waiting;
 } XmaMsgQ;
 
 /* XmaMsgQ APIs */
@@ -73,16 +88,29 @@ bool xma_msgq_isempty(XmaMsgQ *msgq);
 int32_t xma_msgq_enqueue(XmaMsgQ *msgq, void *msg, size_t size);
 int32_t xma_msgq_dequeue(XmaMsgQ *msgq, void *msg, size_t size);
 
+/* Producer: slot to build the next message in, NULL if full */
+void *xma_msgq_reserve(XmaMsgQ *msgq);
+/* Producer: publish the slot returned by xma_msgq_reserve() */
+void xma_msgq_commit(XmaMsgQ *msgq);
+/* Consumer: up to max contiguous messages, *msgs set to the first */
+size_t xma_msgq_peek(XmaMsgQ *msgq, void **msgs, size_t max);
+/* Consumer: free count messages returned by xma_msgq_peek() */
+void xma_msgq_release(XmaMsgQ *msgq, size_t count);
+
 struct XmaActor;
 
-/* Data structure for XmaActor */
+/* Data structure for XmaActor
+ *
+ * The actor thread is the single consumer of msg_q and blocks on a
+ * futex only when the queue is empty; producers block only when it is
+ * full.  send_lock serializes producers so that several threads may
+ * send to the same actor, it is uncontended with a single producer.
+ */
 typedef struct XmaActor
 {
     XmaThread          *thread;
     XmaMsgQ            *msg_q;
-    pthread_mutex_t     lock;
-    pthread_cond_t      queued_cond;
-    pthread_cond_t      dequeued_cond;
+    pthread_mutex_t     send_lock;
 } XmaActor;
 
 /* XmaActor APIs */
@@ -94,7 +122,24 @@ void xma_actor_destroy(XmaActor *actor);
 int xma_actor_sendmsg(XmaActor *actor, void *msg, size_t msg_size);
 int xma_actor_recvmsg(XmaActor *actor, void *msg, size_t msg_size);
 
-/* Data structure for XmaLogger */
+/* Reserve a message slot, waiting while the queue is full.  The slot
+ * must be published with xma_actor_msg_commit() by the same thread. */
+void *xma_actor_msg_reserve(XmaActor *actor);
+void xma_actor_msg_commit(XmaActor *actor);
+
+/* Actor thread: wait for at least one message and return up to max
+ * messages in place, *msgs set to the first (slots are msg_q->slot_size
+ * apart).  Release them with xma_actor_msg_release() once consumed. */
+size_t xma_actor_recvmsg_batch(XmaActor *actor, void **msgs, size_t max);
+void xma_actor_msg_release(XmaActor *actor, size_t count);
+
+/* Data structure for XmaLogger
+ *
+ * Every logging thread owns a lock-free queue and records messages
+ * unformatted (format pointer plus binary arguments).  The logger thread
+ * formats and writes them.  It sleeps on the doorbell futex when all
+ * queues are empty.
+ */
 typedef struct XmaLogger
 {
     bool      use_stdout;
@@ -102,7 +147,12 @@ typedef struct XmaLogger
     char      filename[PATH_MAX];
     int32_t   fd;
     int32_t   log_level;
-    XmaActor *actor;
+    XmaThread *thread;
+    uint32_t  doorbell;
+    int32_t   sleeping;
+    int32_t   shutdown;
+    uint32_t  rate_limit;
+    uint64_t  dropped;
 } XmaLogger;
 
 int32_t xma_logger_init(XmaLogger *logger);
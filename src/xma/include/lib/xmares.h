@@ -209,6 +209,20 @@ XmaSession *xma_res_session_get(XmaKernelRes *kern_res);
 */
 int32_t xma_res_kern_chan_id_get(XmaKernelRes *kern_res);
 
+/**
+ * @brief report frames processed by the kernel of this resource
+ *
+ * Feeds the per kernel frame rate used to place new sessions.
+ *
+ * @param shm_cfg shared memory pointer
+ * @param kern_res Previously allocated kernel resource
+ * @param frames number of frames processed since the last report
+ *
+ * @returns 0 or error code if kern_res is not allocated
+*/
+int32_t xma_res_kernel_progress(XmaResources shm_cfg, XmaKernelRes kern_res,
+                                uint32_t frames);
+
 /**
  * @brief obtain pointer to shared memory resource management database
  *
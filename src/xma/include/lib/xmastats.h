@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2018, Xilinx Inc - All rights reserved
+ * Xilinx SDAccel Media Accelerator API
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+#ifndef _XMA_STATS_LIB_H_
+#define _XMA_STATS_LIB_H_
+
+#include <time.h>
+#include "app/xmastats.h"
+#include "plg/xmasess.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Updates are relaxed atomics on the session counters in the resource
+ * database; all functions are no-ops for a session without counters. */
+
+static inline uint64_t xma_stats_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Bytes of all planes of frame */
+uint64_t xma_stats_frame_bytes(XmaFrame *frame);
+
+/* Count frames and bytes given to / returned by the plugin */
+void xma_stats_frames_in(XmaSession *session, uint32_t frames, uint64_t bytes);
+void xma_stats_frames_out(XmaSession *session, uint32_t frames,
+                          uint64_t bytes);
+
+/* Record a plugin call of stage that started at start_ns */
+void xma_stats_latency(XmaSession *session, XmaStatsStage stage,
+                       uint64_t start_ns);
+
+/* Record the number of frames in flight */
+void xma_stats_queue_depth(XmaSession *session, int32_t depth);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
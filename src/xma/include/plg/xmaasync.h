@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2018, Xilinx Inc - All rights reserved
+ * Xilinx SDAccel Media Accelerator API
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @ingroup xma_plg_intf
+ * @file plg/xmaasync.h
+ * Plugin hooks for pipelined (asynchronous) sessions
+*/
+#ifndef __XMA_ASYNC_PLG_H__
+#define __XMA_ASYNC_PLG_H__
+
+#include "xma.h"
+#include "plg/xmasess.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @ingroup xma_plg_intf
+ * @addtogroup xmaasync xmaasync.h
+ * @{
+ *
+ * When an application enables the asynchronous mode of an encoder, scaler
+ * or filter session, XMA runs every frame through three stages, each on
+ * its own thread: transfer of the input to the device, kernel execution
+ * and transfer of the output to the host.  While frame N executes, frame
+ * N+1 can be written to the device and frame N-1 read back.
+ *
+ * A plugin opts in by pointing the async member of its plugin structure
+ * to an XmaAsyncPlugin.  Each stage is called for one frame at a time and
+ * in submission order, but the three stages run concurrently on different
+ * frames.  XmaAsyncJob::slot tells the plugin which of its max_depth sets
+ * of device buffers the frame uses; a slot is not reused before the frame
+ * holding it has left the last stage.
+ *
+ * Plugins without async hooks still work in asynchronous mode: their
+ * send and receive callbacks are called back to back from the execute
+ * stage thread.
+*/
+
+/**
+ * @struct XmaAsyncJob
+ * One frame moving through the stages of an asynchronous session
+*/
+typedef struct XmaAsyncJob
+{
+    /** device buffer set of the plugin to use, 0 to max_depth - 1 */
+    int32_t     slot;
+    /** input frame, owned by the application until completion */
+    XmaFrame   *frame;
+    /** output: XmaDataBuffer for encoders, XmaFrame list for scalers,
+     *  XmaFrame for filters */
+    void       *output;
+    /** bytes of encoded data written to output (encoders) */
+    int32_t     output_size;
+    /** result of the last stage run; stages after a non zero status
+     *  are skipped */
+    int32_t     status;
+    /** application context passed to the send call */
+    void       *user_data;
+    /** frame passed by the application; differs from frame when the
+     *  input arrived in device memory over a zerocopy connection */
+    XmaFrame   *app_frame;
+} XmaAsyncJob;
+
+/**
+ * @struct XmaAsyncPlugin
+ * Stage callbacks of a plugin supporting pipelined sessions.  Any of
+ * them may be NULL.  Callbacks return XMA_SUCCESS or an error code.
+*/
+typedef struct XmaAsyncPlugin
+{
+    /** sets of device buffers the plugin has; 0 for no limit */
+    int32_t     max_depth;
+    /** copy the input frame of job to the device buffers of job->slot */
+    int32_t     (*xfer_in)(XmaSession *session, XmaAsyncJob *job);
+    /** run the kernel on job->slot and wait for it to finish */
+    int32_t     (*execute)(XmaSession *session, XmaAsyncJob *job);
+    /** copy the result in job->slot to job->output */
+    int32_t     (*xfer_out)(XmaSession *session, XmaAsyncJob *job);
+} XmaAsyncPlugin;
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
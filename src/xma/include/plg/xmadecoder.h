@@ -77,6 +77,9 @@ typedef struct XmaDecoderPlugin
                                   XmaFrame           *frame);
     /** Callback invoked to clean up device buffers when app has terminated session */
     int32_t         (*close)(XmaDecoderSession *session);
+    /** Optional callback reporting the kernel load, out of
+     *  XMA_MAX_KERNEL_LOAD, that the pending session would add */
+    int32_t         (*get_load)(XmaSession *pending_sess, uint32_t *load);
 } XmaDecoderPlugin;
 
 /**
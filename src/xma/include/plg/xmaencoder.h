@@ -25,6 +25,7 @@
 
 #include "xma.h"
 #include "plg/xmasess.h"
+#include "plg/xmaasync.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -56,8 +57,8 @@ typedef struct XmaEncoderSession XmaEncoderSession;
  * application control of a given kernel.
  *
  * The plugin code must statically allocate this structure
- * and provide values for all member except alloc_chan which is
- * an optional callback. This structure and its callbacks are
+ * and provide values for all member except alloc_chan and get_load
+ * which are optional callbacks. This structure and its callbacks are
  * the primary link between the XMA application interface and
  * the hardware kernel.
  *
@@ -69,6 +70,13 @@ typedef struct XmaEncoderSession XmaEncoderSession;
  * XmaEncoderPlugin::get_dev_input_paddr()
  * Plugin should return free buffer that upstream video kernel can fill
  * with video frame data to be encoded.
+ *
+ * XmaEncoderPlugin::get_load()
+ * Called before a kernel is selected for a new session.  Plugin should
+ * return the share of the kernel, out of XMA_MAX_KERNEL_LOAD, that the
+ * session would use (e.g. from resolution and frame rate).  XMA will not
+ * place a session on a kernel whose load would exceed XMA_MAX_KERNEL_LOAD.
+ * If not implemented the session is treated as adding no load.
 */
 typedef struct XmaEncoderPlugin
 {
@@ -101,6 +109,11 @@ typedef struct XmaEncoderPlugin
                                   uint32_t sess_cnt);
     /** Callback called if this encoder supports zerocopy */
     uint64_t        (*get_dev_input_paddr)(XmaEncoderSession *enc_session);
+    /** Optional callback reporting the kernel load, out of
+     *  XMA_MAX_KERNEL_LOAD, that the pending session would add */
+    int32_t         (*get_load)(XmaSession *pending_sess, uint32_t *load);
+    /** Optional stage callbacks for pipelined sessions, see plg/xmaasync.h */
+    const XmaAsyncPlugin *async;
 } XmaEncoderPlugin;
 
 /**
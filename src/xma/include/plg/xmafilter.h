@@ -25,6 +25,7 @@
 
 #include "xma.h"
 #include "plg/xmasess.h"
+#include "plg/xmaasync.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -70,6 +71,11 @@ typedef struct XmaFilterPlugin
     int32_t         (*alloc_chan)(XmaSession *pending_sess,
                                   XmaSession **curr_sess,
                                   uint32_t sess_cnt);
+    /** Optional callback reporting the kernel load, out of
+     *  XMA_MAX_KERNEL_LOAD, that the pending session would add */
+    int32_t         (*get_load)(XmaSession *pending_sess, uint32_t *load);
+    /** Optional stage callbacks for pipelined sessions, see plg/xmaasync.h */
+    const XmaAsyncPlugin *async;
 } XmaFilterPlugin;
 
 /**
@@ -64,6 +64,9 @@ typedef struct XmaKernelPlugin
                             int32_t            *param_cnt);
     /** close callback used to preform cleanup when application terminates session*/
     int32_t         (*close)(XmaKernelSession *session);
+    /** Optional callback reporting the kernel load, out of
+     *  XMA_MAX_KERNEL_LOAD, that the pending session would add */
+    int32_t         (*get_load)(XmaSession *pending_sess, uint32_t *load);
 } XmaKernelPlugin;
 
 /**
@@ -81,8 +81,20 @@ typedef struct XmaSession {
     /** Private stats data attached to a specific session. This field is
     allocated and managed by XMA for each session type. */ 
     void          *stats;
+    /** Pipeline state while the session is in asynchronous mode.
+    Used internally. */
+    void          *async;
+    /** Counters of the session in the XMA resource database, NULL if none
+    could be reserved.  Used internally. */
+    XmaSessionStats *metrics;
 } XmaSession;
 
+/**
+ * Load of a fully used kernel as reported by the plugin get_load()
+ * callbacks
+*/
+#define XMA_MAX_KERNEL_LOAD 1000
+
 /**
  * Determine if XmaSession is a member of XmaDecoderSession
 */
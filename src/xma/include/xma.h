@@ -25,6 +25,7 @@
 #include "app/xmascaler.h"
 #include "app/xmafilter.h"
 #include "app/xmakernel.h"
+#include "app/xmastats.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -370,12 +371,14 @@ int32_t xma_initialize(char *cfgfile);
  * [SystemCfg]    ::= SystemCfg:CRLF
  *                    (HTAB[logifile]CRLF)*
  *                    (HTAB[loglevel]CRLF)*
+ *                    (HTAB[placement]CRLF)*
  *                    HTAB[dsa]CRLF
                       HTAB[pluginpath]CRLF
  *                    HTAB[xclbinpath]CRLF
  *                    (HTAB[ImageCfg])+
  * [logfile]      ::= logfile:[filepath]
  * [loglevel]     ::= loglevel:[0 | 1 | 2| 3]
+ * [placement]    ::= placement:(pack | spread)
  * [dsa]          ::= dsa:[name_string]
  * [pluginpath]   ::= pluginpath:[filepath]
  * [xclbinpath]   ::= xclbinpath:[filepath]
@@ -411,6 +414,11 @@ int32_t xma_initialize(char *cfgfile);
  *     specified or lower will be output to the specified logfile.  The level mapping
  *     is as follows: 0 = CRITICAL, 1 = ERROR, 2 = INFO, 3 = DEBUG.
  *     For more information regarding the logging capability see @ref xmalog.
+ * @param placement  Optional property of SystemCfg; selects how a kernel is
+ *     picked for a new session.  "pack" (default) takes the first kernel, in
+ *     device order, that can accept the session.  "spread" takes the kernel on
+ *     the least loaded device, using the load reported by the plugin get_load()
+ *     callback and the recent frame rate of each kernel.
  * @param dsa        Property of SystemCfg; The name of the "Dynamic System Archive"
  *     used for all images.
  * @param pluginpath Property of SystemCfg; The path to directory containing all
@@ -29,6 +29,7 @@
 #include "lib/xmahw.h"
 #include "lib/xmahw_hal.h"
 #include "plg/xmasess.h"
+#include "plg/xmaasync.h"
 #include "plg/xmadecoder.h"
 #include "plg/xmaencoder.h"
 #include "plg/xmascaler.h"
@@ -156,6 +157,86 @@ int32_t xma_plg_buffer_read(XmaHwSession     s_handle,
                             size_t           size,
                             size_t           offset);
 
+/**
+ * @struct XmaBufferRegion
+ * Part of a device buffer read by @ref xma_plg_buffer_read_list()
+ */
+typedef struct XmaBufferRegion
+{
+    void   *dst; /**< host destination, e.g. a plane of an output frame */
+    size_t  size; /**< bytes to copy */
+    size_t  offset; /**< offset of the data in the device buffer */
+} XmaBufferRegion;
+
+/**
+ *  @brief Read several regions of a device buffer with one transfer
+ *
+ *  This function syncs the span of device memory covering all regions
+ *  from the device once and then copies each region to its host
+ *  destination.  A scaler whose kernel writes every output of the
+ *  ladder to one buffer can read all planes of all outputs, including
+ *  frames taken from a pool created with @ref xma_frame_pool_create(),
+ *  with a single DMA instead of one per plane.
+ *
+ *  @param s_handle    The session handle associated with this plugin instance
+ *  @param b_handle    The buffer handle returned from
+ *                     @ref xma_plg_buffer_alloc()
+ *  @param regions     Regions to copy, in any order
+ *  @param num_regions Number of entries in regions
+ *
+ *  @return         XMA_SUCCESS on success
+ *  @return         XMA_ERROR on failure
+ *
+ */
+int32_t xma_plg_buffer_read_list(XmaHwSession           s_handle,
+                                 XmaBufferHandle        b_handle,
+                                 const XmaBufferRegion *regions,
+                                 int32_t                num_regions);
+
+/**
+ *  @brief Sync a mapped device buffer to the device
+ *
+ *  This function transfers host writes of a mapped device buffer to
+ *  device memory without an intermediate copy.  Use it for frame planes
+ *  of type XMA_DEVICE_BUFFER_TYPE (see @ref xma_frame_pool_create())
+ *  instead of @ref xma_plg_buffer_write(): the handle is
+ *  XmaBufferRef::bo_handle and the kernel can be given
+ *  XmaBufferRef::paddr directly.
+ *
+ *  @param s_handle  The session handle associated with this plugin instance
+ *  @param b_handle  Device buffer handle
+ *  @param size      Size of data to sync
+ *  @param offset    Offset from the beginning of the device buffer
+ *
+ *  @return         XMA_SUCCESS on success
+ *  @return         XMA_ERROR on failure
+ *
+ */
+int32_t xma_plg_buffer_sync_to_device(XmaHwSession     s_handle,
+                                      XmaBufferHandle  b_handle,
+                                      size_t           size,
+                                      size_t           offset);
+
+/**
+ *  @brief Sync a mapped device buffer from the device
+ *
+ *  This function makes device writes to a mapped device buffer visible
+ *  through its host mapping without an intermediate copy.
+ *
+ *  @param s_handle  The session handle associated with this plugin instance
+ *  @param b_handle  Device buffer handle
+ *  @param size      Size of data to sync
+ *  @param offset    Offset from the beginning of the device buffer
+ *
+ *  @return         XMA_SUCCESS on success
+ *  @return         XMA_ERROR on failure
+ *
+ */
+int32_t xma_plg_buffer_sync_from_device(XmaHwSession     s_handle,
+                                        XmaBufferHandle  b_handle,
+                                        size_t           size,
+                                        size_t           offset);
+
 /**
  *  @brief Write kernel register(s)
  *
@@ -213,6 +294,50 @@ int32_t xma_plg_register_read(XmaHwSession     s_handle,
  */
 void xma_plg_register_dump(XmaHwSession     s_handle,
                            int32_t          num_words);
+
+/**
+ *  @brief Get a device frame for a zerocopy output
+ *
+ *  When an output of a scaler or filter session is connected to a
+ *  receiving session on the same DDR bank (see xmaconnect), this returns
+ *  one of the device frames of the connection.  The kernel writes the
+ *  output to XmaBufferRef::paddr of each plane and the frame is then
+ *  passed on with @ref xma_plg_connect_frame_send().  Waits while the
+ *  receiver still holds all device frames of the connection.
+ *
+ *  @param session    The session of this plugin instance
+ *  @param output     Output index (scaler output, 0 for filters)
+ *  @param timeout_ms Maximum time to wait in milliseconds, -1 for no limit
+ *
+ *  @return         Device frame on success
+ *  @return         NULL if the output is not connected or on timeout;
+ *                  the output is then returned in host memory as usual
+ */
+XmaFrame* xma_plg_connect_frame_get(XmaSession *session,
+                                    int32_t     output,
+                                    int32_t     timeout_ms);
+
+/**
+ *  @brief Send a device frame to the receiver of a zerocopy output
+ *
+ *  Call once the kernel has written dev_frame, instead of reading the
+ *  output back into frame.  frame, the frame returned to the application,
+ *  is updated to refer to the device buffers; when the application passes
+ *  it to the receiving session, the receiver plugin gets dev_frame.
+ *
+ *  @param session   The session of this plugin instance
+ *  @param output    Output index (scaler output, 0 for filters)
+ *  @param dev_frame Frame from @ref xma_plg_connect_frame_get()
+ *  @param frame     Output frame provided by the application
+ *
+ *  @return         XMA_SUCCESS on success
+ *  @return         XMA_ERROR if the receiver is gone; the plugin still
+ *                  owns dev_frame and must read the output back
+ */
+int32_t xma_plg_connect_frame_send(XmaSession *session,
+                                   int32_t     output,
+                                   XmaFrame   *dev_frame,
+                                   XmaFrame   *frame);
 /**
  *  @}
  */
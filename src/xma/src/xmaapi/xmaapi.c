@@ -15,6 +15,7 @@
  * under the License.
  */
 
+#include <limits.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <string.h>
@@ -22,6 +23,7 @@
 #include "app/xmaerror.h"
 #include "app/xmalogger.h"
 #include "lib/xmaapi.h"
+#include "lib/xmacache.h"
 #include "lib/xmahw_hal.h"
 #include "lib/xmasignal.h"
 
@@ -32,6 +34,8 @@ XmaSingleton *g_xma_singleton;
 
 int32_t xma_initialize(char *cfgfile)
 {
+    XmaCfgCache *cache;
+    char cache_path[PATH_MAX];
     int32_t ret;
     bool    rc;
 
@@ -41,9 +45,26 @@ int32_t xma_initialize(char *cfgfile)
     g_xma_singleton = malloc(sizeof(*g_xma_singleton));
     memset(g_xma_singleton, 0, sizeof(*g_xma_singleton));
 
-    ret = xma_cfg_parse(cfgfile, &g_xma_singleton->systemcfg);
-    if (ret != XMA_SUCCESS)
-        return ret;
+    /* Warm starts take the parsed config from the snapshot */
+    xma_cfg_cache_path(cache_path, sizeof(cache_path));
+    cache = malloc(sizeof(XmaCfgCache));
+    if (cache &&
+        xma_cfg_cache_load(cache, cache_path, cfgfile) == XMA_SUCCESS)
+    {
+        g_xma_singleton->systemcfg = cache->systemcfg;
+    }
+    else
+    {
+        ret = xma_cfg_parse(cfgfile, &g_xma_singleton->systemcfg);
+        if (ret != XMA_SUCCESS)
+        {
+            free(cache);
+            return ret;
+        }
+        if (cache)
+            xma_cfg_cache_systemcfg_set(cache, &g_xma_singleton->systemcfg);
+    }
+    g_xma_singleton->cfg_cache = cache;
 
     ret = xma_logger_init(&g_xma_singleton->logger);
     if (ret != XMA_SUCCESS)
@@ -71,6 +92,10 @@ int32_t xma_initialize(char *cfgfile)
     rc = xma_hw_configure(&g_xma_singleton->hwcfg,
                           &g_xma_singleton->systemcfg,
                           xma_res_xma_init_completed());
+    g_xma_singleton->cfg_cache = NULL;
+    if (rc)
+        xma_cfg_cache_store(cache, cache_path);
+    free(cache);
     if (!rc)
         goto error;
 
@@ -131,6 +156,9 @@ void xma_exit(void)
 
     if (!g_xma_singleton->shm_freed)
         xma_res_shm_unmap(g_xma_singleton->shm_res_cfg);
+
+    /* Write out log messages still queued by the logger */
+    xma_logger_close(&g_xma_singleton->logger);
 }
 
 int32_t xma_cfg_img_cnt_get()
@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) 2018, Xilinx Inc - All rights reserved
+ * Xilinx SDAccel Media Accelerator API
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "app/xmaerror.h"
+#include "app/xmalogger.h"
+#include "lib/xmaasync.h"
+#include "lib/xmalogger.h"
+#include "lib/xmastats.h"
+
+#define XMA_ASYNC_MOD "xmaasync"
+
+/* Stages of the pipeline, each one is an actor */
+enum XmaAsyncStage {
+    XMA_ASYNC_XFER_IN = 0,
+    XMA_ASYNC_EXECUTE,
+    XMA_ASYNC_XFER_OUT,
+    XMA_ASYNC_STAGES
+};
+
+struct XmaAsync;
+
+/* Message passed between stages (by pointer) */
+typedef struct XmaAsyncEntry
+{
+    XmaAsyncJob      job;
+    struct XmaAsync *async;
+} XmaAsyncEntry;
+
+/* Pipeline state of a session
+ *
+ * entries is a ring of depth jobs, entry n % depth is used by the n-th
+ * submitted frame.  Stages are FIFO so a frame always completes before
+ * the frame depth positions later is submitted.  Only the application
+ * thread submits; in_flight is shared with the last stage.
+ */
+typedef struct XmaAsync
+{
+    XmaSession       *session;
+    XmaAsyncPlugin    stages;
+    XmaAsyncComplete  complete;
+    void            (*done)(void);
+    XmaActor         *actors[XMA_ASYNC_STAGES];
+    XmaAsyncEntry    *entries;
+    XmaAsyncEntry     stop;
+    int32_t           depth;
+    uint64_t          submitted;
+    int32_t           in_flight;
+    pthread_mutex_t   lock;
+    pthread_cond_t    cond;
+} XmaAsync;
+
+static void xma_async_send(XmaActor *actor, XmaAsyncEntry *entry)
+{
+    xma_actor_sendmsg(actor, &entry, sizeof(entry));
+}
+
+static int32_t (*xma_async_stage_func(XmaAsync *async, int32_t stage))
+                                     (XmaSession *session, XmaAsyncJob *job)
+{
+    switch (stage) {
+    case XMA_ASYNC_XFER_IN:
+        return async->stages.xfer_in;
+    case XMA_ASYNC_EXECUTE:
+        return async->stages.execute;
+    default:
+        return async->stages.xfer_out;
+    }
+}
+
+static void *xma_async_stage_loop(XmaActor *actor, int32_t stage)
+{
+    for (;;)
+    {
+        XmaAsyncEntry *entry;
+        XmaAsync *async;
+        int32_t (*func)(XmaSession *session, XmaAsyncJob *job);
+
+        xma_actor_recvmsg(actor, &entry, sizeof(entry));
+        async = entry->async;
+        if (entry == &async->stop)
+        {
+            if (stage + 1 < XMA_ASYNC_STAGES)
+                xma_async_send(async->actors[stage + 1], entry);
+            break;
+        }
+
+        func = xma_async_stage_func(async, stage);
+        if (func && entry->job.status == XMA_SUCCESS)
+        {
+            uint64_t start_ns = xma_stats_now_ns();
+
+            entry->job.status = func(async->session, &entry->job);
+            xma_stats_latency(async->session, XMA_STATS_XFER_IN + stage,
+                              start_ns);
+        }
+
+        if (stage + 1 < XMA_ASYNC_STAGES)
+        {
+            xma_async_send(async->actors[stage + 1], entry);
+            continue;
+        }
+
+        async->complete(async->session, &entry->job, async->done);
+        pthread_mutex_lock(&async->lock);
+        async->in_flight--;
+        xma_stats_queue_depth(async->session, async->in_flight);
+        pthread_cond_broadcast(&async->cond);
+        pthread_mutex_unlock(&async->lock);
+    }
+
+    return NULL;
+}
+
+static void *xma_async_xfer_in_actor(void *data)
+{
+    return xma_async_stage_loop(data, XMA_ASYNC_XFER_IN);
+}
+
+static void *xma_async_execute_actor(void *data)
+{
+    return xma_async_stage_loop(data, XMA_ASYNC_EXECUTE);
+}
+
+static void *xma_async_xfer_out_actor(void *data)
+{
+    return xma_async_stage_loop(data, XMA_ASYNC_XFER_OUT);
+}
+
+static const XmaThreadFunc xma_async_actor_funcs[XMA_ASYNC_STAGES] = {
+    xma_async_xfer_in_actor,
+    xma_async_execute_actor,
+    xma_async_xfer_out_actor,
+};
+
+static void xma_async_free(XmaAsync *async)
+{
+    int32_t i;
+
+    /* stage threads have exited on the stop entry; the shutdown message
+     * of xma_actor_destroy() does not fit the queue so it only joins */
+    for (i = 0; i < XMA_ASYNC_STAGES; i++)
+        xma_actor_destroy(async->actors[i]);
+    pthread_cond_destroy(&async->cond);
+    pthread_mutex_destroy(&async->lock);
+    free(async->entries);
+    free(async);
+}
+
+int32_t xma_async_start(XmaSession           *session,
+                        const XmaAsyncPlugin *stages,
+                        int32_t               depth,
+                        XmaAsyncComplete      complete,
+                        void                (*done)(void))
+{
+    XmaAsync *async;
+    int32_t i;
+
+    xma_logmsg(XMA_DEBUG_LOG, XMA_ASYNC_MOD, "%s()\n", __func__);
+    if (!session || !stages || !complete || depth <= 0)
+        return XMA_ERROR_INVALID;
+    if (session->async)
+        return XMA_ERROR_INVALID;
+
+    if (stages->max_depth > 0 && depth > stages->max_depth)
+        depth = stages->max_depth;
+
+    async = calloc(1, sizeof(XmaAsync));
+    if (!async)
+        return XMA_ERROR;
+    async->entries = calloc(depth, sizeof(XmaAsyncEntry));
+    if (!async->entries)
+    {
+        free(async);
+        return XMA_ERROR;
+    }
+    async->session = session;
+    async->stages = *stages;
+    async->complete = complete;
+    async->done = done;
+    async->depth = depth;
+    async->stop.async = async;
+    pthread_mutex_init(&async->lock, NULL);
+    pthread_cond_init(&async->cond, NULL);
+
+    /* one extra queue entry for the stop message */
+    for (i = 0; i < XMA_ASYNC_STAGES; i++)
+    {
+        async->actors[i] = xma_actor_create(xma_async_actor_funcs[i],
+                                            sizeof(XmaAsyncEntry*),
+                                            depth + 1);
+        xma_actor_start(async->actors[i]);
+    }
+
+    session->async = async;
+    xma_logmsg(XMA_INFO_LOG, XMA_ASYNC_MOD,
+               "Session pipelined with %d frames in flight\n", depth);
+    return XMA_SUCCESS;
+}
+
+int32_t xma_async_submit(XmaSession *session,
+                         XmaFrame   *frame,
+                         XmaFrame   *app_frame,
+                         void       *output,
+                         void       *user_data)
+{
+    XmaAsync *async = session ? session->async : NULL;
+    XmaAsyncEntry *entry;
+
+    if (!async)
+        return XMA_ERROR_INVALID;
+
+    /* backpressure: wait for the oldest frame to complete */
+    pthread_mutex_lock(&async->lock);
+    while (async->in_flight == async->depth)
+        pthread_cond_wait(&async->cond, &async->lock);
+    async->in_flight++;
+    xma_stats_queue_depth(session, async->in_flight);
+    pthread_mutex_unlock(&async->lock);
+
+    entry = &async->entries[async->submitted % async->depth];
+    entry->job.slot = async->submitted % async->depth;
+    entry->job.frame = frame;
+    entry->job.output = output;
+    entry->job.output_size = 0;
+    entry->job.status = XMA_SUCCESS;
+    entry->job.user_data = user_data;
+    entry->job.app_frame = app_frame;
+    entry->async = async;
+    async->submitted++;
+
+    xma_async_send(async->actors[XMA_ASYNC_XFER_IN], entry);
+    return XMA_SUCCESS;
+}
+
+int32_t xma_async_flush(XmaSession *session)
+{
+    XmaAsync *async = session ? session->async : NULL;
+
+    if (!async)
+        return XMA_ERROR_INVALID;
+
+    pthread_mutex_lock(&async->lock);
+    while (async->in_flight > 0)
+        pthread_cond_wait(&async->cond, &async->lock);
+    pthread_mutex_unlock(&async->lock);
+    return XMA_SUCCESS;
+}
+
+void xma_async_stop(XmaSession *session)
+{
+    XmaAsync *async = session ? session->async : NULL;
+
+    if (!async)
+        return;
+
+    xma_logmsg(XMA_DEBUG_LOG, XMA_ASYNC_MOD, "%s()\n", __func__);
+    xma_async_flush(session);
+    xma_async_send(async->actors[XMA_ASYNC_XFER_IN], &async->stop);
+    session->async = NULL;
+    xma_async_free(async);
+}
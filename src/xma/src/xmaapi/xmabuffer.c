@@ -16,12 +16,34 @@
  */
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+#include <time.h>
 
 #include "app/xmabuffers.h"
+#include "app/xmaerror.h"
 #include "app/xmalogger.h"
+#include "lib/xmahw.h"
+#include "plg/xmasess.h"
 
 #define XMA_BUFFER_MOD "xmabuffer"
 
+struct XmaFramePool
+{
+    XmaHwSession        hw_session;
+    XmaFrameProperties  frame_props;
+    int32_t             num_planes;
+    size_t              plane_size[XMA_MAX_PLANES];
+    int32_t             num_frames;
+    XmaFrame           *frames;
+    XmaFrame          **free_list;
+    int32_t             num_free;
+    bool                released; /* destroy when the last frame returns */
+    pthread_mutex_t     lock;
+    pthread_cond_t      avail;
+};
+
+static void xma_frame_pool_free(XmaFramePool *pool);
+
 int32_t
 xma_frame_planes_get(XmaFrameProperties *frame_props)
 {
@@ -38,6 +60,45 @@ xma_frame_planes_get(XmaFrameProperties *frame_props)
     return frame_format_desc[frame_props->format].num_planes;
 }
 
+size_t
+xma_frame_plane_size_get(XmaFrameProperties *frame_props, int32_t plane)
+{
+    size_t width = frame_props->width > 0 ? frame_props->width : 0;
+    size_t height = frame_props->height > 0 ? frame_props->height : 0;
+    int32_t bits_per_sample = frame_props->bits_per_pixel;
+    size_t bytes_per_sample;
+
+    /* packed RGB may give the bits of all three components */
+    if (frame_props->format == XMA_RGB888_FMT_TYPE && bits_per_sample >= 24)
+        bits_per_sample /= 3;
+    bytes_per_sample = bits_per_sample > 8 ? 2 : 1;
+
+    if (plane < 0 || plane >= xma_frame_planes_get(frame_props))
+        return 0;
+
+    switch (frame_props->format)
+    {
+        case XMA_YUV420_FMT_TYPE:
+            if (plane > 0)
+            {
+                width = (width + 1) / 2;
+                height = (height + 1) / 2;
+            }
+            break;
+        case XMA_YUV422_FMT_TYPE:
+            if (plane > 0)
+                width = (width + 1) / 2;
+            break;
+        case XMA_RGB888_FMT_TYPE:
+            width *= 3;
+            break;
+        default:
+            break;
+    }
+
+    return width * height * bytes_per_sample;
+}
+
 XmaFrame*
 xma_frame_alloc(XmaFrameProperties *frame_props)
 {
@@ -54,9 +115,8 @@ xma_frame_alloc(XmaFrameProperties *frame_props)
         frame->data[i].refcount++;
         frame->data[i].buffer_type = XMA_HOST_BUFFER_TYPE;
         frame->data[i].is_clone = false;
-        // TODO: Get plane size for each plane
-        frame->data[i].buffer = malloc(frame_props->width *
-                                       frame_props->height);
+        frame->data[i].buffer = malloc(xma_frame_plane_size_get(frame_props,
+                                                                i));
     }
 
     return frame;
@@ -96,18 +156,257 @@ xma_frame_free(XmaFrame *frame)
                "%s() Free frame %p\n", __func__, frame);
     num_planes = xma_frame_planes_get(&frame->frame_props);
 
-    for (int32_t i = 0; i < num_planes; i++)
-        frame->data[i].refcount--;
+    /* Plane 0 decides, all planes are referenced together */
+    for (int32_t i = num_planes - 1; i > 0; i--)
+        __atomic_sub_fetch(&frame->data[i].refcount, 1, __ATOMIC_ACQ_REL);
 
-    if (frame->data[0].refcount > 0)
+    if (num_planes > 0 &&
+        __atomic_sub_fetch(&frame->data[0].refcount, 1, __ATOMIC_ACQ_REL) > 0)
         return;
 
+    if (frame->pool)
+    {
+        XmaFramePool *pool = frame->pool;
+        bool last;
+
+        pthread_mutex_lock(&pool->lock);
+        pool->free_list[pool->num_free++] = frame;
+        last = pool->released && pool->num_free == pool->num_frames;
+        pthread_cond_signal(&pool->avail);
+        pthread_mutex_unlock(&pool->lock);
+        if (last)
+            xma_frame_pool_free(pool);
+        return;
+    }
+
     for (int32_t i = 0; i < num_planes && !frame->data[i].is_clone; i++)
         free(frame->data[i].buffer);
 
     free(frame);
 }
 
+void
+xma_frame_add_ref(XmaFrame *frame)
+{
+    int32_t num_planes;
+
+    xma_logmsg(XMA_DEBUG_LOG, XMA_BUFFER_MOD,
+               "%s() Reference frame %p\n", __func__, frame);
+    num_planes = xma_frame_planes_get(&frame->frame_props);
+
+    for (int32_t i = 0; i < num_planes; i++)
+        __atomic_add_fetch(&frame->data[i].refcount, 1, __ATOMIC_RELAXED);
+}
+
+static void
+xma_frame_pool_buffers_free(XmaFramePool *pool)
+{
+    for (int32_t f = 0; f < pool->num_frames; f++)
+    {
+        XmaFrame *frame = &pool->frames[f];
+
+        for (int32_t i = 0; i < pool->num_planes; i++)
+        {
+            if (!frame->data[i].buffer)
+                continue;
+            xma_hw_buffer_free(&pool->hw_session, frame->data[i].bo_handle,
+                               frame->data[i].buffer, pool->plane_size[i]);
+        }
+    }
+    free(pool->free_list);
+    free(pool->frames);
+}
+
+static void
+xma_frame_pool_free(XmaFramePool *pool)
+{
+    xma_frame_pool_buffers_free(pool);
+    pthread_cond_destroy(&pool->avail);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+XmaFramePool*
+xma_frame_pool_create(XmaSession         *session,
+                      XmaFrameProperties *frame_props,
+                      int32_t             num_frames)
+{
+    XmaFramePool *pool;
+
+    xma_logmsg(XMA_DEBUG_LOG, XMA_BUFFER_MOD,
+               "%s() session %p with %d frames\n",
+               __func__, session, num_frames);
+    if (!session || num_frames <= 0 || xma_frame_planes_get(frame_props) == 0)
+    {
+        xma_logmsg(XMA_ERROR_LOG, XMA_BUFFER_MOD,
+                   "Invalid frame pool request\n");
+        return NULL;
+    }
+
+    pool = malloc(sizeof(XmaFramePool));
+    memset(pool, 0, sizeof(XmaFramePool));
+    pool->hw_session = session->hw_session;
+    pool->frame_props = *frame_props;
+    pool->num_planes = xma_frame_planes_get(frame_props);
+    pool->num_frames = num_frames;
+    pool->frames = calloc(num_frames, sizeof(XmaFrame));
+    pool->free_list = calloc(num_frames, sizeof(XmaFrame*));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->avail, NULL);
+
+    for (int32_t i = 0; i < pool->num_planes; i++)
+        pool->plane_size[i] = xma_frame_plane_size_get(frame_props, i);
+
+    for (int32_t f = 0; f < num_frames; f++)
+    {
+        XmaFrame *frame = &pool->frames[f];
+
+        frame->frame_props = *frame_props;
+        frame->pool = pool;
+        for (int32_t i = 0; i < pool->num_planes; i++)
+        {
+            XmaBufferRef *ref = &frame->data[i];
+
+            ref->buffer_type = XMA_DEVICE_BUFFER_TYPE;
+            ref->is_clone = false;
+            if (xma_hw_buffer_alloc(&pool->hw_session, pool->plane_size[i],
+                                    &ref->bo_handle, &ref->buffer,
+                                    &ref->paddr) != XMA_SUCCESS)
+            {
+                xma_logmsg(XMA_ERROR_LOG, XMA_BUFFER_MOD,
+                           "Could not allocate device buffer for frame %d "
+                           "plane %d\n", f, i);
+                ref->buffer = NULL;
+                xma_frame_pool_free(pool);
+                return NULL;
+            }
+        }
+        pool->free_list[pool->num_free++] = frame;
+    }
+
+    return pool;
+}
+
+static XmaFrame*
+xma_frame_pool_frame_reset(XmaFramePool *pool, XmaFrame *frame)
+{
+    /* Reset per frame metadata, buffers are kept */
+    frame->time_base.numerator = 0;
+    frame->time_base.denominator = 0;
+    frame->frame_rate.numerator = 0;
+    frame->frame_rate.denominator = 0;
+    frame->pts = 0;
+    frame->is_idr = 0;
+    frame->do_not_encode = 0;
+    frame->is_last_frame = 0;
+    for (int32_t i = 0; i < pool->num_planes; i++)
+        __atomic_store_n(&frame->data[i].refcount, 1, __ATOMIC_RELAXED);
+
+    return frame;
+}
+
+XmaFrame*
+xma_frame_pool_get(XmaFramePool *pool)
+{
+    XmaFrame *frame = NULL;
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->num_free > 0)
+        frame = pool->free_list[--pool->num_free];
+    pthread_mutex_unlock(&pool->lock);
+
+    if (!frame)
+    {
+        xma_logmsg(XMA_DEBUG_LOG, XMA_BUFFER_MOD,
+                   "%s() Pool %p exhausted\n", __func__, pool);
+        return NULL;
+    }
+
+    return xma_frame_pool_frame_reset(pool, frame);
+}
+
+XmaFrame*
+xma_frame_pool_get_wait(XmaFramePool *pool, int32_t timeout_ms)
+{
+    XmaFrame *frame = NULL;
+    struct timespec deadline;
+    int rc = 0;
+
+    if (timeout_ms >= 0)
+    {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->num_free == 0 && rc == 0)
+    {
+        if (timeout_ms < 0)
+            pthread_cond_wait(&pool->avail, &pool->lock);
+        else
+            rc = pthread_cond_timedwait(&pool->avail, &pool->lock, &deadline);
+    }
+    if (pool->num_free > 0)
+        frame = pool->free_list[--pool->num_free];
+    pthread_mutex_unlock(&pool->lock);
+
+    if (!frame)
+    {
+        xma_logmsg(XMA_DEBUG_LOG, XMA_BUFFER_MOD,
+                   "%s() No frame of pool %p released within %d ms\n",
+                   __func__, pool, timeout_ms);
+        return NULL;
+    }
+
+    return xma_frame_pool_frame_reset(pool, frame);
+}
+
+int32_t
+xma_frame_pool_destroy(XmaFramePool *pool)
+{
+    int32_t num_free;
+
+    xma_logmsg(XMA_DEBUG_LOG, XMA_BUFFER_MOD,
+               "%s() Destroy pool %p\n", __func__, pool);
+    pthread_mutex_lock(&pool->lock);
+    num_free = pool->num_free;
+    pthread_mutex_unlock(&pool->lock);
+
+    if (num_free != pool->num_frames)
+    {
+        xma_logmsg(XMA_ERROR_LOG, XMA_BUFFER_MOD,
+                   "Cannot destroy pool %p with %d frames in use\n",
+                   pool, pool->num_frames - num_free);
+        return XMA_ERROR;
+    }
+
+    xma_frame_pool_free(pool);
+
+    return XMA_SUCCESS;
+}
+
+void
+xma_frame_pool_release(XmaFramePool *pool)
+{
+    bool idle;
+
+    xma_logmsg(XMA_DEBUG_LOG, XMA_BUFFER_MOD,
+               "%s() Release pool %p\n", __func__, pool);
+    pthread_mutex_lock(&pool->lock);
+    pool->released = true;
+    idle = pool->num_free == pool->num_frames;
+    pthread_mutex_unlock(&pool->lock);
+
+    if (idle)
+        xma_frame_pool_free(pool);
+}
+
 XmaDataBuffer*
 xma_data_from_buffer_clone(uint8_t *data, size_t size)
 {
@@ -152,8 +451,7 @@ xma_data_buffer_free(XmaDataBuffer *data)
 {
     xma_logmsg(XMA_DEBUG_LOG, XMA_BUFFER_MOD,
                "%s() Free buffer %p\n", __func__, data);
-    data->data.refcount--;
-    if (data->data.refcount > 0)
+    if (__atomic_sub_fetch(&data->data.refcount, 1, __ATOMIC_ACQ_REL) > 0)
         return;
 
     if (!data->data.is_clone)
@@ -0,0 +1,285 @@
+/*
+ * Copyright (C) 2018, Xilinx Inc - All rights reserved
+ * Xilinx SDAccel Media Accelerator API
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+#include <fcntl.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "app/xmaerror.h"
+#include "app/xmalogger.h"
+#include "lib/xmaapi.h"
+#include "lib/xmacache.h"
+
+#define XMA_CACHE_MOD "xmacache"
+#define XMA_CACHE_MAGIC 0x584d4143 /* "XMAC" */
+
+extern XmaSingleton *g_xma_singleton;
+
+#define XMA_FNV_OFFSET 0xcbf29ce484222325ULL
+#define XMA_FNV_PRIME  0x100000001b3ULL
+
+/* FNV-1a over 8-byte words, the tail byte by byte */
+static uint64_t xma_cache_hash(uint64_t hash, const void *data, size_t size)
+{
+    const uint8_t *p = data;
+    size_t i = 0;
+
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+
+        memcpy(&word, p + i, sizeof(word));
+        hash = (hash ^ word) * XMA_FNV_PRIME;
+    }
+    for (; i < size; i++)
+        hash = (hash ^ p[i]) * XMA_FNV_PRIME;
+
+    return hash;
+}
+
+static uint64_t xma_cache_checksum(const XmaCfgCache *cache)
+{
+    return xma_cache_hash(XMA_FNV_OFFSET, cache,
+                          offsetof(XmaCfgCache, checksum));
+}
+
+static int32_t xma_cache_read(int fd, void *buf, size_t size)
+{
+    size_t done = 0;
+
+    while (done < size)
+    {
+        ssize_t n = read(fd, (char*)buf + done, size - done);
+
+        if (n <= 0)
+            return XMA_ERROR;
+        done += n;
+    }
+    return XMA_SUCCESS;
+}
+
+static int32_t xma_cache_file_hash(const char *file, uint64_t *hash)
+{
+    char buf[4096];
+    ssize_t n;
+    int fd;
+
+    fd = open(file, O_RDONLY);
+    if (fd < 0)
+        return XMA_ERROR;
+
+    *hash = XMA_FNV_OFFSET;
+    while ((n = read(fd, buf, sizeof(buf))) > 0)
+        *hash = xma_cache_hash(*hash, buf, n);
+    close(fd);
+
+    return n < 0 ? XMA_ERROR : XMA_SUCCESS;
+}
+
+static int32_t xma_cache_stamp_get(const char *file, XmaXclbinStamp *stamp)
+{
+    struct stat st;
+
+    if (stat(file, &st) < 0)
+        return XMA_ERROR;
+
+    memset(stamp, 0, sizeof(*stamp));
+    stamp->dev = st.st_dev;
+    stamp->ino = st.st_ino;
+    stamp->size = st.st_size;
+    stamp->mtime_ns = (uint64_t)st.st_mtim.tv_sec * 1000000000ULL +
+                      st.st_mtim.tv_nsec;
+    return XMA_SUCCESS;
+}
+
+void xma_cfg_cache_path(char *path, size_t size)
+{
+    const char *dir = getenv("XDG_RUNTIME_DIR");
+
+    if (dir && dir[0] == '/')
+        snprintf(path, size, "%s/%s", dir, XMA_CFG_CACHE_FILE);
+    else
+        snprintf(path, size, "/tmp/%s.%u", XMA_CFG_CACHE_FILE,
+                 (unsigned)geteuid());
+}
+
+/* Open a snapshot for reading, unless it is a link or another user could
+ * have written it */
+static int xma_cache_open(const char *path)
+{
+    struct stat st;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) ||
+        st.st_uid != geteuid() || (st.st_mode & (S_IWGRP | S_IWOTH)))
+    {
+        xma_logmsg(XMA_ERROR_LOG, XMA_CACHE_MOD,
+                   "Ignoring config snapshot %s: not owned by user or writable by others\n",
+                   path);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int32_t xma_cfg_cache_load(XmaCfgCache *cache, const char *path,
+                           const char *cfgfile)
+{
+    uint64_t cfg_hash = 0;
+    int32_t rc = XMA_ERROR;
+    int fd;
+
+    /* the YAML file is small: hashing it is cheaper than parsing it */
+    if (xma_cache_file_hash(cfgfile, &cfg_hash) == XMA_SUCCESS)
+    {
+        fd = xma_cache_open(path);
+        if (fd >= 0)
+        {
+            rc = xma_cache_read(fd, cache, sizeof(XmaCfgCache));
+            close(fd);
+        }
+        if (rc == XMA_SUCCESS &&
+            (cache->magic != XMA_CACHE_MAGIC ||
+             cache->size != sizeof(XmaCfgCache) ||
+             cache->cfg_hash != cfg_hash ||
+             cache->checksum != xma_cache_checksum(cache) ||
+             cache->num_xclbins < 0 ||
+             cache->num_xclbins > MAX_IMAGE_CONFIGS))
+            rc = XMA_ERROR;
+    }
+
+    if (rc != XMA_SUCCESS)
+    {
+        memset(cache, 0, sizeof(XmaCfgCache));
+        cache->magic = XMA_CACHE_MAGIC;
+        cache->size = sizeof(XmaCfgCache);
+        cache->cfg_hash = cfg_hash;
+    }
+    cache->dirty = false;
+
+    return rc;
+}
+
+XmaCfgCache *xma_cfg_cache_get(void)
+{
+    return g_xma_singleton ? g_xma_singleton->cfg_cache : NULL;
+}
+
+void xma_cfg_cache_systemcfg_set(XmaCfgCache        *cache,
+                                 const XmaSystemCfg *systemcfg)
+{
+    cache->systemcfg = *systemcfg;
+    cache->dirty = true;
+}
+
+static int32_t xma_cache_xclbin_find(XmaCfgCache *cache, const char *xclbin)
+{
+    int32_t i;
+
+    for (i = 0; i < cache->num_xclbins; i++)
+    {
+        if (strcmp(cache->xclbins[i].xclbin_name, xclbin) == 0)
+            return i;
+    }
+    return -1;
+}
+
+int32_t xma_cfg_cache_xclbin_get(XmaCfgCache   *cache,
+                                 const char    *xclbin,
+                                 XmaXclbinInfo *info)
+{
+    XmaXclbinStamp stamp;
+    int32_t i;
+
+    i = xma_cache_xclbin_find(cache, xclbin);
+    if (i < 0 || xma_cache_stamp_get(xclbin, &stamp) != XMA_SUCCESS ||
+        memcmp(&stamp, &cache->stamps[i], sizeof(stamp)) != 0)
+        return XMA_ERROR;
+
+    *info = cache->xclbins[i];
+    xma_logmsg(XMA_DEBUG_LOG, XMA_CACHE_MOD,
+               "Using cached IP layout of %s\n", xclbin);
+    return XMA_SUCCESS;
+}
+
+void xma_cfg_cache_xclbin_set(XmaCfgCache         *cache,
+                              const char          *xclbin,
+                              const XmaXclbinInfo *info)
+{
+    XmaXclbinStamp stamp;
+    int32_t i;
+
+    if (strlen(xclbin) >= sizeof(info->xclbin_name) ||
+        xma_cache_stamp_get(xclbin, &stamp) != XMA_SUCCESS)
+        return;
+
+    i = xma_cache_xclbin_find(cache, xclbin);
+    if (i < 0)
+    {
+        if (cache->num_xclbins == MAX_IMAGE_CONFIGS)
+            return;
+        i = cache->num_xclbins++;
+    }
+    cache->xclbins[i] = *info;
+    strcpy(cache->xclbins[i].xclbin_name, xclbin);
+    cache->stamps[i] = stamp;
+    cache->dirty = true;
+}
+
+int32_t xma_cfg_cache_store(XmaCfgCache *cache, const char *path)
+{
+    char tmp[PATH_MAX];
+    ssize_t n;
+    int fd;
+
+    if (!cache->dirty)
+        return XMA_SUCCESS;
+
+    snprintf(tmp, sizeof(tmp), "%s.%d", path, getpid());
+    fd = open(tmp, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC,
+              0600);
+    if (fd < 0)
+    {
+        xma_logmsg(XMA_ERROR_LOG, XMA_CACHE_MOD,
+                   "Could not create config snapshot %s\n", tmp);
+        return XMA_ERROR;
+    }
+
+    cache->dirty = false;
+    cache->checksum = xma_cache_checksum(cache);
+    n = write(fd, cache, sizeof(XmaCfgCache));
+    close(fd);
+    if (n != sizeof(XmaCfgCache) || rename(tmp, path) < 0)
+    {
+        xma_logmsg(XMA_ERROR_LOG, XMA_CACHE_MOD,
+                   "Could not write config snapshot %s\n", path);
+        unlink(tmp);
+        cache->dirty = true;
+        return XMA_ERROR;
+    }
+
+    xma_logmsg(XMA_INFO_LOG, XMA_CACHE_MOD,
+               "Saved config snapshot %s\n", path);
+    return XMA_SUCCESS;
+}
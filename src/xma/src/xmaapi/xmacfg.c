@@ -37,10 +37,12 @@ typedef struct XmaData
 } XmaData;
 
 /* Prototypes for local state transition functions */
-static int validate_node_key(char *key, yaml_node_t *node, int key_no);
+static int validate_node_key(char *key, yaml_node_t *node, int key_no,
+                             bool is_required);
 static int check_systemcfg(XmaData *data);
 static int set_logfile(XmaData *data);
 static int set_loglevel(XmaData *data);
+static int set_placement(XmaData *data);
 static int set_dsa(XmaData *data);
 static int set_pluginpath(XmaData *data);
 static int set_xclbinpath(XmaData *data);
@@ -81,6 +83,7 @@ static XmaSystemCfgSM systemcfg_sm[] = {
 { "SystemCfg",     &check_systemcfg,   true },
 { "logfile",       &set_logfile,       false },
 { "loglevel",      &set_loglevel,      false },
+{ "placement",     &set_placement,     false },
 { "dsa",           &set_dsa,           true },
 { "pluginpath",    &set_pluginpath,    true },
 { "xclbinpath",    &set_xclbinpath,    true },
@@ -132,6 +135,28 @@ int set_loglevel(XmaData *data)
     return XMA_SUCCESS;
 }
 
+int set_placement(XmaData *data)
+{
+    yaml_node_t *next_node;
+    const char *value;
+
+    next_node = get_next_scalar_node(data->document, &data->node_idx);
+    value = (const char*)next_node->data.scalar.value;
+    if (strcmp(value, "pack") == 0)
+        data->systemcfg->placement = XMA_PLACEMENT_PACK;
+    else if (strcmp(value, "spread") == 0)
+        data->systemcfg->placement = XMA_PLACEMENT_SPREAD;
+    else
+    {
+        xma_cfg_log_err("Invalid placement '%s'; expected pack or spread\n",
+                        value);
+        return XMA_ERROR;
+    }
+    data->state_idx++;
+
+    return XMA_SUCCESS;
+}
+
 int set_dsa(XmaData *data)
 {
     yaml_node_t *next_node;
@@ -456,7 +481,8 @@ int run_state_machine(yaml_document_t *document,
             if (!data.node)
                 return XMA_ERROR;
         }
-        if (validate_node_key(state_entry->key, data.node, data.key_no))
+        if (validate_node_key(state_entry->key, data.node, data.key_no,
+                              state_entry->is_required))
         {
             if (!state_entry->is_required)
             {
@@ -516,11 +542,14 @@ int xma_cfg_parse(char *fname, XmaSystemCfg *systemcfg)
     return rc;
 }
 
-int validate_node_key(char *key, yaml_node_t *node, int key_no)
+/* Optional keys that are absent are skipped silently by the caller */
+int validate_node_key(char *key, yaml_node_t *node, int key_no,
+                      bool is_required)
 {
     if (strcmp(key, (const char*)node->data.scalar.value) != 0) {
-        xma_cfg_log_err("Missing %s property on key %d in yaml config file\n",
-                        key, key_no);
+        if (is_required)
+            xma_cfg_log_err("Missing %s property on key %d in yaml config file\n",
+                            key, key_no);
         return XMA_ERROR_INVALID;
     }
     return XMA_SUCCESS;
@@ -15,17 +15,24 @@
  * under the License.
  */
 
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include "app/xmabuffers.h"
 #include "app/xmaerror.h"
+#include "app/xmalogger.h"
 #include "lib/xmaapi.h"
 #include "lib/xmacfg.h"
 #include "lib/xmaconnect.h"
 #include "lib/xmahw.h"
 
+#define XMA_CONNECT_MOD "xmaconnect"
+
 extern XmaSingleton *g_xma_singleton;
 
+// Guards the connection table and the frame queue of each entry
+static pthread_mutex_t xma_connect_lock = PTHREAD_MUTEX_INITIALIZER;
+
 // Helper functions
 bool
 is_zerocopy_enabled(int32_t dev_id);
@@ -50,11 +57,7 @@ xma_connect_alloc(XmaEndpoint *endpt, XmaConnectType type)
     // entry and set the state to pending.
     // NOTE: The connection table is only local to a process
     //       and not kept in shared system memory
-    // TODO: It may be necessary to obtain a lock on the connection
-    //       table; however, assume for now that connections are
-    //       established during initialization and initialization
-    //       is all performed from a single thread.  This assumption
-    //       may not be true and could create a problem.
+    pthread_mutex_lock(&xma_connect_lock);
 
     // Find an unused entry for a sender
     if (type == XMA_CONNECT_SENDER)
@@ -70,7 +73,8 @@ xma_connect_alloc(XmaEndpoint *endpt, XmaConnectType type)
             }
         }
     }
-    // Find a compatible pending entry for a receiver
+    // Find a compatible pending entry for a receiver, never one
+    // of the outputs of the receiving session itself
     if (type == XMA_CONNECT_RECEIVER)
     {
         for (i = 0; i < MAX_CONNECTION_ENTRIES; i++)
@@ -78,9 +82,11 @@ xma_connect_alloc(XmaEndpoint *endpt, XmaConnectType type)
             if (conntbl[i].state == XMA_CONNECT_PENDING_ACTIVE)
             {
                 XmaEndpoint *cmp_endpt = conntbl[i].sender;
-                if (is_connect_compatible(endpt, cmp_endpt))
+                if (cmp_endpt->session != endpt->session &&
+                    is_connect_compatible(endpt, cmp_endpt))
                 {
-                    printf("xmaconnect: compatible connection found\n");
+                    xma_logmsg(XMA_INFO_LOG, XMA_CONNECT_MOD,
+                               "compatible connection found\n");
                     c_handle = i;
                     conntbl[i].receiver = endpt;
                     conntbl[i].state = XMA_CONNECT_ACTIVE;
@@ -89,6 +95,8 @@ xma_connect_alloc(XmaEndpoint *endpt, XmaConnectType type)
             }
         }
     }
+    pthread_mutex_unlock(&xma_connect_lock);
+
     return c_handle;
 }
 
@@ -96,37 +104,214 @@ int32_t
 xma_connect_free(int32_t c_handle, XmaConnectType type)
 {
     XmaConnect *conntbl = g_xma_singleton->connections;
+    XmaConnect *conn;
+    XmaFramePool *pool = NULL;
 
     if (c_handle == -1)
         return XMA_SUCCESS;
 
-    if (type == XMA_CONNECT_SENDER &&
-        conntbl[c_handle].sender != NULL)
+    pthread_mutex_lock(&xma_connect_lock);
+    conn = &conntbl[c_handle];
+
+    if (type == XMA_CONNECT_SENDER && conn->sender != NULL)
     {
-        free(conntbl[c_handle].sender);
-        conntbl[c_handle].sender = NULL;
-        if (conntbl[c_handle].state == XMA_CONNECT_ACTIVE &&
-            conntbl[c_handle].receiver == NULL)
-            conntbl[c_handle].state = XMA_CONNECT_UNUSED;
-        else
-            conntbl[c_handle].state = XMA_CONNECT_PENDING_DELETE;
+        free(conn->sender);
+        conn->sender = NULL;
+        conn->state = XMA_CONNECT_PENDING_DELETE;
+    }
+
+    if (type == XMA_CONNECT_RECEIVER && conn->receiver != NULL)
+    {
+        free(conn->receiver);
+        conn->receiver = NULL;
+        conn->state = XMA_CONNECT_PENDING_DELETE;
+
+        // Frames sent but never received go back to the pool
+        while (conn->queue_cnt > 0)
+        {
+            xma_frame_free(conn->queue[conn->queue_head]);
+            conn->queue_head = (conn->queue_head + 1) % MAX_CONNECTION_FRAMES;
+            conn->queue_cnt--;
+        }
     }
 
-    if (type == XMA_CONNECT_RECEIVER &&
-        conntbl[c_handle].receiver != NULL)
+    // Reclaim the entry once both ends are gone; frames still held
+    // by the application keep the pool alive until released
+    if (conn->sender == NULL && conn->receiver == NULL)
     {
-        free(conntbl[c_handle].receiver);
-        conntbl[c_handle].receiver = NULL;
-        if (conntbl[c_handle].state == XMA_CONNECT_PENDING_DELETE &&
-            conntbl[c_handle].sender == NULL)
-            conntbl[c_handle].state = XMA_CONNECT_UNUSED;
-        else
-            conntbl[c_handle].state = XMA_CONNECT_PENDING_DELETE;
+        pool = conn->pool;
+        conn->pool = NULL;
+        conn->queue_head = 0;
+        conn->state = XMA_CONNECT_UNUSED;
     }
+    pthread_mutex_unlock(&xma_connect_lock);
+
+    if (pool)
+        xma_frame_pool_release(pool);
 
    return XMA_SUCCESS;
 }
 
+XmaFrame*
+xma_connect_frame_get(int32_t c_handle, int32_t timeout_ms)
+{
+    XmaConnect *conn;
+    XmaFramePool *pool;
+
+    if (c_handle < 0 || c_handle >= MAX_CONNECTION_ENTRIES)
+        return NULL;
+
+    pthread_mutex_lock(&xma_connect_lock);
+    conn = &g_xma_singleton->connections[c_handle];
+    if (conn->state != XMA_CONNECT_ACTIVE)
+    {
+        pthread_mutex_unlock(&xma_connect_lock);
+        return NULL;
+    }
+
+    // Device frames are allocated on first use, in the DDR bank of
+    // the sender which is also the bank of the receiver
+    if (!conn->pool)
+    {
+        XmaEndpoint *sender = conn->sender;
+        XmaFrameProperties props;
+
+        props.format = sender->format;
+        props.width = sender->width;
+        props.height = sender->height;
+        props.bits_per_pixel = sender->bits_per_pixel;
+        conn->pool = xma_frame_pool_create(sender->session, &props,
+                                           MAX_CONNECTION_FRAMES);
+        if (!conn->pool)
+            xma_logmsg(XMA_ERROR_LOG, XMA_CONNECT_MOD,
+                       "No device frames for connection %d\n", c_handle);
+    }
+    pool = conn->pool;
+    pthread_mutex_unlock(&xma_connect_lock);
+
+    // The pool lives as long as the sender calling this function
+    if (!pool)
+        return NULL;
+    return xma_frame_pool_get_wait(pool, timeout_ms);
+}
+
+int32_t
+xma_connect_frame_send(int32_t   c_handle,
+                       XmaFrame *dev_frame,
+                       XmaFrame *frame)
+{
+    XmaConnect *conn;
+    int32_t i, num_planes;
+
+    if (c_handle < 0 || c_handle >= MAX_CONNECTION_ENTRIES ||
+        !dev_frame || !frame)
+        return XMA_ERROR_INVALID;
+
+    // The application frame describes the device buffers; its own
+    // host buffers, if any, are left alone and freed with it
+    num_planes = xma_frame_planes_get(&dev_frame->frame_props);
+    frame->frame_props = dev_frame->frame_props;
+    for (i = 0; i < num_planes; i++)
+    {
+        frame->data[i].buffer_type = XMA_DEVICE_BUFFER_TYPE;
+        frame->data[i].bo_handle = dev_frame->data[i].bo_handle;
+        frame->data[i].paddr = dev_frame->data[i].paddr;
+    }
+
+    pthread_mutex_lock(&xma_connect_lock);
+    conn = &g_xma_singleton->connections[c_handle];
+    if (conn->state != XMA_CONNECT_ACTIVE ||
+        conn->queue_cnt == MAX_CONNECTION_FRAMES)
+    {
+        pthread_mutex_unlock(&xma_connect_lock);
+        return XMA_ERROR;
+    }
+    conn->queue[(conn->queue_head + conn->queue_cnt) % MAX_CONNECTION_FRAMES] =
+        dev_frame;
+    conn->queue_cnt++;
+    pthread_mutex_unlock(&xma_connect_lock);
+
+    return XMA_SUCCESS;
+}
+
+XmaFrame*
+xma_connect_frame_recv(int32_t c_handle, XmaFrame *frame)
+{
+    XmaConnect *conn;
+    XmaFrame *dev_frame = NULL;
+
+    if (c_handle < 0 || c_handle >= MAX_CONNECTION_ENTRIES || !frame ||
+        frame->data[0].buffer_type != XMA_DEVICE_BUFFER_TYPE)
+        return NULL;
+
+    pthread_mutex_lock(&xma_connect_lock);
+    conn = &g_xma_singleton->connections[c_handle];
+    if (conn->queue_cnt > 0)
+    {
+        XmaFrame *head = conn->queue[conn->queue_head];
+
+        if (head->data[0].bo_handle == frame->data[0].bo_handle &&
+            head->data[0].paddr == frame->data[0].paddr)
+        {
+            dev_frame = head;
+            conn->queue_head = (conn->queue_head + 1) % MAX_CONNECTION_FRAMES;
+            conn->queue_cnt--;
+        }
+    }
+    pthread_mutex_unlock(&xma_connect_lock);
+
+    if (!dev_frame)
+        return NULL;
+
+    dev_frame->time_base = frame->time_base;
+    dev_frame->frame_rate = frame->frame_rate;
+    dev_frame->pts = frame->pts;
+    dev_frame->is_idr = frame->is_idr;
+    dev_frame->do_not_encode = frame->do_not_encode;
+    dev_frame->is_last_frame = frame->is_last_frame;
+
+    return dev_frame;
+}
+
+static int32_t
+xma_connect_send_handle_get(XmaSession *session, int32_t output)
+{
+    if (!session)
+        return -1;
+
+    if (is_xma_scaler(session))
+    {
+        XmaScalerSession *sc_session = to_xma_scaler(session);
+
+        if (output < 0 || output >= sc_session->props.num_outputs)
+            return -1;
+        return sc_session->conn_send_handles[output];
+    }
+    if (is_xma_filter(session) && output == 0)
+        return to_xma_filter(session)->conn_send_handle;
+
+    return -1;
+}
+
+XmaFrame*
+xma_plg_connect_frame_get(XmaSession *session,
+                          int32_t     output,
+                          int32_t     timeout_ms)
+{
+    return xma_connect_frame_get(xma_connect_send_handle_get(session, output),
+                                 timeout_ms);
+}
+
+int32_t
+xma_plg_connect_frame_send(XmaSession *session,
+                           int32_t     output,
+                           XmaFrame   *dev_frame,
+                           XmaFrame   *frame)
+{
+    return xma_connect_frame_send(xma_connect_send_handle_get(session, output),
+                                  dev_frame, frame);
+}
+
 bool
 is_zerocopy_enabled(int32_t dev_id)
 {
@@ -152,7 +337,8 @@ is_zerocopy_enabled(int32_t dev_id)
             break;
     }
 
-    printf("xmaconnect: zerocopy enable = %d\n", zerocopy);
+    xma_logmsg(XMA_DEBUG_LOG, XMA_CONNECT_MOD,
+               "zerocopy enable = %d\n", zerocopy);
     return zerocopy;
 }
 
@@ -166,7 +352,8 @@ is_connect_compatible(XmaEndpoint *endpt1,
     // Can't check format because of scaler plugin BUG
     //       "endpt1->format  %d, endpt2->format  %d\n"
     //        endpt1->format,  endpt2->format,
-    printf("hw1->dev_handle %p, hw2->dev_handle %p\n"
+    xma_logmsg(XMA_DEBUG_LOG, XMA_CONNECT_MOD,
+           "hw1->dev_handle %p, hw2->dev_handle %p\n"
            "hw1->ddr_bank   %d, hw2->ddr_bandk  %d\n"
            "endpt1->bpp     %d, endpt2->bpp     %d\n"
            "endpt1->width   %d, endpt2->width   %d\n"
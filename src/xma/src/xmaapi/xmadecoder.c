@@ -21,6 +21,7 @@
 #include "lib/xmaapi.h"
 #include "lib/xmahw_hal.h"
 #include "lib/xmares.h"
+#include "lib/xmastats.h"
 #include "app/xmalogger.h"
 #include "xmaplugin.h"
 
@@ -201,8 +202,16 @@ xma_dec_session_send_data(XmaDecoderSession *session,
                           XmaDataBuffer     *data,
 						  int32_t           *data_used)
 {
+    int32_t rc;
+    uint64_t start_ns;
+
     xma_logmsg(XMA_DEBUG_LOG, XMA_DECODER_MOD, "%s()\n", __func__);
-    return session->decoder_plugin->send_data(session, data, data_used);
+    start_ns = xma_stats_now_ns();
+    rc = session->decoder_plugin->send_data(session, data, data_used);
+    xma_stats_latency(&session->base, XMA_STATS_SEND, start_ns);
+    if (rc >= XMA_SUCCESS && *data_used > 0)
+        xma_stats_frames_in(&session->base, 1, *data_used);
+    return rc;
 }
 
 int32_t
@@ -217,6 +226,18 @@ int32_t
 xma_dec_session_recv_frame(XmaDecoderSession *session,
                            XmaFrame           *frame)
 {
+    int32_t rc;
+    uint64_t start_ns;
+
     xma_logmsg(XMA_DEBUG_LOG, XMA_DECODER_MOD, "%s()\n", __func__);
-    return session->decoder_plugin->recv_frame(session, frame);
+    start_ns = xma_stats_now_ns();
+    rc = session->decoder_plugin->recv_frame(session, frame);
+    xma_stats_latency(&session->base, XMA_STATS_RECV, start_ns);
+    if (rc == XMA_SUCCESS)
+    {
+        xma_res_kernel_progress(g_xma_singleton->shm_res_cfg,
+                                session->base.kern_res, 1);
+        xma_stats_frames_out(&session->base, 1, xma_stats_frame_bytes(frame));
+    }
+    return rc;
 }
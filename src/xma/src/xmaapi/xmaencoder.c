@@ -24,8 +24,10 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include "lib/xmaapi.h"
+#include "lib/xmaasync.h"
 #include "lib/xmahw_hal.h"
 #include "lib/xmares.h"
+#include "lib/xmastats.h"
 #include "xmaplugin.h"
 
 char    g_stat_fmt[] = "last_pid_in_use          :%d\n"
@@ -230,6 +232,7 @@ xma_enc_session_destroy(XmaEncoderSession *session)
     int32_t rc;
 
     xma_logmsg(XMA_DEBUG_LOG, XMA_ENCODER_MOD, "%s()\n", __func__);
+    xma_async_stop(&session->base);
 
     // Clean up the stats file, but don't delete it 
     xma_enc_session_statsfile_close(session);
@@ -268,11 +271,32 @@ xma_enc_session_send_frame(XmaEncoderSession *session,
     struct   timespec ts;
     uint64_t timestamp;
     uint32_t frame_size;
+    uint64_t start_ns;
+    XmaFrame *dev_frame;
 
     xma_logmsg(XMA_DEBUG_LOG, XMA_ENCODER_MOD, "%s()\n", __func__);
+    if (xma_async_enabled(&session->base))
+        return XMA_ERROR_INVALID;
     clock_gettime(CLOCK_MONOTONIC, &ts);  
     timestamp = (ts.tv_sec * 1000000000) + ts.tv_nsec;
-    rc = session->encoder_plugin->send_frame(session, frame);
+    // A frame written by a zerocopy sender reaches the plugin as the
+    // device frame of the connection
+    dev_frame = xma_connect_frame_recv(session->conn_recv_handle, frame);
+    start_ns = xma_stats_now_ns();
+    if (dev_frame)
+    {
+        rc = session->encoder_plugin->send_frame(session, dev_frame);
+        xma_frame_free(dev_frame);
+    }
+    else
+        rc = session->encoder_plugin->send_frame(session, frame);
+    xma_stats_latency(&session->base, XMA_STATS_SEND, start_ns);
+    if (rc >= XMA_SUCCESS && frame->do_not_encode == false)
+    {
+        xma_res_kernel_progress(g_xma_singleton->shm_res_cfg,
+                                session->base.kern_res, 1);
+        xma_stats_frames_in(&session->base, 1, xma_stats_frame_bytes(frame));
+    }
     if (frame->do_not_encode == false)
     {
         frame_size = frame->frame_props.width * frame->frame_props.height; 
@@ -292,11 +316,17 @@ xma_enc_session_recv_data(XmaEncoderSession *session,
     int32_t  rc;
     struct   timespec ts;
     uint64_t timestamp;
+    uint64_t start_ns;
 
     xma_logmsg(XMA_DEBUG_LOG, XMA_ENCODER_MOD, "%s()\n", __func__);
+    if (xma_async_enabled(&session->base))
+        return XMA_ERROR_INVALID;
+    start_ns = xma_stats_now_ns();
     rc = session->encoder_plugin->recv_data(session, data, data_size);
+    xma_stats_latency(&session->base, XMA_STATS_RECV, start_ns);
     if (*data_size)
     {
+        xma_stats_frames_out(&session->base, 1, *data_size);
         clock_gettime(CLOCK_MONOTONIC, &ts);  
         timestamp = (ts.tv_sec * 1000000000) + ts.tv_nsec;
         xma_enc_session_statsfile_recv_data(session, 
@@ -307,6 +337,111 @@ xma_enc_session_recv_data(XmaEncoderSession *session,
     return rc;
 }
 
+/* Asynchronous mode for plugins without stage callbacks */
+static int32_t
+xma_enc_session_async_execute(XmaSession *s, XmaAsyncJob *job)
+{
+    XmaEncoderSession *session = to_xma_encoder(s);
+    int32_t rc;
+
+    rc = session->encoder_plugin->send_frame(session, job->frame);
+    if (rc != XMA_SUCCESS)
+        return rc;
+    return session->encoder_plugin->recv_data(session, job->output,
+                                              &job->output_size);
+}
+
+static const XmaAsyncPlugin xma_enc_session_async_default = {
+    .max_depth = 0,
+    .execute = xma_enc_session_async_execute,
+};
+
+static void
+xma_enc_session_async_complete(XmaSession *s, XmaAsyncJob *job,
+                               void (*done)(void))
+{
+    XmaEncoderSession *session = to_xma_encoder(s);
+    struct   timespec ts;
+    uint64_t timestamp;
+
+    if (job->status >= XMA_SUCCESS && job->frame->do_not_encode == false)
+    {
+        xma_res_kernel_progress(g_xma_singleton->shm_res_cfg,
+                                session->base.kern_res, 1);
+        xma_stats_frames_in(&session->base, 1,
+                            xma_stats_frame_bytes(job->frame));
+    }
+    if (job->frame != job->app_frame)
+        xma_frame_free(job->frame);
+    if (job->output_size)
+    {
+        xma_stats_frames_out(&session->base, 1, job->output_size);
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        timestamp = (ts.tv_sec * 1000000000) + ts.tv_nsec;
+        xma_enc_session_statsfile_recv_data(session,
+                                            timestamp,
+                                            job->output_size);
+    }
+    if (done)
+        ((XmaEncoderAsyncDone)done)(session, job->app_frame, job->output,
+                                    job->output_size, job->status,
+                                    job->user_data);
+}
+
+int32_t
+xma_enc_session_async_start(XmaEncoderSession   *session,
+                            int32_t              depth,
+                            XmaEncoderAsyncDone  done)
+{
+    const XmaAsyncPlugin *stages;
+
+    xma_logmsg(XMA_DEBUG_LOG, XMA_ENCODER_MOD, "%s()\n", __func__);
+    if (!session)
+        return XMA_ERROR_INVALID;
+    stages = session->encoder_plugin->async ?
+             session->encoder_plugin->async : &xma_enc_session_async_default;
+    return xma_async_start(&session->base, stages, depth,
+                           xma_enc_session_async_complete,
+                           (void (*)(void))done);
+}
+
+int32_t
+xma_enc_session_send_frame_async(XmaEncoderSession *session,
+                                 XmaFrame          *frame,
+                                 XmaDataBuffer     *data,
+                                 void              *user_data)
+{
+    struct   timespec ts;
+    uint64_t timestamp;
+    uint32_t frame_size;
+    XmaFrame *dev_frame;
+
+    xma_logmsg(XMA_DEBUG_LOG, XMA_ENCODER_MOD, "%s()\n", __func__);
+    if (!session || !frame || !xma_async_enabled(&session->base))
+        return XMA_ERROR_INVALID;
+    if (frame->do_not_encode == false)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        timestamp = (ts.tv_sec * 1000000000) + ts.tv_nsec;
+        frame_size = frame->frame_props.width * frame->frame_props.height;
+        xma_enc_session_statsfile_send_frame(session,
+                                             timestamp,
+                                             frame_size);
+    }
+    dev_frame = xma_connect_frame_recv(session->conn_recv_handle, frame);
+    return xma_async_submit(&session->base, dev_frame ? dev_frame : frame,
+                            frame, data, user_data);
+}
+
+int32_t
+xma_enc_session_async_flush(XmaEncoderSession *session)
+{
+    xma_logmsg(XMA_DEBUG_LOG, XMA_ENCODER_MOD, "%s()\n", __func__);
+    if (!session)
+        return XMA_ERROR_INVALID;
+    return xma_async_flush(&session->base);
+}
+
 void 
 xma_enc_session_statsfile_init(XmaEncoderSession *session)
 {
@@ -419,9 +554,9 @@ void xma_enc_session_statsfile_write(XmaEncoderStats *stats)
             stats->encoded_frame_count,
             stats->encoded_bit_count);
 
-    // Always re-write the entire file
-    lseek(stats->fd, 0, SEEK_SET);
-    rc = write(stats->fd, stat_buf, strlen(stat_buf)); 
+    // Always re-write the entire file; a single pwrite so that the
+    // send and receive sides of an async session can both update it
+    rc = pwrite(stats->fd, stat_buf, strlen(stat_buf), 0);
     if (rc < 0)
         xma_logmsg(XMA_INFO_LOG, XMA_ENCODER_MOD, 
                    "Write to statsfile failed\n");
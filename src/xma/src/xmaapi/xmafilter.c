@@ -19,8 +19,10 @@
 #include <string.h>
 #include <dlfcn.h>
 #include "lib/xmaapi.h"
+#include "lib/xmaasync.h"
 #include "lib/xmahw_hal.h"
 #include "lib/xmares.h"
+#include "lib/xmastats.h"
 #include "xmaplugin.h"
 
 #define XMA_FILTER_MOD "xmafilter"
@@ -196,6 +198,7 @@ xma_filter_session_destroy(XmaFilterSession *session)
     int32_t rc;
 
     xma_logmsg(XMA_DEBUG_LOG, XMA_FILTER_MOD, "%s()\n", __func__);
+    xma_async_stop(&session->base);
     rc  = session->filter_plugin->close(session);
     if (rc != 0)
         xma_logmsg(XMA_ERROR_LOG, XMA_FILTER_MOD,
@@ -224,11 +227,10 @@ xma_filter_session_destroy(XmaFilterSession *session)
     return XMA_SUCCESS;
 }
 
-int32_t
-xma_filter_session_send_frame(XmaFilterSession  *session,
-                              XmaFrame          *frame)
+/* Point the output at the input buffer of a zerocopy encoder */
+static void
+xma_filter_session_zerocopy_dest_set(XmaFilterSession *session)
 {
-    xma_logmsg(XMA_DEBUG_LOG, XMA_FILTER_MOD, "%s()\n", __func__);
     if (session->conn_send_handle != -1)
     {
         // Get the connection entry to find the receiver
@@ -243,21 +245,129 @@ xma_filter_session_send_frame(XmaFilterSession  *session,
                 if (!e_ses->encoder_plugin->get_dev_input_paddr) {
                     xma_logmsg(XMA_DEBUG_LOG, XMA_FILTER_MOD,
                         "encoder plugin does not support zero copy\n");
-                    goto send;
+                    return;
 		}
                 session->out_dev_addr = e_ses->encoder_plugin->get_dev_input_paddr(e_ses);
                 session->zerocopy_dest = true;
             }
         }
     }
-send:
-    return session->filter_plugin->send_frame(session, frame);
+}
+
+int32_t
+xma_filter_session_send_frame(XmaFilterSession  *session,
+                              XmaFrame          *frame)
+{
+    int32_t rc;
+    uint64_t start_ns;
+
+    xma_logmsg(XMA_DEBUG_LOG, XMA_FILTER_MOD, "%s()\n", __func__);
+    if (xma_async_enabled(&session->base))
+        return XMA_ERROR_INVALID;
+    xma_filter_session_zerocopy_dest_set(session);
+    start_ns = xma_stats_now_ns();
+    rc = session->filter_plugin->send_frame(session, frame);
+    xma_stats_latency(&session->base, XMA_STATS_SEND, start_ns);
+    if (rc >= XMA_SUCCESS)
+    {
+        xma_res_kernel_progress(g_xma_singleton->shm_res_cfg,
+                                session->base.kern_res, 1);
+        xma_stats_frames_in(&session->base, 1, xma_stats_frame_bytes(frame));
+    }
+    return rc;
 }
 
 int32_t
 xma_filter_session_recv_frame(XmaFilterSession  *session,
                               XmaFrame          *frame)
+{
+    int32_t rc;
+    uint64_t start_ns;
+
+    xma_logmsg(XMA_DEBUG_LOG, XMA_FILTER_MOD, "%s()\n", __func__);
+    if (xma_async_enabled(&session->base))
+        return XMA_ERROR_INVALID;
+    start_ns = xma_stats_now_ns();
+    rc = session->filter_plugin->recv_frame(session, frame);
+    xma_stats_latency(&session->base, XMA_STATS_RECV, start_ns);
+    if (rc == XMA_SUCCESS)
+        xma_stats_frames_out(&session->base, 1, xma_stats_frame_bytes(frame));
+    return rc;
+}
+
+/* Asynchronous mode for plugins without stage callbacks */
+static int32_t
+xma_filter_session_async_execute(XmaSession *s, XmaAsyncJob *job)
+{
+    XmaFilterSession *session = to_xma_filter(s);
+    int32_t rc;
+
+    rc = session->filter_plugin->send_frame(session, job->frame);
+    if (rc != XMA_SUCCESS)
+        return rc;
+    return session->filter_plugin->recv_frame(session, job->output);
+}
+
+static const XmaAsyncPlugin xma_filter_session_async_default = {
+    .max_depth = 0,
+    .execute = xma_filter_session_async_execute,
+};
+
+static void
+xma_filter_session_async_complete(XmaSession *s, XmaAsyncJob *job,
+                                  void (*done)(void))
+{
+    XmaFilterSession *session = to_xma_filter(s);
+
+    if (job->status >= XMA_SUCCESS)
+    {
+        xma_res_kernel_progress(g_xma_singleton->shm_res_cfg,
+                                session->base.kern_res, 1);
+        xma_stats_frames_in(&session->base, 1,
+                            xma_stats_frame_bytes(job->frame));
+        xma_stats_frames_out(&session->base, 1,
+                             xma_stats_frame_bytes(job->output));
+    }
+    if (done)
+        ((XmaFilterAsyncDone)done)(session, job->app_frame, job->output,
+                                   job->status, job->user_data);
+}
+
+int32_t
+xma_filter_session_async_start(XmaFilterSession   *session,
+                               int32_t             depth,
+                               XmaFilterAsyncDone  done)
+{
+    const XmaAsyncPlugin *stages;
+
+    xma_logmsg(XMA_DEBUG_LOG, XMA_FILTER_MOD, "%s()\n", __func__);
+    if (!session)
+        return XMA_ERROR_INVALID;
+    stages = session->filter_plugin->async ?
+             session->filter_plugin->async : &xma_filter_session_async_default;
+    return xma_async_start(&session->base, stages, depth,
+                           xma_filter_session_async_complete,
+                           (void (*)(void))done);
+}
+
+int32_t
+xma_filter_session_send_frame_async(XmaFilterSession  *session,
+                                    XmaFrame          *frame,
+                                    XmaFrame          *output,
+                                    void              *user_data)
+{
+    xma_logmsg(XMA_DEBUG_LOG, XMA_FILTER_MOD, "%s()\n", __func__);
+    if (!session || !frame || !xma_async_enabled(&session->base))
+        return XMA_ERROR_INVALID;
+    xma_filter_session_zerocopy_dest_set(session);
+    return xma_async_submit(&session->base, frame, frame, output, user_data);
+}
+
+int32_t
+xma_filter_session_async_flush(XmaFilterSession *session)
 {
     xma_logmsg(XMA_DEBUG_LOG, XMA_FILTER_MOD, "%s()\n", __func__);
-    return session->filter_plugin->recv_frame(session, frame);
+    if (!session)
+        return XMA_ERROR_INVALID;
+    return xma_async_flush(&session->base);
 }
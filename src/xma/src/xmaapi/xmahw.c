@@ -35,3 +35,15 @@ bool xma_hw_configure(XmaHwCfg *hwcfg, XmaSystemCfg *systemcfg, bool hw_cfg_stat
 {
     return hw_if.configure(hwcfg, systemcfg, hw_cfg_status);
 }
+
+int32_t xma_hw_buffer_alloc(XmaHwSession *session, size_t size,
+                            uint32_t *handle, void **map, uint64_t *paddr)
+{
+    return hw_if.buffer_alloc(session, size, handle, map, paddr);
+}
+
+void xma_hw_buffer_free(XmaHwSession *session, uint32_t handle,
+                        void *map, size_t size)
+{
+    hw_if.buffer_free(session, handle, map, size);
+}
@@ -23,9 +23,11 @@
 #include <fcntl.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include <xclhal2.h>
 //#include <xclbin.h>
 #include "app/xmaerror.h"
+#include "lib/xmacache.h"
 #include "lib/xmaxclbin.h"
 #include "lib/xmahw_hal.h"
 #include "lib/xmahw_private.h"
@@ -182,6 +184,7 @@ bool hal_configure(XmaHwCfg *hwcfg, XmaSystemCfg *systemcfg, bool hw_configured)
 {
     std::string   xclbinpath = systemcfg->xclbinpath;
     XmaXclbinInfo info;
+    XmaCfgCache *cache = xma_cfg_cache_get();
     int32_t ddr_table[] = {0, 3, 1, 2};
 
     /* Download the requested image to the associated device */
@@ -190,19 +193,32 @@ bool hal_configure(XmaHwCfg *hwcfg, XmaSystemCfg *systemcfg, bool hw_configured)
     {
         std::string xclbin = systemcfg->imagecfg[i].xclbin;
         std::string xclfullname = xclbinpath + "/" + xclbin;
-        char *buffer = xma_xclbin_file_open(xclfullname.c_str());
-        if (!buffer)
+        char *buffer = NULL;
+        int32_t rc;
+
+        /* Devices already programmed only need the IP layout, which the
+         * startup snapshot has unless the xclbin changed */
+        if (!hw_configured || !cache ||
+            xma_cfg_cache_xclbin_get(cache, xclfullname.c_str(),
+                                     &info) != XMA_SUCCESS)
         {
-            xma_logmsg("Could not open xclbin file %s\n",
-                       xclfullname.c_str());
-            return false;
-        }
-        int32_t rc = xma_xclbin_info_get(buffer, &info);
-        if (rc != XMA_SUCCESS)
-        {
-            xma_logmsg("Could not get info for xclbin file %s\n",
-                       xclfullname.c_str());
-            return false;
+            buffer = xma_xclbin_file_open(xclfullname.c_str());
+            if (!buffer)
+            {
+                xma_logmsg("Could not open xclbin file %s\n",
+                           xclfullname.c_str());
+                return false;
+            }
+            rc = xma_xclbin_info_get(buffer, &info);
+            if (rc != XMA_SUCCESS)
+            {
+                xma_logmsg("Could not get info for xclbin file %s\n",
+                           xclfullname.c_str());
+                free(buffer);
+                return false;
+            }
+            if (cache)
+                xma_cfg_cache_xclbin_set(cache, xclfullname.c_str(), &info);
         }
 
         for (int32_t d = 0; d < systemcfg->imagecfg[i].num_devices; d++)
@@ -237,15 +253,54 @@ bool hal_configure(XmaHwCfg *hwcfg, XmaSystemCfg *systemcfg, bool hw_configured)
                 xma_logmsg("Could not download xclbin file %s to device %d\n",
                            xclfullname.c_str(),
                            systemcfg->imagecfg[i].device_id_map[d]);
+                free(buffer);
                 return false;
             }
         }
+        free(buffer);
     }
     return true;
 }
 
+int32_t hal_buffer_alloc(XmaHwSession *session, size_t size,
+                         uint32_t *handle, void **map, uint64_t *paddr)
+{
+    xclDeviceHandle dev_handle = session->dev_handle;
+    unsigned int bo;
+
+    bo = xclAllocBO(dev_handle, size, XCL_BO_DEVICE_RAM, session->ddr_bank);
+    if (bo == (unsigned int)-1)
+    {
+        xma_logmsg("xclAllocBO failed for size %lu on bank %u\n",
+                   size, session->ddr_bank);
+        return XMA_ERROR;
+    }
+
+    *map = xclMapBO(dev_handle, bo, true);
+    if (!*map)
+    {
+        xma_logmsg("xclMapBO failed for handle %u\n", bo);
+        xclFreeBO(dev_handle, bo);
+        return XMA_ERROR;
+    }
+
+    *handle = bo;
+    *paddr = xclGetDeviceAddr(dev_handle, bo);
+    return XMA_SUCCESS;
+}
+
+void hal_buffer_free(XmaHwSession *session, uint32_t handle,
+                     void *map, size_t size)
+{
+    if (map)
+        munmap(map, size);
+    xclFreeBO(session->dev_handle, handle);
+}
+
 XmaHwInterface hw_if = {
     .probe         = hal_probe,
     .is_compatible = hal_is_compatible,
-    .configure     = hal_configure
+    .configure     = hal_configure,
+    .buffer_alloc  = hal_buffer_alloc,
+    .buffer_free   = hal_buffer_free
 };
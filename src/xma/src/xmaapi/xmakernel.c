@@ -21,6 +21,7 @@
 #include "lib/xmaapi.h"
 #include "lib/xmahw_hal.h"
 #include "lib/xmares.h"
+#include "lib/xmastats.h"
 #include "xmaplugin.h"
 
 #define XMA_KERNEL_MOD "xmakernel"
@@ -187,13 +188,33 @@ xma_kernel_session_destroy(XmaKernelSession *session)
     return XMA_SUCCESS;
 }
 
+static uint64_t
+xma_kernel_param_bytes(XmaParameter *param, int32_t param_cnt)
+{
+    uint64_t bytes = 0;
+    int32_t i;
+
+    for (i = 0; i < param_cnt; i++)
+        bytes += param[i].length;
+    return bytes;
+}
+
 int32_t
 xma_kernel_session_write(XmaKernelSession *session,
                          XmaParameter     *param,
                          int32_t           param_cnt)
 {
+    int32_t rc;
+    uint64_t start_ns;
+
     xma_logmsg(XMA_DEBUG_LOG, XMA_KERNEL_MOD, "%s()\n", __func__);
-    return session->kernel_plugin->write(session, param, param_cnt);
+    start_ns = xma_stats_now_ns();
+    rc = session->kernel_plugin->write(session, param, param_cnt);
+    xma_stats_latency(&session->base, XMA_STATS_SEND, start_ns);
+    if (rc >= XMA_SUCCESS)
+        xma_stats_frames_in(&session->base, 1,
+                            xma_kernel_param_bytes(param, param_cnt));
+    return rc;
 }
 
 int32_t
@@ -201,6 +222,15 @@ xma_kernel_session_read(XmaKernelSession *session,
                         XmaParameter      *param,
                         int32_t           *param_cnt)
 {
+    int32_t rc;
+    uint64_t start_ns;
+
     xma_logmsg(XMA_DEBUG_LOG, XMA_KERNEL_MOD, "%s()\n", __func__);
-    return session->kernel_plugin->read(session, param, param_cnt);
+    start_ns = xma_stats_now_ns();
+    rc = session->kernel_plugin->read(session, param, param_cnt);
+    xma_stats_latency(&session->base, XMA_STATS_RECV, start_ns);
+    if (rc >= XMA_SUCCESS)
+        xma_stats_frames_out(&session->base, 1,
+                             xma_kernel_param_bytes(param, *param_cnt));
+    return rc;
 }
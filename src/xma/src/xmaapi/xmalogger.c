@@ -22,12 +22,18 @@
 #include <stdarg.h>
 #include <math.h>
 #include <time.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sched.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/futex.h>
 
 #include "lib/xmaapi.h"
 #include "app/xmalogger.h"
@@ -40,6 +46,36 @@
 #define XMA_DBG_PRINTF(format, ...)
 #endif
 
+/* Maximum number of messages written by one logger wakeup */
+#define XMA_LOGGER_BATCH 32
+
+/* Futex helpers, the waiting side sleeps only if *addr still equals val */
+static void xma_futex_wait(uint32_t *addr, uint32_t val)
+{
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+static void xma_futex_wake(uint32_t *addr)
+{
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+/* Busy polls, then yields, before a blocked side sleeps on the futex */
+#define XMA_MSGQ_SPIN_COUNT    64
+#define XMA_MSGQ_YIELD_COUNT   16
+
+static bool xma_msgq_backoff(int32_t spin)
+{
+    if (spin < XMA_MSGQ_SPIN_COUNT)
+        return true;
+    if (spin < XMA_MSGQ_SPIN_COUNT + XMA_MSGQ_YIELD_COUNT)
+    {
+        sched_yield();
+        return true;
+    }
+    return false;
+}
+
 typedef struct XmaLoggerCbData
 {
     XmaLoggerCallback callback;
@@ -63,9 +99,72 @@ XmaLogLevel2Str g_loglevel_tbl[] = {
     {XMA_DEBUG_LOG,    "DEBUG   "}
 };
 
-/* Prototype for the logger actor thread */
+/* Deferred log record, one per queue slot.  String arguments and the
+ * text of messages that could not be deferred are stored in data. */
+#define XMA_LOG_RECORD_SIZE       512
+#define XMA_LOG_THREAD_ENTRIES    256
+#define XMA_LOG_NAME_SIZE         40
+
+typedef struct XmaLogRecord
+{
+    const char     *fmt;    /* NULL if data holds the formatted message */
+    struct timeval  tv;
+    int32_t         level;
+    uint32_t        suppressed;
+    int32_t         num_args;
+    uint8_t         arg_type[XMA_LOG_MAX_ARGS];
+    char            name[XMA_LOG_NAME_SIZE];
+    uint64_t        args[XMA_LOG_MAX_ARGS]; /* value or offset in data */
+    char            data[];
+} XmaLogRecord;
+
+#define XMA_LOG_DATA_SIZE (XMA_LOG_RECORD_SIZE - sizeof(XmaLogRecord))
+
+typedef enum XmaLogArgType
+{
+    XMA_LOG_ARG_INT = 0,
+    XMA_LOG_ARG_LONG,
+    XMA_LOG_ARG_LLONG,
+    XMA_LOG_ARG_INTMAX,
+    XMA_LOG_ARG_SIZE,
+    XMA_LOG_ARG_PTRDIFF,
+    XMA_LOG_ARG_DOUBLE,
+    XMA_LOG_ARG_PTR,
+    XMA_LOG_ARG_STR,
+} XmaLogArgType;
+
+/* Queue of one logging thread, reused once the thread exits.  Queues
+ * live as long as the process so threads never see a stale one. */
+typedef struct XmaLogThreadBuf
+{
+    XmaMsgQ                 *msg_q;
+    int32_t                  in_use;
+    struct XmaLogThreadBuf  *next;
+} XmaLogThreadBuf;
+
+int32_t xma_log_level_max = XMA_ERROR_LOG;
+
+static XmaLogThreadBuf          *log_thread_bufs;
+static __thread XmaLogThreadBuf *tls_log_buf;
+static pthread_key_t             log_buf_key;
+static pthread_once_t            log_buf_key_once = PTHREAD_ONCE_INIT;
+static pthread_once_t            log_atfork_once = PTHREAD_ONCE_INIT;
+
+/* Prototype for the logger thread */
 void* xma_logger_actor(void *data);
 
+static void xma_logger_level_update(void)
+{
+    int32_t level = XMA_CRITICAL_LOG;
+
+    if (g_xma_singleton)
+        level = g_xma_singleton->logger.log_level;
+    if (g_xma_loggercb_singleton && g_xma_loggercb_singleton->level > level)
+        level = g_xma_loggercb_singleton->level;
+
+    __atomic_store_n(&xma_log_level_max, level, __ATOMIC_RELAXED);
+}
+
 void xma_logger_callback(XmaLoggerCallback callback, XmaLogLevelType level)
 {
     // Allocate singleton if it doesn't exist
@@ -74,7 +173,27 @@ void xma_logger_callback(XmaLoggerCallback callback, XmaLogLevelType level)
 
     g_xma_loggercb_singleton->callback = callback;
     g_xma_loggercb_singleton->level = level;
-    
+    xma_logger_level_update();
+}
+
+void xma_logger_rate_limit_set(uint32_t msgs_per_sec)
+{
+    if (g_xma_singleton)
+        __atomic_store_n(&g_xma_singleton->logger.rate_limit, msgs_per_sec,
+                         __ATOMIC_RELAXED);
+}
+
+/* The logger thread is not duplicated by fork(), a child logs directly */
+static void xma_logger_atfork_child(void)
+{
+    if (g_xma_singleton)
+        g_xma_singleton->logger.thread = NULL;
+    xma_logger_level_update();
+}
+
+static void xma_logger_atfork_register(void)
+{
+    pthread_atfork(NULL, NULL, xma_logger_atfork_child);
 }
 
 int xma_logger_init(XmaLogger *logger)
@@ -112,148 +231,612 @@ int xma_logger_init(XmaLogger *logger)
     else
         logger->fd = -1;
 
-    /* Create logger actor */
-    logger->actor = xma_actor_create(xma_logger_actor,
-                                     XMA_MAX_LOGMSG_SIZE,
-                                     XMA_MAX_LOGMSG_Q_ENTRIES);
-
-    xma_actor_start(logger->actor);
+    /* Create logger thread */
+    logger->doorbell = 0;
+    logger->sleeping = 0;
+    logger->shutdown = 0;
+    logger->dropped = 0;
+    logger->thread = xma_thread_create(xma_logger_actor, logger);
+    xma_thread_start(logger->thread);
+    pthread_once(&log_atfork_once, xma_logger_atfork_register);
+    xma_logger_level_update();
 
     return 0;
 }
 
+/* Wake the logger thread if it sleeps (or unconditionally if forced) */
+static void xma_logger_ring(XmaLogger *logger, bool force)
+{
+    if (force ||
+        (__atomic_load_n(&logger->sleeping, __ATOMIC_SEQ_CST) &&
+         __atomic_exchange_n(&logger->sleeping, 0, __ATOMIC_SEQ_CST)))
+    {
+        __atomic_add_fetch(&logger->doorbell, 1, __ATOMIC_SEQ_CST);
+        xma_futex_wake(&logger->doorbell);
+    }
+}
+
 int xma_logger_close(XmaLogger *logger)
 {
     /* Verify parameters */
     assert(logger);
-    xma_actor_destroy(logger->actor);
+    if (!logger->thread)
+        return 0;
+
+    /* Logger thread drains all queues before it exits */
+    __atomic_store_n(&logger->shutdown, 1, __ATOMIC_SEQ_CST);
+    xma_logger_ring(logger, true);
+    xma_thread_join(logger->thread);
+    xma_thread_destroy(logger->thread);
+    logger->thread = NULL;
+    xma_logger_level_update();
 
     return 0;
 }
 
-void
-xma_logmsg(XmaLogLevelType level, const char *name, const char *msg, ...)
+static void xma_log_buf_release(void *data)
 {
-    /* Handle variable arguments */
-    va_list ap;
+    XmaLogThreadBuf *buf = (XmaLogThreadBuf*)data;
+    __atomic_store_n(&buf->in_use, 0, __ATOMIC_RELEASE);
+}
 
-    /* Create message buffer on the stack */
-    char            msg_buff[XMA_MAX_LOGMSG_SIZE];
-    struct tm      *tm_info;
-    struct timeval  tv;
-    int32_t         millisec;
-    char            log_time[40];
-    char            log_name[40];
-    const char     *log_level;
-    int32_t         hdr_offset;
-    bool            send2callback = false;
-    bool            send2actor = false;
-    char           *buffer;
-
-    /* Get XMA logger */
-    XmaLogger *logger = &g_xma_singleton->logger;
-    XmaLoggerCbData *cbdata = g_xma_loggercb_singleton;
+static void xma_log_buf_key_create(void)
+{
+    pthread_key_create(&log_buf_key, xma_log_buf_release);
+}
 
-    memset(msg_buff, 0, sizeof(msg_buff));
+/* Queue of the calling thread, claimed from exited threads if possible */
+static XmaLogThreadBuf *xma_log_buf_get(void)
+{
+    XmaLogThreadBuf *buf;
+
+    if (tls_log_buf)
+        return tls_log_buf;
 
-    if (cbdata)
+    for (buf = __atomic_load_n(&log_thread_bufs, __ATOMIC_ACQUIRE);
+         buf; buf = buf->next)
     {
-        if (level <= cbdata->level)
-            send2callback = true;
+        int32_t expected = 0;
+        if (__atomic_compare_exchange_n(&buf->in_use, &expected, 1, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+            break;
     }
 
-    if (level <= logger->log_level)
-        send2actor = true;
+    if (!buf)
+    {
+        buf = malloc(sizeof(XmaLogThreadBuf));
+        buf->msg_q = xma_msgq_create(XMA_LOG_RECORD_SIZE,
+                                     XMA_LOG_THREAD_ENTRIES);
+        buf->in_use = 1;
+        buf->next = __atomic_load_n(&log_thread_bufs, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&log_thread_bufs, &buf->next,
+                                            buf, true, __ATOMIC_RELEASE,
+                                            __ATOMIC_RELAXED))
+            ;
+    }
 
-    if (!(send2callback || send2actor))
-        return;
-    
-    /* Get time */
-    gettimeofday(&tv, NULL);
-    millisec = lrint(tv.tv_usec/1000.0);
+    pthread_once(&log_buf_key_once, xma_log_buf_key_create);
+    pthread_setspecific(log_buf_key, buf);
+    tls_log_buf = buf;
+
+    return buf;
+}
+
+/* Argument types of a format string, -1 if it cannot be deferred */
+static int32_t xma_log_parse(const char *fmt, uint8_t *arg_type)
+{
+    int32_t num_args = 0;
+
+    for (const char *p = fmt; *p; p++)
+    {
+        int32_t length = 0; /* 1 l, 2 ll, 3 j, 4 z, 5 t */
+
+        if (*p != '%')
+            continue;
+        p++;
+        if (*p == '%')
+            continue;
+
+        /* flags, width and precision */
+        for (; *p && strchr("-+ #0123456789.*'", *p); p++)
+        {
+            if (*p != '*')
+                continue;
+            if (num_args == XMA_LOG_MAX_ARGS)
+                return -1;
+            arg_type[num_args++] = XMA_LOG_ARG_INT;
+        }
+
+        /* length modifier */
+        for (; *p && strchr("hlqjztL", *p); p++)
+        {
+            if (*p == 'l' || *p == 'q')
+                length = (length == 1 || *p == 'q') ? 2 : 1;
+            else if (*p == 'j')
+                length = 3;
+            else if (*p == 'z')
+                length = 4;
+            else if (*p == 't')
+                length = 5;
+            else if (*p == 'L')
+                return -1;
+        }
+
+        if (num_args == XMA_LOG_MAX_ARGS)
+            return -1;
+
+        switch (*p)
+        {
+            case 'd': case 'i': case 'u': case 'x': case 'X': case 'o':
+                arg_type[num_args++] = (length == 0) ? XMA_LOG_ARG_INT :
+                                       (length == 1) ? XMA_LOG_ARG_LONG :
+                                       (length == 2) ? XMA_LOG_ARG_LLONG :
+                                       (length == 3) ? XMA_LOG_ARG_INTMAX :
+                                       (length == 4) ? XMA_LOG_ARG_SIZE :
+                                                       XMA_LOG_ARG_PTRDIFF;
+                break;
+            case 'c':
+                if (length != 0)
+                    return -1;
+                arg_type[num_args++] = XMA_LOG_ARG_INT;
+                break;
+            case 'f': case 'F': case 'e': case 'E':
+            case 'g': case 'G': case 'a': case 'A':
+                arg_type[num_args++] = XMA_LOG_ARG_DOUBLE;
+                break;
+            case 'p':
+                arg_type[num_args++] = XMA_LOG_ARG_PTR;
+                break;
+            case 's':
+                if (length != 0)
+                    return -1;
+                arg_type[num_args++] = XMA_LOG_ARG_STR;
+                break;
+            default:
+                /* %n, wide characters, incomplete specifications */
+                return -1;
+        }
+    }
+
+    return num_args;
+}
+
+static void xma_log_header(char *buff, size_t size, struct timeval *tv,
+                           int32_t level, const char *name)
+{
+    struct tm       tm_info;
+    struct timeval  now = *tv;
+    int32_t         millisec;
+    char            log_time[40];
+
+    millisec = lrint(now.tv_usec/1000.0);
     if (millisec >= 1000)
     {
         millisec -= 1000;
-        tv.tv_sec++;
+        now.tv_sec++;
     }
-    tm_info = localtime(&tv.tv_sec);
-    strftime(log_time, sizeof(log_time), "%Y-%m-%d %H:%M:%S", tm_info);
+    localtime_r(&now.tv_sec, &tm_info);
+    strftime(log_time, sizeof(log_time), "%Y-%m-%d %H:%M:%S", &tm_info);
 
-    /* Set component name */
-    if (name == NULL)
-        strncpy(log_name, "XMA-default", sizeof(log_name));
-    else
-        strncpy(log_name, name, sizeof(log_name));
+    snprintf(buff, size, "%s.%03d %d %s %s ", log_time, millisec, getpid(),
+             g_loglevel_tbl[level].lvl_str, name);
+}
 
-    log_level = g_loglevel_tbl[level].lvl_str;
-    
-    /* Format log message */
-    sprintf(msg_buff, "%s.%03d %d %s %s ", log_time, millisec, getpid(), log_level, log_name);
-    hdr_offset = strlen(msg_buff);
-    va_start(ap, msg); 
-    vsnprintf(&msg_buff[hdr_offset], (XMA_MAX_LOGMSG_SIZE - hdr_offset), msg, ap);
-    va_end(ap);
+/* Format one argument of a deferred record with its own specification */
+static int32_t xma_log_format_arg(char *dst, size_t size, const char *spec,
+                                  int32_t num_stars, int *stars,
+                                  XmaLogRecord *rec, int32_t arg)
+{
+    uint64_t val = rec->args[arg];
 
-    /* Send message buffer to logger Actor - 
-       will be copied to loggers message buffer */
-    if (send2actor)
-        xma_actor_sendmsg(logger->actor, msg_buff, sizeof(msg_buff));
+#define XMA_LOG_SNPRINTF(v)                                               \
+    ((num_stars == 0) ? snprintf(dst, size, spec, v) :                    \
+     (num_stars == 1) ? snprintf(dst, size, spec, stars[0], v) :          \
+                        snprintf(dst, size, spec, stars[0], stars[1], v))
 
-    if (send2callback)
+    switch (rec->arg_type[arg])
     {
-        buffer = malloc(sizeof(msg_buff));
-        strcpy(buffer, msg_buff);
-        cbdata->callback(buffer);
+        case XMA_LOG_ARG_INT:
+            return XMA_LOG_SNPRINTF((int)val);
+        case XMA_LOG_ARG_LONG:
+            return XMA_LOG_SNPRINTF((long)val);
+        case XMA_LOG_ARG_LLONG:
+            return XMA_LOG_SNPRINTF((long long)val);
+        case XMA_LOG_ARG_INTMAX:
+            return XMA_LOG_SNPRINTF((intmax_t)val);
+        case XMA_LOG_ARG_SIZE:
+            return XMA_LOG_SNPRINTF((size_t)val);
+        case XMA_LOG_ARG_PTRDIFF:
+            return XMA_LOG_SNPRINTF((ptrdiff_t)val);
+        case XMA_LOG_ARG_DOUBLE:
+        {
+            double d;
+            memcpy(&d, &val, sizeof(d));
+            return XMA_LOG_SNPRINTF(d);
+        }
+        case XMA_LOG_ARG_PTR:
+            return XMA_LOG_SNPRINTF((void*)(uintptr_t)val);
+        default:
+            return XMA_LOG_SNPRINTF(&rec->data[val]);
     }
+#undef XMA_LOG_SNPRINTF
 }
 
-void* xma_logger_actor(void *data)
+/* Format the message of a deferred record into buff */
+static void xma_log_format(char *buff, size_t size, XmaLogRecord *rec)
 {
-    int32_t rc;
-    char logmsg[XMA_MAX_LOGMSG_SIZE];
-    XmaLogger *logger = &g_xma_singleton->logger;
-    XmaActor  *actor = (XmaActor*)data;
+    size_t  len = 0;
+    int32_t arg = 0;
 
-    if (!actor)
+    for (const char *p = rec->fmt; *p && len + 1 < size; p++)
     {
-        printf("XMA ERROR: XmaActor does not exist\n");
-        exit(-1);
+        char        spec[32];
+        const char *start = p;
+        int32_t     num_stars = 0;
+        int         stars[2];
+        int32_t     n;
+
+        if (*p != '%' || p[1] == '%')
+        {
+            buff[len++] = *p;
+            p += (*p == '%');
+            continue;
+        }
+
+        for (p++; *p && !strchr("diuxXocfFeEgGaApsn", *p); p++)
+            if (*p == '*' && num_stars < 2)
+                stars[num_stars++] = (int)rec->args[arg++];
+
+        if ((size_t)(p - start + 2) > sizeof(spec) || !*p || num_stars > 2)
+            break;
+        memcpy(spec, start, p - start + 1);
+        spec[p - start + 1] = '\0';
+
+        n = xma_log_format_arg(&buff[len], size - len, spec, num_stars, stars,
+                               rec, arg++);
+        if (n > 0)
+            len += n;
+        if (len >= size)
+            len = size - 1;
     }
+    buff[len] = '\0';
+}
 
-    printf("XMA Logger: Logging thread started\n");
-    while (1)
+/* Format and write all records of all thread queues, returns count */
+static size_t xma_logger_drain(XmaLogger *logger)
+{
+    char            out[XMA_LOGGER_BATCH][XMA_MAX_LOGMSG_SIZE + 64];
+    struct iovec    iov[XMA_LOGGER_BATCH];
+    size_t          total = 0;
+    uint64_t        dropped;
+
+    dropped = __atomic_exchange_n(&logger->dropped, 0, __ATOMIC_RELAXED);
+    if (dropped)
     {
-        memset(logmsg, 0, sizeof(logmsg));
-        rc = xma_actor_recvmsg(actor, logmsg, sizeof(logmsg));
-        if (rc == 0)
+        struct timeval tv;
+        char           msg[XMA_MAX_LOGMSG_SIZE];
+
+        gettimeofday(&tv, NULL);
+        xma_log_header(msg, sizeof(msg), &tv, XMA_ERROR_LOG, "xmalogger");
+        snprintf(&msg[strlen(msg)], sizeof(msg) - strlen(msg),
+                 "%lu log messages dropped, logger queue full\n",
+                 (unsigned long)dropped);
+        if (logger->fd != -1 && write(logger->fd, msg, strlen(msg)) < 0)
+            perror("XMA Logger: could not write to file: ");
+        if (logger->use_stdout)
+            fputs(msg, stdout);
+    }
+
+    for (XmaLogThreadBuf *buf = __atomic_load_n(&log_thread_bufs,
+                                                __ATOMIC_ACQUIRE);
+         buf; buf = buf->next)
+    {
+        void   *msgs;
+        size_t  count;
+
+        while ((count = xma_msgq_peek(buf->msg_q, &msgs, XMA_LOGGER_BATCH)) > 0)
         {
-            if (strncmp(logmsg, "shutdown", 8) == 0)
+            for (size_t i = 0; i < count; i++)
             {
-                printf("XMA logger: received shutdown\n");
-                break;
+                XmaLogRecord *rec = (XmaLogRecord*)((uint8_t*)msgs +
+                                    i * buf->msg_q->slot_size);
+                size_t        hdr;
+
+                xma_log_header(out[i], XMA_MAX_LOGMSG_SIZE, &rec->tv,
+                               rec->level, rec->name);
+                hdr = strlen(out[i]);
+                if (rec->fmt)
+                    xma_log_format(&out[i][hdr], XMA_MAX_LOGMSG_SIZE - hdr, rec);
+                else
+                    snprintf(&out[i][hdr], XMA_MAX_LOGMSG_SIZE - hdr, "%s",
+                             rec->data);
+                iov[i].iov_base = out[i];
+                iov[i].iov_len = strlen(out[i]);
+                if (rec->suppressed)
+                    iov[i].iov_len += snprintf(&out[i][iov[i].iov_len],
+                                               sizeof(out[i]) - iov[i].iov_len,
+                                               "(%u similar messages suppressed)\n",
+                                               rec->suppressed);
             }
-            if (logger->fd != -1)
+            xma_msgq_release(buf->msg_q, count);
+
+            if (logger->fd != -1 && writev(logger->fd, iov, count) < 0)
+                perror("XMA Logger: could not write to file: ");
+            if (logger->use_stdout)
+                for (size_t i = 0; i < count; i++)
+                    fwrite(iov[i].iov_base, 1, iov[i].iov_len, stdout);
+            total += count;
+        }
+    }
+
+    return total;
+}
+
+static bool xma_logger_pending(XmaLogger *logger)
+{
+    for (XmaLogThreadBuf *buf = __atomic_load_n(&log_thread_bufs,
+                                                __ATOMIC_ACQUIRE);
+         buf; buf = buf->next)
+        if (!xma_msgq_isempty(buf->msg_q))
+            return true;
+
+    return false;
+}
+
+/* Record a message into the queue of the calling thread */
+static void xma_log_record(XmaLogger *logger, XmaLogSite *site,
+                           XmaLogLevelType level, const char *name,
+                           struct timeval *tv, uint32_t suppressed,
+                           const char *msg, va_list ap)
+{
+    XmaLogThreadBuf *buf = xma_log_buf_get();
+    XmaLogRecord    *rec;
+    size_t           used = 0;
+
+    while (!(rec = (XmaLogRecord*)xma_msgq_reserve(buf->msg_q)))
+    {
+        /* Never block the data path for informational messages */
+        if (level > XMA_ERROR_LOG)
+        {
+            __atomic_add_fetch(&logger->dropped, 1, __ATOMIC_RELAXED);
+            xma_logger_ring(logger, false);
+            return;
+        }
+        xma_logger_ring(logger, true);
+        sched_yield();
+    }
+
+    rec->tv = *tv;
+    rec->level = level;
+    rec->suppressed = suppressed;
+    strncpy(rec->name, name ? name : "XMA-default", sizeof(rec->name) - 1);
+    rec->name[sizeof(rec->name) - 1] = '\0';
+
+    if (site->parsed > 0)
+    {
+        rec->fmt = msg;
+        rec->num_args = site->num_args;
+        memcpy(rec->arg_type, site->arg_type, site->num_args);
+        for (int32_t i = 0; i < site->num_args; i++)
+        {
+            switch (site->arg_type[i])
             {
-                rc = write(logger->fd, logmsg, strlen(logmsg));
-                if (rc < 0)
+                case XMA_LOG_ARG_INT:
+                    rec->args[i] = (uint64_t)va_arg(ap, int);
+                    break;
+                case XMA_LOG_ARG_LONG:
+                    rec->args[i] = (uint64_t)va_arg(ap, long);
+                    break;
+                case XMA_LOG_ARG_LLONG:
+                    rec->args[i] = (uint64_t)va_arg(ap, long long);
+                    break;
+                case XMA_LOG_ARG_INTMAX:
+                    rec->args[i] = (uint64_t)va_arg(ap, intmax_t);
+                    break;
+                case XMA_LOG_ARG_SIZE:
+                    rec->args[i] = (uint64_t)va_arg(ap, size_t);
+                    break;
+                case XMA_LOG_ARG_PTRDIFF:
+                    rec->args[i] = (uint64_t)va_arg(ap, ptrdiff_t);
+                    break;
+                case XMA_LOG_ARG_DOUBLE:
+                {
+                    double d = va_arg(ap, double);
+                    memcpy(&rec->args[i], &d, sizeof(d));
+                    break;
+                }
+                case XMA_LOG_ARG_PTR:
+                    rec->args[i] = (uint64_t)(uintptr_t)va_arg(ap, void*);
+                    break;
+                default:
                 {
-                    perror("XMA Logger: could not write to file: ");
+                    /* Copy strings, truncated to the space left */
+                    const char *str = va_arg(ap, const char*);
+                    size_t      len;
+
+                    if (!str)
+                        str = "(null)";
+                    len = strnlen(str, XMA_LOG_DATA_SIZE - used - 1);
+                    memcpy(&rec->data[used], str, len);
+                    rec->data[used + len] = '\0';
+                    rec->args[i] = used;
+                    used += len + (used + len + 1 < XMA_LOG_DATA_SIZE);
                     break;
                 }
             }
-            if (logger->use_stdout)
-                printf("%s", logmsg);
+        }
+    }
+    else
+    {
+        rec->fmt = NULL;
+        vsnprintf(rec->data, XMA_LOG_DATA_SIZE, msg, ap);
+    }
+
+    xma_msgq_commit(buf->msg_q);
+    xma_logger_ring(logger, false);
+}
+
+/* Format synchronously, for the callback and before the logger runs */
+static void xma_log_now(char *buff, size_t size, XmaLogLevelType level,
+                        const char *name, struct timeval *tv,
+                        const char *msg, va_list ap)
+{
+    size_t hdr;
+
+    xma_log_header(buff, size, tv, level, name ? name : "XMA-default");
+    hdr = strlen(buff);
+    vsnprintf(&buff[hdr], size - hdr, msg, ap);
+}
+
+static void xma_logmsg_va(XmaLogSite *site, XmaLogLevelType level,
+                          const char *name, const char *msg, va_list ap)
+{
+    XmaLogger       *logger = g_xma_singleton ? &g_xma_singleton->logger : NULL;
+    XmaLoggerCbData *cbdata = g_xma_loggercb_singleton;
+    bool             send2callback = cbdata && level <= cbdata->level;
+    bool             send2logger = logger && level <= logger->log_level;
+    uint32_t         suppressed = 0;
+    uint32_t         rate_limit;
+    struct timeval   tv;
+
+    if (!(send2callback || send2logger))
+        return;
+
+    gettimeofday(&tv, NULL);
+
+    rate_limit = logger ? __atomic_load_n(&logger->rate_limit, __ATOMIC_RELAXED) : 0;
+    if (rate_limit)
+    {
+        uint64_t window = __atomic_load_n(&site->window, __ATOMIC_RELAXED);
+
+        if (window != (uint64_t)tv.tv_sec &&
+            __atomic_compare_exchange_n(&site->window, &window, tv.tv_sec,
+                                        false, __ATOMIC_RELAXED,
+                                        __ATOMIC_RELAXED))
+            __atomic_store_n(&site->count, 0, __ATOMIC_RELAXED);
+
+        if (__atomic_add_fetch(&site->count, 1, __ATOMIC_RELAXED) > rate_limit)
+        {
+            __atomic_add_fetch(&site->suppressed, 1, __ATOMIC_RELAXED);
+            return;
+        }
+        suppressed = __atomic_exchange_n(&site->suppressed, 0, __ATOMIC_RELAXED);
+    }
+
+    if (__atomic_load_n(&site->parsed, __ATOMIC_ACQUIRE) == 0)
+    {
+        uint8_t arg_type[XMA_LOG_MAX_ARGS];
+        int32_t num_args = xma_log_parse(msg, arg_type);
+
+        if (num_args >= 0)
+        {
+            memcpy(site->arg_type, arg_type, sizeof(arg_type));
+            site->num_args = num_args;
+        }
+        __atomic_store_n(&site->parsed, num_args >= 0 ? 1 : -1,
+                         __ATOMIC_RELEASE);
+    }
+
+    if (send2callback)
+    {
+        char   *buffer = malloc(XMA_MAX_LOGMSG_SIZE);
+        va_list aq;
+
+        va_copy(aq, ap);
+        xma_log_now(buffer, XMA_MAX_LOGMSG_SIZE, level, name, &tv, msg, aq);
+        va_end(aq);
+        cbdata->callback(buffer);
+    }
+
+    if (!send2logger)
+        return;
+
+    if (!logger->thread)
+    {
+        char buffer[XMA_MAX_LOGMSG_SIZE];
+
+        xma_log_now(buffer, sizeof(buffer), level, name, &tv, msg, ap);
+        if (logger->fd != -1 && logger->use_fileout)
+        {
+            if (write(logger->fd, buffer, strlen(buffer)) < 0)
+                perror("XMA Logger: could not write to file: ");
         }
         else
-            /* Logger has been shutdown - so return from thread */
+            fputs(buffer, stdout);
+        return;
+    }
+
+    xma_log_record(logger, site, level, name, &tv, suppressed, msg, ap);
+}
+
+void
+xma_logmsg_site(XmaLogSite *site, XmaLogLevelType level, const char *name,
+                const char *msg, ...)
+{
+    va_list ap;
+
+    va_start(ap, msg);
+    xma_logmsg_va(site, level, name, msg, ap);
+    va_end(ap);
+}
+
+/* Function form, used when the macro is bypassed: no call site state,
+ * the format is parsed on every call */
+void
+(xma_logmsg)(XmaLogLevelType level, const char *name, const char *msg, ...)
+{
+    XmaLogSite site;
+    va_list    ap;
+
+    if ((int32_t)level > xma_log_level_max)
+        return;
+
+    memset(&site, 0, sizeof(site));
+    va_start(ap, msg);
+    xma_logmsg_va(&site, level, name, msg, ap);
+    va_end(ap);
+}
+
+void* xma_logger_actor(void *data)
+{
+    XmaLogger *logger = (XmaLogger*)data;
+    int32_t    spin = 0;
+
+    printf("XMA Logger: Logging thread started\n");
+    while (1)
+    {
+        uint32_t doorbell;
+
+        if (xma_logger_drain(logger) > 0)
+        {
+            spin = 0;
+            continue;
+        }
+        if (__atomic_load_n(&logger->shutdown, __ATOMIC_SEQ_CST))
+        {
+            xma_logger_drain(logger);
             break;
+        }
+        if (xma_msgq_backoff(spin++))
+            continue;
+
+        /* Producers ring the doorbell once they see sleeping set, recheck
+         * the queues after setting it so no message is left behind */
+        __atomic_store_n(&logger->sleeping, 1, __ATOMIC_SEQ_CST);
+        doorbell = __atomic_load_n(&logger->doorbell, __ATOMIC_SEQ_CST);
+        if (!xma_logger_pending(logger) &&
+            !__atomic_load_n(&logger->shutdown, __ATOMIC_SEQ_CST))
+            xma_futex_wait(&logger->doorbell, doorbell);
+        __atomic_store_n(&logger->sleeping, 0, __ATOMIC_SEQ_CST);
+        spin = 0;
     }
     printf("XMA Logger: shutting down\n");
+    fflush(stdout);
     if (logger->fd != -1)
         close(logger->fd);
+    logger->fd = -1;
 
     return NULL;
-
 }
 
 /* XmaThread APIs */
@@ -299,13 +882,25 @@ void xma_thread_join(XmaThread *thread)
 /* XmaMsgQ APIs */
 XmaMsgQ *xma_msgq_create(size_t msg_size, size_t max_msg_entries)
 {
-    XmaMsgQ *msgq = malloc(sizeof(XmaMsgQ));
+    XmaMsgQ *msgq;
+    size_t   entries = 1;
+
+    /* Free running 32-bit counters need a power of 2 ring */
+    while (entries < max_msg_entries)
+        entries <<= 1;
+
+    if (posix_memalign((void**)&msgq, XMA_MSGQ_CACHELINE, sizeof(XmaMsgQ)))
+        return NULL;
+    memset(msgq, 0, sizeof(XmaMsgQ));
     msgq->msg_size = msg_size;
-    msgq->max_msg_entries = max_msg_entries;
-    msgq->msg_array = malloc(msg_size * max_msg_entries);
-    msgq->num_entries = 0;
-    msgq->front = 0;
-    msgq->back = 0; 
+    msgq->slot_size = (msg_size + 7) & ~(size_t)7;
+    msgq->max_msg_entries = entries;
+    if (posix_memalign((void**)&msgq->msg_array, XMA_MSGQ_CACHELINE,
+                       msgq->slot_size * entries))
+    {
+        free(msgq);
+        return NULL;
+    }
 
     return msgq;
 }
@@ -318,44 +913,109 @@ void xma_msgq_destroy(XmaMsgQ *msgq)
 
 bool xma_msgq_isfull(XmaMsgQ *msgq)
 {
-    return (msgq->num_entries == msgq->max_msg_entries);
+    uint32_t head = __atomic_load_n(&msgq->head, __ATOMIC_ACQUIRE);
+    uint32_t tail = __atomic_load_n(&msgq->tail, __ATOMIC_ACQUIRE);
+
+    return (head - tail == msgq->max_msg_entries);
 }
 
 bool xma_msgq_isempty(XmaMsgQ *msgq)
 {
-    return (msgq->num_entries == 0); 
+    uint32_t head = __atomic_load_n(&msgq->head, __ATOMIC_ACQUIRE);
+    uint32_t tail = __atomic_load_n(&msgq->tail, __ATOMIC_ACQUIRE);
+
+    return (head == tail);
 }
 
-int32_t xma_msgq_enqueue(XmaMsgQ *msgq, void *msg, size_t size)
+void *xma_msgq_reserve(XmaMsgQ *msgq)
 {
-    if (xma_msgq_isfull(msgq))
+    uint32_t head = msgq->head;
+
+    /* Only reload the consumer index when the cached one says full */
+    if (head - msgq->tail_cache == msgq->max_msg_entries)
     {
-        XMA_DBG_PRINTF("XMA msgq enqueue: full\n");
-        return XMA_MSGQ_FULL;
+        msgq->tail_cache = __atomic_load_n(&msgq->tail, __ATOMIC_ACQUIRE);
+        if (head - msgq->tail_cache == msgq->max_msg_entries)
+            return NULL;
     }
 
+    return msgq->msg_array +
+           msgq->slot_size * (head & (msgq->max_msg_entries - 1));
+}
+
+void xma_msgq_commit(XmaMsgQ *msgq)
+{
+    __atomic_store_n(&msgq->head, msgq->head + 1, __ATOMIC_SEQ_CST);
+    /* One wakeup per sleep, the flag is set again before sleeping */
+    if (__atomic_load_n(&msgq->consumer_waiting, __ATOMIC_SEQ_CST) &&
+        __atomic_exchange_n(&msgq->consumer_waiting, 0, __ATOMIC_SEQ_CST))
+        xma_futex_wake(&msgq->head);
+}
+
+size_t xma_msgq_peek(XmaMsgQ *msgq, void **msgs, size_t max)
+{
+    uint32_t tail = msgq->tail;
+    uint32_t index = tail & (msgq->max_msg_entries - 1);
+    size_t   count;
+
+    if (msgq->head_cache == tail)
+    {
+        msgq->head_cache = __atomic_load_n(&msgq->head, __ATOMIC_ACQUIRE);
+        if (msgq->head_cache == tail)
+            return 0;
+    }
+
+    /* Contiguous messages only, stop at the end of the ring */
+    count = msgq->head_cache - tail;
+    if (count > msgq->max_msg_entries - index)
+        count = msgq->max_msg_entries - index;
+    if (count > max)
+        count = max;
+
+    *msgs = msgq->msg_array + msgq->slot_size * index;
+    return count;
+}
+
+void xma_msgq_release(XmaMsgQ *msgq, size_t count)
+{
+    uint32_t tail = msgq->tail + (uint32_t)count;
+
+    __atomic_store_n(&msgq->tail, tail, __ATOMIC_SEQ_CST);
+
+    /* Let a blocked producer sleep until half the ring is free instead
+     * of waking it for every slot */
+    if (__atomic_load_n(&msgq->producer_waiting, __ATOMIC_SEQ_CST) &&
+        msgq->head_cache - tail <= msgq->max_msg_entries / 2 &&
+        __atomic_exchange_n(&msgq->producer_waiting, 0, __ATOMIC_SEQ_CST))
+        xma_futex_wake(&msgq->tail);
+}
+
+int32_t xma_msgq_enqueue(XmaMsgQ *msgq, void *msg, size_t size)
+{
+    void *msgdst;
+
     if (size > msgq->msg_size)
     {
         XMA_DBG_PRINTF("XMA msgq enqueue: too Large\n");
         return XMA_MSGQ_MSG_TOO_LARGE;
     }
-    
-    uint8_t *msgdst = msgq->msg_array + (msgq->msg_size * msgq->back);
+
+    msgdst = xma_msgq_reserve(msgq);
+    if (!msgdst)
+    {
+        XMA_DBG_PRINTF("XMA msgq enqueue: full\n");
+        return XMA_MSGQ_FULL;
+    }
+
     memcpy(msgdst, msg, size);
-    
-    msgq->back = (msgq->back + 1) % (msgq->max_msg_entries);
-    msgq->num_entries++;
+    xma_msgq_commit(msgq);
 
     return 0;
 }
     
 int32_t xma_msgq_dequeue(XmaMsgQ *msgq, void *msg, size_t size)
 {
-    if (xma_msgq_isempty(msgq))
-    {
-        XMA_DBG_PRINTF("XMA msgq dequeue: empty\n");
-        return XMA_MSGQ_EMPTY;
-    }
+    void *msgsrc;
 
     if (size < msgq->msg_size)
     {
@@ -363,11 +1023,14 @@ int32_t xma_msgq_dequeue(XmaMsgQ *msgq, void *msg, size_t size)
         return XMA_MSGQ_MSG_TOO_SMALL;
     }
 
-    uint8_t *msgsrc = msgq->msg_array + (msgq->msg_size * msgq->front); 
-    memcpy(msg, msgsrc, msgq->msg_size); 
+    if (xma_msgq_peek(msgq, &msgsrc, 1) == 0)
+    {
+        XMA_DBG_PRINTF("XMA msgq dequeue: empty\n");
+        return XMA_MSGQ_EMPTY;
+    }
 
-    msgq->front = (msgq->front + 1) % (msgq->max_msg_entries);
-    msgq->num_entries--;
+    memcpy(msg, msgsrc, msgq->msg_size);
+    xma_msgq_release(msgq, 1);
 
     return 0;
 }
@@ -378,9 +1041,7 @@ XmaActor *xma_actor_create(XmaThreadFunc    func,
                            size_t           max_msg_entries)
 {
     XmaActor *actor = malloc(sizeof(XmaActor));
-    pthread_mutex_init(&actor->lock, NULL);
-    pthread_cond_init(&actor->queued_cond, NULL);
-    pthread_cond_init(&actor->dequeued_cond, NULL);
+    pthread_mutex_init(&actor->send_lock, NULL);
     actor->msg_q = xma_msgq_create(msg_size, max_msg_entries);
     actor->thread = xma_thread_create(func, actor);
     
@@ -398,79 +1059,100 @@ void xma_actor_destroy(XmaActor *actor)
 
     /* Send shutdown message to Actor */
     XMA_DBG_PRINTF("XMA sending shutdown message\n");
-    xma_actor_sendmsg(actor, shutdown, strlen(shutdown));
+    xma_actor_sendmsg(actor, shutdown, strlen(shutdown) + 1);
     xma_thread_join(actor->thread);
     xma_msgq_destroy(actor->msg_q);
     xma_thread_destroy(actor->thread);
+    pthread_mutex_destroy(&actor->send_lock);
 
     free(actor);
 }
 
-int32_t xma_actor_sendmsg(XmaActor *actor, void *msg, size_t msg_size)
+void *xma_actor_msg_reserve(XmaActor *actor)
 {
-    int32_t rc;
-    bool    was_empty;
+    XmaMsgQ *msgq = actor->msg_q;
+    void    *slot;
 
-    pthread_mutex_lock(&actor->lock);
-    XMA_DBG_PRINTF("XMA actor sendmsg on entry depth=%d, front=%d, back=%d\n", 
-            actor->msg_q->num_entries,
-            actor->msg_q->front,
-            actor->msg_q->back);
-    if (xma_msgq_isfull(actor->msg_q))
+    pthread_mutex_lock(&actor->send_lock);
+    for (int32_t spin = 0; ; spin++)
     {
+        slot = xma_msgq_reserve(msgq);
+        if (slot)
+            break;
+        if (xma_msgq_backoff(spin))
+            continue;
+
+        /* Full: sleep until the consumer moves tail */
+        uint32_t tail = msgq->tail_cache;
         XMA_DBG_PRINTF("Waiting: msgq_isfull\n");
-        pthread_cond_wait(&actor->dequeued_cond, &actor->lock);
-        XMA_DBG_PRINTF("Waiting: msgq_isfull done\n");
-    }
-    was_empty = xma_msgq_isempty(actor->msg_q);
-    rc = xma_msgq_enqueue(actor->msg_q, msg, msg_size);
-    if (rc == 0 && was_empty)
-    {
-        XMA_DBG_PRINTF("Sending queued_cond for previously empty queue\n");
-        pthread_cond_broadcast(&actor->queued_cond);
+        __atomic_store_n(&msgq->producer_waiting, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&msgq->tail, __ATOMIC_SEQ_CST) == tail)
+            xma_futex_wait(&msgq->tail, tail);
+        __atomic_store_n(&msgq->producer_waiting, 0, __ATOMIC_RELAXED);
     }
 
-    XMA_DBG_PRINTF("XMA actor sendmsg on exit depth=%d, front=%d, back=%d\n", 
-            actor->msg_q->num_entries,
-            actor->msg_q->front,
-            actor->msg_q->back);
-
-    pthread_mutex_unlock(&actor->lock);
+    return slot;
+}
 
-    return rc; 
-        
+void xma_actor_msg_commit(XmaActor *actor)
+{
+    xma_msgq_commit(actor->msg_q);
+    pthread_mutex_unlock(&actor->send_lock);
 }
 
-int32_t xma_actor_recvmsg(XmaActor *actor, void *msg, size_t msg_size)
+int32_t xma_actor_sendmsg(XmaActor *actor, void *msg, size_t msg_size)
 {
-    int32_t rc;
-    bool    was_full;
+    void *slot;
 
-    pthread_mutex_lock(&actor->lock);
+    if (msg_size > actor->msg_q->msg_size)
+        return XMA_MSGQ_MSG_TOO_LARGE;
 
-    XMA_DBG_PRINTF("XMA actor recvmsg on entry depth=%d, front=%d, back=%d\n", 
-            actor->msg_q->num_entries,
-            actor->msg_q->front,
-            actor->msg_q->back);
+    slot = xma_actor_msg_reserve(actor);
+    memcpy(slot, msg, msg_size);
+    xma_actor_msg_commit(actor);
 
+    return 0;
+}
 
-    if (xma_msgq_isempty(actor->msg_q))
-        pthread_cond_wait(&actor->queued_cond, &actor->lock);
+size_t xma_actor_recvmsg_batch(XmaActor *actor, void **msgs, size_t max)
+{
+    XmaMsgQ *msgq = actor->msg_q;
+    size_t   count;
 
-    was_full = xma_msgq_isfull(actor->msg_q);
-    rc = xma_msgq_dequeue(actor->msg_q, msg, msg_size);
-    if (was_full)
+    for (int32_t spin = 0; ; spin++)
     {
-        XMA_DBG_PRINTF("sending dequeued_cond\n");
-        pthread_cond_broadcast(&actor->dequeued_cond);
+        count = xma_msgq_peek(msgq, msgs, max);
+        if (count > 0)
+            break;
+        if (xma_msgq_backoff(spin))
+            continue;
+
+        /* Empty: sleep until a producer moves head */
+        uint32_t head = msgq->head_cache;
+        __atomic_store_n(&msgq->consumer_waiting, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&msgq->head, __ATOMIC_SEQ_CST) == head)
+            xma_futex_wait(&msgq->head, head);
+        __atomic_store_n(&msgq->consumer_waiting, 0, __ATOMIC_RELAXED);
     }
 
-    XMA_DBG_PRINTF("XMA actor recvmsg on exit depth=%d, front=%d, back=%d\n", 
-            actor->msg_q->num_entries,
-            actor->msg_q->front,
-            actor->msg_q->back);
+    return count;
+}
+
+void xma_actor_msg_release(XmaActor *actor, size_t count)
+{
+    xma_msgq_release(actor->msg_q, count);
+}
 
-    pthread_mutex_unlock(&actor->lock);
+int32_t xma_actor_recvmsg(XmaActor *actor, void *msg, size_t msg_size)
+{
+    void *slot;
 
-    return rc;
+    if (msg_size < actor->msg_q->msg_size)
+        return XMA_MSGQ_MSG_TOO_SMALL;
+
+    xma_actor_recvmsg_batch(actor, &slot, 1);
+    memcpy(msg, slot, actor->msg_q->msg_size);
+    xma_actor_msg_release(actor, 1);
+
+    return 0;
 }
@@ -33,10 +33,12 @@
 #include <pthread.h>
 #include <sched.h>
 #include <signal.h>
+#include <stddef.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "lib/xmaapi.h"
@@ -93,15 +95,27 @@ typedef struct XmaImage {
 typedef struct XmaKernelChan {
     pthread_t thread_id;
     XmaSession *session;
+    uint32_t load; /**< load reported by plugin get_load() */
 } XmaKernelChan;
 
+/**
+ * load and chan_cnt change under the device lock; they and the frame
+ * rate fields are also read without it to rank placement candidates.
+*/
 typedef struct XmaKernelInstance {
     uint32_t kernel_id;
     pid_t client_id;
     XmaKernelChan channels[MAX_KERNEL_CHANS];
+    uint32_t load; /**< sum of channel loads, out of XMA_MAX_KERNEL_LOAD */
+    uint32_t chan_cnt; /**< channels in use */
+    uint64_t frames; /**< frames reported by xma_res_kernel_progress() */
+    uint64_t rate_frames; /**< value of frames at rate_stamp_ns */
+    uint64_t rate_stamp_ns; /**< time of last frame rate update */
+    uint32_t fps; /**< smoothed frame rate */
 } XmaKernelInstance;
 
 typedef struct XmaDevice {
+    pthread_mutex_t lock; /**< guards device and its kernel instances */
     bool configured; /**< Indicates xclbin loaded */
     bool excl; /**< device locked for exclusive use */
     bool exists; /**< device exists within system */
@@ -111,11 +125,47 @@ typedef struct XmaDevice {
     uint32_t kernel_cnt;
 } XmaDevice;
 
+/**
+ * Kernel instance index: for each (kernel type, vendor) pair the
+ * instances of matching kernels on all devices, in device order.  The
+ * slots of an index entry are contiguous in XmaShmRes.slots.
+*/
+#define XMA_RES_MAX_INDEX (MAX_IMAGE_CONFIGS * MAX_KERNEL_CONFIGS)
+#define XMA_RES_MAX_SLOTS (MAX_XILINX_DEVICES * MAX_KERNEL_CONFIGS)
+
+typedef struct XmaKernSlot {
+    int32_t dev_id;
+    int32_t kern_idx; /**< instance index in XmaDevice.kernels */
+    int32_t plugin_handle;
+} XmaKernSlot;
+
+typedef struct XmaKernIndex {
+    enum XmaKernType type;
+    uint32_t vendor_hash;
+    char vendor[MAX_VENDOR_NAME];
+    uint32_t first_slot;
+    uint32_t slot_cnt;
+} XmaKernIndex;
+
 typedef struct XmaShmRes {
     XmaDevice devices[MAX_XILINX_DEVICES];
     XmaImage images[MAX_IMAGE_CONFIGS];
+    uint32_t index_cnt;
+    XmaKernIndex index[XMA_RES_MAX_INDEX];
+    XmaKernSlot slots[XMA_RES_MAX_SLOTS];
+    /**
+     * counters of live sessions, read by other processes without locks.
+     * An entry is reserved by swapping pid from 0 to -1 and published by
+     * storing the owner pid once reset.
+    */
+    XmaSessionStats stats[MAX_STATS_SESSIONS];
 } XmaShmRes;
 
+/**
+ * lock guards the client list and (re)initialization of the database.
+ * Device and kernel allocation only take the lock of the device
+ * involved; when both are needed lock is taken first.
+*/
 typedef struct XmaResConfig {
     XmaShmRes sys_res;
     pthread_mutex_t lock;
@@ -123,6 +173,49 @@ typedef struct XmaResConfig {
     uint32_t ref_cnt;
 } XmaResConfig;
 
+/* plugin callbacks involved in allocating a kernel instance */
+typedef struct XmaResPlugin {
+    int32_t (*alloc_chan)(XmaSession *pending,
+                          XmaSession **current,
+                          uint32_t sess_cnt);
+    int32_t (*get_load)(XmaSession *pending, uint32_t *load);
+    size_t kernel_data_size;
+} XmaResPlugin;
+
+/**
+ * Placement policies.  A policy ranks the candidate kernel instances of
+ * a request by filling a key that is compared lexicographically, lowest
+ * first.  Candidates stay in device order when a policy has no score
+ * function.  Keys come from unlocked reads; the chosen kernel is checked
+ * again under its device lock.
+*/
+#define XMA_RES_SCORE_KEYS       6
+#define XMA_RES_FPS_PERIOD_NS    1000000000ULL
+
+typedef struct XmaResCand {
+    uint32_t slot; /**< index in XmaShmRes.slots */
+    uint32_t load; /**< load the pending session adds */
+    uint64_t key[XMA_RES_SCORE_KEYS];
+} XmaResCand;
+
+/* per device totals over all kernel instances, computed on first use */
+typedef struct XmaResDevLoad {
+    bool valid;
+    uint64_t load;
+    uint64_t chans;
+    uint64_t fps;
+} XmaResDevLoad;
+
+typedef void (*XmaResScoreFunc)(XmaResConfig *xma_shm,
+                                XmaResCand *cand,
+                                XmaResDevLoad *dev_loads,
+                                uint64_t now_ns);
+
+typedef struct XmaResPolicy {
+    const char *name;
+    XmaResScoreFunc score;
+} XmaResPolicy;
+
 /**********************************GLOBALS*************************************/
 #ifdef XMA_RES_TEST
 char *XMA_SHM_FILE = "/tmp/xma_shm_db";
@@ -144,6 +237,16 @@ static int xma_shm_lock(XmaResConfig *xma_shm);
 
 static int xma_shm_unlock(XmaResConfig *xma_shm);
 
+static int xma_dev_lock(XmaResConfig *xma_shm, int32_t dev_id);
+
+static int xma_dev_unlock(XmaResConfig *xma_shm, int32_t dev_id);
+
+static void xma_init_shm_index(XmaResConfig *xma_shm);
+
+static XmaKernIndex *xma_find_kern_index(XmaResConfig *xma_shm,
+                                         enum XmaKernType type,
+                                         const char *vendor);
+
 static int xma_verify_process_res(pid_t pid);
 
 static int xma_verify_shm_client_procs(XmaResConfig *xma_shm,
@@ -151,23 +254,28 @@ static int xma_verify_shm_client_procs(XmaResConfig *xma_shm,
 
 static int xma_alloc_next_dev(XmaResources shm_cfg, int *dev_handle, bool excl);
 
-static int xma_get_next_free_dev(XmaResConfig *xma_shm, int *dev_handle);
+static bool xma_dev_is_free(XmaResConfig *xma_shm, int dev_id);
 
-static int xma_alloc_dev(XmaResConfig *xma_shm, int dev_handle, bool excl);
+static int xma_alloc_dev(XmaResConfig *xma_shm, int dev_handle, bool excl,
+                         bool *registered);
 
 static int32_t xma_res_alloc_kernel(XmaResources shm_cfg,
                                     XmaSession *session,
                                     XmaKernReq *kern_props,
                                     enum XmaKernType type);
 
-static int xma_client_thread_kernel_alloc(XmaResources shm_cfg,
-                                          XmaDevice *dev,
+static int xma_client_thread_kernel_alloc(XmaDevice *dev,
                                           int dev_kern_idx,
                                           XmaSession *session,
-                                          size_t kernel_data_size,
-                                          int32_t (*alloc_chan)(XmaSession *p,
-                                                                XmaSession **s,
-                                                                uint32_t cnt));
+                                          const XmaResPlugin *plugin,
+                                          uint32_t load);
+
+static void xma_res_spread_score(XmaResConfig *xma_shm,
+                                 XmaResCand *cand,
+                                 XmaResDevLoad *dev_loads,
+                                 uint64_t now_ns);
+
+static uint64_t xma_res_now_ns(void);
 
 static int xma_client_thread_kernel_free(XmaDevice *dev,
                                          pid_t proc_id,
@@ -181,14 +289,26 @@ static XmaKernReq *xma_res_create_kern_req(enum XmaKernType type,
 
 static int xma_free_dev(XmaResConfig *xma_shm, int32_t dev_handle, pid_t pid);
 
+static void xma_kernel_inst_reset(XmaKernelInstance *kernel);
+
 static void xma_free_all_kernel_chan_res(XmaDevice *dev, pid_t pid);
 
 static void xma_free_all_proc_res(XmaResConfig *xma_shm, pid_t proc_id);
 
+static XmaSessionStats *xma_res_stats_alloc(XmaResConfig *xma_shm,
+                                            XmaKernReq *kern_props);
+
+static void xma_res_stats_free(XmaSessionStats *stats, pid_t proc_id);
+
 static void xma_dec_ref_shm(XmaResConfig *xma_shm);
 
 static int xma_inc_ref_shm(XmaResConfig *xma_shm);
 
+static const XmaResPolicy xma_res_policies[] = {
+    [XMA_PLACEMENT_PACK]   = { "pack",   NULL },
+    [XMA_PLACEMENT_SPREAD] = { "spread", &xma_res_spread_score },
+};
+
 /********************************IMPLEMENTATION********************************/
 
 XmaResources xma_res_shm_map(XmaSystemCfg *config)
@@ -239,26 +359,31 @@ static int32_t xma_alloc_next_dev(XmaResources shm_cfg,
                                   bool excl)
 {
     XmaResConfig *xma_shm = (XmaResConfig *)shm_cfg;
+    int dev_id;
 
-    while (*dev_handle < MAX_XILINX_DEVICES)
+    xma_logmsg(XMA_DEBUG_LOG, XMA_RES_MOD, "%s()\n", __func__);
+    /* start search from next device: *dev_handle + 1 */
+    for (dev_id = *dev_handle >= 0 ? *dev_handle + 1 : 0;
+         dev_id < MAX_XILINX_DEVICES; dev_id++)
     {
         int ret;
-        if (xma_shm_lock(xma_shm))
+
+        if (!xma_shm->sys_res.devices[dev_id].exists)
+            continue;
+
+        if (xma_dev_lock(xma_shm, dev_id))
             return XMA_ERROR;
-        ret = xma_get_next_free_dev(xma_shm, dev_handle);
-        if (ret < 0) {
-            xma_shm_unlock(xma_shm);
-            return ret;
-        }
-        ret = xma_alloc_dev(xma_shm, *dev_handle, excl);
-        xma_shm_unlock(xma_shm);
+        ret = xma_dev_is_free(xma_shm, dev_id) ?
+              xma_alloc_dev(xma_shm, dev_id, excl, NULL) : XMA_ERROR_NO_DEV;
+        xma_dev_unlock(xma_shm, dev_id);
         if (ret < 0)
             continue;
 
-        return *dev_handle;
+        *dev_handle = dev_id;
+        return dev_id;
     }
 
-    return XMA_ERROR;
+    return XMA_ERROR_NO_DEV;
 }
 
 int32_t xma_res_alloc_dec_kernel(XmaResources shm_cfg, XmaDecoderType type,
@@ -367,11 +492,16 @@ int32_t xma_res_free_kernel(XmaResources shm_cfg, XmaKernelRes kern_res)
         return XMA_ERROR;
 
     dev = &xma_shm->sys_res.devices[dev_handle];
-    if (xma_shm_lock(xma_shm))
+    if (xma_dev_lock(xma_shm, dev_handle))
         return XMA_ERROR;
     ret = xma_client_thread_kernel_free(dev, proc_id, thread_id,
                                         kern_handle, session);
-    xma_shm_unlock(xma_shm);
+    if (session->metrics)
+    {
+        xma_res_stats_free(session->metrics, proc_id);
+        session->metrics = NULL;
+    }
+    xma_dev_unlock(xma_shm, dev_handle);
     free(kern_req);
     return ret;
 }
@@ -386,10 +516,10 @@ int32_t xma_res_free_dev(XmaResources shm_cfg, int32_t dev_handle)
     if (!shm_cfg)
         return XMA_ERROR_INVALID;
 
-    if (xma_shm_lock(xma_shm))
+    if (xma_dev_lock(xma_shm, dev_handle))
         return XMA_ERROR;
     ret = xma_free_dev(xma_shm, dev_handle, proc_id);
-    xma_shm_unlock(xma_shm);
+    xma_dev_unlock(xma_shm, dev_handle);
     return ret;
 }
 
@@ -482,11 +612,51 @@ int32_t xma_res_kern_chan_id_get(XmaKernelRes *kern_res)
     return ((XmaKernReq *)kern_res)->session->chan_id;
 }
 
+int32_t xma_res_kernel_progress(XmaResources shm_cfg, XmaKernelRes kern_res,
+                                uint32_t frames)
+{
+    XmaResConfig *xma_shm = (XmaResConfig *)shm_cfg;
+    XmaKernReq *kern_req = (XmaKernReq *)kern_res;
+    XmaKernelInstance *kernel;
+    uint64_t total, now_ns, stamp;
+
+    if (!shm_cfg || !kern_req || kern_req->dev_handle < 0 ||
+        kern_req->kern_handle < 0)
+        return XMA_ERROR_INVALID;
+
+    kernel = &xma_shm->sys_res.devices[kern_req->dev_handle].kernels[kern_req->kern_handle];
+    total = __atomic_add_fetch(&kernel->frames, frames, __ATOMIC_RELAXED);
+
+    /* refresh the frame rate at most once a period, by one caller */
+    now_ns = xma_res_now_ns();
+    stamp = __atomic_load_n(&kernel->rate_stamp_ns, __ATOMIC_RELAXED);
+    if (stamp && now_ns - stamp < XMA_RES_FPS_PERIOD_NS)
+        return XMA_SUCCESS;
+    if (!__atomic_compare_exchange_n(&kernel->rate_stamp_ns, &stamp, now_ns,
+                                     false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        return XMA_SUCCESS;
+
+    if (stamp) {
+        uint64_t delta = total - __atomic_load_n(&kernel->rate_frames,
+                                                 __ATOMIC_RELAXED);
+        uint32_t fps = (uint32_t)(delta * XMA_RES_FPS_PERIOD_NS /
+                                  (now_ns - stamp));
+        uint32_t prev = __atomic_load_n(&kernel->fps, __ATOMIC_RELAXED);
+
+        /* weight the new sample 1/4 once a rate has been established */
+        __atomic_store_n(&kernel->fps, prev ? (3 * prev + fps) / 4 : fps,
+                         __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&kernel->rate_frames, total, __ATOMIC_RELAXED);
+    return XMA_SUCCESS;
+}
+
 static XmaResConfig *xma_shm_open(char *shm_filename, XmaSystemCfg *config)
 {
     extern XmaSingleton *g_xma_singleton;
     int ret, fd;
     XmaResConfig *shm_map;
+    struct stat db_stat;
 
     pthread_mutexattr_t proc_shared_lock;
 
@@ -532,6 +702,15 @@ eexist:
         return NULL;
     }
 
+    /* database left behind by a different version of XMA */
+    if (fstat(fd, &db_stat) || db_stat.st_size != sizeof(XmaResConfig)) {
+        xma_logmsg(XMA_ERROR_LOG, XMA_RES_MOD,
+                   "Resource database %s has unexpected size, remove it\n",
+                   shm_filename);
+        close(fd);
+        return NULL;
+    }
+
     shm_map = (XmaResConfig *)mmap(NULL, sizeof(XmaResConfig),
                PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
 
@@ -592,6 +771,9 @@ static int xma_init_shm(XmaResConfig *xma_shm,
     int decoder_idx = 0;
     int encoder_idx = 0;
     int scaler_idx = 0;
+    int filter_idx = 0;
+    int kernel_idx = 0;
+    pthread_mutexattr_t proc_shared_lock;
 
     xma_logmsg(XMA_DEBUG_LOG, XMA_RES_MOD, "%s()\n", __func__);
     img_cnt = xma_cfg_img_cnt_get();
@@ -606,6 +788,13 @@ static int xma_init_shm(XmaResConfig *xma_shm,
 
     memset(&xma_shm->sys_res, 0, sizeof(XmaShmRes));
 
+    pthread_mutexattr_init(&proc_shared_lock);
+    pthread_mutexattr_setpshared(&proc_shared_lock, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&proc_shared_lock, PTHREAD_MUTEX_ROBUST);
+    for (i = 0; i < MAX_XILINX_DEVICES; i++)
+        pthread_mutex_init(&shm_devices[i].lock, &proc_shared_lock);
+    pthread_mutexattr_destroy(&proc_shared_lock);
+
     /* init device data */
     for (i = 0, cfg_dev_idx = 0; i < dev_cnt; i++, cfg_dev_idx++) {
         shm_devices[cfg_dev_ids[cfg_dev_idx]].configured = true;
@@ -645,6 +834,14 @@ static int xma_init_shm(XmaResConfig *xma_shm,
                    XMA_CFG_FUNC_NM_DEC) == 0) {
                     shm_images[i].kernels[kern_cnt].plugin_handle =
                         decoder_idx++;
+            } else if (strcmp(config->imagecfg[i].kernelcfg[kern_cnt].function,
+                   XMA_CFG_FUNC_NM_FILTER) == 0) {
+                    shm_images[i].kernels[kern_cnt].plugin_handle =
+                        filter_idx++;
+            } else if (strcmp(config->imagecfg[i].kernelcfg[kern_cnt].function,
+                   XMA_CFG_FUNC_NM_KERNEL) == 0) {
+                    shm_images[i].kernels[kern_cnt].plugin_handle =
+                        kernel_idx++;
             }
         }
         /* map image id to shm device entry */
@@ -667,6 +864,7 @@ static int xma_init_shm(XmaResConfig *xma_shm,
             shm_devices[dev_id].kernel_cnt = tot_kerns;
         }
     }
+    xma_init_shm_index(xma_shm);
     xma_inc_ref_shm(xma_shm);
     if (!shm_locked)
         xma_shm_unlock(xma_shm);
@@ -674,6 +872,110 @@ static int xma_init_shm(XmaResConfig *xma_shm,
     return XMA_SUCCESS;
 }
 
+static enum XmaKernType xma_func_to_kern_type(const char *function)
+{
+    if (strcmp(function, XMA_CFG_FUNC_NM_ENC) == 0)
+        return xma_res_encoder;
+    if (strcmp(function, XMA_CFG_FUNC_NM_SCALE) == 0)
+        return xma_res_scaler;
+    if (strcmp(function, XMA_CFG_FUNC_NM_DEC) == 0)
+        return xma_res_decoder;
+    if (strcmp(function, XMA_CFG_FUNC_NM_FILTER) == 0)
+        return xma_res_filter;
+    if (strcmp(function, XMA_CFG_FUNC_NM_KERNEL) == 0)
+        return xma_res_kernel;
+    return 0;
+}
+
+/* FNV-1a, only used to skip string compares of index entries */
+static uint32_t xma_vendor_hash(const char *vendor)
+{
+    uint32_t hash = 2166136261u;
+
+    for (; *vendor; vendor++)
+        hash = (hash ^ (uint8_t)*vendor) * 16777619u;
+    return hash;
+}
+
+static XmaKernIndex *xma_find_kern_index(XmaResConfig *xma_shm,
+                                         enum XmaKernType type,
+                                         const char *vendor)
+{
+    XmaShmRes *res = &xma_shm->sys_res;
+    uint32_t hash = xma_vendor_hash(vendor);
+    uint32_t i;
+
+    for (i = 0; i < res->index_cnt; i++)
+        if (res->index[i].type == type && res->index[i].vendor_hash == hash &&
+            strcmp(res->index[i].vendor, vendor) == 0)
+            return &res->index[i];
+    return NULL;
+}
+
+/* call while holding lock, after device and image data are set */
+static void xma_init_shm_index(XmaResConfig *xma_shm)
+{
+    XmaShmRes *res = &xma_shm->sys_res;
+    uint32_t slot_cnt[XMA_RES_MAX_INDEX] = {0};
+    uint32_t pass, dev_id, kern_idx, i, next_slot;
+
+    xma_logmsg(XMA_DEBUG_LOG, XMA_RES_MOD, "%s()\n", __func__);
+    res->index_cnt = 0;
+    /* pass 0 creates entries and counts slots, pass 1 fills slots */
+    for (pass = 0; pass < 2; pass++)
+    {
+        for (dev_id = 0; dev_id < MAX_XILINX_DEVICES; dev_id++)
+        {
+            XmaDevice *dev = &res->devices[dev_id];
+
+            if (!dev->exists)
+                continue;
+
+            for (kern_idx = 0;
+                 kern_idx < dev->kernel_cnt && kern_idx < MAX_KERNEL_CONFIGS;
+                 kern_idx++)
+            {
+                XmaImage *image = &res->images[dev->image_id];
+                XmaKernel *kernel =
+                    &image->kernels[dev->kernels[kern_idx].kernel_id];
+                enum XmaKernType type = xma_func_to_kern_type(kernel->function);
+                XmaKernIndex *entry;
+                XmaKernSlot *slot;
+
+                if (!type)
+                    continue;
+
+                entry = xma_find_kern_index(xma_shm, type, kernel->vendor);
+                if (!entry) {
+                    if (res->index_cnt == XMA_RES_MAX_INDEX)
+                        continue;
+                    entry = &res->index[res->index_cnt++];
+                    entry->type = type;
+                    strncpy(entry->vendor, kernel->vendor, MAX_VENDOR_NAME - 1);
+                    entry->vendor_hash = xma_vendor_hash(entry->vendor);
+                }
+
+                if (pass == 0) {
+                    entry->slot_cnt++;
+                    continue;
+                }
+
+                i = entry - res->index;
+                slot = &res->slots[entry->first_slot + slot_cnt[i]++];
+                slot->dev_id = dev_id;
+                slot->kern_idx = kern_idx;
+                slot->plugin_handle = kernel->plugin_handle;
+            }
+        }
+
+        for (i = 0, next_slot = 0; pass == 0 && i < res->index_cnt; i++)
+        {
+            res->index[i].first_slot = next_slot;
+            next_slot += res->index[i].slot_cnt;
+        }
+    }
+}
+
 static void xma_shm_close(XmaResConfig *xma_shm, bool rm_shm)
 {
     if (!xma_shm)
@@ -711,53 +1013,48 @@ static int xma_verify_process_res(pid_t pid)
     return XMA_SUCCESS;
 }
 
-static int xma_get_next_free_dev(XmaResConfig *xma_shm, int *dev_handle)
+/* call while holding device lock */
+static bool xma_dev_is_free(XmaResConfig *xma_shm, int dev_id)
 {
-    XmaDevice *devices = xma_shm->sys_res.devices;
+    XmaDevice *dev = &xma_shm->sys_res.devices[dev_id];
     pid_t  proc_id = getpid();
-    uint32_t dev_id;
     int ret;
 
-    xma_logmsg(XMA_DEBUG_LOG, XMA_RES_MOD, "%s()\n", __func__);
-    /* start search from next device: *dev_handle + 1 */
-    for (dev_id = *dev_handle >= 0 ? *dev_handle + 1 : 0;
-         dev_id < MAX_XILINX_DEVICES; dev_id++) {
-        if (!devices[dev_id].exists)
-            continue;
+    if (!dev->exists)
+        return false;
 
-        if (devices[dev_id].excl) {
-            ret = xma_verify_process_res(devices[dev_id].client_procs[0]);
-            if (ret) {
-                xma_free_all_kernel_chan_res(&devices[dev_id], 0);
-                xma_logmsg(XMA_DEBUG_LOG, XMA_RES_MOD,
-                           "Resetting client id for exclusive use device %u\n",
-                           dev_id);
-                devices[dev_id].excl = false;
-                devices[dev_id].client_procs[0] = 0;
-                *dev_handle = dev_id;
-                return XMA_SUCCESS;
-            } else if (devices[dev_id].client_procs[0] == proc_id) {
-                xma_logmsg(XMA_DEBUG_LOG, XMA_RES_MOD,
-                           "Found free device id: %u\n", dev_id);
-                *dev_handle = dev_id;
-                return XMA_SUCCESS;
-            }
-            continue;
+    if (dev->excl) {
+        ret = xma_verify_process_res(dev->client_procs[0]);
+        if (ret) {
+            xma_free_all_kernel_chan_res(dev, 0);
+            xma_logmsg(XMA_DEBUG_LOG, XMA_RES_MOD,
+                       "Resetting client id for exclusive use device %u\n",
+                       dev_id);
+            dev->excl = false;
+            dev->client_procs[0] = 0;
+            return true;
+        } else if (dev->client_procs[0] == proc_id) {
+            xma_logmsg(XMA_DEBUG_LOG, XMA_RES_MOD,
+                       "Found free device id: %u\n", dev_id);
+            return true;
         }
-        *dev_handle = dev_id;
-        return XMA_SUCCESS;
+        return false;
     }
-    return XMA_ERROR_NO_DEV;
+    return true;
 }
 
+/* call while holding device lock, *registered tells if the process was
+ * added to the device by this call */
 static int xma_alloc_dev(XmaResConfig *xma_shm, int dev_handle,
-                         bool excl)
+                         bool excl, bool *registered)
 {
     XmaDevice *devices = xma_shm->sys_res.devices;
     pid_t  proc_id = getpid();
     int pid_idx;
 
     xma_logmsg(XMA_DEBUG_LOG, XMA_RES_MOD, "%s()\n", __func__);
+    if (registered)
+        *registered = false;
     /* does process already have exclusive access? */
     if (devices[dev_handle].excl)
     {
@@ -783,6 +1080,8 @@ static int xma_alloc_dev(XmaResConfig *xma_shm, int dev_handle,
         }
         devices[dev_handle].excl = true;
         devices[dev_handle].client_procs[0] = proc_id;
+        if (registered)
+            *registered = true;
         return XMA_SUCCESS;
     }
 
@@ -802,6 +1101,8 @@ static int xma_alloc_dev(XmaResConfig *xma_shm, int dev_handle,
             xma_logmsg(XMA_DEBUG_LOG, XMA_RES_MOD,
                        "%s() Registering pid %lu with device %lu\n",
                        __func__, proc_id, dev_handle);
+            if (registered)
+                *registered = true;
             return XMA_SUCCESS;
         }
 
@@ -814,7 +1115,8 @@ static int xma_free_dev(XmaResConfig *xma_shm, int32_t dev_handle,
     XmaDevice *devices = xma_shm->sys_res.devices;
 
     xma_logmsg(XMA_DEBUG_LOG, XMA_RES_MOD, "%s()\n", __func__);
-    if (!devices[dev_handle].exists)
+    if (dev_handle < 0 || dev_handle >= MAX_XILINX_DEVICES ||
+        !devices[dev_handle].exists)
         return XMA_ERROR_NO_DEV;
 
     if (devices[dev_handle].excl) {
@@ -837,130 +1139,232 @@ static int xma_free_dev(XmaResConfig *xma_shm, int32_t dev_handle,
     return XMA_ERROR_INVALID;
 }
 
+/* match the plugin of a kernel instance against the request, plugin
+ * configuration is per process so it is not part of the shared index */
+static bool xma_res_plugin_match(enum XmaKernType type,
+                                 int32_t plugin_handle,
+                                 XmaKernReq *kern_props,
+                                 XmaResPlugin *plugin)
+{
+    extern XmaSingleton *g_xma_singleton;
+
+    memset(plugin, 0, sizeof(*plugin));
+    if (plugin_handle < 0 || plugin_handle >= MAX_PLUGINS)
+        return false;
+
+    switch (type) {
+    case xma_res_scaler:
+    {
+        XmaScalerPlugin *scaler = &g_xma_singleton->scalercfg[plugin_handle];
+        plugin->alloc_chan = scaler->alloc_chan;
+        plugin->get_load = scaler->get_load;
+        return scaler->hwscaler_type == kern_props->kernel_spec.scal_type;
+    }
+    case xma_res_encoder:
+    {
+        XmaEncoderPlugin *encoder = &g_xma_singleton->encodercfg[plugin_handle];
+        plugin->alloc_chan = encoder->alloc_chan;
+        plugin->get_load = encoder->get_load;
+        plugin->kernel_data_size = encoder->kernel_data_size;
+        return encoder->hwencoder_type == kern_props->kernel_spec.enc_type;
+    }
+    case xma_res_decoder:
+    {
+        XmaDecoderPlugin *decoder = &g_xma_singleton->decodercfg[plugin_handle];
+        plugin->get_load = decoder->get_load;
+        return decoder->hwdecoder_type == kern_props->kernel_spec.dec_type;
+    }
+    case xma_res_filter:
+    {
+        XmaFilterPlugin *filter = &g_xma_singleton->filtercfg[plugin_handle];
+        plugin->alloc_chan = filter->alloc_chan;
+        plugin->get_load = filter->get_load;
+        return filter->hwfilter_type == kern_props->kernel_spec.filter_type;
+    }
+    case xma_res_kernel:
+    {
+        XmaKernelPlugin *kernel = &g_xma_singleton->kernelcfg[plugin_handle];
+        plugin->get_load = kernel->get_load;
+        return kernel->hwkernel_type == kern_props->kernel_spec.kernel_type;
+    }
+    }
+    return false;
+}
+
+static uint64_t xma_res_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* frame rate of a kernel instance, 0 once it stopped reporting progress */
+static uint32_t xma_res_kernel_fps(XmaKernelInstance *kernel, uint64_t now_ns)
+{
+    uint64_t stamp = __atomic_load_n(&kernel->rate_stamp_ns, __ATOMIC_RELAXED);
+
+    if (!stamp || now_ns - stamp > 2 * XMA_RES_FPS_PERIOD_NS)
+        return 0;
+    return __atomic_load_n(&kernel->fps, __ATOMIC_RELAXED);
+}
+
+/* least loaded device first, then least loaded kernel on the device */
+static void xma_res_spread_score(XmaResConfig *xma_shm,
+                                 XmaResCand *cand,
+                                 XmaResDevLoad *dev_loads,
+                                 uint64_t now_ns)
+{
+    XmaKernSlot *slot = &xma_shm->sys_res.slots[cand->slot];
+    XmaDevice *dev = &xma_shm->sys_res.devices[slot->dev_id];
+    XmaResDevLoad *dev_load = &dev_loads[slot->dev_id];
+    XmaKernelInstance *kernel = &dev->kernels[slot->kern_idx];
+    uint32_t i;
+
+    if (!dev_load->valid) {
+        for (i = 0; i < dev->kernel_cnt && i < MAX_KERNEL_CONFIGS; i++) {
+            XmaKernelInstance *k = &dev->kernels[i];
+
+            dev_load->load += __atomic_load_n(&k->load, __ATOMIC_RELAXED);
+            dev_load->chans += __atomic_load_n(&k->chan_cnt, __ATOMIC_RELAXED);
+            dev_load->fps += xma_res_kernel_fps(k, now_ns);
+        }
+        dev_load->valid = true;
+    }
+
+    cand->key[0] = dev_load->load;
+    cand->key[1] = dev_load->chans;
+    cand->key[2] = dev_load->fps;
+    cand->key[3] = __atomic_load_n(&kernel->load, __ATOMIC_RELAXED);
+    cand->key[4] = __atomic_load_n(&kernel->chan_cnt, __ATOMIC_RELAXED);
+    cand->key[5] = cand->slot;
+}
+
+static int xma_res_cand_cmp(const void *c1, const void *c2)
+{
+    const XmaResCand *cand1 = c1;
+    const XmaResCand *cand2 = c2;
+    int i;
+
+    for (i = 0; i < XMA_RES_SCORE_KEYS; i++) {
+        if (cand1->key[i] != cand2->key[i])
+            return cand1->key[i] < cand2->key[i] ? -1 : 1;
+    }
+    return 0;
+}
+
 static int32_t xma_res_alloc_kernel(XmaResources shm_cfg,
-                                         XmaSession *session,
-                                         XmaKernReq *kern_props,
-                                         enum XmaKernType type)
+                                    XmaSession *session,
+                                    XmaKernReq *kern_props,
+                                    enum XmaKernType type)
 {
-    int32_t (*plugin_alloc_chan)(XmaSession *pending,
-                                 XmaSession **current,
-                                 uint32_t sess_cnt);
+    extern XmaSingleton *g_xma_singleton;
     XmaResConfig *xma_shm = (XmaResConfig *)shm_cfg;
+    XmaResCand cands[XMA_RES_MAX_SLOTS];
+    XmaResDevLoad dev_loads[MAX_XILINX_DEVICES];
+    /* pending session load per plugin, -1 until queried */
+    int64_t plugin_loads[MAX_PLUGINS];
+    const XmaResPolicy *policy;
+    XmaPlacement placement;
     pid_t proc_id = getpid();
-    extern XmaSingleton *g_xma_singleton;
-    int kern_idx, dev_id;
-    bool kern_aquired = false;
-    size_t kernel_data_size;
+    XmaKernIndex *entry;
+    XmaResPlugin plugin;
+    uint64_t now_ns = 0;
+    uint32_t cand_cnt = 0;
+    uint32_t i;
 
     xma_logmsg(XMA_DEBUG_LOG, XMA_RES_MOD, "%s()\n", __func__);
     if (!session)
         return XMA_ERROR_INVALID;
 
-    for (dev_id = -1; !kern_aquired && (dev_id < MAX_XILINX_DEVICES);)
+    placement = g_xma_singleton->systemcfg.placement;
+    if (placement < 0 || placement > XMA_PLACEMENT_SPREAD)
+        placement = XMA_PLACEMENT_PACK;
+    policy = &xma_res_policies[placement];
+    if (policy->score) {
+        memset(dev_loads, 0, sizeof(dev_loads));
+        now_ns = xma_res_now_ns();
+    }
+    for (i = 0; i < MAX_PLUGINS; i++)
+        plugin_loads[i] = -1;
+
+    /* candidates for type and vendor, in device order */
+    entry = xma_find_kern_index(xma_shm, type, kern_props->vendor);
+    for (i = 0; entry && i < entry->slot_cnt; i++)
     {
-        XmaDevice *dev;
-        int ret = 0;
-        bool dev_exclusive = kern_props->dev_excl;
-
-        dev_id = xma_res_alloc_next_dev(shm_cfg, dev_id, dev_exclusive);
-        if (dev_id < 0)
-            break;
-
-        dev = &xma_shm->sys_res.devices[dev_id];
-        /* JPM check to see if matching kernel is on allocated device */
-        /* if not, free device, increment dev count, re-loop */
-        for (kern_idx = 0;
-             kern_idx < MAX_KERNEL_CONFIGS &&
-             kern_idx < dev->kernel_cnt && !kern_aquired;
-             kern_idx++)
-        {
-            int str_cmp1 = -1, str_cmp2 = -1, type_cmp = false;
-            int kern_id = dev->kernels[kern_idx].kernel_id;
-            XmaKernel *kernel =
-                &xma_shm->sys_res.images[dev->image_id].kernels[kern_id];
-            XmaScalerPlugin *scaler;
-            XmaDecoderPlugin *decoder;
-            XmaEncoderPlugin *encoder;
-            XmaFilterPlugin *filter;
-            XmaKernelPlugin *kernplg;
-            plugin_alloc_chan = NULL;
-
-            str_cmp1 = strcmp(kernel->vendor, kern_props->vendor);
-            if (type == xma_res_scaler) {
-                scaler = &g_xma_singleton->scalercfg[kernel->plugin_handle];
-                str_cmp2 = strcmp(kernel->function, XMA_CFG_FUNC_NM_SCALE);
-                type_cmp = scaler->hwscaler_type ==
-                           kern_props->kernel_spec.scal_type ? true : false;
-                plugin_alloc_chan = scaler->alloc_chan;
-                kernel_data_size = 0;
-            } else if (type == xma_res_encoder) {
-                encoder = &g_xma_singleton->encodercfg[kernel->plugin_handle];
-                str_cmp2 = strcmp(kernel->function, XMA_CFG_FUNC_NM_ENC);
-                type_cmp = encoder->hwencoder_type ==
-                           kern_props->kernel_spec.enc_type ? true : false;
-                plugin_alloc_chan = encoder->alloc_chan;
-                kernel_data_size = encoder->kernel_data_size;
-            } else if (type == xma_res_decoder) {
-                decoder = &g_xma_singleton->decodercfg[kernel->plugin_handle];
-                str_cmp2 = strcmp(kernel->function, XMA_CFG_FUNC_NM_DEC);
-                type_cmp = decoder->hwdecoder_type ==
-                           kern_props->kernel_spec.dec_type ? true : false;
-                plugin_alloc_chan = NULL;
-                kernel_data_size = 0;
-            } else if (type == xma_res_filter) {
-                filter = &g_xma_singleton->filtercfg[kernel->plugin_handle];
-                str_cmp2 = strcmp(kernel->function, XMA_CFG_FUNC_NM_FILTER);
-                type_cmp = filter->hwfilter_type ==
-                           kern_props->kernel_spec.filter_type ? true : false;
-                plugin_alloc_chan = filter->alloc_chan;
-                kernel_data_size = 0;
-            } else if (type == xma_res_kernel) {
-                kernplg = &g_xma_singleton->kernelcfg[kernel->plugin_handle];
-                str_cmp2 = strcmp(kernel->function, XMA_CFG_FUNC_NM_KERNEL);
-                type_cmp = kernplg->hwkernel_type ==
-                           kern_props->kernel_spec.kernel_type ? true : false;
-                kernel_data_size = 0;
-            }
+        uint32_t slot_idx = entry->first_slot + i;
+        XmaKernSlot *slot = &xma_shm->sys_res.slots[slot_idx];
+        XmaDevice *dev = &xma_shm->sys_res.devices[slot->dev_id];
+        XmaKernelInstance *kernel_inst = &dev->kernels[slot->kern_idx];
+        XmaResCand *cand = &cands[cand_cnt];
+        pid_t owner;
+
+        if (!xma_res_plugin_match(type, slot->plugin_handle, kern_props,
+                                  &plugin))
+            continue;
 
-            if (str_cmp1 == 0 && str_cmp2 == 0 && type_cmp) {
-                /* register client thread id with kernel */
-                    ret = xma_client_thread_kernel_alloc(shm_cfg, dev, kern_idx,
-                                                         session,
-                                                         kernel_data_size,
-                                                         plugin_alloc_chan);
-                    if (ret)
-                        continue;
+        /* skip kernels of other processes without taking the lock */
+        owner = __atomic_load_n(&kernel_inst->client_id, __ATOMIC_RELAXED);
+        if (owner && owner != proc_id)
+            continue;
 
-                    kern_props->dev_handle = dev_id;
-                    kern_props->kern_handle = kern_idx;
-                    kern_props->plugin_handle = kernel->plugin_handle;
-                    kern_props->session = session;
-                    kern_aquired = true;
-            }
-        }
+        if (plugin_loads[slot->plugin_handle] < 0) {
+            uint32_t load = 0;
 
-        if (!kern_aquired) {
-            xma_logmsg(XMA_DEBUG_LOG, XMA_RES_MOD,
-                       "%s() Unable to locate requested %s kernel type\n",
-                        __func__,
-                        kern_props->kernel_spec.scal_type ? "scaler" :
-                        kern_props->kernel_spec.enc_type ? "encoder" :
-                        kern_props->kernel_spec.dec_type ? "decoder" :
-                        kern_props->kernel_spec.filter_type ? "filter" :
-                        "kernel"
-                        );
-            xma_logmsg(XMA_DEBUG_LOG, XMA_RES_MOD,
-                       "%s() from vendor %s on device %d\n",
-                        __func__, kern_props->vendor, dev_id);
-            ret = xma_free_dev(xma_shm, dev_id, proc_id);
+            if (plugin.get_load && plugin.get_load(session, &load))
+                load = XMA_MAX_KERNEL_LOAD + 1;
+            plugin_loads[slot->plugin_handle] = load;
         }
+        cand->slot = slot_idx;
+        cand->load = (uint32_t)plugin_loads[slot->plugin_handle];
+        if (__atomic_load_n(&kernel_inst->load, __ATOMIC_RELAXED) + cand->load >
+            XMA_MAX_KERNEL_LOAD)
+            continue;
+
+        if (policy->score)
+            policy->score(xma_shm, cand, dev_loads, now_ns);
+        cand_cnt++;
+    }
+
+    if (policy->score && cand_cnt > 1)
+        qsort(cands, cand_cnt, sizeof(cands[0]), xma_res_cand_cmp);
 
-        if (ret < 0) {
+    for (i = 0; i < cand_cnt; i++)
+    {
+        XmaKernSlot *slot = &xma_shm->sys_res.slots[cands[i].slot];
+        XmaDevice *dev = &xma_shm->sys_res.devices[slot->dev_id];
+        bool registered = false;
+        int ret;
+
+        xma_res_plugin_match(type, slot->plugin_handle, kern_props, &plugin);
+        if (xma_dev_lock(xma_shm, slot->dev_id))
             return XMA_ERROR;
+
+        ret = xma_dev_is_free(xma_shm, slot->dev_id) ?
+              xma_alloc_dev(xma_shm, slot->dev_id, kern_props->dev_excl,
+                            &registered) : XMA_ERROR_NO_DEV;
+        if (ret == XMA_SUCCESS) {
+            /* register client thread id with kernel */
+            ret = xma_client_thread_kernel_alloc(dev, slot->kern_idx,
+                                                 session, &plugin,
+                                                 cands[i].load);
+            if (ret && registered)
+                xma_free_dev(xma_shm, slot->dev_id, proc_id);
         }
-    }
-    if (kern_aquired) {
+        xma_dev_unlock(xma_shm, slot->dev_id);
+        if (ret)
+            continue;
+
+        kern_props->dev_handle = slot->dev_id;
+        kern_props->kern_handle = slot->kern_idx;
+        kern_props->plugin_handle = slot->plugin_handle;
+        kern_props->session = session;
         session->kern_res = (XmaKernelRes)kern_props;
+        session->metrics = xma_res_stats_alloc(xma_shm, kern_props);
+        xma_logmsg(XMA_DEBUG_LOG, XMA_RES_MOD,
+                   "%s() %s placement: device %d kernel %d load %u\n",
+                   __func__, policy->name, slot->dev_id, slot->kern_idx,
+                   cands[i].load);
         return XMA_SUCCESS;
     }
 
@@ -974,33 +1378,32 @@ static int32_t xma_res_alloc_kernel(XmaResources shm_cfg,
 
 }
 
-static int32_t xma_client_thread_kernel_alloc(XmaResources shm_cfg,
-                                              XmaDevice *dev,
+/* call while holding device lock */
+static int32_t xma_client_thread_kernel_alloc(XmaDevice *dev,
                                               int dev_kern_idx,
                                               XmaSession *session,
-                                              size_t kernel_data_size,
-                                              int32_t (*alloc_chan)
-                                                            (XmaSession *p,
-                                                             XmaSession **c,
-                                                             uint32_t sess_cnt))
+                                              const XmaResPlugin *plugin,
+                                              uint32_t load)
 {
+    int32_t (*alloc_chan)(XmaSession *p, XmaSession **c, uint32_t sess_cnt) =
+                                                          plugin->alloc_chan;
+    size_t kernel_data_size = plugin->kernel_data_size;
     XmaKernelInstance *kernel_inst = &dev->kernels[dev_kern_idx];
-    XmaResConfig *xma_shm = (XmaResConfig *)shm_cfg;
     XmaSession *sessions[MAX_KERNEL_CHANS];
     pthread_t thread_id = pthread_self();
     pid_t proc_id = getpid();
     int j, ret;
 
     xma_logmsg(XMA_DEBUG_LOG, XMA_RES_MOD, "%s()\n", __func__);
-    if (xma_shm_lock(xma_shm))
-        return XMA_ERROR;
-
-    if (kernel_inst->client_id && kernel_inst->client_id != proc_id) {
-        xma_shm_unlock(xma_shm);
+    if (kernel_inst->client_id && kernel_inst->client_id != proc_id)
         return XMA_ERROR_NO_KERNEL; /* some other process has this kernel */
-    }
 
-    kernel_inst->client_id = proc_id;
+    if (kernel_inst->load + load > XMA_MAX_KERNEL_LOAD) {
+        xma_logmsg(XMA_DEBUG_LOG, XMA_RES_MOD,
+                   "%s() Kernel load %u cannot take %u more\n",
+                   __func__, kernel_inst->load, load);
+        return XMA_ERROR_NO_KERNEL;
+    }
 
     for (j = 0; kernel_inst->channels[j].thread_id && j < MAX_KERNEL_CHANS; j++)
         sessions[j] = kernel_inst->channels[j].session;
@@ -1016,17 +1419,20 @@ static int32_t xma_client_thread_kernel_alloc(XmaResources shm_cfg,
             if (ret) {
                 xma_logmsg(XMA_DEBUG_LOG, XMA_RES_MOD,
                            "%s() Channel request rejected\n", __func__);
-                xma_shm_unlock(xma_shm);
                 return ret;
             }
         }
+        /* read without the lock by xma_res_alloc_kernel() */
+        __atomic_store_n(&kernel_inst->client_id, proc_id, __ATOMIC_RELAXED);
         kernel_inst->channels[j].session = session;
         kernel_inst->channels[j].thread_id = thread_id;
+        kernel_inst->channels[j].load = load;
+        __atomic_store_n(&kernel_inst->load, load, __ATOMIC_RELAXED);
+        __atomic_store_n(&kernel_inst->chan_cnt, 1, __ATOMIC_RELAXED);
         session->chan_id = session->chan_id >= 0 ? session->chan_id : 0;
         xma_logmsg(XMA_DEBUG_LOG, XMA_RES_MOD,
                    "%s() Kernel aquired. Channel id %d\n",
                    __func__, session->chan_id);
-        xma_shm_unlock(xma_shm);
         return XMA_SUCCESS;
     } else if (j && j < MAX_KERNEL_CHANS && alloc_chan) {
         /* verify it can support another request */
@@ -1036,22 +1442,21 @@ static int32_t xma_client_thread_kernel_alloc(XmaResources shm_cfg,
         if (kernel_data_size > 0)
             session->kernel_data = sessions[0]->kernel_data;
         ret = alloc_chan(session, sessions, j);
-        if (ret) {
-            xma_shm_unlock(xma_shm);
+        if (ret)
             return ret;
-        }
         kernel_inst->channels[j].session = session;
         kernel_inst->channels[j].thread_id = thread_id;
-        xma_shm_unlock(xma_shm);
+        kernel_inst->channels[j].load = load;
+        __atomic_store_n(&kernel_inst->load, kernel_inst->load + load,
+                         __ATOMIC_RELAXED);
+        __atomic_store_n(&kernel_inst->chan_cnt, j + 1, __ATOMIC_RELAXED);
         return XMA_SUCCESS;
     } else if (j && !alloc_chan) {
         /* kernel is in-use and doesn't support channels */
         xma_logmsg(XMA_DEBUG_LOG, XMA_RES_MOD,
                    "%s() All kernel channels in-use \n", __func__);
-        xma_shm_unlock(xma_shm);
         return XMA_ERROR_NO_KERNEL;
     }
-    xma_shm_unlock(xma_shm);
     return XMA_ERROR;
 }
 
@@ -1075,25 +1480,29 @@ static int xma_client_thread_kernel_free(XmaDevice *dev,
             continue;
         if (kernel_inst->channels[i].session != session)
             continue;
+        __atomic_store_n(&kernel_inst->load,
+                         kernel_inst->load - kernel_inst->channels[i].load,
+                         __ATOMIC_RELAXED);
+        __atomic_store_n(&kernel_inst->chan_cnt, kernel_inst->chan_cnt - 1,
+                         __ATOMIC_RELAXED);
         kernel_inst->channels[i].thread_id = 0;
         kernel_inst->channels[i].session = NULL;
+        kernel_inst->channels[i].load = 0;
         /* eliminate fragmentation in list of used channels after free */
         for (; i < MAX_KERNEL_CHANS-1 &&
                kernel_inst->channels[i+1].thread_id &&
                kernel_inst->channels[i+1].session; i++) {
-            kernel_inst->channels[i].thread_id =
-                                     kernel_inst->channels[i+1].thread_id;
-            kernel_inst->channels[i].session =
-                                     kernel_inst->channels[i+1].session;
+            kernel_inst->channels[i] = kernel_inst->channels[i+1];
         }
         last_used_chan = !i ? true : false;
         /* ensure last entry is cleared if not otherwise */
         if (!last_used_chan) {
             kernel_inst->channels[i].thread_id = 0;
             kernel_inst->channels[i].session = NULL;
+            kernel_inst->channels[i].load = 0;
             return XMA_SUCCESS;
         } else {
-            kernel_inst->client_id = 0;
+            xma_kernel_inst_reset(kernel_inst);
             if (session->kernel_data)
                 free(session->kernel_data);
             return XMA_SUCCESS;
@@ -1149,6 +1558,32 @@ static int xma_shm_unlock(XmaResConfig *xma_shm)
     return pthread_mutex_unlock(&xma_shm->lock);
 }
 
+static int xma_dev_lock(XmaResConfig *xma_shm, int32_t dev_id)
+{
+    extern XmaSingleton *g_xma_singleton;
+    pthread_mutex_t *lock;
+    int ret;
+
+    if (g_xma_singleton->shm_freed || !xma_shm ||
+        dev_id < 0 || dev_id >= MAX_XILINX_DEVICES)
+        return XMA_ERROR_INVALID;
+
+    lock = &xma_shm->sys_res.devices[dev_id].lock;
+    ret = pthread_mutex_lock(lock);
+    if (ret == EOWNERDEAD) {
+        pthread_mutex_consistent(lock);
+        return XMA_SUCCESS;
+    }
+    return ret;
+}
+
+static int xma_dev_unlock(XmaResConfig *xma_shm, int32_t dev_id)
+{
+    if (!xma_shm || dev_id < 0 || dev_id >= MAX_XILINX_DEVICES)
+        return XMA_ERROR_INVALID;
+    return pthread_mutex_unlock(&xma_shm->sys_res.devices[dev_id].lock);
+}
+
 static void xma_free_all_kernel_chan_res(XmaDevice *dev, pid_t proc_id)
 {
     int i;
@@ -1162,15 +1597,28 @@ static void xma_free_all_kernel_chan_res(XmaDevice *dev, pid_t proc_id)
         if (proc_id && kernel->client_id != proc_id)
             continue;
 
-        kernel->client_id = 0;
         for (j = 0; j < MAX_KERNEL_CHANS && kernel->channels[j].session; j++)
         {
             kernel->channels[j].thread_id = 0;
             kernel->channels[j].session = NULL;
+            kernel->channels[j].load = 0;
         }
+        xma_kernel_inst_reset(kernel);
     }
 }
 
+/* call while holding device lock, clears owner, load and frame rate */
+static void xma_kernel_inst_reset(XmaKernelInstance *kernel)
+{
+    __atomic_store_n(&kernel->client_id, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&kernel->load, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&kernel->chan_cnt, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&kernel->fps, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&kernel->rate_stamp_ns, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&kernel->rate_frames, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&kernel->frames, 0, __ATOMIC_RELAXED);
+}
+
 static int xma_verify_shm_client_procs(XmaResConfig *xma_shm,
                                        XmaSystemCfg *config)
 {
@@ -1233,7 +1681,7 @@ static void xma_dec_ref_shm(XmaResConfig *xma_shm)
     int max_refs = MAX_XILINX_DEVICES * MAX_KERNEL_CONFIGS;
     int i;
 
-    xma_logmsg(XMA_DEBUG_LOG, XMA_RES_MOD, __func__);
+    xma_logmsg(XMA_DEBUG_LOG, XMA_RES_MOD, "%s()\n", __func__);
     for (i = 0; i < xma_shm->ref_cnt; i++)
     {
         int j;
@@ -1269,7 +1717,7 @@ static int xma_inc_ref_shm(XmaResConfig *xma_shm)
     return XMA_SUCCESS;
 }
 
-/* call while holding lock */
+/* call while holding lock, takes the device locks */
 static void xma_free_all_proc_res(XmaResConfig *xma_shm, pid_t proc_id)
 {
     int i;
@@ -1277,8 +1725,101 @@ static void xma_free_all_proc_res(XmaResConfig *xma_shm, pid_t proc_id)
     xma_logmsg(XMA_DEBUG_LOG, XMA_RES_MOD, "%s()\n", __func__);
     for (i = 0; i < MAX_XILINX_DEVICES; i++)
     {
+        if (!xma_shm->sys_res.devices[i].exists || xma_dev_lock(xma_shm, i))
+            continue;
         xma_free_dev(xma_shm, i, proc_id);
         xma_free_all_kernel_chan_res(&xma_shm->sys_res.devices[i], proc_id);
+        xma_dev_unlock(xma_shm, i);
     }
+    for (i = 0; i < MAX_STATS_SESSIONS; i++)
+        xma_res_stats_free(&xma_shm->sys_res.stats[i], proc_id);
     return;
 }
+
+static XmaSessionStats *xma_res_stats_alloc(XmaResConfig *xma_shm,
+                                            XmaKernReq *kern_props)
+{
+    XmaSession *session = kern_props->session;
+    const size_t reset_from = offsetof(XmaSessionStats, session_type);
+    int i;
+
+    for (i = 0; i < MAX_STATS_SESSIONS; i++)
+    {
+        XmaSessionStats *stats = &xma_shm->sys_res.stats[i];
+        pid_t unused = 0;
+        size_t vendor_len;
+
+        if (!__atomic_compare_exchange_n(&stats->pid, &unused, -1, false,
+                                         __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            continue;
+
+        memset((char *)stats + reset_from, 0, sizeof(*stats) - reset_from);
+        stats->session_type = session->session_type;
+        vendor_len = strnlen(kern_props->vendor, sizeof(stats->vendor) - 1);
+        memcpy(stats->vendor, kern_props->vendor, vendor_len);
+        stats->vendor[vendor_len] = '\0';
+        stats->dev_id = kern_props->dev_handle;
+        stats->kern_idx = kern_props->kern_handle;
+        stats->chan_id = session->chan_id;
+        stats->start_ns = xma_res_now_ns();
+        __atomic_store_n(&stats->pid, getpid(), __ATOMIC_RELEASE);
+        return stats;
+    }
+
+    xma_logmsg(XMA_INFO_LOG, XMA_RES_MOD,
+               "All %d session statistics entries in use\n",
+               MAX_STATS_SESSIONS);
+    return NULL;
+}
+
+/* release the entry if it belongs to proc_id */
+static void xma_res_stats_free(XmaSessionStats *stats, pid_t proc_id)
+{
+    pid_t owner = proc_id;
+
+    __atomic_compare_exchange_n(&stats->pid, &owner, 0, false,
+                                __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+}
+
+int32_t xma_stats_list(XmaSessionStats *stats, int32_t max)
+{
+    const XmaResConfig *xma_shm;
+    struct stat db_stat;
+    int32_t i, cnt = 0;
+    int fd;
+
+    if (!stats || max < 0)
+        return XMA_ERROR_INVALID;
+
+    xma_set_shm_filenames();
+    fd = open(XMA_SHM_FILE, O_RDONLY);
+    if (fd < 0)
+        return 0;
+    if (fstat(fd, &db_stat) || db_stat.st_size != sizeof(XmaResConfig)) {
+        close(fd);
+        return 0;
+    }
+    xma_shm = (const XmaResConfig *)mmap(NULL, sizeof(XmaResConfig),
+                                         PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (xma_shm == MAP_FAILED)
+        return 0;
+
+    for (i = 0; i < MAX_STATS_SESSIONS && cnt < max; i++)
+    {
+        const XmaSessionStats *entry = &xma_shm->sys_res.stats[i];
+        pid_t pid = __atomic_load_n(&entry->pid, __ATOMIC_ACQUIRE);
+
+        /* entries of crashed processes stay until the next cleanup */
+        if (pid <= 0 || (kill(pid, 0) && errno == ESRCH))
+            continue;
+        memcpy(&stats[cnt], entry, sizeof(*entry));
+        if (__atomic_load_n(&entry->pid, __ATOMIC_ACQUIRE) != pid)
+            continue;
+        stats[cnt].pid = pid;
+        cnt++;
+    }
+
+    munmap((void *)xma_shm, sizeof(XmaResConfig));
+    return cnt;
+}
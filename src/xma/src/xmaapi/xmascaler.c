@@ -14,13 +14,17 @@
  * License for the specific language governing permissions and limitations
  * under the License.
  */
+#include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <dlfcn.h>
 #include "lib/xmaapi.h"
+#include "lib/xmaasync.h"
 #include "lib/xmahw_hal.h"
 #include "lib/xmares.h"
+#include "lib/xmastats.h"
 #include "xmaplugin.h"
 
 #define XMA_SCALER_MOD "xmascaler"
@@ -97,16 +101,111 @@ static int16_t fixed_coeff_taps12[64][12] =
 
 static void copy_coeffecients(int16_t coeff[64][12])
 {
-    int32_t i, j;
+    memcpy(coeff, fixed_coeff_taps12, sizeof(fixed_coeff_taps12));
+}
+
+#define XMA_SCALER_PHASES      64
+#define XMA_SCALER_MAX_TAPS    12
+#define XMA_SCALER_COEFF_ONE   4096
+
+/* Generated filter banks of the process.  Entries are never freed, so
+ * lookups hand out pointers; an ABR ladder only needs a few of them. */
+typedef struct XmaScalerCoeffEntry
+{
+    XmaScalerCoeffTable         table;
+    struct XmaScalerCoeffEntry *next;
+} XmaScalerCoeffEntry;
+
+static XmaScalerCoeffEntry *xma_scaler_coeff_cache;
+static pthread_mutex_t xma_scaler_coeff_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static double xma_scaler_sinc(double x)
+{
+    if (fabs(x) < 1e-9)
+        return 1.0;
+    return sin(M_PI * x) / (M_PI * x);
+}
+
+/* Lanczos windowed sinc, widened by the ratio when downscaling so the
+ * filter cuts off at the output Nyquist frequency */
+static void xma_scaler_coeff_generate(XmaScalerCoeffTable *table)
+{
+    double scale = table->out_size < table->in_size ?
+                   (double)table->out_size / table->in_size : 1.0;
+    double half = table->taps / 2.0;
+    int32_t pad = (XMA_SCALER_MAX_TAPS - table->taps) / 2;
+    int32_t phase, t;
+
+    memset(table->coeff, 0, sizeof(table->coeff));
+    for (phase = 0; phase < XMA_SCALER_PHASES; phase++)
+    {
+        double weight[XMA_SCALER_MAX_TAPS];
+        double sum = 0;
+        int32_t total = 0, rest, center = pad + table->taps / 2 - 1;
+
+        for (t = 0; t < table->taps; t++)
+        {
+            double x = t - (half - 1) - (double)phase / XMA_SCALER_PHASES;
+
+            weight[t] = xma_scaler_sinc(x * scale) *
+                        xma_scaler_sinc(x / half);
+            sum += weight[t];
+        }
+        for (t = 0; t < table->taps; t++)
+        {
+            table->coeff[phase][pad + t] =
+                (int16_t)lround(weight[t] * XMA_SCALER_COEFF_ONE / sum);
+            total += table->coeff[phase][pad + t];
+        }
+        /* rounding must not change the DC gain; the half phase splits the
+         * error between its two center taps to stay symmetric */
+        rest = XMA_SCALER_COEFF_ONE - total;
+        if (phase * 2 == XMA_SCALER_PHASES)
+        {
+            table->coeff[phase][center] += rest / 2;
+            table->coeff[phase][center + 1] += rest - rest / 2;
+        }
+        else
+        {
+            table->coeff[phase][phase * 2 < XMA_SCALER_PHASES ?
+                                center : center + 1] += rest;
+        }
+    }
+}
+
+const XmaScalerCoeffTable*
+xma_scaler_filter_coeff_get(int32_t in_size, int32_t out_size, int32_t taps)
+{
+    XmaScalerCoeffEntry *entry;
 
     xma_logmsg(XMA_DEBUG_LOG, XMA_SCALER_MOD, "%s()\n", __func__);
-    for (i = 0; i < 64; i++)
+    if (in_size <= 0 || out_size <= 0 || taps < 2 ||
+        taps > XMA_SCALER_MAX_TAPS || taps % 2)
+        return NULL;
+
+    pthread_mutex_lock(&xma_scaler_coeff_lock);
+    for (entry = xma_scaler_coeff_cache; entry; entry = entry->next)
     {
-        for (j = 0; j < 12; j++)
+        if (entry->table.in_size == in_size &&
+            entry->table.out_size == out_size && entry->table.taps == taps)
+            break;
+    }
+    if (!entry)
+    {
+        entry = malloc(sizeof(XmaScalerCoeffEntry));
+        if (entry)
         {
-            coeff[i][j] = fixed_coeff_taps12[i][j];
+            entry->table.in_size = in_size;
+            entry->table.out_size = out_size;
+            entry->table.taps = taps;
+            xma_scaler_coeff_generate(&entry->table);
+            entry->next = xma_scaler_coeff_cache;
+            xma_scaler_coeff_cache = entry;
         }
     }
+    pthread_mutex_unlock(&xma_scaler_coeff_lock);
+
+    return entry ? &entry->table : NULL;
 }
 
 int32_t
@@ -297,6 +396,7 @@ xma_scaler_session_destroy(XmaScalerSession *session)
     int32_t rc, i;
 
     xma_logmsg(XMA_DEBUG_LOG, XMA_SCALER_MOD, "%s()\n", __func__);
+    xma_async_stop(&session->base);
     rc  = session->scaler_plugin->close(session);
     if (rc != 0)
         xma_logmsg(XMA_ERROR_LOG, XMA_SCALER_MOD,
@@ -328,13 +428,12 @@ xma_scaler_session_destroy(XmaScalerSession *session)
     return XMA_SUCCESS;
 }
 
-int32_t
-xma_scaler_session_send_frame(XmaScalerSession  *session,
-                              XmaFrame          *frame)
+/* Point outputs connected to a zerocopy encoder at its input buffer */
+static void
+xma_scaler_session_zerocopy_dests_set(XmaScalerSession *session)
 {
     int32_t i;
 
-    xma_logmsg(XMA_DEBUG_LOG, XMA_SCALER_MOD, "%s()\n", __func__);
     for (i = 0; i < session->props.num_outputs; i++)
     {
         if (session->conn_send_handles[i] != -1)
@@ -362,14 +461,135 @@ xma_scaler_session_send_frame(XmaScalerSession  *session,
         }
     }
 
-    return session->scaler_plugin->send_frame(session, frame);
+}
+
+int32_t
+xma_scaler_session_send_frame(XmaScalerSession  *session,
+                              XmaFrame          *frame)
+{
+    int32_t rc;
+    uint64_t start_ns;
+
+    xma_logmsg(XMA_DEBUG_LOG, XMA_SCALER_MOD, "%s()\n", __func__);
+    if (xma_async_enabled(&session->base))
+        return XMA_ERROR_INVALID;
+    xma_scaler_session_zerocopy_dests_set(session);
+    start_ns = xma_stats_now_ns();
+    rc = session->scaler_plugin->send_frame(session, frame);
+    xma_stats_latency(&session->base, XMA_STATS_SEND, start_ns);
+    if (rc >= XMA_SUCCESS)
+    {
+        xma_res_kernel_progress(g_xma_singleton->shm_res_cfg,
+                                session->base.kern_res, 1);
+        xma_stats_frames_in(&session->base, 1, xma_stats_frame_bytes(frame));
+    }
+    return rc;
+}
+
+/* Count the outputs of one input frame */
+static void
+xma_scaler_session_stats_outputs(XmaScalerSession *session,
+                                 XmaFrame        **frame_list)
+{
+    uint64_t bytes = 0;
+    int32_t i;
+
+    for (i = 0; i < session->props.num_outputs; i++)
+        bytes += xma_stats_frame_bytes(frame_list[i]);
+    xma_stats_frames_out(&session->base, session->props.num_outputs, bytes);
 }
 
 int32_t
 xma_scaler_session_recv_frame_list(XmaScalerSession  *session,
                                    XmaFrame          **frame_list)
+{
+    int32_t rc;
+    uint64_t start_ns;
+
+    xma_logmsg(XMA_DEBUG_LOG, XMA_SCALER_MOD, "%s()\n", __func__);
+    if (xma_async_enabled(&session->base))
+        return XMA_ERROR_INVALID;
+    start_ns = xma_stats_now_ns();
+    rc = session->scaler_plugin->recv_frame_list(session, frame_list);
+    xma_stats_latency(&session->base, XMA_STATS_RECV, start_ns);
+    if (rc == XMA_SUCCESS)
+        xma_scaler_session_stats_outputs(session, frame_list);
+    return rc;
+}
+
+/* Asynchronous mode for plugins without stage callbacks */
+static int32_t
+xma_scaler_session_async_execute(XmaSession *s, XmaAsyncJob *job)
+{
+    XmaScalerSession *session = to_xma_scaler(s);
+    int32_t rc;
+
+    rc = session->scaler_plugin->send_frame(session, job->frame);
+    if (rc != XMA_SUCCESS)
+        return rc;
+    return session->scaler_plugin->recv_frame_list(session, job->output);
+}
+
+static const XmaAsyncPlugin xma_scaler_session_async_default = {
+    .max_depth = 0,
+    .execute = xma_scaler_session_async_execute,
+};
+
+static void
+xma_scaler_session_async_complete(XmaSession *s, XmaAsyncJob *job,
+                                  void (*done)(void))
+{
+    XmaScalerSession *session = to_xma_scaler(s);
+
+    if (job->status >= XMA_SUCCESS)
+    {
+        xma_res_kernel_progress(g_xma_singleton->shm_res_cfg,
+                                session->base.kern_res, 1);
+        xma_stats_frames_in(&session->base, 1,
+                            xma_stats_frame_bytes(job->frame));
+        xma_scaler_session_stats_outputs(session, job->output);
+    }
+    if (done)
+        ((XmaScalerAsyncDone)done)(session, job->app_frame, job->output,
+                                   job->status, job->user_data);
+}
+
+int32_t
+xma_scaler_session_async_start(XmaScalerSession   *session,
+                               int32_t             depth,
+                               XmaScalerAsyncDone  done)
+{
+    const XmaAsyncPlugin *stages;
+
+    xma_logmsg(XMA_DEBUG_LOG, XMA_SCALER_MOD, "%s()\n", __func__);
+    if (!session)
+        return XMA_ERROR_INVALID;
+    stages = session->scaler_plugin->async ?
+             session->scaler_plugin->async : &xma_scaler_session_async_default;
+    return xma_async_start(&session->base, stages, depth,
+                           xma_scaler_session_async_complete,
+                           (void (*)(void))done);
+}
+
+int32_t
+xma_scaler_session_send_frame_async(XmaScalerSession  *session,
+                                    XmaFrame          *frame,
+                                    XmaFrame         **frame_list,
+                                    void              *user_data)
+{
+    xma_logmsg(XMA_DEBUG_LOG, XMA_SCALER_MOD, "%s()\n", __func__);
+    if (!session || !frame || !xma_async_enabled(&session->base))
+        return XMA_ERROR_INVALID;
+    xma_scaler_session_zerocopy_dests_set(session);
+    return xma_async_submit(&session->base, frame, frame, frame_list,
+                            user_data);
+}
+
+int32_t
+xma_scaler_session_async_flush(XmaScalerSession *session)
 {
     xma_logmsg(XMA_DEBUG_LOG, XMA_SCALER_MOD, "%s()\n", __func__);
-    return session->scaler_plugin->recv_frame_list(session,
-                                                   frame_list);
+    if (!session)
+        return XMA_ERROR_INVALID;
+    return xma_async_flush(&session->base);
 }
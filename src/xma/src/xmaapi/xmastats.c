@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2018, Xilinx Inc - All rights reserved
+ * Xilinx SDAccel Media Accelerator API
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "xma.h"
+#include "lib/xmastats.h"
+
+static uint32_t xma_stats_bucket(uint64_t ns)
+{
+    uint64_t us = ns / 1000;
+    uint32_t bucket = 0;
+
+    while (us && bucket < XMA_STATS_BUCKETS - 1)
+    {
+        us >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+static void xma_stats_max(uint64_t *max, uint64_t value)
+{
+    uint64_t cur = __atomic_load_n(max, __ATOMIC_RELAXED);
+
+    while (value > cur &&
+           !__atomic_compare_exchange_n(max, &cur, value, false,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+uint64_t xma_stats_frame_bytes(XmaFrame *frame)
+{
+    uint64_t bytes = 0;
+    int32_t i;
+
+    if (!frame)
+        return 0;
+    for (i = 0; i < xma_frame_planes_get(&frame->frame_props); i++)
+        bytes += xma_frame_plane_size_get(&frame->frame_props, i);
+    return bytes;
+}
+
+void xma_stats_frames_in(XmaSession *session, uint32_t frames, uint64_t bytes)
+{
+    XmaSessionStats *stats = session->metrics;
+
+    if (!stats)
+        return;
+    __atomic_add_fetch(&stats->frames_in, frames, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&stats->bytes_in, bytes, __ATOMIC_RELAXED);
+}
+
+void xma_stats_frames_out(XmaSession *session, uint32_t frames,
+                          uint64_t bytes)
+{
+    XmaSessionStats *stats = session->metrics;
+
+    if (!stats)
+        return;
+    __atomic_add_fetch(&stats->frames_out, frames, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&stats->bytes_out, bytes, __ATOMIC_RELAXED);
+}
+
+void xma_stats_latency(XmaSession *session, XmaStatsStage stage,
+                       uint64_t start_ns)
+{
+    XmaSessionStats *stats = session->metrics;
+    XmaStatsHist *hist;
+    uint64_t ns;
+
+    if (!stats || stage < 0 || stage >= XMA_STATS_STAGES)
+        return;
+    ns = xma_stats_now_ns() - start_ns;
+    hist = &stats->latency[stage];
+    __atomic_add_fetch(&hist->count, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&hist->total_ns, ns, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&hist->buckets[xma_stats_bucket(ns)], 1,
+                       __ATOMIC_RELAXED);
+    xma_stats_max(&hist->max_ns, ns);
+    __atomic_add_fetch(&stats->plugin_ns, ns, __ATOMIC_RELAXED);
+}
+
+void xma_stats_queue_depth(XmaSession *session, int32_t depth)
+{
+    XmaSessionStats *stats = session->metrics;
+    int32_t max;
+
+    if (!stats)
+        return;
+    __atomic_store_n(&stats->queue_depth, depth, __ATOMIC_RELAXED);
+    max = __atomic_load_n(&stats->queue_max, __ATOMIC_RELAXED);
+    while (depth > max &&
+           !__atomic_compare_exchange_n(&stats->queue_max, &max, depth, false,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
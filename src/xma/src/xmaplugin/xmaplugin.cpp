@@ -117,6 +117,84 @@ xma_plg_buffer_read(XmaHwSession s_handle,
     return rc;
 }
 
+int32_t
+xma_plg_buffer_read_list(XmaHwSession           s_handle,
+                         XmaBufferHandle        b_handle,
+                         const XmaBufferRegion *regions,
+                         int32_t                num_regions)
+{
+    int32_t rc;
+    size_t  start, end;
+
+    if (!regions || num_regions <= 0)
+        return XMA_ERROR;
+
+    xclDeviceHandle dev_handle = s_handle.dev_handle;
+
+    start = regions[0].offset;
+    end = regions[0].offset + regions[0].size;
+    for (int32_t i = 1; i < num_regions; i++)
+    {
+        if (regions[i].offset < start)
+            start = regions[i].offset;
+        if (regions[i].offset + regions[i].size > end)
+            end = regions[i].offset + regions[i].size;
+    }
+
+    rc = xclSyncBO(dev_handle, b_handle, XCL_BO_SYNC_BO_FROM_DEVICE,
+                   end - start, start);
+    if (rc != 0)
+    {
+        printf("xclSyncBO failed %d\n", rc);
+        return rc;
+    }
+
+    for (int32_t i = 0; i < num_regions; i++)
+    {
+        rc = xclReadBO(dev_handle, b_handle, regions[i].dst,
+                       regions[i].size, regions[i].offset);
+        if (rc != 0)
+        {
+            printf("xclReadBO failed %d\n", rc);
+            return rc;
+        }
+    }
+
+    return rc;
+}
+
+int32_t
+xma_plg_buffer_sync_to_device(XmaHwSession     s_handle,
+                              XmaBufferHandle  b_handle,
+                              size_t           size,
+                              size_t           offset)
+{
+    int32_t rc;
+    xclDeviceHandle dev_handle = s_handle.dev_handle;
+
+    rc = xclSyncBO(dev_handle, b_handle, XCL_BO_SYNC_BO_TO_DEVICE, size, offset);
+    if (rc != 0)
+        printf("xclSyncBO failed %d\n", rc);
+
+    return rc;
+}
+
+int32_t
+xma_plg_buffer_sync_from_device(XmaHwSession     s_handle,
+                                XmaBufferHandle  b_handle,
+                                size_t           size,
+                                size_t           offset)
+{
+    int32_t rc;
+    xclDeviceHandle dev_handle = s_handle.dev_handle;
+
+    rc = xclSyncBO(dev_handle, b_handle, XCL_BO_SYNC_BO_FROM_DEVICE, size, offset);
+    if (rc != 0)
+        printf("xclSyncBO failed %d\n", rc);
+
+    return rc;
+}
+
 int32_t
 xma_plg_register_write(XmaHwSession  s_handle,
                        void         *src,
@@ -0,0 +1,208 @@
+/**
+ * Copyright (C) 2016-2018 Xilinx, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+// Host to device and device to host bandwidth of the emulation flows.
+// Build with MODE=sw_emu or MODE=hw_emu and run with
+// XCL_EMULATION_MODE set accordingly; compare the numbers with and without
+// a device process that maps the shared device memory.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <CL/opencl.h>
+
+#define MIN_SIZE (4 * 1024)
+#define MAX_SIZE (64 * 1024 * 1024)
+#define MIN_BYTES (256 * 1024 * 1024)
+#define CHECK_WORDS 1024
+
+int
+load_file_to_memory(const char *filename, char **result)
+{
+  int size = 0;
+  FILE *f = fopen(filename, "rb");
+  if (f == NULL)
+  {
+    *result = NULL;
+    return -1; // -1 means file opening fail
+  }
+  fseek(f, 0, SEEK_END);
+  size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  *result = (char *)malloc(size+1);
+  if (size != fread(*result, sizeof(char), size, f))
+  {
+    free(*result);
+    return -2; // -2 means file reading fail
+  }
+  fclose(f);
+  (*result)[size] = 0;
+  return size;
+}
+
+static double
+seconds(const struct timespec& start, const struct timespec& end)
+{
+  return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+int main(int argc, char** argv)
+{
+  int err;
+  int status;
+  cl_platform_id platform_id;
+  cl_device_id device_id;
+  cl_context context;
+  cl_command_queue commands;
+  cl_program program;
+  cl_kernel kernel;
+
+  if (argc != 3){
+    printf("test-cl.exe -k <inputfile>\n");
+    return EXIT_FAILURE;
+  }
+
+  err = clGetPlatformIDs(1,&platform_id,NULL);
+  if (err != CL_SUCCESS)
+  {
+    printf("ERROR: Failed to find an OpenCL platform!\n");
+    printf("ERROR: Test failed\n");
+    return EXIT_FAILURE;
+  }
+  err = clGetDeviceIDs(platform_id, CL_DEVICE_TYPE_ACCELERATOR, 1, &device_id, NULL);
+  if (err != CL_SUCCESS)
+  {
+    printf("ERROR: Failed to create a device group!\n");
+    return EXIT_FAILURE;
+  }
+  context = clCreateContext(0, 1, &device_id, NULL, NULL, &err);
+  if (!context)
+  {
+    printf("ERROR: Failed to create a compute context!\n");
+    return EXIT_FAILURE;
+  }
+  commands = clCreateCommandQueue(context, device_id, 0, &err);
+  if (!commands)
+  {
+    printf("ERROR: Failed to create a command commands!\n");
+    printf("ERROR: code %i\n",err);
+    return EXIT_FAILURE;
+  }
+
+  unsigned char *kernelbinary;
+  char *xclbin=argv[2];
+  printf("loading %s\n", xclbin);
+  int n_i = load_file_to_memory(xclbin, (char **) &kernelbinary);
+  if (n_i < 0) {
+    printf("failed to load kernel from xclbin: %s\n", xclbin);
+    printf("ERROR: Test failed\n");
+    return EXIT_FAILURE;
+  }
+  size_t n = n_i;
+  program = clCreateProgramWithBinary(context, 1, &device_id, &n,
+                                      (const unsigned char **) &kernelbinary, &status, &err);
+  if ((!program) || (err!=CL_SUCCESS)) {
+    printf("ERROR: Failed to create compute program from binary %d!\n", err);
+    printf("ERROR: Test failed\n");
+    return EXIT_FAILURE;
+  }
+  err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
+  if (err != CL_SUCCESS)
+  {
+    printf("ERROR: Failed to build program executable!\n");
+    return EXIT_FAILURE;
+  }
+  kernel = clCreateKernel(program, "bandwidth", &err);
+  if (!kernel || err != CL_SUCCESS)
+  {
+    printf("ERROR: Failed to create compute kernel!\n");
+    return EXIT_FAILURE;
+  }
+
+  cl_mem input_a = clCreateBuffer(context, CL_MEM_READ_ONLY, MAX_SIZE, NULL, &err);
+  cl_mem output_b = clCreateBuffer(context, CL_MEM_WRITE_ONLY, MAX_SIZE, NULL, &err);
+  unsigned *a = (unsigned *)malloc(MAX_SIZE);
+  unsigned *b = (unsigned *)malloc(MAX_SIZE);
+  if (!input_a || !output_b || !a || !b)
+  {
+    printf("ERROR: Failed to allocate memory!\n");
+    return EXIT_FAILURE;
+  }
+  for (size_t i = 0; i < MAX_SIZE / sizeof(unsigned); i++)
+    a[i] = i;
+
+  // The device must see the host data and the host the device results
+  // whichever way the buffers travel
+  cl_uint count = CHECK_WORDS;
+  err  = clEnqueueWriteBuffer(commands, input_a, CL_TRUE, 0, count * sizeof(unsigned), a, 0, NULL, NULL);
+  err |= clSetKernelArg(kernel, 0, sizeof(cl_mem), &input_a);
+  err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &output_b);
+  err |= clSetKernelArg(kernel, 2, sizeof(cl_uint), &count);
+  err |= clEnqueueTask(commands, kernel, 0, NULL, NULL);
+  err |= clEnqueueReadBuffer(commands, output_b, CL_TRUE, 0, count * sizeof(unsigned), b, 0, NULL, NULL);
+  if (err != CL_SUCCESS)
+  {
+    printf("ERROR: Failed to run kernel! %d\n", err);
+    return EXIT_FAILURE;
+  }
+  for (cl_uint i = 0; i < count; i++) {
+    if (b[i] != a[i] + 1) {
+      printf("ERROR: Mismatch at %u: %u != %u\n", i, b[i], a[i] + 1);
+      printf("ERROR: Test failed\n");
+      return EXIT_FAILURE;
+    }
+  }
+
+  printf("%12s %12s %12s\n", "bytes", "write MB/s", "read MB/s");
+  for (size_t size = MIN_SIZE; size <= MAX_SIZE; size *= 4) {
+    size_t reps = MIN_BYTES / size;
+    struct timespec start, end;
+    double wsec, rsec;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t r = 0; r < reps; r++)
+      err |= clEnqueueWriteBuffer(commands, input_a, CL_TRUE, 0, size, a, 0, NULL, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    wsec = seconds(start, end);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t r = 0; r < reps; r++)
+      err |= clEnqueueReadBuffer(commands, input_a, CL_TRUE, 0, size, b, 0, NULL, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    rsec = seconds(start, end);
+
+    if (err != CL_SUCCESS || memcmp(a, b, size)) {
+      printf("ERROR: Transfer of %zu bytes failed\n", size);
+      printf("ERROR: Test failed\n");
+      return EXIT_FAILURE;
+    }
+    printf("%12zu %12.1f %12.1f\n", size,
+           reps * size / wsec / 1e6, reps * size / rsec / 1e6);
+  }
+
+  free(a);
+  free(b);
+  clReleaseMemObject(input_a);
+  clReleaseMemObject(output_b);
+  clReleaseProgram(program);
+  clReleaseKernel(kernel);
+  clReleaseCommandQueue(commands);
+  clReleaseContext(context);
+
+  printf("Test passed!\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,25 @@
+/**
+ * Copyright (C) 2016-2018 Xilinx, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+// Increments count words of in into out, used to check that the device
+// sees what the host wrote and the host what the device wrote
+__kernel
+__attribute__ ((reqd_work_group_size(1, 1, 1)))
+void bandwidth(__global const uint* in, __global uint* out, uint count)
+{
+  for (uint i = 0; i < count; i++)
+    out[i] = in[i] + 1;
+}
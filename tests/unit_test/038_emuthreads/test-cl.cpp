@@ -0,0 +1,228 @@
+/**
+ * Copyright (C) 2016-2018 Xilinx, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+// Aggregate host <-> device throughput of the emulation flows with 1 to 8
+// host threads, each copying its own buffer through its own command queue
+// while another thread keeps running the kernel.  With per buffer locking
+// in the shim the copies of different threads overlap.
+// Build with MODE=sw_emu or MODE=hw_emu and run with XCL_EMULATION_MODE
+// set accordingly.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <CL/opencl.h>
+
+#define BUF_SIZE (4 * 1024 * 1024)
+#define TOTAL_BYTES (512 * 1024 * 1024)
+#define MAX_THREADS 8
+#define CHECK_WORDS 1024
+
+int
+load_file_to_memory(const char *filename, char **result)
+{
+  int size = 0;
+  FILE *f = fopen(filename, "rb");
+  if (f == NULL)
+  {
+    *result = NULL;
+    return -1; // -1 means file opening fail
+  }
+  fseek(f, 0, SEEK_END);
+  size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  *result = (char *)malloc(size+1);
+  if (size != fread(*result, sizeof(char), size, f))
+  {
+    free(*result);
+    return -2; // -2 means file reading fail
+  }
+  fclose(f);
+  (*result)[size] = 0;
+  return size;
+}
+
+// Write and read back the buffer of one thread reps times
+static bool
+copy_loop(cl_context context, cl_device_id device_id, unsigned id, size_t reps)
+{
+  int err;
+  cl_command_queue queue = clCreateCommandQueue(context, device_id, 0, &err);
+  cl_mem mem = clCreateBuffer(context, CL_MEM_READ_WRITE, BUF_SIZE, NULL, &err);
+  std::vector<unsigned> a(BUF_SIZE / sizeof(unsigned)), b(a.size());
+  if (!queue || !mem)
+    return false;
+  for (size_t i = 0; i < a.size(); i++)
+    a[i] = id << 24 | i;
+
+  bool ok = true;
+  for (size_t r = 0; r < reps && ok; r++) {
+    err  = clEnqueueWriteBuffer(queue, mem, CL_TRUE, 0, BUF_SIZE, a.data(), 0, NULL, NULL);
+    err |= clEnqueueReadBuffer(queue, mem, CL_TRUE, 0, BUF_SIZE, b.data(), 0, NULL, NULL);
+    ok = (err == CL_SUCCESS) && a == b;
+  }
+  clReleaseMemObject(mem);
+  clReleaseCommandQueue(queue);
+  return ok;
+}
+
+int main(int argc, char** argv)
+{
+  int err;
+  int status;
+  cl_platform_id platform_id;
+  cl_device_id device_id;
+  cl_context context;
+  cl_program program;
+  cl_kernel kernel;
+
+  if (argc != 3){
+    printf("test-cl.exe -k <inputfile>\n");
+    return EXIT_FAILURE;
+  }
+
+  err = clGetPlatformIDs(1,&platform_id,NULL);
+  if (err != CL_SUCCESS)
+  {
+    printf("ERROR: Failed to find an OpenCL platform!\n");
+    printf("ERROR: Test failed\n");
+    return EXIT_FAILURE;
+  }
+  err = clGetDeviceIDs(platform_id, CL_DEVICE_TYPE_ACCELERATOR, 1, &device_id, NULL);
+  if (err != CL_SUCCESS)
+  {
+    printf("ERROR: Failed to create a device group!\n");
+    return EXIT_FAILURE;
+  }
+  context = clCreateContext(0, 1, &device_id, NULL, NULL, &err);
+  if (!context)
+  {
+    printf("ERROR: Failed to create a compute context!\n");
+    return EXIT_FAILURE;
+  }
+
+  unsigned char *kernelbinary;
+  char *xclbin=argv[2];
+  printf("loading %s\n", xclbin);
+  int n_i = load_file_to_memory(xclbin, (char **) &kernelbinary);
+  if (n_i < 0) {
+    printf("failed to load kernel from xclbin: %s\n", xclbin);
+    printf("ERROR: Test failed\n");
+    return EXIT_FAILURE;
+  }
+  size_t n = n_i;
+  program = clCreateProgramWithBinary(context, 1, &device_id, &n,
+                                      (const unsigned char **) &kernelbinary, &status, &err);
+  if ((!program) || (err!=CL_SUCCESS)) {
+    printf("ERROR: Failed to create compute program from binary %d!\n", err);
+    printf("ERROR: Test failed\n");
+    return EXIT_FAILURE;
+  }
+  err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
+  if (err != CL_SUCCESS)
+  {
+    printf("ERROR: Failed to build program executable!\n");
+    return EXIT_FAILURE;
+  }
+  kernel = clCreateKernel(program, "bandwidth", &err);
+  if (!kernel || err != CL_SUCCESS)
+  {
+    printf("ERROR: Failed to create compute kernel!\n");
+    return EXIT_FAILURE;
+  }
+
+  // Keep the kernel running, and so the register polling of the shim busy,
+  // while the copies run
+  cl_command_queue kqueue = clCreateCommandQueue(context, device_id, 0, &err);
+  cl_mem kin = clCreateBuffer(context, CL_MEM_READ_ONLY, CHECK_WORDS * sizeof(unsigned), NULL, &err);
+  cl_mem kout = clCreateBuffer(context, CL_MEM_WRITE_ONLY, CHECK_WORDS * sizeof(unsigned), NULL, &err);
+  std::vector<unsigned> kdata(CHECK_WORDS), kresult(CHECK_WORDS);
+  for (unsigned i = 0; i < CHECK_WORDS; i++)
+    kdata[i] = i;
+  cl_uint count = CHECK_WORDS;
+  err  = clEnqueueWriteBuffer(kqueue, kin, CL_TRUE, 0, CHECK_WORDS * sizeof(unsigned), kdata.data(), 0, NULL, NULL);
+  err |= clSetKernelArg(kernel, 0, sizeof(cl_mem), &kin);
+  err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &kout);
+  err |= clSetKernelArg(kernel, 2, sizeof(cl_uint), &count);
+  if (err != CL_SUCCESS)
+  {
+    printf("ERROR: Failed to set kernel arguments! %d\n", err);
+    return EXIT_FAILURE;
+  }
+
+  printf("%8s %12s %10s\n", "threads", "MB/s", "kernels");
+  bool passed = true;
+  for (unsigned threads = 1; threads <= MAX_THREADS && passed; threads *= 2) {
+    const size_t reps = TOTAL_BYTES / BUF_SIZE / threads;
+    std::atomic<bool> done(false);
+    std::atomic<unsigned> failures(0);
+    unsigned kernels = 0;
+
+    std::thread runner([&] {
+      while (!done) {
+        if (clEnqueueTask(kqueue, kernel, 0, NULL, NULL) != CL_SUCCESS ||
+            clFinish(kqueue) != CL_SUCCESS) {
+          failures++;
+          return;
+        }
+        kernels++;
+      }
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++)
+      workers.emplace_back([&, t] {
+        if (!copy_loop(context, device_id, t, reps))
+          failures++;
+      });
+    for (auto& w : workers)
+      w.join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    done = true;
+    runner.join();
+
+    err = clEnqueueReadBuffer(kqueue, kout, CL_TRUE, 0, CHECK_WORDS * sizeof(unsigned), kresult.data(), 0, NULL, NULL);
+    for (unsigned i = 0; i < CHECK_WORDS && err == CL_SUCCESS; i++)
+      if (kresult[i] != kdata[i] + 1)
+        err = CL_INVALID_VALUE;
+    if (failures || err != CL_SUCCESS) {
+      printf("ERROR: %u threads: transfers or kernel results are wrong\n", threads);
+      passed = false;
+      break;
+    }
+    printf("%8u %12.1f %10u\n", threads,
+           2.0 * reps * threads * BUF_SIZE / elapsed.count() / 1e6, kernels);
+  }
+
+  clReleaseMemObject(kin);
+  clReleaseMemObject(kout);
+  clReleaseCommandQueue(kqueue);
+  clReleaseKernel(kernel);
+  clReleaseProgram(program);
+  clReleaseContext(context);
+
+  if (!passed) {
+    printf("ERROR: Test failed\n");
+    return EXIT_FAILURE;
+  }
+  printf("Test passed!\n");
+  return EXIT_SUCCESS;
+}
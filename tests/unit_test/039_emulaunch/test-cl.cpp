@@ -0,0 +1,190 @@
+/**
+ * Copyright (C) 2016-2018 Xilinx, Inc
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+// Kernel launch rate of the emulation flows: back to back launches of a
+// kernel that does almost nothing, so the time goes into programming the
+// CU registers and waiting for it to be done.  Compare device processes
+// with and without batched register messages.
+// Build with MODE=sw_emu or MODE=hw_emu and run with XCL_EMULATION_MODE
+// set accordingly.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include <CL/opencl.h>
+
+#define LAUNCHES 1000
+#define QUEUED 16
+#define WORDS 16
+
+int
+load_file_to_memory(const char *filename, char **result)
+{
+  int size = 0;
+  FILE *f = fopen(filename, "rb");
+  if (f == NULL)
+  {
+    *result = NULL;
+    return -1; // -1 means file opening fail
+  }
+  fseek(f, 0, SEEK_END);
+  size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  *result = (char *)malloc(size+1);
+  if (size != fread(*result, sizeof(char), size, f))
+  {
+    free(*result);
+    return -2; // -2 means file reading fail
+  }
+  fclose(f);
+  (*result)[size] = 0;
+  return size;
+}
+
+int main(int argc, char** argv)
+{
+  int err;
+  int status;
+  cl_platform_id platform_id;
+  cl_device_id device_id;
+  cl_context context;
+  cl_command_queue commands;
+  cl_program program;
+  cl_kernel kernel;
+
+  if (argc != 3){
+    printf("test-cl.exe -k <inputfile>\n");
+    return EXIT_FAILURE;
+  }
+
+  err = clGetPlatformIDs(1,&platform_id,NULL);
+  if (err != CL_SUCCESS)
+  {
+    printf("ERROR: Failed to find an OpenCL platform!\n");
+    printf("ERROR: Test failed\n");
+    return EXIT_FAILURE;
+  }
+  err = clGetDeviceIDs(platform_id, CL_DEVICE_TYPE_ACCELERATOR, 1, &device_id, NULL);
+  if (err != CL_SUCCESS)
+  {
+    printf("ERROR: Failed to create a device group!\n");
+    return EXIT_FAILURE;
+  }
+  context = clCreateContext(0, 1, &device_id, NULL, NULL, &err);
+  if (!context)
+  {
+    printf("ERROR: Failed to create a compute context!\n");
+    return EXIT_FAILURE;
+  }
+  commands = clCreateCommandQueue(context, device_id, 0, &err);
+  if (!commands)
+  {
+    printf("ERROR: Failed to create a command commands!\n");
+    printf("ERROR: code %i\n",err);
+    return EXIT_FAILURE;
+  }
+
+  unsigned char *kernelbinary;
+  char *xclbin=argv[2];
+  printf("loading %s\n", xclbin);
+  int n_i = load_file_to_memory(xclbin, (char **) &kernelbinary);
+  if (n_i < 0) {
+    printf("failed to load kernel from xclbin: %s\n", xclbin);
+    printf("ERROR: Test failed\n");
+    return EXIT_FAILURE;
+  }
+  size_t n = n_i;
+  program = clCreateProgramWithBinary(context, 1, &device_id, &n,
+                                      (const unsigned char **) &kernelbinary, &status, &err);
+  if ((!program) || (err!=CL_SUCCESS)) {
+    printf("ERROR: Failed to create compute program from binary %d!\n", err);
+    printf("ERROR: Test failed\n");
+    return EXIT_FAILURE;
+  }
+  err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
+  if (err != CL_SUCCESS)
+  {
+    printf("ERROR: Failed to build program executable!\n");
+    return EXIT_FAILURE;
+  }
+  kernel = clCreateKernel(program, "bandwidth", &err);
+  if (!kernel || err != CL_SUCCESS)
+  {
+    printf("ERROR: Failed to create compute kernel!\n");
+    return EXIT_FAILURE;
+  }
+
+  cl_mem in = clCreateBuffer(context, CL_MEM_READ_ONLY, WORDS * sizeof(unsigned), NULL, &err);
+  cl_mem out = clCreateBuffer(context, CL_MEM_WRITE_ONLY, WORDS * sizeof(unsigned), NULL, &err);
+  std::vector<unsigned> data(WORDS), result(WORDS);
+  for (unsigned i = 0; i < WORDS; i++)
+    data[i] = i;
+  cl_uint count = WORDS;
+  err  = clEnqueueWriteBuffer(commands, in, CL_TRUE, 0, WORDS * sizeof(unsigned), data.data(), 0, NULL, NULL);
+  err |= clSetKernelArg(kernel, 0, sizeof(cl_mem), &in);
+  err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &out);
+  err |= clSetKernelArg(kernel, 2, sizeof(cl_uint), &count);
+  if (err != CL_SUCCESS)
+  {
+    printf("ERROR: Failed to set kernel arguments! %d\n", err);
+    return EXIT_FAILURE;
+  }
+
+  // One launch at a time measures the round trip of a launch, several in
+  // flight how fast the scheduler retires them
+  printf("%8s %14s %14s\n", "queued", "launches/s", "us/launch");
+  for (unsigned queued = 1; queued <= QUEUED; queued *= QUEUED) {
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < LAUNCHES && err == CL_SUCCESS; i += queued) {
+      for (unsigned q = 0; q < queued; q++)
+        err |= clEnqueueTask(commands, kernel, 0, NULL, NULL);
+      err |= clFinish(commands);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    if (err != CL_SUCCESS)
+    {
+      printf("ERROR: Failed to run kernel! %d\n", err);
+      printf("ERROR: Test failed\n");
+      return EXIT_FAILURE;
+    }
+    printf("%8u %14.1f %14.1f\n", queued,
+           LAUNCHES / elapsed.count(), elapsed.count() * 1e6 / LAUNCHES);
+  }
+
+  err = clEnqueueReadBuffer(commands, out, CL_TRUE, 0, WORDS * sizeof(unsigned), result.data(), 0, NULL, NULL);
+  for (unsigned i = 0; i < WORDS && err == CL_SUCCESS; i++) {
+    if (result[i] != data[i] + 1) {
+      printf("ERROR: Mismatch at %u: %u != %u\n", i, result[i], data[i] + 1);
+      err = CL_INVALID_VALUE;
+    }
+  }
+
+  clReleaseMemObject(in);
+  clReleaseMemObject(out);
+  clReleaseKernel(kernel);
+  clReleaseProgram(program);
+  clReleaseCommandQueue(commands);
+  clReleaseContext(context);
+
+  if (err != CL_SUCCESS) {
+    printf("ERROR: Test failed\n");
+    return EXIT_FAILURE;
+  }
+  printf("Test passed!\n");
+  return EXIT_SUCCESS;
+}
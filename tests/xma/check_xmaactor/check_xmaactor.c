@@ -0,0 +1,394 @@
+/*
+ * Copyright (C) 2018, Xilinx Inc - All rights reserved
+ * Xilinx SDAccel Media Accelerator API
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <memory.h>
+#include <string>
+#include <iostream>
+#include "lib/xmaapi.h"
+#include "lib/xmalogger.h"
+
+#define TST_MSG_SIZE       64
+#define TST_MSG_ENTRIES    128
+#define TST_NUM_MSGS       2000000
+
+int ck_assert_int_eq(int rc1, int rc2) {
+  if (rc1 != rc2) {
+    return -1;
+  } else {
+    return 0;
+  }
+}
+
+int ck_assert(bool result) {
+  if (!result) {
+    return -1;
+  } else {
+    return 0;
+  }
+}
+
+static double tst_now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1.0e9;
+}
+
+/* Reference: mutex and condition variable queue the actor used before
+ * the lock-free ring, kept to compare throughput */
+typedef struct LegacyActor
+{
+    uint8_t            *msg_array;
+    size_t              msg_size;
+    size_t              max_msg_entries;
+    size_t              num_entries;
+    size_t              front;
+    size_t              back;
+    pthread_mutex_t     lock;
+    pthread_cond_t      queued_cond;
+    pthread_cond_t      dequeued_cond;
+} LegacyActor;
+
+static void legacy_sendmsg(LegacyActor *actor, void *msg, size_t size)
+{
+    pthread_mutex_lock(&actor->lock);
+    while (actor->num_entries == actor->max_msg_entries)
+        pthread_cond_wait(&actor->dequeued_cond, &actor->lock);
+    bool was_empty = (actor->num_entries == 0);
+    memcpy(actor->msg_array + actor->msg_size * actor->back, msg, size);
+    actor->back = (actor->back + 1) % actor->max_msg_entries;
+    actor->num_entries++;
+    if (was_empty)
+        pthread_cond_broadcast(&actor->queued_cond);
+    pthread_mutex_unlock(&actor->lock);
+}
+
+static void legacy_recvmsg(LegacyActor *actor, void *msg, size_t size)
+{
+    pthread_mutex_lock(&actor->lock);
+    while (actor->num_entries == 0)
+        pthread_cond_wait(&actor->queued_cond, &actor->lock);
+    bool was_full = (actor->num_entries == actor->max_msg_entries);
+    memcpy(msg, actor->msg_array + actor->msg_size * actor->front, size);
+    actor->front = (actor->front + 1) % actor->max_msg_entries;
+    actor->num_entries--;
+    if (was_full)
+        pthread_cond_broadcast(&actor->dequeued_cond);
+    pthread_mutex_unlock(&actor->lock);
+}
+
+static uint64_t legacy_errors;
+
+static void *legacy_consumer(void *data)
+{
+    LegacyActor *actor = (LegacyActor*)data;
+    uint8_t msg[TST_MSG_SIZE];
+
+    for (uint64_t i = 0; i < TST_NUM_MSGS; i++)
+    {
+        legacy_recvmsg(actor, msg, sizeof(msg));
+        if (*(uint64_t*)msg != i)
+            legacy_errors++;
+    }
+    return NULL;
+}
+
+/* Consumers of the XmaActor under test, messages carry a sequence number */
+static uint64_t actor_errors;
+static uint64_t actor_received;
+
+static void *actor_copy_consumer(void *data)
+{
+    XmaActor *actor = (XmaActor*)data;
+    uint8_t msg[TST_MSG_SIZE];
+
+    for (uint64_t i = 0; i < TST_NUM_MSGS; i++)
+    {
+        xma_actor_recvmsg(actor, msg, sizeof(msg));
+        if (*(uint64_t*)msg != i)
+            actor_errors++;
+        actor_received++;
+    }
+    return NULL;
+}
+
+static void *actor_batch_consumer(void *data)
+{
+    XmaActor *actor = (XmaActor*)data;
+    uint64_t expected = 0;
+
+    while (expected < TST_NUM_MSGS)
+    {
+        void *msgs;
+        size_t count = xma_actor_recvmsg_batch(actor, &msgs, 32);
+        for (size_t i = 0; i < count; i++, expected++)
+        {
+            uint8_t *msg = (uint8_t*)msgs + i * actor->msg_q->slot_size;
+            if (*(uint64_t*)msg != expected)
+                actor_errors++;
+        }
+        xma_actor_msg_release(actor, count);
+        actor_received += count;
+    }
+    return NULL;
+}
+
+/* Several producers share one actor, per producer order is kept */
+#define TST_NUM_PRODUCERS  4
+#define TST_PRODUCER_MSGS  100000
+
+static XmaActor *mp_actor;
+
+static void *mp_consumer(void *data)
+{
+    XmaActor *actor = (XmaActor*)data;
+    uint64_t next[TST_NUM_PRODUCERS] = {0};
+
+    for (uint64_t n = 0; n < TST_NUM_PRODUCERS * TST_PRODUCER_MSGS; )
+    {
+        void *msgs;
+        size_t count = xma_actor_recvmsg_batch(actor, &msgs, 32);
+        for (size_t i = 0; i < count; i++, n++)
+        {
+            uint64_t *msg = (uint64_t*)((uint8_t*)msgs + i * actor->msg_q->slot_size);
+            if (msg[0] >= TST_NUM_PRODUCERS || msg[1] != next[msg[0]]++)
+                actor_errors++;
+        }
+        xma_actor_msg_release(actor, count);
+        actor_received += count;
+    }
+    return NULL;
+}
+
+static void *mp_producer(void *data)
+{
+    uint64_t id = (uint64_t)(uintptr_t)data;
+
+    for (uint64_t i = 0; i < TST_PRODUCER_MSGS; i++)
+    {
+        uint64_t *slot = (uint64_t*)xma_actor_msg_reserve(mp_actor);
+        slot[0] = id;
+        slot[1] = i;
+        xma_actor_msg_commit(mp_actor);
+    }
+    return NULL;
+}
+
+int xma_actor_multi_producer_tst()
+{
+    pthread_t tid[TST_NUM_PRODUCERS];
+    int rc;
+
+    actor_errors = 0;
+    actor_received = 0;
+    mp_actor = xma_actor_create(mp_consumer, TST_MSG_SIZE, TST_MSG_ENTRIES);
+    xma_actor_start(mp_actor);
+    for (uint64_t i = 0; i < TST_NUM_PRODUCERS; i++)
+        pthread_create(&tid[i], NULL, mp_producer, (void*)(uintptr_t)i);
+    for (int i = 0; i < TST_NUM_PRODUCERS; i++)
+        pthread_join(tid[i], NULL);
+    xma_thread_join(mp_actor->thread);
+
+    rc = ck_assert_int_eq(actor_errors, 0);
+    rc |= ck_assert_int_eq(actor_received, TST_NUM_PRODUCERS * TST_PRODUCER_MSGS);
+
+    xma_msgq_destroy(mp_actor->msg_q);
+    xma_thread_destroy(mp_actor->thread);
+    free(mp_actor);
+
+    return rc;
+}
+
+int xma_msgq_basic_tst()
+{
+    XmaMsgQ *msgq;
+    uint8_t msg[TST_MSG_SIZE];
+    void *slot;
+    int rc;
+
+    /* entries round up to a power of 2 */
+    msgq = xma_msgq_create(TST_MSG_SIZE, 3);
+    rc = ck_assert(msgq != NULL);
+    rc |= ck_assert_int_eq(msgq->max_msg_entries, 4);
+    rc |= ck_assert(xma_msgq_isempty(msgq));
+
+    for (uint64_t i = 0; i < 4; i++)
+    {
+        *(uint64_t*)msg = i;
+        rc |= ck_assert_int_eq(xma_msgq_enqueue(msgq, msg, sizeof(msg)), 0);
+    }
+    rc |= ck_assert(xma_msgq_isfull(msgq));
+    rc |= ck_assert_int_eq(xma_msgq_enqueue(msgq, msg, sizeof(msg)), XMA_MSGQ_FULL);
+    rc |= ck_assert(xma_msgq_reserve(msgq) == NULL);
+    rc |= ck_assert_int_eq(xma_msgq_enqueue(msgq, msg, TST_MSG_SIZE + 1),
+                           XMA_MSGQ_MSG_TOO_LARGE);
+    rc |= ck_assert_int_eq(xma_msgq_dequeue(msgq, msg, TST_MSG_SIZE - 1),
+                           XMA_MSGQ_MSG_TOO_SMALL);
+
+    rc |= ck_assert_int_eq(xma_msgq_dequeue(msgq, msg, sizeof(msg)), 0);
+    rc |= ck_assert_int_eq(*(uint64_t*)msg, 0);
+
+    /* reserve/commit wraps, peek stops at the end of the ring */
+    slot = xma_msgq_reserve(msgq);
+    rc |= ck_assert(slot == msgq->msg_array);
+    *(uint64_t*)slot = 4;
+    xma_msgq_commit(msgq);
+
+    void *msgs;
+    size_t count = xma_msgq_peek(msgq, &msgs, 8);
+    rc |= ck_assert_int_eq(count, 3);
+    rc |= ck_assert_int_eq(*(uint64_t*)msgs, 1);
+    xma_msgq_release(msgq, count);
+
+    count = xma_msgq_peek(msgq, &msgs, 8);
+    rc |= ck_assert_int_eq(count, 1);
+    rc |= ck_assert_int_eq(*(uint64_t*)msgs, 4);
+    xma_msgq_release(msgq, count);
+
+    rc |= ck_assert(xma_msgq_isempty(msgq));
+    rc |= ck_assert_int_eq(xma_msgq_dequeue(msgq, msg, sizeof(msg)), XMA_MSGQ_EMPTY);
+
+    xma_msgq_destroy(msgq);
+
+    return rc;
+}
+
+double legacy_throughput()
+{
+    LegacyActor actor;
+    pthread_t tid;
+    uint8_t msg[TST_MSG_SIZE];
+    double start;
+
+    memset(&actor, 0, sizeof(actor));
+    actor.msg_size = TST_MSG_SIZE;
+    actor.max_msg_entries = TST_MSG_ENTRIES;
+    actor.msg_array = (uint8_t*)malloc(TST_MSG_SIZE * TST_MSG_ENTRIES);
+    pthread_mutex_init(&actor.lock, NULL);
+    pthread_cond_init(&actor.queued_cond, NULL);
+    pthread_cond_init(&actor.dequeued_cond, NULL);
+
+    start = tst_now_sec();
+    pthread_create(&tid, NULL, legacy_consumer, &actor);
+    memset(msg, 0, sizeof(msg));
+    for (uint64_t i = 0; i < TST_NUM_MSGS; i++)
+    {
+        *(uint64_t*)msg = i;
+        legacy_sendmsg(&actor, msg, sizeof(msg));
+    }
+    pthread_join(tid, NULL);
+
+    free(actor.msg_array);
+    return TST_NUM_MSGS / (tst_now_sec() - start);
+}
+
+double actor_throughput(XmaThreadFunc consumer, bool in_place)
+{
+    XmaActor *actor;
+    uint8_t msg[TST_MSG_SIZE];
+    double start;
+
+    actor_errors = 0;
+    actor_received = 0;
+    actor = xma_actor_create(consumer, TST_MSG_SIZE, TST_MSG_ENTRIES);
+
+    start = tst_now_sec();
+    xma_actor_start(actor);
+    memset(msg, 0, sizeof(msg));
+    for (uint64_t i = 0; i < TST_NUM_MSGS; i++)
+    {
+        if (in_place)
+        {
+            void *slot = xma_actor_msg_reserve(actor);
+            *(uint64_t*)slot = i;
+            xma_actor_msg_commit(actor);
+        }
+        else
+        {
+            *(uint64_t*)msg = i;
+            xma_actor_sendmsg(actor, msg, sizeof(msg));
+        }
+    }
+    xma_thread_join(actor->thread);
+    double rate = TST_NUM_MSGS / (tst_now_sec() - start);
+
+    /* consumer has exited, release the actor without a shutdown message */
+    xma_msgq_destroy(actor->msg_q);
+    xma_thread_destroy(actor->thread);
+    free(actor);
+
+    return rate;
+}
+
+int xma_actor_throughput_tst()
+{
+    double legacy, copy, batch;
+    int rc;
+
+    legacy = legacy_throughput();
+    rc = ck_assert_int_eq(legacy_errors, 0);
+
+    copy = actor_throughput(actor_copy_consumer, false);
+    rc |= ck_assert_int_eq(actor_errors, 0);
+    rc |= ck_assert_int_eq(actor_received, TST_NUM_MSGS);
+
+    batch = actor_throughput(actor_batch_consumer, true);
+    rc |= ck_assert_int_eq(actor_errors, 0);
+    rc |= ck_assert_int_eq(actor_received, TST_NUM_MSGS);
+
+    printf("XmaActor throughput, %d messages of %d bytes, %d entries:\n",
+           TST_NUM_MSGS, TST_MSG_SIZE, TST_MSG_ENTRIES);
+    printf("  mutex/condvar send/recv    : %12.0f msgs/s\n", legacy);
+    printf("  lock-free send/recv        : %12.0f msgs/s (%.1fx)\n",
+           copy, copy / legacy);
+    printf("  lock-free reserve/batch    : %12.0f msgs/s (%.1fx)\n",
+           batch, batch / legacy);
+
+    return rc;
+}
+
+int main()
+{
+    int number_failed = 0;
+    int32_t rc;
+
+    rc = xma_msgq_basic_tst();
+    if (rc != 0) {
+      number_failed++;
+    }
+
+    rc = xma_actor_multi_producer_tst();
+    if (rc != 0) {
+      number_failed++;
+    }
+
+    rc = xma_actor_throughput_tst();
+    if (rc != 0) {
+      number_failed++;
+    }
+
+   if (number_failed == 0) {
+     printf("XMA check_xmaactor test completed successfully\n");
+     return EXIT_SUCCESS;
+    } else {
+     printf("ERROR: XMA check_xmaactor test failed\n");
+     return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,447 @@
+/*
+ * Copyright (C) 2018, Xilinx Inc - All rights reserved
+ * Xilinx SDAccel Media Accelerator API
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdlib.h>
+
+#include <memory.h>
+#include <string>
+#include <iostream>
+#include "xma.h"
+#include "xmaplugin.h"
+#include "lib/xmahw.h"
+#include "lib/xmahw_hal.h"
+#include "lib/xmaapi.h"
+#include "lib/xmares.h"
+
+#define TST_FRAMES         32
+#define TST_DEPTH          4
+#define TST_STAGE_US       2000
+
+int ck_assert_int_eq(int rc1, int rc2) {
+  if (rc1 != rc2) {
+    return -1;
+  } else {
+    return 0;
+  }
+}
+
+int ck_assert(bool result) {
+  if (!result) {
+    return -1;
+  } else {
+    return 0;
+  }
+}
+
+static XmaHwHAL hw_hal;
+
+/* Stage timestamps of each frame, recorded by the stub plugin */
+typedef struct TstTrace
+{
+    double  in_start[TST_FRAMES];
+    double  out_end[TST_FRAMES];
+    int32_t slot[TST_FRAMES];
+    int32_t fail_id;
+    int32_t done_cnt;
+    int32_t in_flight;
+    int32_t max_in_flight;
+    int32_t errors;
+} TstTrace;
+
+static TstTrace trace;
+
+static double tst_now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1.0e9;
+}
+
+static int32_t tst_frame_id(XmaAsyncJob *job)
+{
+    return (int32_t)(intptr_t)job->user_data;
+}
+
+/* Encoder plugin stand-in: every stage takes TST_STAGE_US */
+static int32_t tst_enc_init(XmaEncoderSession *session)
+{
+    return XMA_SUCCESS;
+}
+
+static int32_t tst_enc_send_frame(XmaEncoderSession *session, XmaFrame *frame)
+{
+    usleep(TST_STAGE_US);
+    return XMA_SUCCESS;
+}
+
+static int32_t tst_enc_recv_data(XmaEncoderSession *session,
+                                 XmaDataBuffer *data, int32_t *data_size)
+{
+    *data_size = data->alloc_size;
+    return XMA_SUCCESS;
+}
+
+static int32_t tst_enc_close(XmaEncoderSession *session)
+{
+    return XMA_SUCCESS;
+}
+
+static int32_t tst_stage_xfer_in(XmaSession *session, XmaAsyncJob *job)
+{
+    int32_t id = tst_frame_id(job);
+    int32_t n = __atomic_add_fetch(&trace.in_flight, 1, __ATOMIC_SEQ_CST);
+
+    if (n > trace.max_in_flight)
+        trace.max_in_flight = n;
+    trace.in_start[id] = tst_now_sec();
+    trace.slot[id] = job->slot;
+    usleep(TST_STAGE_US);
+    return XMA_SUCCESS;
+}
+
+static int32_t tst_stage_execute(XmaSession *session, XmaAsyncJob *job)
+{
+    usleep(TST_STAGE_US);
+    /* the failing frame must not reach xfer_out */
+    return tst_frame_id(job) == trace.fail_id ? XMA_ERROR : XMA_SUCCESS;
+}
+
+static int32_t tst_stage_xfer_out(XmaSession *session, XmaAsyncJob *job)
+{
+    XmaDataBuffer *data = (XmaDataBuffer*)job->output;
+
+    usleep(TST_STAGE_US);
+    if (tst_frame_id(job) == trace.fail_id)
+        trace.errors++;
+    job->output_size = data->alloc_size;
+    trace.out_end[tst_frame_id(job)] = tst_now_sec();
+    return XMA_SUCCESS;
+}
+
+static XmaAsyncPlugin tst_enc_async;
+static XmaEncoderPlugin tst_enc_plugin;
+
+static void tst_enc_done(XmaEncoderSession *session, XmaFrame *frame,
+                         XmaDataBuffer *data, int32_t data_size,
+                         int32_t status, void *user_data)
+{
+    int32_t id = (int32_t)(intptr_t)user_data;
+
+    __atomic_sub_fetch(&trace.in_flight, 1, __ATOMIC_SEQ_CST);
+    if (id != trace.done_cnt)
+        trace.errors++;
+    if (id == trace.fail_id && status != XMA_ERROR)
+        trace.errors++;
+    if (id != trace.fail_id &&
+        (status != XMA_SUCCESS || data_size != data->alloc_size))
+        trace.errors++;
+    trace.done_cnt++;
+}
+
+/* Scaler plugin stand-in without async hooks */
+static int32_t tst_scaler_init(XmaScalerSession *session)
+{
+    return XMA_SUCCESS;
+}
+
+static int32_t tst_scaler_send_frame(XmaScalerSession *session,
+                                     XmaFrame *frame)
+{
+    usleep(TST_STAGE_US);
+    return XMA_SUCCESS;
+}
+
+static int32_t tst_scaler_recv_frame_list(XmaScalerSession *session,
+                                          XmaFrame **frame_list)
+{
+    frame_list[0]->frame_props.width = 1280;
+    return XMA_SUCCESS;
+}
+
+static int32_t tst_scaler_close(XmaScalerSession *session)
+{
+    return XMA_SUCCESS;
+}
+
+static XmaScalerPlugin tst_scaler_plugin;
+
+static void tst_scaler_done(XmaScalerSession *session, XmaFrame *frame,
+                            XmaFrame **frame_list, int32_t status,
+                            void *user_data)
+{
+    int32_t id = (int32_t)(intptr_t)user_data;
+
+    if (id != trace.done_cnt || status != XMA_SUCCESS ||
+        frame_list[0]->frame_props.width != 1280)
+        trace.errors++;
+    trace.done_cnt++;
+}
+
+static XmaEncoderSession *tst_enc_session_create(void)
+{
+    XmaEncoderProperties enc_props;
+
+    memset(&enc_props, 0, sizeof(XmaEncoderProperties));
+    enc_props.hwencoder_type = XMA_COPY_ENCODER_TYPE;
+    strncpy(enc_props.hwvendor_string, "Xilinx", (MAX_VENDOR_NAME - 1));
+    return xma_enc_session_create(&enc_props);
+}
+
+int xma_async_enc_overlap_tst()
+{
+    extern XmaSingleton *g_xma_singleton;
+    XmaEncoderSession *sess;
+    XmaFrame frames[TST_FRAMES];
+    XmaDataBuffer data[TST_FRAMES];
+    double start, elapsed, serial;
+    int32_t i, overlaps = 0;
+    int rc = 0;
+
+    /* depth 8 requested, the plugin only has TST_DEPTH buffer sets */
+    g_xma_singleton->encodercfg[0].async = &tst_enc_async;
+    trace.fail_id = 5;
+    sess = tst_enc_session_create();
+    rc |= ck_assert(sess != NULL);
+    if (!sess)
+        return rc;
+    rc |= ck_assert_int_eq(xma_enc_session_async_start(sess, 8, tst_enc_done),
+                           XMA_SUCCESS);
+    rc |= ck_assert_int_eq(xma_enc_session_async_start(sess, 8, tst_enc_done),
+                           XMA_ERROR_INVALID);
+    rc |= ck_assert_int_eq(xma_enc_session_send_frame(sess, &frames[0]),
+                           XMA_ERROR_INVALID);
+
+    memset(frames, 0, sizeof(frames));
+    memset(data, 0, sizeof(data));
+    start = tst_now_sec();
+    for (i = 0; i < TST_FRAMES; i++)
+    {
+        data[i].alloc_size = 100 + i;
+        rc |= ck_assert_int_eq(xma_enc_session_send_frame_async(sess,
+                                   &frames[i], &data[i], (void*)(intptr_t)i),
+                               XMA_SUCCESS);
+    }
+    rc |= ck_assert_int_eq(xma_enc_session_async_flush(sess), XMA_SUCCESS);
+    elapsed = tst_now_sec() - start;
+
+    rc |= ck_assert_int_eq(trace.done_cnt, TST_FRAMES);
+    rc |= ck_assert_int_eq(trace.errors, 0);
+    rc |= ck_assert(trace.max_in_flight <= TST_DEPTH);
+    for (i = 0; i < TST_FRAMES; i++)
+        rc |= ck_assert_int_eq(trace.slot[i], i % TST_DEPTH);
+
+    /* frame i+1 is written to the device before frame i is read back */
+    for (i = 0; i + 1 < TST_FRAMES; i++)
+        if (i != trace.fail_id && trace.in_start[i + 1] < trace.out_end[i])
+            overlaps++;
+    rc |= ck_assert(overlaps >= (TST_FRAMES - 2) / 2);
+    serial = TST_FRAMES * 3 * TST_STAGE_US / 1.0e6;
+    rc |= ck_assert(elapsed < serial * 0.75);
+    printf("%d frames: %.1f ms pipelined, %.1f ms serial, %d overlapped\n",
+           TST_FRAMES, elapsed * 1000, serial * 1000, overlaps);
+
+    rc |= ck_assert_int_eq(xma_enc_session_destroy(sess), XMA_SUCCESS);
+    return rc;
+}
+
+int xma_async_enc_default_tst()
+{
+    XmaEncoderSession *sess;
+    XmaFrame frames[TST_FRAMES];
+    XmaDataBuffer data[TST_FRAMES];
+    int32_t i;
+    int rc = 0;
+
+    /* plugin without stage callbacks: send and recv on the execute stage */
+    trace.fail_id = -1;
+    sess = tst_enc_session_create();
+    rc |= ck_assert(sess != NULL);
+    if (!sess)
+        return rc;
+    rc |= ck_assert_int_eq(xma_enc_session_send_frame_async(sess, &frames[0],
+                               &data[0], NULL),
+                           XMA_ERROR_INVALID);
+    rc |= ck_assert_int_eq(xma_enc_session_async_start(sess, TST_DEPTH,
+                                                       tst_enc_done),
+                           XMA_SUCCESS);
+
+    memset(frames, 0, sizeof(frames));
+    memset(data, 0, sizeof(data));
+    for (i = 0; i < TST_FRAMES; i++)
+    {
+        data[i].alloc_size = 100 + i;
+        rc |= ck_assert_int_eq(xma_enc_session_send_frame_async(sess,
+                                   &frames[i], &data[i], (void*)(intptr_t)i),
+                               XMA_SUCCESS);
+    }
+
+    /* destroy waits for the frames still in flight */
+    rc |= ck_assert_int_eq(xma_enc_session_destroy(sess), XMA_SUCCESS);
+    rc |= ck_assert_int_eq(trace.done_cnt, TST_FRAMES);
+    rc |= ck_assert_int_eq(trace.errors, 0);
+
+    return rc;
+}
+
+int xma_async_scaler_default_tst()
+{
+    XmaScalerProperties scaler_props;
+    XmaScalerSession *sess;
+    XmaFrame frames[TST_FRAMES];
+    XmaFrame outputs[TST_FRAMES];
+    XmaFrame *lists[TST_FRAMES][1];
+    int32_t i;
+    int rc = 0;
+
+    memset(&scaler_props, 0, sizeof(XmaScalerProperties));
+    scaler_props.num_outputs = 1;
+    scaler_props.hwscaler_type = XMA_POLYPHASE_SCALER_TYPE;
+    strncpy(scaler_props.hwvendor_string, "Xilinx", (MAX_VENDOR_NAME - 1));
+    sess = xma_scaler_session_create(&scaler_props);
+    rc |= ck_assert(sess != NULL);
+    if (!sess)
+        return rc;
+    rc |= ck_assert_int_eq(xma_scaler_session_async_start(sess, TST_DEPTH,
+                                                          tst_scaler_done),
+                           XMA_SUCCESS);
+
+    memset(frames, 0, sizeof(frames));
+    memset(outputs, 0, sizeof(outputs));
+    for (i = 0; i < TST_FRAMES; i++)
+    {
+        lists[i][0] = &outputs[i];
+        rc |= ck_assert_int_eq(xma_scaler_session_send_frame_async(sess,
+                                   &frames[i], lists[i], (void*)(intptr_t)i),
+                               XMA_SUCCESS);
+    }
+    rc |= ck_assert_int_eq(xma_scaler_session_async_flush(sess), XMA_SUCCESS);
+    rc |= ck_assert_int_eq(trace.done_cnt, TST_FRAMES);
+    rc |= ck_assert_int_eq(trace.errors, 0);
+    rc |= ck_assert_int_eq(xma_scaler_session_recv_frame_list(sess, lists[0]),
+                           XMA_ERROR_INVALID);
+    rc |= ck_assert_int_eq(xma_scaler_session_destroy(sess), XMA_SUCCESS);
+
+    return rc;
+}
+
+static int tst_setup(void)
+{
+    extern XmaSingleton *g_xma_singleton;
+    char *cfgfile = (char*) "../system_cfg/check_cfg.yaml";
+    int32_t i;
+    int rc = 0;
+
+    memset(&trace, 0, sizeof(trace));
+    g_xma_singleton = (XmaSingleton*)malloc(sizeof(*g_xma_singleton));
+    memset(g_xma_singleton, 0, sizeof(*g_xma_singleton));
+
+    rc |= ck_assert_int_eq(xma_cfg_parse(cfgfile, &g_xma_singleton->systemcfg), 0);
+    rc |= ck_assert_int_eq(xma_logger_init(&g_xma_singleton->logger), 0);
+    g_xma_singleton->logger.log_level = XMA_CRITICAL_LOG;
+
+    /* Ensure no prior test file system pollution remains */
+    unlink(XMA_SHM_FILE);
+    unlink(XMA_SHM_FILE_SIG);
+
+    g_xma_singleton->shm_res_cfg = xma_res_shm_map(&g_xma_singleton->systemcfg);
+    rc |= ck_assert(g_xma_singleton->shm_res_cfg != NULL);
+    xma_res_mark_xma_ready(g_xma_singleton->shm_res_cfg);
+
+    g_xma_singleton->hwcfg.num_devices = 10;
+    for (i = 0; i < 10; i++)
+        g_xma_singleton->hwcfg.devices[i].handle = (XmaHwDevice *)&hw_hal;
+
+    /* Plugin handles follow the order of the kernels in check_cfg.yaml:
+     * encoder 0 Xilinx, scaler 0 Xilinx */
+    g_xma_singleton->encodercfg[0] = tst_enc_plugin;
+    g_xma_singleton->scalercfg[0] = tst_scaler_plugin;
+
+    return rc;
+}
+
+static int tst_teardown_check(void)
+{
+    extern XmaSingleton *g_xma_singleton;
+    struct stat stat_buf;
+    int rc = 0;
+
+    xma_res_shm_unmap(g_xma_singleton->shm_res_cfg);
+    rc |= ck_assert(stat(XMA_SHM_FILE, &stat_buf) < 0);
+    rc |= ck_assert(stat(XMA_SHM_FILE_SIG, &stat_buf) < 0);
+    xma_logger_close(&g_xma_singleton->logger);
+    free(g_xma_singleton);
+    g_xma_singleton = NULL;
+
+    return rc;
+}
+
+int main()
+{
+    int number_failed = 0;
+    int32_t rc;
+
+    tst_enc_async.max_depth = TST_DEPTH;
+    tst_enc_async.xfer_in = tst_stage_xfer_in;
+    tst_enc_async.execute = tst_stage_execute;
+    tst_enc_async.xfer_out = tst_stage_xfer_out;
+
+    tst_enc_plugin.hwencoder_type = XMA_COPY_ENCODER_TYPE;
+    tst_enc_plugin.hwvendor_string = "Xilinx";
+    tst_enc_plugin.init = tst_enc_init;
+    tst_enc_plugin.send_frame = tst_enc_send_frame;
+    tst_enc_plugin.recv_data = tst_enc_recv_data;
+    tst_enc_plugin.close = tst_enc_close;
+
+    tst_scaler_plugin.hwscaler_type = XMA_POLYPHASE_SCALER_TYPE;
+    tst_scaler_plugin.hwvendor_string = "Xilinx";
+    tst_scaler_plugin.init = tst_scaler_init;
+    tst_scaler_plugin.send_frame = tst_scaler_send_frame;
+    tst_scaler_plugin.recv_frame_list = tst_scaler_recv_frame_list;
+    tst_scaler_plugin.close = tst_scaler_close;
+
+    rc = tst_setup();
+    rc |= xma_async_enc_overlap_tst();
+    rc |= tst_teardown_check();
+    if (rc != 0) {
+      number_failed++;
+    }
+
+    rc = tst_setup();
+    rc |= xma_async_enc_default_tst();
+    rc |= tst_teardown_check();
+    if (rc != 0) {
+      number_failed++;
+    }
+
+    rc = tst_setup();
+    rc |= xma_async_scaler_default_tst();
+    rc |= tst_teardown_check();
+    if (rc != 0) {
+      number_failed++;
+    }
+
+   if (number_failed == 0) {
+     printf("XMA check_xmaasync test completed successfully\n");
+     return EXIT_SUCCESS;
+    } else {
+     printf("ERROR: XMA check_xmaasync test failed\n");
+     return EXIT_FAILURE;
+    }
+}
@@ -385,6 +385,144 @@ int xma_frame_free_tst()
     return rc;
 }
 
+int xma_frame_plane_size_tst()
+{
+    XmaFrameProperties frame_props;
+    int rc;
+
+    memset(&frame_props, 0, sizeof(XmaFrameProperties));
+    frame_props.format = XMA_YUV420_FMT_TYPE;
+    frame_props.width = 1920;
+    frame_props.height = 1080;
+    frame_props.bits_per_pixel = 8;
+    rc = ck_assert_int_eq(xma_frame_plane_size_get(&frame_props, 0), 1920 * 1080);
+    rc |= ck_assert_int_eq(xma_frame_plane_size_get(&frame_props, 1), 960 * 540);
+    rc |= ck_assert_int_eq(xma_frame_plane_size_get(&frame_props, 2), 960 * 540);
+    rc |= ck_assert_int_eq(xma_frame_plane_size_get(&frame_props, 3), 0);
+
+    /* odd dimensions round chroma up, 10 bit samples take two bytes */
+    frame_props.width = 1279;
+    frame_props.height = 719;
+    frame_props.bits_per_pixel = 10;
+    rc |= ck_assert_int_eq(xma_frame_plane_size_get(&frame_props, 1), 640 * 360 * 2);
+
+    frame_props.format = XMA_YUV422_FMT_TYPE;
+    frame_props.width = 1280;
+    frame_props.height = 720;
+    frame_props.bits_per_pixel = 8;
+    rc |= ck_assert_int_eq(xma_frame_plane_size_get(&frame_props, 1), 640 * 720);
+
+    frame_props.format = XMA_YUV444_FMT_TYPE;
+    rc |= ck_assert_int_eq(xma_frame_plane_size_get(&frame_props, 2), 1280 * 720);
+
+    frame_props.format = XMA_RGB888_FMT_TYPE;
+    rc |= ck_assert_int_eq(xma_frame_plane_size_get(&frame_props, 0), 1280 * 720 * 3);
+    rc |= ck_assert_int_eq(xma_frame_plane_size_get(&frame_props, 1), 0);
+
+    /* packed RGB with bits per pixel, 8 bits per component */
+    frame_props.bits_per_pixel = 24;
+    rc |= ck_assert_int_eq(xma_frame_plane_size_get(&frame_props, 0), 1280 * 720 * 3);
+    frame_props.bits_per_pixel = 30;
+    rc |= ck_assert_int_eq(xma_frame_plane_size_get(&frame_props, 0), 1280 * 720 * 3 * 2);
+
+    return rc;
+}
+
+int xma_frame_add_ref_tst()
+{
+    XmaFrameProperties frame_props;
+    XmaFrame *frame = NULL;
+    int rc;
+
+    memset(&frame_props, 0, sizeof(XmaFrameProperties));
+    frame_props.format = XMA_YUV420_FMT_TYPE;
+    frame_props.width = 1920;
+    frame_props.height = 1080;
+    frame_props.bits_per_pixel = 8;
+
+    frame = xma_frame_alloc(&frame_props);
+    rc = ck_assert(frame != NULL);
+
+    xma_frame_add_ref(frame);
+    rc |= ck_assert_int_eq(frame->data[0].refcount, 2);
+    rc |= ck_assert_int_eq(frame->data[2].refcount, 2);
+
+    xma_frame_free(frame);
+    rc |= ck_assert_int_eq(frame->data[0].refcount, 1);
+    rc |= ck_assert_int_eq(frame->data[1].refcount, 1);
+
+    xma_frame_free(frame);
+
+    return rc;
+}
+
+static int32_t check_xmabuffer_num_bos = 0;
+
+static int32_t check_xmabuffer_buffer_alloc(XmaHwSession *session, size_t size,
+                                            uint32_t *handle, void **map,
+                                            uint64_t *paddr) {
+    *handle = ++check_xmabuffer_num_bos;
+    *map = malloc(size);
+    *paddr = 0x1000000ULL * *handle;
+    return 0;
+}
+
+static void check_xmabuffer_buffer_free(XmaHwSession *session, uint32_t handle,
+                                        void *map, size_t size) {
+    check_xmabuffer_num_bos--;
+    free(map);
+}
+
+int xma_frame_pool_tst()
+{
+    XmaFrameProperties frame_props;
+    XmaSession session;
+    XmaFramePool *pool;
+    XmaFrame *frame[3];
+    int rc;
+
+    memset(&session, 0, sizeof(XmaSession));
+    memset(&frame_props, 0, sizeof(XmaFrameProperties));
+    frame_props.format = XMA_YUV420_FMT_TYPE;
+    frame_props.width = 1920;
+    frame_props.height = 1080;
+    frame_props.bits_per_pixel = 8;
+
+    pool = xma_frame_pool_create(&session, &frame_props, 2);
+    rc = ck_assert(pool != NULL);
+    rc |= ck_assert_int_eq(check_xmabuffer_num_bos, 6);
+
+    frame[0] = xma_frame_pool_get(pool);
+    frame[1] = xma_frame_pool_get(pool);
+    frame[2] = xma_frame_pool_get(pool);
+    rc |= ck_assert(frame[0] != NULL && frame[1] != NULL);
+    rc |= ck_assert(frame[2] == NULL);
+    rc |= ck_assert_int_eq(frame[0]->data[0].buffer_type, XMA_DEVICE_BUFFER_TYPE);
+    rc |= ck_assert_int_eq(frame[0]->data[1].refcount, 1);
+    rc |= ck_assert(frame[0]->data[2].paddr != 0);
+
+    /* frames in use keep the pool alive */
+    rc |= ck_assert_int_eq(xma_frame_pool_destroy(pool), XMA_ERROR);
+
+    /* last reference returns the frame, buffers are recycled */
+    xma_frame_add_ref(frame[0]);
+    frame[0]->pts = 42;
+    xma_frame_free(frame[0]);
+    rc |= ck_assert(xma_frame_pool_get(pool) == NULL);
+    xma_frame_free(frame[0]);
+    frame[2] = xma_frame_pool_get(pool);
+    rc |= ck_assert(frame[2] == frame[0]);
+    rc |= ck_assert_int_eq(frame[2]->pts, 0);
+    rc |= ck_assert_int_eq(frame[2]->data[0].refcount, 1);
+
+    xma_frame_free(frame[1]);
+    xma_frame_free(frame[2]);
+    rc |= ck_assert_int_eq(xma_frame_pool_destroy(pool), XMA_SUCCESS);
+    rc |= ck_assert_int_eq(check_xmabuffer_num_bos, 0);
+
+    return rc;
+}
+
 static inline int32_t check_xmaapi_probe(XmaHwCfg *hwcfg) {
     return 0;
 }
@@ -411,6 +549,8 @@ int main()
     hw_if.is_compatible = check_xmaapi_is_compatible;
     hw_if.configure = check_xmaapi_hw_configure;
     hw_if.probe = check_xmaapi_probe;
+    hw_if.buffer_alloc = check_xmabuffer_buffer_alloc;
+    hw_if.buffer_free = check_xmabuffer_buffer_free;
 
     xmabuffer_unchecked_setup();
 
@@ -479,6 +619,21 @@ int main()
       number_failed++;
     }
 
+    rc = xma_frame_plane_size_tst();
+    if (rc != 0) {
+      number_failed++;
+    }
+
+    rc = xma_frame_add_ref_tst();
+    if (rc != 0) {
+      number_failed++;
+    }
+
+    rc = xma_frame_pool_tst();
+    if (rc != 0) {
+      number_failed++;
+    }
+
 
    if (number_failed == 0) {
      printf("XMA check_xmabuffer test completed successfully\n");
@@ -15,6 +15,8 @@
  * under the License.
  */
 #include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
 
 #include <memory.h>
 //#include <strings.h>
@@ -24,6 +26,7 @@
 #include "lib/xmahw.h"
 #include "lib/xmahw_private.h"
 #include "lib/xmacfg.h"
+#include "lib/xmacache.h"
 
 int ck_assert_int_eq(int rc1, int rc2) {
   if (rc1 != rc2) {
@@ -194,6 +197,108 @@ int test_error3_config()
     return rc;
 }
 
+static int tst_file_write(const char *name, const char *data, bool append)
+{
+    FILE *fp = fopen(name, append ? "a" : "w");
+
+    if (!fp)
+        return -1;
+    fputs(data, fp);
+    fclose(fp);
+    return 0;
+}
+
+static int tst_file_copy(const char *from, const char *to)
+{
+    char buf[4096];
+    size_t n;
+    FILE *in = fopen(from, "r");
+    FILE *out = fopen(to, "w");
+
+    if (!in || !out)
+        return -1;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+        fwrite(buf, 1, n, out);
+    fclose(in);
+    fclose(out);
+    return 0;
+}
+
+int test_config_cache()
+{
+    char cfgfile[64], xclbin[64], snapshot[64];
+    XmaCfgCache *cache, *warm;
+    XmaXclbinInfo info;
+    XmaSystemCfg systemcfg;
+    FILE *fp;
+    int rc = 0;
+
+    sprintf(cfgfile, "/tmp/check_xmacfg_%d.yaml", getpid());
+    sprintf(xclbin, "/tmp/check_xmacfg_%d.xclbin", getpid());
+    sprintf(snapshot, "/tmp/check_xmacfg_cache_%d", getpid());
+    rc |= tst_file_copy("../system_cfg/simple_cfg.yaml", cfgfile);
+    rc |= tst_file_write(xclbin, "not really an xclbin", false);
+    unlink(snapshot);
+
+    cache = (XmaCfgCache*)calloc(1, sizeof(XmaCfgCache));
+    warm = (XmaCfgCache*)calloc(1, sizeof(XmaCfgCache));
+
+    /* Cold start: no snapshot, parse and record */
+    rc |= ck_assert_int_eq(xma_cfg_cache_load(cache, snapshot, cfgfile), -1);
+    memset(&systemcfg, 0, sizeof(systemcfg));
+    rc |= ck_assert_int_eq(xma_cfg_parse(cfgfile, &systemcfg), 0);
+    xma_cfg_cache_systemcfg_set(cache, &systemcfg);
+    memset(&info, 0, sizeof(info));
+    strcpy((char*)info.ip_layout[0].kernel_name, "scaler_1");
+    info.ip_layout[0].base_addr = 0x1800000;
+    xma_cfg_cache_xclbin_set(cache, xclbin, &info);
+    rc |= ck_assert_int_eq(xma_cfg_cache_store(cache, snapshot), 0);
+
+    /* Warm start: config and IP layout without parsing */
+    rc |= ck_assert_int_eq(xma_cfg_cache_load(warm, snapshot, cfgfile), 0);
+    rc |= ck_assert(memcmp(&warm->systemcfg, &systemcfg,
+                           sizeof(systemcfg)) == 0);
+    memset(&info, 0, sizeof(info));
+    rc |= ck_assert_int_eq(xma_cfg_cache_xclbin_get(warm, xclbin, &info), 0);
+    rc |= ck_assert_str_eq((char*)info.ip_layout[0].kernel_name, "scaler_1");
+    rc |= ck_assert(info.ip_layout[0].base_addr == 0x1800000);
+    rc |= ck_assert_int_eq(xma_cfg_cache_xclbin_get(warm, cfgfile, &info), -1);
+
+    /* A changed xclbin is parsed again */
+    rc |= tst_file_write(xclbin, "rebuilt", true);
+    rc |= ck_assert_int_eq(xma_cfg_cache_xclbin_get(warm, xclbin, &info), -1);
+
+    /* A corrupted snapshot is ignored */
+    fp = fopen(snapshot, "r+");
+    rc |= ck_assert(fp != NULL);
+    if (fp)
+    {
+        fseek(fp, 100, SEEK_SET);
+        fputc('!', fp);
+        fclose(fp);
+    }
+    rc |= ck_assert_int_eq(xma_cfg_cache_load(warm, snapshot, cfgfile), -1);
+    rc |= ck_assert_int_eq(warm->num_xclbins, 0);
+
+    /* Only a changed snapshot is written */
+    rc |= ck_assert_int_eq(xma_cfg_cache_store(cache, snapshot), 0);
+    rc |= ck_assert_int_eq(xma_cfg_cache_load(warm, snapshot, cfgfile), -1);
+    xma_cfg_cache_systemcfg_set(cache, &systemcfg);
+    rc |= ck_assert_int_eq(xma_cfg_cache_store(cache, snapshot), 0);
+    rc |= ck_assert_int_eq(xma_cfg_cache_load(warm, snapshot, cfgfile), 0);
+
+    /* The snapshot of an edited config is ignored */
+    rc |= tst_file_write(cfgfile, "# edited\n", true);
+    rc |= ck_assert_int_eq(xma_cfg_cache_load(warm, snapshot, cfgfile), -1);
+
+    free(warm);
+    free(cache);
+    unlink(snapshot);
+    unlink(xclbin);
+    unlink(cfgfile);
+    return rc;
+}
+
 static inline int32_t check_xmaapi_probe(XmaHwCfg *hwcfg) {
     return 0;
 }
@@ -245,6 +350,11 @@ int main()
       number_failed++;
     }
 
+    rc = test_config_cache();
+    if (rc != 0) {
+      number_failed++;
+    }
+
 
     if (number_failed == 0) {
      printf("XMA check_xmacfg test completed successfully\n");
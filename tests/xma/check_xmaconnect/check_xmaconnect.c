@@ -0,0 +1,526 @@
+/*
+ * Copyright (C) 2018, Xilinx Inc - All rights reserved
+ * Xilinx SDAccel Media Accelerator API
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdlib.h>
+
+#include <memory.h>
+#include <string>
+#include <iostream>
+#include "xma.h"
+#include "xmaplugin.h"
+#include "lib/xmahw.h"
+#include "lib/xmahw_hal.h"
+#include "lib/xmahw_private.h"
+#include "lib/xmaapi.h"
+#include "lib/xmares.h"
+
+#define TST_FRAMES         64
+#define TST_HELD_MAX       MAX_CONNECTION_FRAMES
+
+int ck_assert_int_eq(int rc1, int rc2) {
+  if (rc1 != rc2) {
+    return -1;
+  } else {
+    return 0;
+  }
+}
+
+int ck_assert(bool result) {
+  if (!result) {
+    return -1;
+  } else {
+    return 0;
+  }
+}
+
+static XmaHwHAL hw_hal;
+
+/* What the stub plugins saw */
+typedef struct TstState
+{
+    int32_t   timeout_ms;   /* wait of the scaler for a device frame */
+    int32_t   hold;         /* frames the encoder keeps, like references */
+    XmaFrame *held[TST_HELD_MAX];
+    int32_t   held_cnt;
+    int32_t   dev_frames;   /* received by the encoder in device memory */
+    int32_t   host_frames;  /* received by the encoder in host memory */
+    int32_t   sent_dev;     /* written by the scaler to device frames */
+    int32_t   errors;
+    int32_t   num_bos;
+} TstState;
+
+static TstState tst;
+
+static int32_t tst_buffer_alloc(XmaHwSession *session, size_t size,
+                                uint32_t *handle, void **map,
+                                uint64_t *paddr)
+{
+    static uint32_t next_handle = 0;
+
+    *handle = __atomic_add_fetch(&next_handle, 1, __ATOMIC_RELAXED);
+    *map = malloc(size);
+    *paddr = 0x1000000ULL * *handle;
+    __atomic_add_fetch(&tst.num_bos, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+static void tst_buffer_free(XmaHwSession *session, uint32_t handle,
+                            void *map, size_t size)
+{
+    __atomic_sub_fetch(&tst.num_bos, 1, __ATOMIC_RELAXED);
+    free(map);
+}
+
+/* Scaler stand-in: writes its single output to the device frame of the
+ * connection when there is one, else to the host frame */
+static int32_t tst_scaler_init(XmaScalerSession *session)
+{
+    return XMA_SUCCESS;
+}
+
+static int32_t tst_scaler_send_frame(XmaScalerSession *session,
+                                     XmaFrame *frame)
+{
+    *(uint64_t*)session->base.plugin_data = frame->pts;
+    return XMA_SUCCESS;
+}
+
+static int32_t tst_scaler_recv_frame_list(XmaScalerSession *session,
+                                          XmaFrame **frame_list)
+{
+    uint64_t pts = *(uint64_t*)session->base.plugin_data;
+    XmaFrame *dev;
+
+    frame_list[0]->pts = pts;
+    dev = xma_plg_connect_frame_get(&session->base, 0, tst.timeout_ms);
+    if (dev)
+    {
+        /* the kernel writes the scaled output to device memory */
+        memset(dev->data[0].buffer, (uint8_t)pts, 16);
+        if (xma_plg_connect_frame_send(&session->base, 0, dev,
+                                       frame_list[0]) == XMA_SUCCESS)
+        {
+            __atomic_add_fetch(&tst.sent_dev, 1, __ATOMIC_RELAXED);
+            return XMA_SUCCESS;
+        }
+        xma_frame_free(dev);
+    }
+    memset(frame_list[0]->data[0].buffer, (uint8_t)pts, 16);
+    return XMA_SUCCESS;
+}
+
+static int32_t tst_scaler_close(XmaScalerSession *session)
+{
+    return XMA_SUCCESS;
+}
+
+/* Encoder stand-in: checks where its input is and keeps the last
+ * tst.hold input frames */
+static int32_t tst_enc_init(XmaEncoderSession *session)
+{
+    return XMA_SUCCESS;
+}
+
+static int32_t tst_enc_send_frame(XmaEncoderSession *session, XmaFrame *frame)
+{
+    uint8_t *data = (uint8_t*)frame->data[0].buffer;
+
+    if (data[0] != (uint8_t)frame->pts || data[15] != (uint8_t)frame->pts)
+        tst.errors++;
+    if (!frame->pool)
+    {
+        tst.host_frames++;
+        return XMA_SUCCESS;
+    }
+
+    tst.dev_frames++;
+    if (frame->data[0].buffer_type != XMA_DEVICE_BUFFER_TYPE)
+        tst.errors++;
+    if (tst.hold > 0)
+    {
+        if (tst.held_cnt == tst.hold)
+        {
+            xma_frame_free(tst.held[0]);
+            memmove(&tst.held[0], &tst.held[1],
+                    (tst.hold - 1) * sizeof(XmaFrame*));
+            tst.held_cnt--;
+        }
+        xma_frame_add_ref(frame);
+        tst.held[tst.held_cnt++] = frame;
+    }
+    return XMA_SUCCESS;
+}
+
+static int32_t tst_enc_recv_data(XmaEncoderSession *session,
+                                 XmaDataBuffer *data, int32_t *data_size)
+{
+    *data_size = 0;
+    return XMA_SUCCESS;
+}
+
+static void tst_enc_release_held(void)
+{
+    while (tst.held_cnt > 0)
+        xma_frame_free(tst.held[--tst.held_cnt]);
+}
+
+static int32_t tst_enc_close(XmaEncoderSession *session)
+{
+    tst_enc_release_held();
+    return XMA_SUCCESS;
+}
+
+static XmaScalerPlugin tst_scaler_plugin;
+static XmaEncoderPlugin tst_enc_plugin;
+
+static void tst_frame_props_set(XmaFrameProperties *props)
+{
+    props->format = XMA_YUV420_FMT_TYPE;
+    props->width = 1280;
+    props->height = 720;
+    props->bits_per_pixel = 8;
+}
+
+static XmaScalerSession *tst_scaler_create(void)
+{
+    XmaScalerProperties scaler_props;
+
+    memset(&scaler_props, 0, sizeof(XmaScalerProperties));
+    scaler_props.hwscaler_type = XMA_POLYPHASE_SCALER_TYPE;
+    strncpy(scaler_props.hwvendor_string, "Xilinx", (MAX_VENDOR_NAME - 1));
+    scaler_props.num_outputs = 1;
+    scaler_props.max_dest_cnt = 1;
+    scaler_props.input.format = XMA_YUV420_FMT_TYPE;
+    scaler_props.input.bits_per_pixel = 8;
+    scaler_props.input.width = 1920;
+    scaler_props.input.height = 1080;
+    scaler_props.output[0].format = XMA_YUV420_FMT_TYPE;
+    scaler_props.output[0].bits_per_pixel = 8;
+    scaler_props.output[0].width = 1280;
+    scaler_props.output[0].height = 720;
+    return xma_scaler_session_create(&scaler_props);
+}
+
+static XmaEncoderSession *tst_enc_create(void)
+{
+    XmaEncoderProperties enc_props;
+
+    memset(&enc_props, 0, sizeof(XmaEncoderProperties));
+    enc_props.hwencoder_type = XMA_COPY_ENCODER_TYPE;
+    strncpy(enc_props.hwvendor_string, "ACME", (MAX_VENDOR_NAME - 1));
+    enc_props.format = XMA_YUV420_FMT_TYPE;
+    enc_props.bits_per_pixel = 8;
+    enc_props.width = 1280;
+    enc_props.height = 720;
+    return xma_enc_session_create(&enc_props);
+}
+
+/* One frame through scaler and encoder; returns the output frame
+ * without handing it to the encoder when enc is NULL */
+static XmaFrame *tst_scale(XmaScalerSession *sc, uint64_t pts, int *rc)
+{
+    XmaFrameProperties props;
+    XmaFrame input;
+    XmaFrame *out;
+
+    memset(&input, 0, sizeof(XmaFrame));
+    input.pts = pts;
+    tst_frame_props_set(&props);
+    out = xma_frame_alloc(&props);
+    *rc |= ck_assert_int_eq(xma_scaler_session_send_frame(sc, &input),
+                            XMA_SUCCESS);
+    *rc |= ck_assert_int_eq(xma_scaler_session_recv_frame_list(sc, &out),
+                            XMA_SUCCESS);
+    return out;
+}
+
+static void tst_encode(XmaEncoderSession *enc, XmaFrame *frame, int *rc)
+{
+    *rc |= ck_assert_int_eq(xma_enc_session_send_frame(enc, frame),
+                            XMA_SUCCESS);
+    xma_frame_free(frame);
+}
+
+int xma_connect_chain_tst()
+{
+    XmaScalerSession *sc;
+    XmaEncoderSession *enc;
+    int32_t i;
+    int rc = 0;
+
+    sc = tst_scaler_create();
+    enc = tst_enc_create();
+    rc |= ck_assert(sc != NULL && enc != NULL);
+    if (!sc || !enc)
+        return rc;
+    rc |= ck_assert(sc->conn_send_handles[0] >= 0);
+    rc |= ck_assert_int_eq(enc->conn_recv_handle, sc->conn_send_handles[0]);
+
+    /* the encoder keeps two frames, device buffers are recycled */
+    tst.timeout_ms = -1;
+    tst.hold = 2;
+    for (i = 0; i < TST_FRAMES; i++)
+        tst_encode(enc, tst_scale(sc, i, &rc), &rc);
+
+    rc |= ck_assert_int_eq(tst.dev_frames, TST_FRAMES);
+    rc |= ck_assert_int_eq(tst.host_frames, 0);
+    rc |= ck_assert_int_eq(tst.errors, 0);
+    rc |= ck_assert_int_eq(tst.num_bos, MAX_CONNECTION_FRAMES * 3);
+
+    rc |= ck_assert_int_eq(xma_enc_session_destroy(enc), XMA_SUCCESS);
+    rc |= ck_assert_int_eq(xma_scaler_session_destroy(sc), XMA_SUCCESS);
+    rc |= ck_assert_int_eq(tst.num_bos, 0);
+
+    return rc;
+}
+
+int xma_connect_backpressure_tst()
+{
+    XmaScalerSession *sc;
+    XmaEncoderSession *enc;
+    XmaFrame *frame;
+    int32_t i;
+    int rc = 0;
+
+    sc = tst_scaler_create();
+    enc = tst_enc_create();
+    rc |= ck_assert(sc != NULL && enc != NULL);
+    if (!sc || !enc)
+        return rc;
+
+    /* the encoder holds every device frame: once they are all in use
+     * the scaler gives up waiting and falls back to host memory */
+    tst.timeout_ms = 20;
+    tst.hold = MAX_CONNECTION_FRAMES;
+    for (i = 0; i < MAX_CONNECTION_FRAMES + 2; i++)
+        tst_encode(enc, tst_scale(sc, i, &rc), &rc);
+    rc |= ck_assert_int_eq(tst.dev_frames, MAX_CONNECTION_FRAMES);
+    rc |= ck_assert_int_eq(tst.host_frames, 2);
+
+    /* released frames are used again */
+    tst_enc_release_held();
+    tst.hold = 0;
+    tst_encode(enc, tst_scale(sc, i, &rc), &rc);
+    rc |= ck_assert_int_eq(tst.dev_frames, MAX_CONNECTION_FRAMES + 1);
+
+    /* frames still queued when the receiver goes away are recycled and
+     * the sender writes to host memory from then on */
+    for (i = 0; i < 3; i++)
+        xma_frame_free(tst_scale(sc, 100 + i, &rc));
+    rc |= ck_assert_int_eq(xma_enc_session_destroy(enc), XMA_SUCCESS);
+    frame = tst_scale(sc, 200, &rc);
+    rc |= ck_assert_int_eq(frame->data[0].buffer_type, XMA_HOST_BUFFER_TYPE);
+    xma_frame_free(frame);
+    rc |= ck_assert_int_eq(tst.sent_dev, MAX_CONNECTION_FRAMES + 1 + 3);
+    rc |= ck_assert_int_eq(tst.errors, 0);
+
+    rc |= ck_assert_int_eq(xma_scaler_session_destroy(sc), XMA_SUCCESS);
+    rc |= ck_assert_int_eq(tst.num_bos, 0);
+
+    return rc;
+}
+
+/* Frames on their way from the scaler thread to the encoder thread */
+typedef struct TstPipe
+{
+    XmaFrame        *frames[TST_FRAMES];
+    int32_t          head;
+    int32_t          tail;
+    int32_t          max_depth;
+    pthread_mutex_t  lock;
+    pthread_cond_t   cond;
+    XmaScalerSession *sc;
+    int              rc;
+} TstPipe;
+
+static void *tst_scaler_thread(void *data)
+{
+    TstPipe *pipe = (TstPipe*)data;
+    int32_t i;
+
+    for (i = 0; i < TST_FRAMES; i++)
+    {
+        XmaFrame *frame = tst_scale(pipe->sc, i, &pipe->rc);
+
+        pthread_mutex_lock(&pipe->lock);
+        pipe->frames[pipe->tail++] = frame;
+        if (pipe->tail - pipe->head > pipe->max_depth)
+            pipe->max_depth = pipe->tail - pipe->head;
+        pthread_cond_signal(&pipe->cond);
+        pthread_mutex_unlock(&pipe->lock);
+    }
+    return NULL;
+}
+
+int xma_connect_threads_tst()
+{
+    XmaEncoderSession *enc;
+    pthread_t thread;
+    TstPipe pipe;
+    int32_t i;
+    int rc = 0;
+
+    memset(&pipe, 0, sizeof(TstPipe));
+    pthread_mutex_init(&pipe.lock, NULL);
+    pthread_cond_init(&pipe.cond, NULL);
+    pipe.sc = tst_scaler_create();
+    enc = tst_enc_create();
+    rc |= ck_assert(pipe.sc != NULL && enc != NULL);
+    if (!pipe.sc || !enc)
+        return rc;
+
+    /* a slow encoder throttles the scaler to the frames of the pool */
+    tst.timeout_ms = -1;
+    tst.hold = 2;
+    pthread_create(&thread, NULL, tst_scaler_thread, &pipe);
+    for (i = 0; i < TST_FRAMES; i++)
+    {
+        XmaFrame *frame;
+
+        pthread_mutex_lock(&pipe.lock);
+        while (pipe.head == pipe.tail)
+            pthread_cond_wait(&pipe.cond, &pipe.lock);
+        frame = pipe.frames[pipe.head++];
+        pthread_mutex_unlock(&pipe.lock);
+        usleep(500);
+        tst_encode(enc, frame, &rc);
+    }
+    pthread_join(thread, NULL);
+    rc |= pipe.rc;
+
+    rc |= ck_assert_int_eq(tst.dev_frames, TST_FRAMES);
+    rc |= ck_assert_int_eq(tst.host_frames, 0);
+    rc |= ck_assert_int_eq(tst.errors, 0);
+    rc |= ck_assert(pipe.max_depth <= MAX_CONNECTION_FRAMES);
+
+    rc |= ck_assert_int_eq(xma_scaler_session_destroy(pipe.sc), XMA_SUCCESS);
+    rc |= ck_assert_int_eq(xma_enc_session_destroy(enc), XMA_SUCCESS);
+    rc |= ck_assert_int_eq(tst.num_bos, 0);
+    pthread_cond_destroy(&pipe.cond);
+    pthread_mutex_destroy(&pipe.lock);
+
+    return rc;
+}
+
+static int tst_setup(void)
+{
+    extern XmaSingleton *g_xma_singleton;
+    char *cfgfile = (char*) "../system_cfg/check_cfg.yaml";
+    int32_t i;
+    int rc = 0;
+
+    memset(&tst, 0, sizeof(tst));
+    g_xma_singleton = (XmaSingleton*)malloc(sizeof(*g_xma_singleton));
+    memset(g_xma_singleton, 0, sizeof(*g_xma_singleton));
+
+    rc |= ck_assert_int_eq(xma_cfg_parse(cfgfile, &g_xma_singleton->systemcfg), 0);
+    rc |= ck_assert_int_eq(xma_logger_init(&g_xma_singleton->logger), 0);
+    g_xma_singleton->logger.log_level = XMA_CRITICAL_LOG;
+
+    /* Ensure no prior test file system pollution remains */
+    unlink(XMA_SHM_FILE);
+    unlink(XMA_SHM_FILE_SIG);
+
+    g_xma_singleton->shm_res_cfg = xma_res_shm_map(&g_xma_singleton->systemcfg);
+    rc |= ck_assert(g_xma_singleton->shm_res_cfg != NULL);
+    xma_res_mark_xma_ready(g_xma_singleton->shm_res_cfg);
+
+    g_xma_singleton->hwcfg.num_devices = 10;
+    for (i = 0; i < 10; i++)
+        g_xma_singleton->hwcfg.devices[i].handle = (XmaHwDevice *)&hw_hal;
+
+    /* Plugin handles follow the order of the kernels in check_cfg.yaml:
+     * scaler 0 Xilinx and encoder 1 ACME share the zerocopy image */
+    g_xma_singleton->scalercfg[0] = tst_scaler_plugin;
+    g_xma_singleton->encodercfg[1] = tst_enc_plugin;
+
+    return rc;
+}
+
+static int tst_teardown_check(void)
+{
+    extern XmaSingleton *g_xma_singleton;
+    struct stat stat_buf;
+    int rc = 0;
+
+    xma_res_shm_unmap(g_xma_singleton->shm_res_cfg);
+    rc |= ck_assert(stat(XMA_SHM_FILE, &stat_buf) < 0);
+    rc |= ck_assert(stat(XMA_SHM_FILE_SIG, &stat_buf) < 0);
+    xma_logger_close(&g_xma_singleton->logger);
+    free(g_xma_singleton);
+    g_xma_singleton = NULL;
+
+    return rc;
+}
+
+int main()
+{
+    int number_failed = 0;
+    int32_t rc;
+    extern XmaHwInterface hw_if;
+
+    hw_if.buffer_alloc = tst_buffer_alloc;
+    hw_if.buffer_free = tst_buffer_free;
+    hw_hal.dev_handle = (void*)"bogus 0";
+
+    tst_scaler_plugin.hwscaler_type = XMA_POLYPHASE_SCALER_TYPE;
+    tst_scaler_plugin.hwvendor_string = "Xilinx";
+    tst_scaler_plugin.plugin_data_size = sizeof(uint64_t);
+    tst_scaler_plugin.init = tst_scaler_init;
+    tst_scaler_plugin.send_frame = tst_scaler_send_frame;
+    tst_scaler_plugin.recv_frame_list = tst_scaler_recv_frame_list;
+    tst_scaler_plugin.close = tst_scaler_close;
+
+    tst_enc_plugin.hwencoder_type = XMA_COPY_ENCODER_TYPE;
+    tst_enc_plugin.hwvendor_string = "ACME";
+    tst_enc_plugin.init = tst_enc_init;
+    tst_enc_plugin.send_frame = tst_enc_send_frame;
+    tst_enc_plugin.recv_data = tst_enc_recv_data;
+    tst_enc_plugin.close = tst_enc_close;
+
+    rc = tst_setup();
+    rc |= xma_connect_chain_tst();
+    rc |= tst_teardown_check();
+    if (rc != 0) {
+      number_failed++;
+    }
+
+    rc = tst_setup();
+    rc |= xma_connect_backpressure_tst();
+    rc |= tst_teardown_check();
+    if (rc != 0) {
+      number_failed++;
+    }
+
+    rc = tst_setup();
+    rc |= xma_connect_threads_tst();
+    rc |= tst_teardown_check();
+    if (rc != 0) {
+      number_failed++;
+    }
+
+   if (number_failed == 0) {
+     printf("XMA check_xmaconnect test completed successfully\n");
+     return EXIT_SUCCESS;
+    } else {
+     printf("ERROR: XMA check_xmaconnect test failed\n");
+     return EXIT_FAILURE;
+    }
+}
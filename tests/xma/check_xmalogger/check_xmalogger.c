@@ -0,0 +1,258 @@
+/*
+ * Copyright (C) 2018, Xilinx Inc - All rights reserved
+ * Xilinx SDAccel Media Accelerator API
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <memory.h>
+#include <string>
+#include <iostream>
+#include "lib/xmaapi.h"
+#include "lib/xmalogger.h"
+#include "app/xmalogger.h"
+
+#define TST_MOD            "check_xmalogger"
+#define TST_LOG_FILE       "/tmp/check_xmalogger.log"
+#define TST_NUM_THREADS    4
+#define TST_NUM_MSGS       100
+#define TST_BENCH_MSGS     200000
+
+extern XmaSingleton *g_xma_singleton;
+
+int ck_assert_int_eq(int rc1, int rc2) {
+  if (rc1 != rc2) {
+    return -1;
+  } else {
+    return 0;
+  }
+}
+
+int ck_assert(bool result) {
+  if (!result) {
+    return -1;
+  } else {
+    return 0;
+  }
+}
+
+static double tst_now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1.0e9;
+}
+
+static int tst_logger_open(int32_t level)
+{
+    unlink(TST_LOG_FILE);
+    if (!g_xma_singleton)
+        g_xma_singleton = (XmaSingleton*)calloc(1, sizeof(XmaSingleton));
+    memset(&g_xma_singleton->logger, 0, sizeof(g_xma_singleton->logger));
+    g_xma_singleton->systemcfg.logger_initialized = true;
+    strcpy(g_xma_singleton->systemcfg.logfile, TST_LOG_FILE);
+    g_xma_singleton->systemcfg.loglevel = level;
+    return xma_logger_init(&g_xma_singleton->logger);
+}
+
+/* Close the logger (drains all queues) and read back the log file */
+static std::string tst_logger_close(void)
+{
+    std::string log;
+    char        buf[4096];
+    size_t      n;
+
+    xma_logger_close(&g_xma_singleton->logger);
+    FILE *fp = fopen(TST_LOG_FILE, "r");
+    if (!fp)
+        return log;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+        log.append(buf, n);
+    fclose(fp);
+    unlink(TST_LOG_FILE);
+    return log;
+}
+
+static size_t tst_count(const std::string &log, const char *str)
+{
+    size_t count = 0;
+    for (size_t pos = log.find(str); pos != std::string::npos;
+         pos = log.find(str, pos + 1))
+        count++;
+    return count;
+}
+
+int xma_logger_format_tst(void)
+{
+    int rc = 0;
+    char name[16];
+
+    rc |= ck_assert_int_eq(tst_logger_open(XMA_DEBUG_LOG), 0);
+
+    /* String arguments are copied, the buffer may change after the call */
+    strcpy(name, "stream0");
+    xma_logmsg(XMA_INFO_LOG, TST_MOD, "int %d %5u %-3x| long %ld %lld %zu\n",
+               -7, 42u, 0xab, -123456789012L, 1LL << 40, (size_t)99);
+    xma_logmsg(XMA_INFO_LOG, TST_MOD, "str %s %.3s %*d %c %.2f %%\n",
+               name, "abcdef", 4, 12, 'z', 3.14159);
+    xma_logmsg(XMA_INFO_LOG, TST_MOD, "null %s\n", (char*)NULL);
+    strcpy(name, "overwritten");
+
+    /* Not deferred: formatted by the caller */
+    xma_logmsg(XMA_INFO_LOG, TST_MOD, "wide %ls\n", L"w");
+
+    /* Filtered by level */
+    g_xma_singleton->logger.log_level = XMA_INFO_LOG;
+    xma_logmsg(XMA_DEBUG_LOG, TST_MOD, "debug should not appear\n");
+
+    std::string log = tst_logger_close();
+    rc |= ck_assert(log.find(TST_MOD " int -7    42 ab | long -123456789012 1099511627776 99\n") != std::string::npos);
+    rc |= ck_assert(log.find("str stream0 abc   12 z 3.14 %\n") != std::string::npos);
+    rc |= ck_assert(log.find("null (null)\n") != std::string::npos);
+    rc |= ck_assert(log.find("wide w\n") != std::string::npos);
+    rc |= ck_assert(log.find("debug should not appear") == std::string::npos);
+    rc |= ck_assert(log.find("overwritten") == std::string::npos);
+
+    if (rc != 0)
+        printf("%s failed:\n%s", __func__, log.c_str());
+    return rc;
+}
+
+int xma_logger_rate_limit_tst(void)
+{
+    int rc = 0;
+
+    rc |= ck_assert_int_eq(tst_logger_open(XMA_DEBUG_LOG), 0);
+    xma_logger_rate_limit_set(10);
+
+    /* One call site: at most 10 messages per second get through */
+    for (int i = 0; i < 1000; i++)
+        xma_logmsg(XMA_DEBUG_LOG, TST_MOD, "limited %d\n", i);
+    /* Other call sites are not affected */
+    xma_logmsg(XMA_DEBUG_LOG, TST_MOD, "other site\n");
+
+    std::string log = tst_logger_close();
+    size_t count = tst_count(log, "limited ");
+    rc |= ck_assert(count >= 10 && count <= 20);
+    rc |= ck_assert(log.find("other site\n") != std::string::npos);
+
+    xma_logger_rate_limit_set(0);
+    if (rc != 0)
+        printf("%s failed: %zu messages\n", __func__, count);
+    return rc;
+}
+
+static void *tst_log_thread(void *data)
+{
+    long id = (long)data;
+
+    for (int i = 0; i < TST_NUM_MSGS; i++)
+        xma_logmsg(XMA_ERROR_LOG, TST_MOD, "thread %ld msg %d\n", id, i);
+    return NULL;
+}
+
+int xma_logger_multi_thread_tst(void)
+{
+    int rc = 0;
+    pthread_t threads[TST_NUM_THREADS];
+
+    rc |= ck_assert_int_eq(tst_logger_open(XMA_ERROR_LOG), 0);
+    for (long i = 0; i < TST_NUM_THREADS; i++)
+        pthread_create(&threads[i], NULL, tst_log_thread, (void*)i);
+    for (int i = 0; i < TST_NUM_THREADS; i++)
+        pthread_join(threads[i], NULL);
+
+    /* Error messages are never dropped; per thread order is kept */
+    std::string log = tst_logger_close();
+    rc |= ck_assert_int_eq(tst_count(log, " msg "), TST_NUM_THREADS * TST_NUM_MSGS);
+    for (long i = 0; i < TST_NUM_THREADS; i++)
+    {
+        size_t last = 0;
+        for (int j = 0; j < TST_NUM_MSGS; j++)
+        {
+            char line[64];
+            snprintf(line, sizeof(line), "thread %ld msg %d\n", i, j);
+            size_t pos = log.find(line);
+            rc |= ck_assert(pos != std::string::npos && pos >= last);
+            last = (pos == std::string::npos) ? last : pos;
+        }
+    }
+
+    return rc;
+}
+
+/* Time spent in the caller for debug messages, filtered out and deferred */
+int xma_logger_latency_tst(void)
+{
+    int rc = 0;
+    double start;
+
+    rc |= ck_assert_int_eq(tst_logger_open(XMA_INFO_LOG), 0);
+    start = tst_now_sec();
+    for (int i = 0; i < TST_BENCH_MSGS; i++)
+        xma_logmsg(XMA_DEBUG_LOG, TST_MOD, "frame %d pts %ld\n", i, (long)i * 3000);
+    double filtered = tst_now_sec() - start;
+    tst_logger_close();
+
+    rc |= ck_assert_int_eq(tst_logger_open(XMA_DEBUG_LOG), 0);
+    start = tst_now_sec();
+    for (int i = 0; i < TST_BENCH_MSGS; i++)
+        xma_logmsg(XMA_DEBUG_LOG, TST_MOD, "frame %d pts %ld\n", i, (long)i * 3000);
+    double deferred = tst_now_sec() - start;
+    uint64_t dropped = g_xma_singleton->logger.dropped;
+    tst_logger_close();
+
+    printf("xmalogger: filtered %.1f ns/msg, deferred %.1f ns/msg (%lu dropped)\n",
+           filtered * 1e9 / TST_BENCH_MSGS, deferred * 1e9 / TST_BENCH_MSGS,
+           (unsigned long)dropped);
+    return rc;
+}
+
+int main()
+{
+    int number_failed = 0;
+    int32_t rc;
+
+    rc = xma_logger_format_tst();
+    if (rc != 0) {
+      number_failed++;
+    }
+
+    rc = xma_logger_rate_limit_tst();
+    if (rc != 0) {
+      number_failed++;
+    }
+
+    rc = xma_logger_multi_thread_tst();
+    if (rc != 0) {
+      number_failed++;
+    }
+
+    rc = xma_logger_latency_tst();
+    if (rc != 0) {
+      number_failed++;
+    }
+
+   if (number_failed == 0) {
+     printf("XMA check_xmalogger test completed successfully\n");
+     return EXIT_SUCCESS;
+    } else {
+     printf("ERROR: XMA check_xmalogger test failed\n");
+     return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,591 @@
+/*
+ * Copyright (C) 2018, Xilinx Inc - All rights reserved
+ * Xilinx SDAccel Media Accelerator API
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdlib.h>
+
+#include <memory.h>
+#include <string>
+#include <iostream>
+#include "xma.h"
+#include "lib/xmaapi.h"
+#include "lib/xmares.h"
+#include "lib/xmastats.h"
+
+#define TST_NUM_PROCS      8
+#define TST_ITERATIONS     500
+#define TST_SCALER_CHANS   4
+
+int ck_assert_int_eq(int rc1, int rc2) {
+  if (rc1 != rc2) {
+    return -1;
+  } else {
+    return 0;
+  }
+}
+
+int ck_assert(bool result) {
+  if (!result) {
+    return -1;
+  } else {
+    return 0;
+  }
+}
+
+/* Counters shared by all processes of the stress test */
+typedef struct TstShared
+{
+    int32_t holders[MAX_XILINX_DEVICES][MAX_KERNEL_CONFIGS];
+    int32_t sessions;
+    int32_t busy;
+    int32_t errors;
+} TstShared;
+
+static double tst_now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1.0e9;
+}
+
+/* Scaler plugin stand-in supporting a few channels per kernel */
+static int32_t tst_scaler_alloc_chan(XmaSession *pending_sess,
+                                     XmaSession **curr_sess,
+                                     uint32_t sess_cnt)
+{
+    if (sess_cnt >= TST_SCALER_CHANS)
+        return XMA_ERROR_NO_KERNEL;
+    pending_sess->chan_id = sess_cnt;
+    return XMA_SUCCESS;
+}
+
+/* Load the next scaler session adds, see tst_scaler_get_load() */
+static uint32_t tst_scaler_load;
+
+static int32_t tst_scaler_get_load(XmaSession *pending_sess, uint32_t *load)
+{
+    *load = tst_scaler_load;
+    return XMA_SUCCESS;
+}
+
+static int tst_setup(void)
+{
+    extern XmaSingleton *g_xma_singleton;
+    char *cfgfile = (char*) "../system_cfg/check_cfg.yaml";
+    int rc = 0;
+
+    g_xma_singleton = (XmaSingleton*)malloc(sizeof(*g_xma_singleton));
+    memset(g_xma_singleton, 0, sizeof(*g_xma_singleton));
+
+    rc |= ck_assert_int_eq(xma_cfg_parse(cfgfile, &g_xma_singleton->systemcfg), 0);
+    rc |= ck_assert_int_eq(xma_logger_init(&g_xma_singleton->logger), 0);
+    /* busy kernels are expected in the stress test, keep output short */
+    g_xma_singleton->logger.log_level = XMA_CRITICAL_LOG;
+
+    /* Ensure no prior test file system pollution remains */
+    unlink(XMA_SHM_FILE);
+    unlink(XMA_SHM_FILE_SIG);
+
+    g_xma_singleton->shm_res_cfg = xma_res_shm_map(&g_xma_singleton->systemcfg);
+    rc |= ck_assert(g_xma_singleton->shm_res_cfg != NULL);
+    xma_res_mark_xma_ready(g_xma_singleton->shm_res_cfg);
+
+    /* Plugin handles follow the order of the kernels in check_cfg.yaml:
+     * encoder 0 Xilinx, encoder 1 ACME, scaler 0 Xilinx */
+    g_xma_singleton->encodercfg[0].hwencoder_type = XMA_COPY_ENCODER_TYPE;
+    g_xma_singleton->encodercfg[1].hwencoder_type = XMA_COPY_ENCODER_TYPE;
+    g_xma_singleton->scalercfg[0].hwscaler_type = XMA_POLYPHASE_SCALER_TYPE;
+    g_xma_singleton->scalercfg[0].alloc_chan = tst_scaler_alloc_chan;
+
+    return rc;
+}
+
+static int tst_teardown_check(void)
+{
+    extern XmaSingleton *g_xma_singleton;
+    struct stat stat_buf;
+    int rc = 0;
+
+    xma_res_shm_unmap(g_xma_singleton->shm_res_cfg);
+    rc |= ck_assert(stat(XMA_SHM_FILE, &stat_buf) < 0);
+    rc |= ck_assert(stat(XMA_SHM_FILE_SIG, &stat_buf) < 0);
+    xma_logger_close(&g_xma_singleton->logger);
+    free(g_xma_singleton);
+    g_xma_singleton = NULL;
+
+    return rc;
+}
+
+int xma_res_kernel_index_tst(void)
+{
+    extern XmaSingleton *g_xma_singleton;
+    XmaResources shm = g_xma_singleton->shm_res_cfg;
+    XmaSession sess[6];
+    int rc = 0;
+    int i;
+
+    memset(sess, 0, sizeof(sess));
+    for (i = 0; i < 6; i++)
+        sess[i].chan_id = -1;
+
+    /* Xilinx encoders: 2 instances on devices 0 and 1 */
+    for (i = 0; i < 4; i++) {
+        rc |= ck_assert_int_eq(xma_res_alloc_enc_kernel(shm, XMA_COPY_ENCODER_TYPE,
+                                                        "Xilinx", &sess[i], false), 0);
+        rc |= ck_assert_int_eq(xma_res_dev_handle_get((XmaKernelRes*)sess[i].kern_res),
+                               i / 2);
+        rc |= ck_assert_int_eq(xma_res_kern_handle_get((XmaKernelRes*)sess[i].kern_res),
+                               i % 2);
+    }
+    rc |= ck_assert_int_eq(xma_res_alloc_enc_kernel(shm, XMA_COPY_ENCODER_TYPE,
+                                                    "Xilinx", &sess[4], false),
+                           XMA_ERROR_NO_KERNEL);
+
+    /* ACME encoders live on devices 2 and 3 after the scalers */
+    rc |= ck_assert_int_eq(xma_res_alloc_enc_kernel(shm, XMA_COPY_ENCODER_TYPE,
+                                                    "ACME", &sess[5], false), 0);
+    rc |= ck_assert_int_eq(xma_res_dev_handle_get((XmaKernelRes*)sess[5].kern_res), 2);
+    rc |= ck_assert_int_eq(xma_res_kern_handle_get((XmaKernelRes*)sess[5].kern_res), 2);
+    rc |= ck_assert_int_eq(xma_res_plugin_handle_get((XmaKernelRes*)sess[5].kern_res), 1);
+
+    /* Unknown vendor and type/vendor pair */
+    rc |= ck_assert_int_eq(xma_res_alloc_enc_kernel(shm, XMA_COPY_ENCODER_TYPE,
+                                                    "Nobody", &sess[4], false),
+                           XMA_ERROR_NO_KERNEL);
+    rc |= ck_assert_int_eq(xma_res_alloc_scal_kernel(shm, XMA_POLYPHASE_SCALER_TYPE,
+                                                     "ACME", &sess[4], false),
+                           XMA_ERROR_NO_KERNEL);
+
+    /* A freed instance is found again */
+    rc |= ck_assert_int_eq(xma_res_free_kernel(shm, sess[1].kern_res), 0);
+    rc |= ck_assert_int_eq(xma_res_alloc_enc_kernel(shm, XMA_COPY_ENCODER_TYPE,
+                                                    "Xilinx", &sess[4], false), 0);
+    rc |= ck_assert_int_eq(xma_res_dev_handle_get((XmaKernelRes*)sess[4].kern_res), 0);
+    rc |= ck_assert_int_eq(xma_res_kern_handle_get((XmaKernelRes*)sess[4].kern_res), 1);
+
+    for (i = 0; i < 6; i++)
+        if (i != 1)
+            rc |= ck_assert_int_eq(xma_res_free_kernel(shm, sess[i].kern_res), 0);
+
+    return rc;
+}
+
+int xma_res_kernel_chan_tst(void)
+{
+    extern XmaSingleton *g_xma_singleton;
+    XmaResources shm = g_xma_singleton->shm_res_cfg;
+    XmaSession sess[TST_SCALER_CHANS + 1];
+    int rc = 0;
+    int i;
+
+    memset(sess, 0, sizeof(sess));
+    for (i = 0; i <= TST_SCALER_CHANS; i++) {
+        sess[i].chan_id = -1;
+        rc |= ck_assert_int_eq(xma_res_alloc_scal_kernel(shm, XMA_POLYPHASE_SCALER_TYPE,
+                                                         "Xilinx", &sess[i], false), 0);
+    }
+
+    /* channels fill the first kernel before the next one is used */
+    for (i = 0; i < TST_SCALER_CHANS; i++) {
+        rc |= ck_assert_int_eq(xma_res_dev_handle_get((XmaKernelRes*)sess[i].kern_res), 2);
+        rc |= ck_assert_int_eq(xma_res_kern_handle_get((XmaKernelRes*)sess[i].kern_res), 0);
+        rc |= ck_assert_int_eq(sess[i].chan_id, i);
+    }
+    rc |= ck_assert_int_eq(xma_res_kern_handle_get((XmaKernelRes*)sess[i].kern_res), 1);
+
+    for (i = 0; i <= TST_SCALER_CHANS; i++)
+        rc |= ck_assert_int_eq(xma_res_free_kernel(shm, sess[i].kern_res), 0);
+
+    return rc;
+}
+
+static int tst_check_placement(XmaSession *sess, int32_t dev, int32_t kern)
+{
+    int rc = 0;
+
+    rc |= ck_assert_int_eq(xma_res_dev_handle_get((XmaKernelRes*)sess->kern_res), dev);
+    rc |= ck_assert_int_eq(xma_res_kern_handle_get((XmaKernelRes*)sess->kern_res), kern);
+    return rc;
+}
+
+int xma_res_placement_spread_tst(void)
+{
+    extern XmaSingleton *g_xma_singleton;
+    XmaResources shm = g_xma_singleton->shm_res_cfg;
+    XmaSession sess[5];
+    int rc = 0;
+    int i;
+
+    g_xma_singleton->systemcfg.placement = XMA_PLACEMENT_SPREAD;
+    memset(sess, 0, sizeof(sess));
+    for (i = 0; i < 5; i++) {
+        sess[i].chan_id = -1;
+        rc |= ck_assert_int_eq(xma_res_alloc_scal_kernel(shm, XMA_POLYPHASE_SCALER_TYPE,
+                                                         "Xilinx", &sess[i], false), 0);
+    }
+
+    /* scalers are on devices 2 and 3: alternate devices, then kernels */
+    rc |= tst_check_placement(&sess[0], 2, 0);
+    rc |= tst_check_placement(&sess[1], 3, 0);
+    rc |= tst_check_placement(&sess[2], 2, 1);
+    rc |= tst_check_placement(&sess[3], 3, 1);
+    rc |= tst_check_placement(&sess[4], 2, 0);
+    rc |= ck_assert_int_eq(sess[4].chan_id, 1);
+
+    /* a device with free channels is preferred after a release */
+    rc |= ck_assert_int_eq(xma_res_free_kernel(shm, sess[1].kern_res), 0);
+    rc |= ck_assert_int_eq(xma_res_free_kernel(shm, sess[3].kern_res), 0);
+    memset(&sess[1], 0, sizeof(sess[1]));
+    sess[1].chan_id = -1;
+    rc |= ck_assert_int_eq(xma_res_alloc_scal_kernel(shm, XMA_POLYPHASE_SCALER_TYPE,
+                                                     "Xilinx", &sess[1], false), 0);
+    rc |= tst_check_placement(&sess[1], 3, 0);
+
+    /* frame rate is reported per kernel */
+    rc |= ck_assert_int_eq(xma_res_kernel_progress(shm, sess[1].kern_res, 1), 0);
+    rc |= ck_assert(xma_res_kernel_progress(shm, NULL, 1) != 0);
+
+    for (i = 0; i < 5; i++)
+        if (i != 3)
+            rc |= ck_assert_int_eq(xma_res_free_kernel(shm, sess[i].kern_res), 0);
+    g_xma_singleton->systemcfg.placement = XMA_PLACEMENT_PACK;
+
+    return rc;
+}
+
+int xma_res_placement_load_tst(void)
+{
+    extern XmaSingleton *g_xma_singleton;
+    XmaResources shm = g_xma_singleton->shm_res_cfg;
+    XmaSession sess[4];
+    XmaSession big;
+    int rc = 0;
+    int i;
+
+    g_xma_singleton->scalercfg[0].get_load = tst_scaler_get_load;
+    memset(sess, 0, sizeof(sess));
+    memset(&big, 0, sizeof(big));
+    big.chan_id = -1;
+
+    /* more than a kernel can take is never placed */
+    tst_scaler_load = XMA_MAX_KERNEL_LOAD + 1;
+    rc |= ck_assert_int_eq(xma_res_alloc_scal_kernel(shm, XMA_POLYPHASE_SCALER_TYPE,
+                                                     "Xilinx", &big, false),
+                           XMA_ERROR_NO_KERNEL);
+
+    /* two sessions of 40% fit a kernel, the third goes to the next one */
+    tst_scaler_load = XMA_MAX_KERNEL_LOAD * 4 / 10;
+    for (i = 0; i < 3; i++) {
+        sess[i].chan_id = -1;
+        rc |= ck_assert_int_eq(xma_res_alloc_scal_kernel(shm, XMA_POLYPHASE_SCALER_TYPE,
+                                                         "Xilinx", &sess[i], false), 0);
+    }
+    rc |= tst_check_placement(&sess[0], 2, 0);
+    rc |= tst_check_placement(&sess[1], 2, 0);
+    rc |= tst_check_placement(&sess[2], 2, 1);
+
+    /* 60% only fits the kernel with one 40% session */
+    tst_scaler_load = XMA_MAX_KERNEL_LOAD * 6 / 10;
+    sess[3].chan_id = -1;
+    rc |= ck_assert_int_eq(xma_res_alloc_scal_kernel(shm, XMA_POLYPHASE_SCALER_TYPE,
+                                                     "Xilinx", &sess[3], false), 0);
+    rc |= tst_check_placement(&sess[3], 2, 1);
+
+    /* releasing a session returns its load */
+    rc |= ck_assert_int_eq(xma_res_free_kernel(shm, sess[0].kern_res), 0);
+    memset(&sess[0], 0, sizeof(sess[0]));
+    sess[0].chan_id = -1;
+    rc |= ck_assert_int_eq(xma_res_alloc_scal_kernel(shm, XMA_POLYPHASE_SCALER_TYPE,
+                                                     "Xilinx", &sess[0], false), 0);
+    rc |= tst_check_placement(&sess[0], 2, 0);
+
+    for (i = 0; i < 4; i++)
+        rc |= ck_assert_int_eq(xma_res_free_kernel(shm, sess[i].kern_res), 0);
+    g_xma_singleton->scalercfg[0].get_load = NULL;
+
+    return rc;
+}
+
+/* Child process: create and destroy sessions, checking that no kernel
+ * instance is ever handed to two sessions at the same time */
+static int tst_stress_child(TstShared *shared, int id)
+{
+    extern XmaSingleton *g_xma_singleton;
+    XmaResources shm;
+    int rc = 0;
+
+    g_xma_singleton->shm_res_cfg = NULL;
+    shm = xma_res_shm_map(&g_xma_singleton->systemcfg);
+    if (!shm)
+        return -1;
+    g_xma_singleton->shm_res_cfg = shm;
+
+    for (int i = 0; i < TST_ITERATIONS; i++)
+    {
+        XmaSession sess;
+        int32_t dev, kern, ret;
+
+        memset(&sess, 0, sizeof(sess));
+        sess.chan_id = -1;
+        ret = xma_res_alloc_enc_kernel(shm, XMA_COPY_ENCODER_TYPE,
+                                       (i + id) % 2 ? "Xilinx" : "ACME",
+                                       &sess, false);
+        if (ret == XMA_ERROR_NO_KERNEL) {
+            __atomic_add_fetch(&shared->busy, 1, __ATOMIC_RELAXED);
+            sched_yield();
+            continue;
+        }
+        rc |= ck_assert_int_eq(ret, 0);
+        if (ret)
+            continue;
+
+        dev = xma_res_dev_handle_get((XmaKernelRes*)sess.kern_res);
+        kern = xma_res_kern_handle_get((XmaKernelRes*)sess.kern_res);
+        if (__atomic_fetch_add(&shared->holders[dev][kern], 1, __ATOMIC_SEQ_CST) != 0)
+            __atomic_add_fetch(&shared->errors, 1, __ATOMIC_RELAXED);
+        sched_yield();
+        __atomic_sub_fetch(&shared->holders[dev][kern], 1, __ATOMIC_SEQ_CST);
+
+        rc |= ck_assert_int_eq(xma_res_free_kernel(shm, sess.kern_res), 0);
+        __atomic_add_fetch(&shared->sessions, 1, __ATOMIC_RELAXED);
+    }
+
+    xma_res_shm_unmap(shm);
+    return rc;
+}
+
+int xma_res_multi_process_tst(void)
+{
+    extern XmaSingleton *g_xma_singleton;
+    pid_t pids[TST_NUM_PROCS];
+    TstShared *shared;
+    double start;
+    int rc = 0;
+
+    shared = (TstShared*)mmap(NULL, sizeof(TstShared), PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED)
+        return -1;
+    memset(shared, 0, sizeof(TstShared));
+
+    start = tst_now_sec();
+    for (int i = 0; i < TST_NUM_PROCS; i++)
+    {
+        pids[i] = fork();
+        if (pids[i] == 0)
+            _exit(tst_stress_child(shared, i) ? EXIT_FAILURE : EXIT_SUCCESS);
+        rc |= ck_assert(pids[i] > 0);
+    }
+
+    for (int i = 0; i < TST_NUM_PROCS; i++)
+    {
+        int status = 0;
+        if (pids[i] <= 0)
+            continue;
+        waitpid(pids[i], &status, 0);
+        rc |= ck_assert(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS);
+    }
+    double elapsed = tst_now_sec() - start;
+
+    rc |= ck_assert_int_eq(shared->errors, 0);
+    rc |= ck_assert(shared->sessions > 0);
+    rc |= ck_assert_int_eq(shared->sessions + shared->busy,
+                           TST_NUM_PROCS * TST_ITERATIONS);
+    printf("xmares: %d processes, %d sessions (%d busy retries) in %.3f s, "
+           "%.0f sessions/s\n", TST_NUM_PROCS, shared->sessions, shared->busy,
+           elapsed, shared->sessions / elapsed);
+
+    /* all children have released their kernels */
+    XmaSession sess;
+    memset(&sess, 0, sizeof(sess));
+    sess.chan_id = -1;
+    for (int i = 0; i < 4; i++) {
+        rc |= ck_assert_int_eq(xma_res_alloc_enc_kernel(g_xma_singleton->shm_res_cfg,
+                                                        XMA_COPY_ENCODER_TYPE, "Xilinx",
+                                                        &sess, false), 0);
+        sess.kern_res = NULL;
+    }
+
+    munmap(shared, sizeof(TstShared));
+    return rc;
+}
+
+/* Child process: look for the counters recorded by the parent */
+static int tst_stats_child(uint64_t frame_bytes)
+{
+    XmaSessionStats stats[MAX_STATS_SESSIONS];
+    int32_t cnt, i, found = 0;
+
+    cnt = xma_stats_list(stats, MAX_STATS_SESSIONS);
+    for (i = 0; i < cnt; i++) {
+        XmaStatsHist *send = &stats[i].latency[XMA_STATS_SEND];
+
+        if (stats[i].chan_id != 0)
+            continue;
+        /* calls take at least 3 us: none below the 2-4 us bucket (slow
+         * ones may land above it) */
+        if (stats[i].frames_in == 10 && stats[i].bytes_in == 10 * frame_bytes &&
+            stats[i].frames_out == 2 && stats[i].bytes_out == 100 &&
+            stats[i].queue_depth == 1 && stats[i].queue_max == 3 &&
+            send->count == 10 && send->buckets[0] == 0 && send->buckets[1] == 0 &&
+            send->max_ns >= 3000 && stats[i].plugin_ns >= 30000)
+            found++;
+    }
+    return cnt == 2 && found == 1 ? 0 : 1;
+}
+
+int xma_res_session_stats_tst(void)
+{
+    extern XmaSingleton *g_xma_singleton;
+    XmaResources shm = g_xma_singleton->shm_res_cfg;
+    XmaSessionStats stats[MAX_STATS_SESSIONS];
+    XmaSession sess[2];
+    XmaFrame frame;
+    uint64_t frame_bytes;
+    pid_t child;
+    int status;
+    int rc = 0;
+    int i;
+
+    memset(sess, 0, sizeof(sess));
+    for (i = 0; i < 2; i++) {
+        sess[i].session_type = XMA_SCALER;
+        sess[i].chan_id = -1;
+        rc |= ck_assert_int_eq(xma_res_alloc_scal_kernel(shm, XMA_POLYPHASE_SCALER_TYPE,
+                                                         "Xilinx", &sess[i], false), 0);
+    }
+    rc |= ck_assert(sess[0].metrics != NULL && sess[1].metrics != NULL);
+    rc |= ck_assert(sess[0].metrics != sess[1].metrics);
+
+    rc |= ck_assert_int_eq(xma_stats_list(stats, MAX_STATS_SESSIONS), 2);
+    rc |= ck_assert_int_eq(stats[0].pid, getpid());
+    rc |= ck_assert_int_eq(stats[0].session_type, XMA_SCALER);
+    rc |= ck_assert(strcmp(stats[0].vendor, "Xilinx") == 0);
+    rc |= ck_assert_int_eq(stats[0].dev_id, 2);
+    rc |= ck_assert_int_eq(xma_stats_list(stats, 1), 1);
+    rc |= ck_assert_int_eq(xma_stats_list(NULL, 1), XMA_ERROR_INVALID);
+
+    memset(&frame, 0, sizeof(frame));
+    frame.frame_props.format = XMA_YUV420_FMT_TYPE;
+    frame.frame_props.width = 1920;
+    frame.frame_props.height = 1080;
+    frame.frame_props.bits_per_pixel = 8;
+    frame_bytes = xma_stats_frame_bytes(&frame);
+    rc |= ck_assert(frame_bytes == 1920 * 1080 * 3 / 2);
+
+    for (i = 0; i < 10; i++) {
+        xma_stats_latency(&sess[0], XMA_STATS_SEND, xma_stats_now_ns() - 3000);
+        xma_stats_frames_in(&sess[0], 1, frame_bytes);
+    }
+    xma_stats_frames_out(&sess[0], 2, 100);
+    xma_stats_queue_depth(&sess[0], 3);
+    xma_stats_queue_depth(&sess[0], 1);
+
+    /* another process reads the counters from the database file */
+    child = fork();
+    if (child == 0)
+        _exit(tst_stats_child(frame_bytes));
+    waitpid(child, &status, 0);
+    rc |= ck_assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    /* a process exiting without closing its session is not listed */
+    child = fork();
+    if (child == 0) {
+        XmaSession orphan;
+
+        memset(&orphan, 0, sizeof(orphan));
+        orphan.session_type = XMA_SCALER;
+        orphan.chan_id = -1;
+        if (xma_res_alloc_scal_kernel(shm, XMA_POLYPHASE_SCALER_TYPE,
+                                      "Xilinx", &orphan, false) ||
+            !orphan.metrics)
+            _exit(1);
+        _exit(xma_stats_list(stats, MAX_STATS_SESSIONS) == 3 ? 0 : 1);
+    }
+    waitpid(child, &status, 0);
+    rc |= ck_assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    rc |= ck_assert_int_eq(xma_stats_list(stats, MAX_STATS_SESSIONS), 2);
+
+    for (i = 0; i < 2; i++) {
+        rc |= ck_assert_int_eq(xma_res_free_kernel(shm, sess[i].kern_res), 0);
+        rc |= ck_assert(sess[i].metrics == NULL);
+    }
+    rc |= ck_assert_int_eq(xma_stats_list(stats, MAX_STATS_SESSIONS), 0);
+
+    return rc;
+}
+
+int main()
+{
+    int number_failed = 0;
+    int32_t rc;
+
+    rc = tst_setup();
+    rc |= xma_res_kernel_index_tst();
+    rc |= tst_teardown_check();
+    if (rc != 0) {
+      number_failed++;
+    }
+
+    rc = tst_setup();
+    rc |= xma_res_kernel_chan_tst();
+    rc |= tst_teardown_check();
+    if (rc != 0) {
+      number_failed++;
+    }
+
+    rc = tst_setup();
+    rc |= xma_res_placement_spread_tst();
+    rc |= tst_teardown_check();
+    if (rc != 0) {
+      number_failed++;
+    }
+
+    rc = tst_setup();
+    rc |= xma_res_placement_load_tst();
+    rc |= tst_teardown_check();
+    if (rc != 0) {
+      number_failed++;
+    }
+
+    rc = tst_setup();
+    rc |= xma_res_multi_process_tst();
+    rc |= tst_teardown_check();
+    if (rc != 0) {
+      number_failed++;
+    }
+
+    rc = tst_setup();
+    rc |= xma_res_session_stats_tst();
+    rc |= tst_teardown_check();
+    if (rc != 0) {
+      number_failed++;
+    }
+
+   if (number_failed == 0) {
+     printf("XMA check_xmares test completed successfully\n");
+     return EXIT_SUCCESS;
+    } else {
+     printf("ERROR: XMA check_xmares test failed\n");
+     return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2018, Xilinx Inc - All rights reserved
+ * Xilinx SDAccel Media Accelerator API
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <memory.h>
+#include "xma.h"
+#include "lib/xmaapi.h"
+
+#define TST_THREADS    8
+
+extern XmaSingleton *g_xma_singleton;
+
+int ck_assert_int_eq(int rc1, int rc2) {
+  if (rc1 != rc2) {
+    return -1;
+  } else {
+    return 0;
+  }
+}
+
+int ck_assert(bool result) {
+  if (!result) {
+    return -1;
+  } else {
+    return 0;
+  }
+}
+
+int xma_scaler_default_coeff_tst()
+{
+    XmaScalerFilterProperties *props;
+    int rc = 0;
+
+    props = (XmaScalerFilterProperties*)calloc(1, sizeof(*props));
+    xma_scaler_default_filter_coeff_set(props);
+    rc |= ck_assert_int_eq(props->h_coeff0[0][5], 730);
+    rc |= ck_assert_int_eq(props->v_coeff3[63][0], 18);
+    rc |= ck_assert(memcmp(props->h_coeff0, props->v_coeff3,
+                           sizeof(props->h_coeff0)) == 0);
+    free(props);
+
+    return rc;
+}
+
+/* Every phase keeps the DC gain, unused columns are zero and phases p
+ * and 64 - p are mirror images */
+static int tst_coeff_check(const XmaScalerCoeffTable *table)
+{
+    int32_t pad = (12 - table->taps) / 2;
+    int32_t p, t;
+    int rc = 0;
+
+    for (p = 0; p < 64; p++)
+    {
+        int32_t sum = 0;
+
+        for (t = 0; t < 12; t++)
+        {
+            sum += table->coeff[p][t];
+            if (t < pad || t >= pad + table->taps)
+                rc |= ck_assert_int_eq(table->coeff[p][t], 0);
+        }
+        rc |= ck_assert_int_eq(sum, 4096);
+        if (p == 0)
+            continue;
+        for (t = 0; t < table->taps; t++)
+            rc |= ck_assert(abs(table->coeff[p][pad + t] -
+                    table->coeff[64 - p][pad + table->taps - 1 - t]) <= 1);
+    }
+    return rc;
+}
+
+int xma_scaler_coeff_get_tst()
+{
+    const XmaScalerCoeffTable *t12, *t6, *up;
+    int rc = 0;
+
+    t12 = xma_scaler_filter_coeff_get(1920, 1280, 12);
+    t6 = xma_scaler_filter_coeff_get(1920, 1280, 6);
+    up = xma_scaler_filter_coeff_get(1280, 1920, 12);
+    rc |= ck_assert(t12 != NULL && t6 != NULL && up != NULL);
+    if (rc)
+        return rc;
+
+    rc |= ck_assert_int_eq(t12->in_size, 1920);
+    rc |= ck_assert_int_eq(t12->out_size, 1280);
+    rc |= ck_assert_int_eq(t6->taps, 6);
+    rc |= tst_coeff_check(t12);
+    rc |= tst_coeff_check(t6);
+    rc |= tst_coeff_check(up);
+
+    /* upscaling at phase 0 samples an input pixel exactly */
+    rc |= ck_assert_int_eq(up->coeff[0][5], 4096);
+    /* downscaling low-pass filters */
+    rc |= ck_assert(t12->coeff[0][5] < 4096);
+    rc |= ck_assert(t12->coeff[0][4] > 0);
+
+    /* cached: the same table for the same key */
+    rc |= ck_assert(xma_scaler_filter_coeff_get(1920, 1280, 12) == t12);
+    rc |= ck_assert(xma_scaler_filter_coeff_get(1920, 1280, 6) == t6);
+    rc |= ck_assert(t12 != t6 && t12 != up);
+
+    rc |= ck_assert(xma_scaler_filter_coeff_get(1920, 1280, 0) == NULL);
+    rc |= ck_assert(xma_scaler_filter_coeff_get(1920, 1280, 7) == NULL);
+    rc |= ck_assert(xma_scaler_filter_coeff_get(1920, 1280, 14) == NULL);
+    rc |= ck_assert(xma_scaler_filter_coeff_get(0, 1280, 12) == NULL);
+
+    return rc;
+}
+
+static void *tst_coeff_thread(void *data)
+{
+    return (void*)xma_scaler_filter_coeff_get(3840, 640, 8);
+}
+
+int xma_scaler_coeff_threads_tst()
+{
+    pthread_t threads[TST_THREADS];
+    void *tables[TST_THREADS];
+    int32_t i;
+    int rc = 0;
+
+    for (i = 0; i < TST_THREADS; i++)
+        pthread_create(&threads[i], NULL, tst_coeff_thread, NULL);
+    for (i = 0; i < TST_THREADS; i++)
+        pthread_join(threads[i], &tables[i]);
+
+    rc |= ck_assert(tables[0] != NULL);
+    for (i = 1; i < TST_THREADS; i++)
+        rc |= ck_assert(tables[i] == tables[0]);
+
+    return rc;
+}
+
+static int tst_setup(void)
+{
+    int rc = 0;
+
+    g_xma_singleton = (XmaSingleton*)calloc(1, sizeof(*g_xma_singleton));
+    rc |= ck_assert_int_eq(xma_logger_init(&g_xma_singleton->logger), 0);
+    g_xma_singleton->logger.log_level = XMA_CRITICAL_LOG;
+
+    return rc;
+}
+
+static void tst_teardown(void)
+{
+    xma_logger_close(&g_xma_singleton->logger);
+    free(g_xma_singleton);
+    g_xma_singleton = NULL;
+}
+
+int main()
+{
+    int number_failed = 0;
+    int32_t rc;
+
+    rc = tst_setup();
+    rc |= xma_scaler_default_coeff_tst();
+    if (rc != 0) {
+      number_failed++;
+    }
+
+    rc = xma_scaler_coeff_get_tst();
+    if (rc != 0) {
+      number_failed++;
+    }
+
+    rc = xma_scaler_coeff_threads_tst();
+    if (rc != 0) {
+      number_failed++;
+    }
+    tst_teardown();
+
+   if (number_failed == 0) {
+     printf("XMA check_xmascaler test completed successfully\n");
+     return EXIT_SUCCESS;
+    } else {
+     printf("ERROR: XMA check_xmascaler test failed\n");
+     return EXIT_FAILURE;
+    }
+}
@@ -28,6 +28,19 @@ static int32_t xma_encoder_close(XmaEncoderSession *sess)
     return 0;
 }
 
+/* Kernel is sized for one 4K60 stream */
+static int32_t xma_encoder_get_load(XmaSession *pending_sess, uint32_t *load)
+{
+    XmaEncoderProperties *props = &to_xma_encoder(pending_sess)->encoder_props;
+    uint64_t pixel_rate = 0;
+
+    if (props->framerate.denominator > 0)
+        pixel_rate = (uint64_t)props->width * props->height *
+                     props->framerate.numerator / props->framerate.denominator;
+    *load = pixel_rate * XMA_MAX_KERNEL_LOAD / (3840 * 2160 * 60);
+    return 0;
+}
+
 XmaEncoderPlugin encoder_plugin = {
     .hwencoder_type = XMA_COPY_ENCODER_TYPE,
     .hwvendor_string = "Xilinx",
@@ -41,4 +54,5 @@ XmaEncoderPlugin encoder_plugin = {
     .close = xma_encoder_close,
     .alloc_chan = NULL,
     .get_dev_input_paddr = NULL,
+    .get_load = xma_encoder_get_load,
 };